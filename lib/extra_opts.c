@@ -39,80 +39,53 @@ is_option2 (char *str)
 
 /* this is the externally visible function used by plugins */
 char **np_extra_opts(int *argc, char **argv, const char *plugin_name){
-	np_arg_list *extra_args=NULL, *ea1=NULL, *ea_tmp=NULL;
+	np_arg_list *extra_args=NULL, **ea_tail=&extra_args, *ea1=NULL;
 	char **argv_new=NULL;
 	char *argptr=NULL;
-	int i, j, optfound, argc_new, ea_num=*argc;
+	int i, kept, argc_new, ea_num=0;
 
 	if(*argc<2) {
 		/* No arguments provided */
 		return argv;
 	}
 
-	for(i=1; i<*argc; i++){
-		argptr=NULL;
-		optfound=0;
-
+	/* Single pass: plain arguments are moved down over the removed
+	 * extra-opts ones, ini arguments are appended to extra_args */
+	for(i=1, kept=1; i<*argc; i++){
 		/* Do we have an extra-opts parameter? */
 		if(strncmp(argv[i], "--extra-opts=", 13)==0){
 			/* It is a single argument with value */
 			argptr=argv[i]+13;
-			/* Delete the extra opts argument */
-			for(j=i;j<*argc;j++) argv[j]=argv[j+1];
-			i--;
-			*argc-=1;
 		}else if(strcmp(argv[i], "--extra-opts")==0){
 			if((i+1<*argc)&&!is_option2(argv[i+1])){
 				/* It is a argument with separate value */
-				argptr=argv[i+1];
-				/* Delete the extra-opts argument/value */
-				for(j=i;j<*argc-1;j++) argv[j]=argv[j+2];
-				i-=2;
-				*argc-=2;
-				ea_num--;
+				argptr=argv[++i];
 			}else{
 				/* It has no value */
-				optfound=1;
-				/* Delete the extra opts argument */
-				for(j=i;j<*argc;j++) argv[j]=argv[j+1];
-				i--;
-				*argc-=1;
+				argptr=NULL;
 			}
+		}else{
+			argv[kept++]=argv[i];
+			continue;
 		}
 
-		/* If we found extra-opts, expand them and store them for later*/
-		if(argptr||optfound){
-			/* Process ini section, returning a linked list of arguments */
-			ea1=np_get_defaults(argptr, plugin_name);
-			if(ea1==NULL) {
-				/* no extra args (empty section)? */
-				ea_num--;
-				continue;
-			}
-
-			/* append the list to extra_args */
-			if(extra_args==NULL){
-				extra_args=ea1;
-				while((ea1=ea1->next)) ea_num++;
-			}else{
-				ea_tmp=extra_args;
-				while(ea_tmp->next) {
-					ea_tmp=ea_tmp->next;
-				}
-				ea_tmp->next=ea1;
-				while((ea1=ea1->next)) ea_num++;
-			}
-			ea1=ea_tmp=NULL;
-		}
+		/* Process ini section, returning a linked list of arguments */
+		*ea_tail=np_get_defaults(argptr, plugin_name);
+		/* keep the tail so the next section is appended in O(1) */
+		for(; *ea_tail; ea_tail=&(*ea_tail)->next) ea_num++;
 	} /* lather, rince, repeat */
 
-	if(ea_num==*argc && extra_args==NULL){
-		/* No extra-opts */
+	/* Terminate what is left of the original array */
+	*argc=kept;
+	argv[kept]=NULL;
+
+	if(extra_args==NULL){
+		/* No extra-opts, or they were all empty */
 		return argv;
 	}
 
 	/* done processing arguments. now create a new argv array... */
-	argv_new=(char**)malloc((ea_num+1)*sizeof(char*));
+	argv_new=(char**)malloc((ea_num+kept+1)*sizeof(char*));
 	if(argv_new==NULL) die(STATE_UNKNOWN, _("malloc() failed!\n"));
 
 	/* starting with program name */
@@ -133,4 +106,3 @@ char **np_extra_opts(int *argc, char **argv, const char *plugin_name){
 
 	return argv_new;
 }
-
@@ -23,12 +23,15 @@
 
 #include "common.h"
 #include "utils_base.h"
+#include "utils_str.h"
 #include "parse_ini.h"
 #include "../gl/idpriv.h"
 #include <ctype.h>
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
 #include <unistd.h>
 
 /* np_ini_info contains the result of parsing a "locator" in the format
@@ -66,13 +69,57 @@ static char *default_ini_path_names[] = {
 	NULL
 };
 
-/* eat all characters from a FILE pointer until n is encountered */
-#define GOBBLE_TO(f, c, n) do { (c)=fgetc((f)); } while((c)!=EOF && (c)!=(n))
+/* one [section] of a loaded ini file, pointing into the file buffer */
+typedef struct {
+	const char *name;	/* NULL for a header without closing ']' */
+	size_t name_len;
+	const char *body;	/* first byte after the header */
+	const char *end;	/* start of the next header or end of file */
+	size_t order;		/* position in the file, a section may repeat */
+} np_ini_section;
+
+/* an ini file loaded into memory with an index of its sections, sorted
+ * by name so a stanza is found with a binary search */
+typedef struct {
+	dev_t dev;
+	ino_t ino;
+	time_t mtime;
+	off_t size;
+	char *buf;
+	size_t len;
+	int mapped;	/* buf is mmap()ed rather than malloc()ed */
+	np_ini_section *sections;
+	size_t nsections;
+} np_ini_file;
+
+/* header of a pre-parsed cache file, followed by one offset per section
+ * and the sections themselves as "name\0arg\0arg\0\0", sorted by name */
+#define NP_INI_CACHE_MAGIC "NPINI01"
+typedef struct {
+	char magic[8];
+	dev_t dev;
+	ino_t ino;
+	time_t mtime;
+	off_t size;
+	uint32_t count;
+} np_ini_cache_header;
+
+/* the last file loaded, several --extra-opts usually point to the same one */
+static np_ini_file *last_file=NULL;
 
+/* internal functions that load and index an ini file */
+static np_ini_file *load_file(int fd, const struct stat *st);
+static np_ini_file *load_stream(FILE *f);
+static void free_file(np_ini_file *f);
+static int index_sections(np_ini_file *f);
 /* internal function that returns the constructed defaults options */
-static int read_defaults(FILE *f, const char *stanza, np_arg_list **opts);
+static int read_defaults(np_ini_file *f, const char *stanza, np_arg_list **opts);
 /* internal function that converts a single line into options format */
-static int add_option(FILE *f, np_arg_list **optlst);
+static np_arg_list *add_option(const char *line, const char *end);
+/* internal functions for the pre-parsed cache */
+static char *cache_file(const struct stat *st);
+static int read_cache(const struct stat *st, const char *stanza, np_arg_list **opts);
+static void write_cache(np_ini_file *f);
 /* internal functions to find default file */
 static char* default_file(void);
 static char* default_file_in_path(void);
@@ -116,10 +163,11 @@ static void parse_locator(const char *locator, const char *def_stanza, np_ini_in
 
 /* this is the externally visible function used by extra_opts */
 np_arg_list* np_get_defaults(const char *locator, const char *default_section){
-	FILE *inifile=NULL;
+	np_ini_file *inifile=NULL;
 	np_arg_list *defaults=NULL;
 	np_ini_info i;
-	struct stat fstat;
+	struct stat st;
+	int fd, status=-1;
 	bool is_suid_set = np_suid();
 
 	if (is_suid_set && idpriv_temp_drop() == -1) 
@@ -129,29 +177,42 @@ np_arg_list* np_get_defaults(const char *locator, const char *default_section){
 	/* If a file was specified or if we're using the default file. */
 	if (i.file != NULL && strlen(i.file) > 0) {
 		if (strcmp(i.file, "-") == 0) {
-			inifile = stdin;
+			inifile = load_stream(stdin);
 		} else {
 			/* We must be able to stat() the thing. */
-			if (lstat(i.file, &fstat) != 0)
+			if (lstat(i.file, &st) != 0)
 				die(STATE_UNKNOWN, "%s %s\n", _("Can't read config file."), strerror(errno));
 			/* The requested file must be a regular file. */
-			if (!S_ISREG(fstat.st_mode))
+			if (!S_ISREG(st.st_mode))
 				die(STATE_UNKNOWN, "%s\n", _("Can't read config file. Requested path is not a regular file."));
 			/* We must be able to read the requested file. */
 			if (access(i.file, R_OK|F_OK) != 0)
 				die(STATE_UNKNOWN, "%s %s\n", _("Can't read config file."), strerror(errno));
 			/* We need to successfully open the file for reading... */
-			if ((inifile=fopen(i.file, "r")) == NULL)
+			if ((fd=open(i.file, O_RDONLY)) == -1 || fstat(fd, &st) != 0)
 				die(STATE_UNKNOWN, "%s %s\n", _("Can't read config file."), strerror(errno));
+			/* a valid pre-parsed cache saves reading the file at all */
+			status=read_cache(&st, i.stanza, &defaults);
+			if (status == -1 && (inifile=load_file(fd, &st)) != last_file) {
+				write_cache(inifile);
+				free_file(last_file);
+				last_file = inifile;
+			}
+			close(fd);
 		}
 
-		/* before attempting access, let's make sure inifile is not null, this should never be the case though */
-		if (inifile == NULL)
-			die(STATE_UNKNOWN, "%s %s\n", _("Can't read config file:"), strerror(errno));
-		/* inifile points to an open FILE our ruid/rgid can access, parse its contents. */
-		if (read_defaults(inifile, i.stanza, &defaults) == FALSE)
+		if (status == -1) {
+			/* before attempting access, let's make sure inifile is not null, this should never be the case though */
+			if (inifile == NULL)
+				die(STATE_UNKNOWN, "%s %s\n", _("Can't read config file:"), strerror(errno));
+			/* inifile holds the contents our ruid/rgid can access, parse them. */
+			status=read_defaults(inifile, i.stanza, &defaults);
+			/* a stream is read again next time */
+			if (inifile != last_file)
+				free_file(inifile);
+		}
+		if (status == FALSE)
 			die(STATE_UNKNOWN,"%s%s%s%s'\n", _("Invalid section '"), i.stanza, _("' in config file '"), i.file);
-		if (inifile != stdin) fclose(inifile);
 	}
 
 	if (i.file != NULL) {
@@ -169,186 +230,409 @@ np_arg_list* np_get_defaults(const char *locator, const char *default_section){
 	return defaults;
 }
 
-/* read_defaults is where the meat of the parsing takes place.
+/* map a regular ini file into memory and index it, reusing the last file
+ * if it is still the same one */
+static np_ini_file *load_file(int fd, const struct stat *st){
+	np_ini_file *f;
+
+	if (last_file && last_file->dev == st->st_dev && last_file->ino == st->st_ino &&
+	    last_file->mtime == st->st_mtime && last_file->size == st->st_size)
+		return last_file;
+
+	if((f=calloc(1, sizeof(np_ini_file)))==NULL)
+		die(STATE_UNKNOWN, "%s\n", _("malloc() failed!"));
+	f->dev=st->st_dev;
+	f->ino=st->st_ino;
+	f->mtime=st->st_mtime;
+	f->size=st->st_size;
+	f->len=(size_t)st->st_size;
+	/* an empty file can't be mapped, but has no sections either */
+	if(f->len>0){
+		f->buf=mmap(NULL, f->len, PROT_READ, MAP_PRIVATE, fd, 0);
+		if(f->buf==MAP_FAILED)
+			die(STATE_UNKNOWN, "%s %s\n", _("Can't read config file."), strerror(errno));
+		f->mapped=TRUE;
+	}
+	if(index_sections(f)==FALSE)
+		die(STATE_UNKNOWN, "%s\n", _("Config file error"));
+	return f;
+}
+
+/* read a stream that can't be mapped (stdin) into memory and index it */
+static np_ini_file *load_stream(FILE *stream){
+	np_ini_file *f;
+	size_t size=0, n;
+
+	if((f=calloc(1, sizeof(np_ini_file)))==NULL)
+		die(STATE_UNKNOWN, "%s\n", _("malloc() failed!"));
+	do {
+		if(f->len==size){
+			size=size?size<<1:BUFSIZ;
+			if((f->buf=realloc(f->buf, size))==NULL)
+				die(STATE_UNKNOWN, "%s\n", _("malloc() failed!"));
+		}
+		n=fread(f->buf+f->len, 1, size-f->len, stream);
+		f->len+=n;
+	} while(n>0);
+	if(ferror(stream))
+		die(STATE_UNKNOWN, "%s %s\n", _("Can't read config file."), strerror(errno));
+	if(index_sections(f)==FALSE)
+		die(STATE_UNKNOWN, "%s\n", _("Config file error"));
+	return f;
+}
+
+/* release a file loaded by load_file() or load_stream() */
+static void free_file(np_ini_file *f){
+	if(f==NULL)
+		return;
+	if(f->mapped)
+		munmap(f->buf, f->len);
+	else
+		free(f->buf);
+	free(f->sections);
+	free(f);
+}
+
+static const char *line_end(const char *p, const char *end){
+	const char *eol=memchr(p, '\n', (size_t)(end-p));
+	return eol?eol:end;
+}
+
+static int compare_names(const np_ini_section *s1, const np_ini_section *s2){
+	size_t len=s1->name_len<s2->name_len?s1->name_len:s2->name_len;
+	int diff;
+
+	/* unnamed sections sort last, they can never match */
+	if(s1->name==NULL || s2->name==NULL)
+		return (s1->name==NULL)-(s2->name==NULL);
+	if((diff=memcmp(s1->name, s2->name, len))==0 && s1->name_len!=s2->name_len)
+		diff=s1->name_len<s2->name_len?-1:1;
+	return diff;
+}
+
+/* sort by name, repeated sections stay in file order */
+static int compare_sections(const void *a, const void *b){
+	const np_ini_section *s1=a, *s2=b;
+	int diff=compare_names(s1, s2);
+
+	if(diff==0)
+		diff=s1->order<s2->order?-1:(s1->order>s2->order);
+	return diff;
+}
+
+/* index_sections is where the meat of the parsing takes place. It walks
+ * the file once and records where every section starts and ends.
  *
  * note that this may be called by a setuid binary, so we need to
  * be extra careful about user-supplied input (i.e. avoiding possible
  * format string vulnerabilities, etc)
  */
-static int read_defaults(FILE *f, const char *stanza, np_arg_list **opts){
-	int c, status=FALSE;
-	size_t i, stanza_len;
-	enum { NOSTANZA, WRONGSTANZA, RIGHTSTANZA } stanzastate=NOSTANZA;
+static int index_sections(np_ini_file *f){
+	const char *p=f->buf, *end=f->buf+f->len, *q, *e;
+	np_ini_section *s;
+	size_t alloc=0;
 
-	stanza_len=strlen(stanza);
-
-	/* our little stanza-parsing state machine.  */
-	while((c=fgetc(f))!=EOF){
+	while(p<end){
 		/* gobble up leading whitespace */
-		if(isspace(c)) continue;
-		switch(c){
+		if(isspace((unsigned char)*p)){
+			p++;
+			continue;
+		}
+		switch(*p){
 			/* globble up comment lines */
 			case ';':
 			case '#':
-				GOBBLE_TO(f, c, '\n');
+				p=line_end(p, end);
 				break;
-			/* start of a stanza.  check to see if it matches */
+			/* start of a stanza, the previous one ends here */
 			case '[':
-				stanzastate=WRONGSTANZA;
-				for(i=0; i<stanza_len; i++){
-					c=fgetc(f);
-					/* Strip leading whitespace */
-					if(i==0) for(; isspace(c); c=fgetc(f));
-					/* nope, read to the end of the line */
-					if(c!=stanza[i]) {
-						GOBBLE_TO(f, c, '\n');
-						break;
-					}
+				if(f->nsections>0)
+					f->sections[f->nsections-1].end=p;
+				if(f->nsections==alloc){
+					alloc=alloc?alloc<<1:16;
+					f->sections=realloc(f->sections, alloc*sizeof(np_ini_section));
+					if(f->sections==NULL) die(STATE_UNKNOWN, "%s\n", _("malloc() failed!"));
 				}
-				/* if it matched up to here and the next char is ']'... */
-				if(i==stanza_len){
-					c=fgetc(f);
-					/* Strip trailing whitespace */
-					for(; isspace(c); c=fgetc(f));
-					if(c==']') stanzastate=RIGHTSTANZA;
+				s=&f->sections[f->nsections];
+				s->order=f->nsections++;
+				/* the name runs to the ']' on the same line, stripped of whitespace */
+				for(q=++p; q<end && *q!=']' && *q!='\n'; q++);
+				if(q<end && *q==']'){
+					for(; p<q && isspace((unsigned char)*p); p++);
+					for(e=q; e>p && isspace((unsigned char)e[-1]); e--);
+					s->name=p;
+					s->name_len=(size_t)(e-p);
+					p=q+1;
+				} else {
+					s->name=NULL;
+					s->name_len=0;
+					p=q;
 				}
+				s->body=p;
 				break;
 			/* otherwise, we're in the body of a stanza or a parse error */
 			default:
-				switch(stanzastate){
-					/* we never found the start of the first stanza, so
-					 * we're dealing with a config error
-					 */
-					case NOSTANZA:
-						die(STATE_UNKNOWN, "%s\n", _("Config file error"));
-					/* we're in a stanza, but for a different plugin */
-					case WRONGSTANZA:
-						GOBBLE_TO(f, c, '\n');
-						break;
-					/* okay, this is where we start taking the config */
-					case RIGHTSTANZA:
-						ungetc(c, f);
-						if(add_option(f, opts)){
-							die(STATE_UNKNOWN, "%s\n", _("Config file error"));
-						}
-						status=TRUE;
-						break;
-				}
+				/* we never found the start of the first stanza, so
+				 * we're dealing with a config error
+				 */
+				if(f->nsections==0)
+					return FALSE;
+				p=line_end(p, end);
 				break;
 		}
 	}
-	return status;
+	if(f->nsections>0){
+		f->sections[f->nsections-1].end=end;
+		qsort(f->sections, f->nsections, sizeof(np_ini_section), compare_sections);
+	}
+	return TRUE;
 }
 
-/*
- * read one line of input in the format
- * 	^option[[:space:]]*(=[[:space:]]*value)?
- * and creates it as a cmdline argument
- * 	--option[=value]
- * appending it to the linked list optbuf.
- */
-static int add_option(FILE *f, np_arg_list **optlst){
-	np_arg_list *opttmp=*optlst, *optnew;
-	char *linebuf=NULL, *lineend=NULL, *optptr=NULL, *optend=NULL;
-	char *eqptr=NULL, *valptr=NULL, *valend=NULL;
-	short done_reading=0, equals=0, value=0;
-	size_t cfg_len=0, read_sz=8, linebuf_sz=0, read_pos=0;
-	size_t opt_len=0, val_len=0;
-
-	/* read one line from the file */
-	while(!done_reading){
-		/* grow if necessary */
-		if(linebuf==NULL || read_pos+read_sz >= linebuf_sz){
-			linebuf_sz=(linebuf_sz>0)?linebuf_sz<<1:read_sz;
-			linebuf=realloc(linebuf, linebuf_sz);
-			if(linebuf==NULL) die(STATE_UNKNOWN, "%s\n", _("malloc() failed!"));
+/* append the options of one section body to the list at *tail, returns
+ * the number of options or -1 on a syntax error */
+static int read_section(const np_ini_section *s, np_arg_list ***tail){
+	const char *p=s->body, *eol;
+	int count=0;
+
+	while(p<s->end){
+		if(isspace((unsigned char)*p)){
+			p++;
+			continue;
 		}
-		if(fgets(&linebuf[read_pos], (int)read_sz, f)==NULL) done_reading=1;
-		else {
-			read_pos=strlen(linebuf);
-			if(linebuf[read_pos-1]=='\n') {
-				linebuf[--read_pos]='\0';
-				done_reading=1;
-			}
+		eol=line_end(p, s->end);
+		if(*p!=';' && *p!='#'){
+			if((**tail=add_option(p, eol))==NULL)
+				return -1;
+			*tail=&(**tail)->next;
+			count++;
 		}
+		p=eol;
 	}
-	lineend=&linebuf[read_pos];
-	/* all that to read one line.  isn't C fun? :) now comes the parsing :/ */
-
-	/* skip leading whitespace */
-	for(optptr=linebuf; optptr<lineend && isspace(*optptr); optptr++);
-	/* continue to '=' or EOL, watching for spaces that might precede it */
-	for(eqptr=optptr; eqptr<lineend && *eqptr!='='; eqptr++){
-		if(isspace(*eqptr) && optend==NULL) optend=eqptr;
-		else optend=NULL;
-	}
-	if(optend==NULL) optend=eqptr;
-	--optend;
-	/* ^[[:space:]]*=foo is a syntax error */
-	if(optptr==eqptr) die(STATE_UNKNOWN, "%s\n", _("Config file error"));
-	/* continue from '=' to start of value or EOL */
-	for(valptr=eqptr+1; valptr<lineend && isspace(*valptr); valptr++);
-	/* continue to the end of value */
-	for(valend=valptr; valend<lineend; valend++);
-	--valend;
-	/* Finally trim off trailing spaces */
-	for(; isspace(*valend); valend--);
-	/* calculate the length of "--foo" */
-	opt_len=(size_t)(1+optend-optptr);
-	/* 1-character params needs only one dash */
-	if(opt_len==1)
-		cfg_len=1+(opt_len);
-	else
-		cfg_len=2+(opt_len);
-	/* if valptr<lineend then we have to also allocate space for "=bar" */
-	if(valptr<lineend) {
-		equals=value=1;
-		val_len=(size_t)(1+valend-valptr);
-		cfg_len+=1+val_len;
+	return count;
+}
+
+/* collect the options of every section named stanza, in file order */
+static int read_defaults(np_ini_file *f, const char *stanza, np_arg_list **opts){
+	np_ini_section key;
+	np_arg_list **tail=opts;
+	size_t lo=0, hi=f->nsections, mid;
+	int status=FALSE;
+
+	key.name=stanza;
+	key.name_len=strlen(stanza);
+	/* binary search for the first section of that name */
+	while(lo<hi){
+		mid=lo+(hi-lo)/2;
+		if(compare_names(&f->sections[mid], &key)<0)
+			lo=mid+1;
+		else
+			hi=mid;
 	}
-	/* if valptr==valend then we have "=" but no "bar" */
-	else if(valptr==lineend) {
-		equals=1;
-		cfg_len+=1;
+	for(; lo<f->nsections && compare_names(&f->sections[lo], &key)==0; lo++){
+		switch(read_section(&f->sections[lo], &tail)){
+			case -1:
+				die(STATE_UNKNOWN, "%s\n", _("Config file error"));
+			case 0:
+				break;
+			default:
+				status=TRUE;
+				break;
+		}
 	}
-	/* A line with no equal sign isn't valid */
-	if(equals==0) die(STATE_UNKNOWN, "%s\n", _("Config file error"));
+	return status;
+}
+
+/*
+ * convert one line in the format
+ * 	^option[[:space:]]*(=[[:space:]]*value)?
+ * into a cmdline argument
+ * 	--option[=value]
+ * returned as a new np_arg_list element, or NULL on a syntax error.
+ */
+static np_arg_list *add_option(const char *line, const char *end){
+	np_arg_list *optnew;
+	const char *eqptr, *optend, *valptr, *valend;
+	size_t opt_len, val_len, read_pos=0;
+
+	/* A line with no equal sign isn't valid, neither is ^=foo */
+	if((eqptr=memchr(line, '=', (size_t)(end-line)))==NULL || eqptr==line)
+		return NULL;
+	/* trim whitespace around the option name and the value */
+	for(optend=eqptr; optend>line && isspace((unsigned char)optend[-1]); optend--);
+	for(valptr=eqptr+1; valptr<end && isspace((unsigned char)*valptr); valptr++);
+	for(valend=end; valend>valptr && isspace((unsigned char)valend[-1]); valend--);
+	opt_len=(size_t)(optend-line);
+	val_len=(size_t)(valend-valptr);
 
-	/* okay, now we have all the info we need, so we create a new np_arg_list
-	 * element and set the argument...
-	 */
 	optnew=malloc(sizeof(np_arg_list));
+	/* room for "--", "=" and the terminating NUL */
+	if(optnew==NULL || (optnew->arg=malloc(opt_len+val_len+4))==NULL)
+		die(STATE_UNKNOWN, "%s\n", _("malloc() failed!"));
 	optnew->next=NULL;
 
-	read_pos=0;
-	optnew->arg=malloc(cfg_len+1);
 	/* 1-character params needs only one dash */
-	if(opt_len==1) {
-		strncpy(&optnew->arg[read_pos], "-", 1);
-		read_pos+=1;
-	} else {
-		strncpy(&optnew->arg[read_pos], "--", 2);
-		read_pos+=2;
-	}
-	strncpy(&optnew->arg[read_pos], optptr, opt_len); read_pos+=opt_len;
-	if(value) {
+	optnew->arg[read_pos++]='-';
+	if(opt_len>1)
+		optnew->arg[read_pos++]='-';
+	memcpy(&optnew->arg[read_pos], line, opt_len); read_pos+=opt_len;
+	/* "foo=" without a value is a flag */
+	if(val_len>0) {
 		optnew->arg[read_pos++]='=';
-		strncpy(&optnew->arg[read_pos], valptr, val_len); read_pos+=val_len;
+		memcpy(&optnew->arg[read_pos], valptr, val_len); read_pos+=val_len;
 	}
 	optnew->arg[read_pos]='\0';
 
-	/* ...and put that to the end of the list */
-	if(*optlst==NULL) {
-		*optlst=optnew;
-	}	else {
-		while(opttmp->next!=NULL) {
-			opttmp=opttmp->next;
+	return optnew;
+}
+
+/*
+ * The pre-parsed cache is only used if NAGIOS_PLUGIN_INI_CACHE names a
+ * directory. Each ini file gets a cache file named after its device and
+ * inode, valid as long as the file's mtime and size are unchanged.
+ */
+static char *cache_file(const struct stat *st){
+	char *dir, *path;
+
+	/* Do not allow redirecting the cache in setuid plugins */
+	if(np_suid() || (dir=getenv("NAGIOS_PLUGIN_INI_CACHE"))==NULL || dir[0]=='\0')
+		return NULL;
+	if(asprintf(&path, "%s/ini-%lu-%lu.cache", dir, (unsigned long)st->st_dev, (unsigned long)st->st_ino)<0)
+		die(STATE_UNKNOWN, "%s\n", _("Insufficient Memory"));
+	return path;
+}
+
+static int compare_cache_names(const void *key, const void *offset){
+	const char *base=((const char **)key)[1];
+
+	return strcmp(((const char **)key)[0], base+*(const uint32_t *)offset);
+}
+
+/* look stanza up in the cache, returns TRUE or FALSE like read_defaults,
+ * or -1 if there is no usable cache */
+static int read_cache(const struct stat *st, const char *stanza, np_arg_list **opts){
+	np_ini_cache_header hdr;
+	np_arg_list **tail=opts;
+	struct stat cst;
+	const char *key[2], *base, *p, *end;
+	const uint32_t *offsets, *found;
+	char *path;
+	int fd, status=-1;
+	uint32_t n;
+
+	if((path=cache_file(st))==NULL)
+		return -1;
+	fd=open(path, O_RDONLY);
+	free(path);
+	if(fd==-1)
+		return -1;
+	/* only trust a cache nobody else could have written */
+	if(fstat(fd, &cst)!=0 || !S_ISREG(cst.st_mode) || cst.st_uid!=geteuid() ||
+	   (cst.st_mode & (S_IWGRP|S_IWOTH)) || (size_t)cst.st_size<sizeof(hdr)+2 ||
+	   (base=mmap(NULL, (size_t)cst.st_size, PROT_READ, MAP_PRIVATE, fd, 0))==MAP_FAILED){
+		close(fd);
+		return -1;
+	}
+	close(fd);
+
+	end=base+cst.st_size;
+	memcpy(&hdr, base, sizeof(hdr));
+	if(memcmp(hdr.magic, NP_INI_CACHE_MAGIC, sizeof(hdr.magic)) || hdr.dev!=st->st_dev ||
+	   hdr.ino!=st->st_ino || hdr.mtime!=st->st_mtime || hdr.size!=st->st_size ||
+	   hdr.count>((size_t)cst.st_size-sizeof(hdr))/sizeof(uint32_t) || end[-1]!='\0'){
+		munmap((void *)base, (size_t)cst.st_size);
+		return -1;
+	}
+	offsets=(const uint32_t *)(base+sizeof(hdr));
+	for(n=0; n<hdr.count; n++)
+		if(offsets[n]<sizeof(hdr) || offsets[n]>=(size_t)cst.st_size){
+			munmap((void *)base, (size_t)cst.st_size);
+			return -1;
+		}
+
+	key[0]=stanza;
+	key[1]=base;
+	status=FALSE;
+	if((found=bsearch(key, offsets, hdr.count, sizeof(uint32_t), compare_cache_names))!=NULL){
+		/* the arguments follow the name, up to an empty string */
+		for(p=base+*found; p<end && *p; ){
+			p+=strlen(p)+1;
+			if(p>=end || *p=='\0')
+				break;
+			if((*tail=malloc(sizeof(np_arg_list)))==NULL || ((*tail)->arg=strdup(p))==NULL)
+				die(STATE_UNKNOWN, "%s\n", _("malloc() failed!"));
+			(*tail)->next=NULL;
+			tail=&(*tail)->next;
+			status=TRUE;
 		}
-		opttmp->next = optnew;
 	}
+	munmap((void *)base, (size_t)cst.st_size);
+	return status;
+}
+
+/* write every section of f to the cache, unless some section has a syntax
+ * error or the file may still change within the same second */
+static void write_cache(np_ini_file *f){
+	np_ini_cache_header hdr;
+	np_str records=NP_STR_INIT;
+	np_arg_list *opts, **tail, *next;
+	struct stat st;
+	uint32_t *offsets=NULL, count=0;
+	size_t n, start;
+	char *path, *tmp=NULL;
+	int fd, ok=TRUE;
 
-	free(linebuf);
-	return 0;
+	st.st_dev=f->dev;
+	st.st_ino=f->ino;
+	if(f->buf==NULL || f->mtime>=time(NULL) || (path=cache_file(&st))==NULL)
+		return;
+
+	if((offsets=malloc((f->nsections+1)*sizeof(uint32_t)))==NULL)
+		die(STATE_UNKNOWN, "%s\n", _("malloc() failed!"));
+	/* sections are sorted by name, repeats of a name are merged */
+	for(n=0; ok && n<f->nsections && f->sections[n].name; n++){
+		if(n==0 || compare_names(&f->sections[n-1], &f->sections[n])!=0){
+			if(count>0)
+				np_str_addn(&records, "", 1);
+			offsets[count++]=(uint32_t)records.len;
+			np_str_addn(&records, f->sections[n].name, f->sections[n].name_len);
+			np_str_addn(&records, "", 1);
+		}
+		opts=NULL;
+		tail=&opts;
+		if(read_section(&f->sections[n], &tail)<0)
+			ok=FALSE;
+		for(; opts; opts=next){
+			np_str_addn(&records, opts->arg, strlen(opts->arg)+1);
+			next=opts->next;
+			free(opts->arg);
+			free(opts);
+		}
+	}
+	np_str_addn(&records, "", 1);
+
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, NP_INI_CACHE_MAGIC, sizeof(hdr.magic));
+	hdr.dev=f->dev;
+	hdr.ino=f->ino;
+	hdr.mtime=f->mtime;
+	hdr.size=f->size;
+	hdr.count=count;
+	start=sizeof(hdr)+count*sizeof(uint32_t);
+	for(n=0; n<count; n++)
+		offsets[n]+=(uint32_t)start;
+
+	/* write a temporary file and rename it, readers never see half a cache */
+	if(ok && count>0 && asprintf(&tmp, "%s.XXXXXX", path)>=0 && (fd=mkstemp(tmp))!=-1){
+		if(write(fd, &hdr, sizeof(hdr))!=(ssize_t)sizeof(hdr) ||
+		   write(fd, offsets, count*sizeof(uint32_t))!=(ssize_t)(count*sizeof(uint32_t)) ||
+		   write(fd, records.data, records.len)!=(ssize_t)records.len ||
+		   close(fd)!=0 || rename(tmp, path)!=0)
+			unlink(tmp);
+	}
+	free(tmp);
+	free(path);
+	free(offsets);
+	np_str_free(&records);
 }
 
 static char *default_file_in_path(void){
@@ -207,9 +207,9 @@ void
 np_test_mount_entry_regex (struct mount_entry *dummy_mount_list, char *regstr, int cflags, int expect, char *desc)
 {	
 	int matches = 0;
-	regex_t re;
+	np_regex re;
 	struct mount_entry *me;
-	if (regcomp(&re,regstr, cflags) == 0) {
+	if (np_regex_compile(&re,regstr, cflags) == 0) {
 		for (me = dummy_mount_list; me; me= me->me_next) {
 			if(np_regex_match_mount_entry(me,&re))
 				matches++;
@@ -217,7 +217,7 @@ np_test_mount_entry_regex (struct mount_entry *dummy_mount_list, char *regstr, i
 		ok( matches == expect, 
 	    	    "%s '%s' matched %i/3 entries. ok: %i/3",
 		    desc, regstr, expect, matches);
-
+		np_regex_free(&re);
 	} else
 		ok ( false, "regex '%s' not compilable", regstr);
 }
@@ -0,0 +1,125 @@
+/*****************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*
+*****************************************************************************/
+
+#include "common.h"
+#include "utils_icmp.h"
+
+#include "tap.h"
+
+#include <arpa/inet.h>
+
+/* an IPv4 header of 20 bytes, as raw sockets deliver it */
+static const unsigned char ip_header[] = {
+	0x45, 0x00, 0x00, 0x54, 0x00, 0x00, 0x40, 0x00, 0x40, 0x01, 0x00, 0x00,
+	0x7f, 0x00, 0x00, 0x01, 0x7f, 0x00, 0x00, 0x01
+};
+
+/* ICMP message of type and code with an echo header of ident and seq */
+static int
+message (unsigned char *buf, int type, int code, int ident, int seq)
+{
+	memset (buf, 0, 8);
+	buf[0] = type;
+	buf[1] = code;
+	buf[4] = ident >> 8;
+	buf[5] = ident & 0xff;
+	buf[6] = seq >> 8;
+	buf[7] = seq & 0xff;
+	return 8;
+}
+
+/* an error of type and code quoting our echo request of ident and seq */
+static int
+quoting (unsigned char *buf, int type, int code, int ident, int seq)
+{
+	int len = message (buf, type, code, 0, 0);
+
+	memcpy (buf + len, ip_header, sizeof (ip_header));
+	len += sizeof (ip_header);
+	return len + message (buf + len, 8, 0, ident, seq);
+}
+
+int
+main (int argc, char **argv)
+{
+	unsigned char buf[256];
+	unsigned short ident = htons (0x1234), seq;
+	int len, error;
+
+	plan_tests(17);
+
+	/* datagram sockets, the kernel has matched the reply already */
+	len = message (buf, 0, 0, 0x9999, 3);
+	for (; len < 64; len++)
+		buf[len] = len;
+	ok( np_icmp_parse (buf, len, AF_INET, FALSE, ident, &seq, &error) == NP_ICMP_ECHO_REPLY && seq == 3,
+	    "Echo reply on a datagram socket" );
+	ok( np_icmp_parse (buf, 8, AF_INET, FALSE, ident, &seq, &error) == NP_ICMP_ECHO_REPLY,
+	    "Echo reply without data" );
+	ok( np_icmp_parse (buf, 7, AF_INET, FALSE, ident, &seq, &error) == NP_ICMP_OTHER,
+	    "Truncated reply is left out" );
+	ok( np_icmp_parse (buf, len, AF_INET, TRUE, ident, &seq, &error) == NP_ICMP_OTHER,
+	    "Reply to another process on a raw socket is left out" );
+
+	/* raw sockets, behind an IP header */
+	memcpy (buf, ip_header, sizeof (ip_header));
+	len = sizeof (ip_header) + message (buf + sizeof (ip_header), 0, 0, 0x1234, 0x0102);
+	ok( np_icmp_parse (buf, len, AF_INET, TRUE, ident, &seq, &error) == NP_ICMP_ECHO_REPLY && seq == 0x0102,
+	    "Echo reply behind an IP header" );
+	ok( np_icmp_parse (buf, len - 1, AF_INET, TRUE, ident, &seq, &error) == NP_ICMP_OTHER,
+	    "Truncated reply behind an IP header is left out" );
+	buf[0] = 0x4f;
+	ok( np_icmp_parse (buf, len, AF_INET, TRUE, ident, &seq, &error) == NP_ICMP_OTHER,
+	    "IP header longer than the packet is left out" );
+
+	len = sizeof (ip_header) + message (buf + sizeof (ip_header), 8, 0, 0x1234, 0);
+	memcpy (buf, ip_header, sizeof (ip_header));
+	ok( np_icmp_parse (buf, len, AF_INET, TRUE, ident, &seq, &error) == NP_ICMP_OTHER,
+	    "Our own request looped back is left out" );
+
+	memcpy (buf, ip_header, sizeof (ip_header));
+	len = sizeof (ip_header) + quoting (buf + sizeof (ip_header), 3, 1, 0x1234, 2);
+	error = 0;
+	ok( np_icmp_parse (buf, len, AF_INET, TRUE, ident, &seq, &error) == NP_ICMP_ERROR && error == EHOSTUNREACH,
+	    "Host unreachable about our request" );
+	ok( np_icmp_parse (buf, len - 1, AF_INET, TRUE, ident, &seq, &error) == NP_ICMP_OTHER,
+	    "Error quoting a truncated request is left out" );
+	ok( np_icmp_parse (buf, len, AF_INET, FALSE, ident, &seq, &error) == NP_ICMP_OTHER,
+	    "Datagram sockets get errors from recv, not as packets" );
+	len = sizeof (ip_header) + quoting (buf + sizeof (ip_header), 3, 3, 0x4321, 2);
+	ok( np_icmp_parse (buf, len, AF_INET, TRUE, ident, &seq, &error) == NP_ICMP_OTHER,
+	    "Error about another process is left out" );
+	len = sizeof (ip_header) + quoting (buf + sizeof (ip_header), 3, 3, 0x1234, 2);
+	ok( np_icmp_parse (buf, len, AF_INET, TRUE, ident, &seq, &error) == NP_ICMP_ERROR && error == ECONNREFUSED,
+	    "Port unreachable about our request" );
+
+	ok( np_icmp_error (AF_INET, 11, 0) == ETIMEDOUT, "Time exceeded" );
+	ok( np_icmp_error (AF_INET, 3, 13) == EACCES && np_icmp_error (AF_INET, 3, 0) == ENETUNREACH,
+	    "Prohibited and network unreachable" );
+	ok( np_icmp_error (AF_INET, 0, 0) == 0 && np_icmp_error (AF_INET, 5, 0) == 0, "Other types are no error" );
+
+#ifdef USE_IPV6
+	len = message (buf, 129, 0, 0x1234, 7);
+	ok( np_icmp_parse (buf, len, AF_INET6, TRUE, ident, &seq, &error) == NP_ICMP_ECHO_REPLY && seq == 7 &&
+	    np_icmp_error (AF_INET6, 1, 0) == ENETUNREACH, "ICMPv6 echo reply and no route" );
+#else
+	skip(1, "No IPv6 support");
+#endif
+
+	return exit_status();
+}
@@ -22,6 +22,9 @@
 
 #include "tap.h"
 
+#include <sys/stat.h>
+#include <utime.h>
+
 void my_free(char *string) {
 	if (string != NULL) {
 		printf("string:\n\t|%s|\n", string);
@@ -49,12 +52,29 @@ list2str(np_arg_list *optlst)
 	return optstr;
 }
 
+/* write an ini file and date it back, so it may be cached */
+void
+write_ini(const char *file, const char *contents, time_t mtime)
+{
+	struct utimbuf times;
+	FILE *f=fopen(file, "w");
+
+	fputs(contents, f);
+	fclose(f);
+	times.actime=times.modtime=mtime;
+	utime(file, &times);
+}
+
 int
 main (int argc, char **argv)
 {
-	char *optstr=NULL;
+	char *optstr=NULL, *file=NULL, *locator=NULL, *cache=NULL;
+	char dir[]="/tmp/test_ini1.XXXXXX";
+	struct stat st;
+	FILE *f;
+	int i;
 
-	plan_tests(12);
+	plan_tests(20);
 
 	optstr=list2str(np_get_defaults("section@./config-tiny.ini", "check_disk"));
 	ok( !strcmp(optstr, "--one=two --Foo=Bar --this=Your Mother! --blank"), "config-tiny.ini's section as expected");
@@ -104,6 +124,70 @@ main (int argc, char **argv)
 	ok( !strcmp(optstr, "--escape --send=Foo bar BAZ yadda yadda yadda Foo bar BAZ yadda yadda yadda Foo bar BAZ yadda yadda yadda Foo bar BAZ yadda yadda yadda Foo bar BAZ yadda yadda yadda Foo bar BAZ yadda yadda yadda Foo bar BAZ yadda yadda yadda Foo bar BAZ yadda yadda yadda Foo bar BAZ yadda yadda yadda Foo bar BAZ yadda yadda yadda Foo bar BAZ yadda yadda yadda Foo bar BAZ yadda yadda yadda Foo bar BAZ yadda yadda yadda Foo bar BAZ yadda yadda yadda Foo bar BAZ yadda yadda yadda Foo bar BAZ yadda yadda yadda Foo bar BAZ yadda yadda yadda Foo bar BAZ yadda yadda yadda --expect=Foo bar BAZ yadda yadda yadda Foo bar BAZ yadda yadda yadda Foo bar BAZ yadda yadda yadda Foo bar BAZ yadda yadda yadda Foo bar BAZ yadda yadda yadda Foo bar BAZ yadda yadda yadda Foo bar BAZ yadda yadda yadda Foo bar BAZ yadda yadda yadda Foo bar BAZ yadda yadda yadda Foo bar BAZ yadda yadda yadda Foo bar BAZ yadda yadda yadda Foo bar BAZ yadda yadda yadda Foo bar BAZ yadda yadda yadda Foo bar BAZ yadda yadda yadda Foo bar BAZ yadda yadda yadda Foo bar BAZ yadda yadda yadda Foo bar BAZ yadda yadda yadda Foo bar BAZ yadda yadda yadda Foo bar BAZ yadda yadda yadda Foo bar BAZ yadda yadda yadda Foo bar BAZ yadda yadda yadda Foo bar BAZ yadda yadda yadda Foo bar BAZ yadda yadda yadda --jail"), "Long options");
 	my_free(optstr);
 
+	optstr=list2str(np_get_defaults("whitespace@./plugin.ini", "check_disk"));
+	ok( !strcmp(optstr, "--key=value -k=v"), "plugin.ini's whitespace around the option name is trimmed");
+	my_free(optstr);
+
+	/* one large file, sections are found through the index */
+	if (mkdtemp(dir)==NULL) {
+		skip(7, "cannot create temporary directory");
+		return exit_status();
+	}
+	asprintf(&file, "%s/large.ini", dir);
+	f=fopen(file, "w");
+	fprintf(f, "[repeat]\nfirst=1\n");
+	for (i=0; i<20000; i++)
+		fprintf(f, "; section %d\n[check_%05d]\nwarning = %d\ncritical=%d\n\n", i, i, i, i*2);
+	fprintf(f, "[repeat]\nlast=2\n");
+	fclose(f);
+
+	asprintf(&locator, "check_19999@%s", file);
+	optstr=list2str(np_get_defaults(locator, "check_disk"));
+	ok( !strcmp(optstr, "--warning=19999 --critical=39998"), "Last of 20000 sections found");
+	my_free(optstr);
+	free(locator);
+
+	asprintf(&locator, "repeat@%s", file);
+	optstr=list2str(np_get_defaults(locator, "check_disk"));
+	ok( !strcmp(optstr, "--first=1 --last=2"), "Repeated section at both ends merged in file order");
+	my_free(optstr);
+	free(locator);
+	unlink(file);
+	free(file);
+
+	/* pre-parsed cache */
+	setenv("NAGIOS_PLUGIN_INI_CACHE", dir, 1);
+	asprintf(&file, "%s/cached.ini", dir);
+	write_ini(file, "[check_disk]\nwarning=10\n[check_load]\nw=1\n", time(NULL)-60);
+	stat(file, &st);
+	asprintf(&cache, "%s/ini-%lu-%lu.cache", dir, (unsigned long)st.st_dev, (unsigned long)st.st_ino);
+	asprintf(&locator, "@%s", file);
+
+	optstr=list2str(np_get_defaults(locator, "check_disk"));
+	ok( !strcmp(optstr, "--warning=10"), "Section read before the cache exists");
+	my_free(optstr);
+	ok( stat(cache, &st)==0 && (st.st_mode & 077)==0, "Cache file written, private to its owner");
+
+	optstr=list2str(np_get_defaults(locator, "check_load"));
+	ok( !strcmp(optstr, "-w=1"), "Other section read from the cache");
+	my_free(optstr);
+
+	/* same size and mtime, the cache can't tell the difference */
+	write_ini(file, "[check_disk]\nwarning=20\n[check_load]\nw=2\n", time(NULL)-60);
+	optstr=list2str(np_get_defaults(locator, "check_disk"));
+	ok( !strcmp(optstr, "--warning=10"), "Cache used while mtime and size match");
+	my_free(optstr);
+
+	write_ini(file, "[check_disk]\nwarning=20\n[check_load]\nw=2\n", time(NULL)-30);
+	optstr=list2str(np_get_defaults(locator, "check_disk"));
+	ok( !strcmp(optstr, "--warning=20"), "Changed mtime invalidates the cache");
+	my_free(optstr);
+
+	unlink(cache);
+	unlink(file);
+	rmdir(dir);
+	unsetenv("NAGIOS_PLUGIN_INI_CACHE");
+
 	return exit_status();
 }
 
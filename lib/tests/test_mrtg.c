@@ -0,0 +1,92 @@
+/*****************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*
+*****************************************************************************/
+
+#include "common.h"
+#include "utils_base.h"
+#include "utils_mrtg.h"
+
+#include "tap.h"
+
+static const char mrtg_log[] =
+	"1400000300 5000000 7000000\n"
+	"1400000300 1200 3400 5600 7800\n"
+	"1400000000 1100 3300 5500 7700\n";
+
+int
+main (int argc, char **argv)
+{
+	np_mrtg_log log;
+	np_mapped_file file;
+	np_str state = NP_STR_INIT;
+	double rate[2], saved[2] = { 12.5, 25 };
+	char path[] = "/tmp/test_mrtg.XXXXXX";
+	int fd, i;
+
+	plan_tests(23);
+
+	ok( np_mrtg_parse(mrtg_log, strlen(mrtg_log), &log) == OK, "Log head is parsed" );
+	ok( log.counter_time == 1400000300 && log.counter[0] == 5000000 && log.counter[1] == 7000000, "Counters from the first line" );
+	ok( log.timestamp == 1400000300 && log.average[0] == 1200 && log.average[1] == 3400, "Averages from the newest entry" );
+	ok( log.maximum[0] == 5600 && log.maximum[1] == 7800, "Maxima from the newest entry" );
+	ok( np_mrtg_parse(mrtg_log, 40, &log) == ERROR, "Entry cut short is an error" );
+	ok( np_mrtg_parse("1400000300 1 2\n1400000300 1 2 3\n", 33, &log) == ERROR, "Entry with missing values is an error" );
+	ok( np_mrtg_parse("garbage\n1400000300 1 2 3 4\n", 28, &log) == OK && log.counter_time == 0, "Log without counters still has its entry" );
+	ok( np_mrtg_parse("", 0, &log) == ERROR, "Empty log is an error" );
+
+	np_mrtg_parse(mrtg_log, strlen(mrtg_log), &log);
+	ok( !np_mrtg_rates(NULL, "/mrtg/eth0.log", &log, rate), "No rates without state" );
+	ok( !np_mrtg_rates("1400000000 2000000 1000000 -1.000000 -1.000000 /mrtg/eth1.log", "/mrtg/eth0.log", &log, rate),
+	    "No rates for another log" );
+	ok( np_mrtg_rates("1400000000 2000000 1000000 -1.000000 -1.000000 /mrtg/eth1.log\t"
+	                  "1400000000 2000000 1000000 -1.000000 -1.000000 /mrtg/eth0.log", "/mrtg/eth0.log", &log, rate),
+	    "Rates from the second entry" );
+	ok( rate[0] == 10000 && rate[1] == 20000, "Rates are counter differences over the interval" );
+	ok( !np_mrtg_rates("1400000000 6000000 1000000 -1.000000 -1.000000 /mrtg/eth0.log", "/mrtg/eth0.log", &log, rate),
+	    "No rates when a counter went back" );
+	ok( !np_mrtg_rates("1400000300 5000000 7000000 -1.000000 -1.000000 /mrtg/eth0.log", "/mrtg/eth0.log", &log, rate),
+	    "No rates when MRTG has not run and none were saved" );
+	ok( np_mrtg_rates("1400000300 5000000 7000000 12.500000 25.000000 /mrtg/eth0.log", "/mrtg/eth0.log", &log, rate) &&
+	    rate[0] == 12.5 && rate[1] == 25, "Saved rates are used when MRTG has not run" );
+	ok( !np_mrtg_rates("1400000000 2000000 1000000 -1.000000 -1.000000 /mrtg/eth0.log.old", "/mrtg/eth0.log", &log, rate),
+	    "Longer path does not match" );
+
+	np_mrtg_state_add(&state, "/mrtg/eth0.log", &log, NULL);
+	np_mrtg_state_add(&state, "/mrtg/eth 1.log", &log, saved);
+	ok( strcmp(np_str_get(&state), "1400000300 5000000 7000000 -1.000000 -1.000000 /mrtg/eth0.log\t"
+	           "1400000300 5000000 7000000 12.500000 25.000000 /mrtg/eth 1.log") == 0, "State entries are written" );
+	ok( np_mrtg_rates(np_str_get(&state), "/mrtg/eth 1.log", &log, rate) && rate[1] == 25, "Path with a space is found" );
+	np_str_free(&state);
+	log.counter_time = 0;
+	np_mrtg_state_add(&state, "/mrtg/eth0.log", &log, NULL);
+	ok( state.len == 0, "Log without counters adds no entry" );
+
+	/* only the head of a large log is looked at */
+	fd = mkstemp(path);
+	write(fd, mrtg_log, strlen(mrtg_log));
+	for (i = 0; i < 20000; i++)
+		write(fd, "1399990000 1000 3000 5000 7000\n", 31);
+	close(fd);
+	ok( np_mrtg_read(path, &log) == OK && log.average[0] == 1200, "Log file is read" );
+	ok( np_map_file(&file, path) == OK && file.len == strlen(mrtg_log) + 20000 * 31, "Whole file is mapped" );
+	np_unmap_file(&file);
+	unlink(path);
+	ok( np_mrtg_read("/nonexistent/file.log", &log) == ERROR && errno == ENOENT, "Missing log is an error" );
+	ok( np_map_file(&file, "/dev/null") == ERROR && file.len == 0, "Device is not mapped" );
+
+	return exit_status();
+}
@@ -84,10 +84,10 @@ int array_diff(int i1, char **a1, int i2, char **a2) {
 int
 main (int argc, char **argv)
 {
-	char **argv_new=NULL;
-	int i, argc_test;
+	char **argv_new=NULL, **argv_big=NULL;
+	int i, argc_test, big_ok;
 
-	plan_tests(5);
+	plan_tests(7);
 
 	{
 		char *argv_test[] = {"prog_name", (char *) NULL};
@@ -134,6 +134,34 @@ main (int argc, char **argv)
 		my_free(&argc_test, argv_new, argv_test);
 	}
 
+	{
+		char *argv_test[] = {"prog_name", "arg1", "--extra-opts=sect1@./config-opts.ini", "arg2", "--extra-opts", "sect2@./config-opts.ini", "arg3", (char *) NULL};
+		argc_test=7;
+		char *argv_known[] = {"prog_name", "--one=two", "--something else=oops", "--this=that", "arg1", "arg2", "arg3", (char *) NULL};
+		argv_new=np_extra_opts(&argc_test, argv_test, "check_disk");
+		ok(array_diff(argc_test, argv_new, 7, argv_known), "extra opts between other arguments keep their order");
+		my_free(&argc_test, argv_new, argv_test);
+	}
+
+	{
+		/* extra-opts in the middle of a long command line */
+		argv_big=malloc(10003*sizeof(char *));
+		argv_big[0]="prog_name";
+		for (i=1; i<=10000; i++)
+			argv_big[i+(i>5000)]=(i%2)?"odd":"even";
+		argv_big[5001]="--extra-opts=sect1@./config-opts.ini";
+		argv_big[10002]=NULL;
+		argc_test=10002;
+		argv_new=np_extra_opts(&argc_test, argv_big, "check_disk");
+		big_ok=(argc_test==10002 && !strcmp(argv_new[1], "--one=two") && argv_new[10002]==NULL);
+		for (i=2; big_ok && i<10002; i++)
+			big_ok=!strcmp(argv_new[i], (i%2)?"even":"odd");
+		ok(big_ok, "10000 arguments around one extra opts");
+		free(argv_new[1]);
+		free(argv_new);
+		free(argv_big);
+	}
+
 	return exit_status();
 }
 
@@ -0,0 +1,148 @@
+/*****************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*
+*****************************************************************************/
+
+#include "common.h"
+#include "utils_base.h"
+#include "utils_proc.h"
+
+#include "tap.h"
+
+static const char meminfo[] =
+	"MemTotal:       16314736 kB\n"
+	"MemFree:         1022932 kB\n"
+	"SwapCached:        10240 kB\n"
+	"SwapTotal:       8388604 kB\n"
+	"SwapFree:        6291452 kB\n"
+	"Dirty:               120 kB\n";
+
+static const char swaps[] =
+	"Filename\t\t\t\tType\t\tSize\t\tUsed\t\tPriority\n"
+	"/dev/sda2                               partition\t8388604\t\t2097152\t\t-2\n"
+	"/var/swap\\040file                       file\t\t1048576\t\t0\t\t-3\n";
+
+static const char pressure[] =
+	"some avg10=1.50 avg60=0.75 avg300=0.10 total=123456\n"
+	"full avg10=0.25 avg60=0.00 avg300=0.00 total=789\n";
+
+/* the fgets and sscanf loop check_swap used before */
+static double
+old_swap_free (const char *path)
+{
+	char line[MAX_INPUT_BUFFER], str[32];
+	double value, avail = 0;
+	FILE *fp;
+
+	if ((fp = fopen (path, "r")) == NULL)
+		return -1;
+	while (fgets (line, MAX_INPUT_BUFFER - 1, fp)) {
+		if (sscanf (line, "%*[S]%*[w]%*[a]%*[p]%*[:] %lf %lf %lf", &value, &value, &value) == 3)
+			continue;
+		else if (sscanf (line, "%*[S]%*[w]%*[a]%*[p]%[TotalFre]%*[:] %lf %*[k]%*[B]", str, &value) == 2) {
+			if (strcmp ("Free", str) == 0)
+				avail = value / 1024;
+		}
+	}
+	fclose (fp);
+	return avail;
+}
+
+int
+main (int argc, char **argv)
+{
+	unsigned long long value;
+	np_swap_device *devices;
+	np_proc_entry *procs, *self = NULL;
+	size_t nprocs, j;
+	double la[3], uptime;
+	np_pressure some, full;
+	char path[] = "/tmp/test_proc.XXXXXX", fixture[] = "/tmp/test_proc.XXXXXX", *buf;
+	size_t len;
+	double total_mb, free_mb;
+	int fd, i;
+
+	plan_tests(28);
+
+	ok( np_proc_value(meminfo, "SwapTotal:", &value) && value == 8388604, "Key at start of line is found" );
+	ok( np_proc_value(meminfo, "SwapFree:", &value) && value == 6291452, "Key in last lines is found" );
+	ok( !np_proc_value(meminfo, "Swap:", &value), "Partial key is not matched" );
+	ok( !np_proc_value(meminfo, "Cached:", &value), "Key inside a line is not matched" );
+	ok( np_proc_value("pswpin 17\npswpout 42\n", "pswpin", &value) && value == 17, "Prefix of another key matches only itself" );
+	ok( np_proc_value("pswpin 17\npswpout 42", "pswpout", &value) && value == 42, "Last line without newline" );
+
+	devices = np_swap_devices_parse(swaps);
+	ok( devices != NULL && strcmp(devices->name, "/dev/sda2") == 0, "First swap device" );
+	ok( devices != NULL && devices->total_mb == 8388604 / 1024.0 && devices->used_mb == 2048, "First swap device sizes" );
+	ok( devices != NULL && devices->next != NULL && strcmp(devices->next->name, "/var/swap\\040file") == 0, "Escaped names are kept" );
+	ok( devices != NULL && devices->next != NULL && devices->next->next == NULL, "Two swap devices" );
+	np_swap_devices_free(devices);
+	ok( np_swap_devices_parse("Filename\tType\tSize\tUsed\tPriority\n") == NULL, "No swap devices" );
+
+	ok( np_pressure_parse(pressure, &some, &full), "Pressure lines parsed" );
+	ok( some.avg10 == 1.5 && some.avg60 == 0.75 && some.total == 123456, "Pressure some line" );
+	ok( full.avg10 == 0.25 && full.total == 789, "Pressure full line" );
+	ok( np_pressure_parse("some avg10=2.00 avg60=0.00 avg300=0.00 total=5\n", &some, &full) && full.avg10 == 0, "Missing full line is zeroed" );
+	ok( !np_pressure_parse("", &some, &full), "Empty pressure file" );
+
+	/* larger than the first buffer, to make it grow */
+	fd = mkstemp(path);
+	for (i = 0; i < 1000; i++)
+		write(fd, "Filler:            12345 kB\n", 28);
+	write(fd, meminfo, strlen(meminfo));
+	close(fd);
+	buf = np_proc_load(path, &len);
+	ok( buf != NULL && len == 28000 + strlen(meminfo) && strlen(buf) == len, "Whole file is loaded" );
+	ok( buf != NULL && np_proc_value(buf, "SwapFree:", &value) && value == 6291452, "Value found after the filler" );
+	free(buf);
+	unlink(path);
+	ok( np_proc_load("/nonexistent/file", &len) == NULL, "Missing file gives NULL" );
+
+	ok( np_proc_uptime(&uptime) == OK && uptime > 0, "Uptime is read" );
+	ok( np_proc_loadavg(la) == OK && la[0] >= 0 && la[2] >= 0, "Load averages are read" );
+	procs = np_proc_scan(&nprocs);
+	for (j = 0; procs && j < nprocs; j++)
+		if (procs[j].pid == getpid())
+			self = &procs[j];
+	ok( self != NULL && self->ppid == getppid() && self->uid == geteuid(), "Process scan finds this process" );
+	ok( self != NULL && strstr(self->args, "test_proc") != NULL && self->state == 'R', "Own command line and state" );
+	if (procs)
+		np_proc_scan_free(procs, nprocs);
+	buf = np_proc_args(getpid());
+	ok( buf != NULL && strstr(buf, "test_proc") != NULL, "Command line of one process" );
+	free(buf);
+	buf = np_proc_exe(getpid());
+	ok( buf != NULL && strstr(buf, "test_proc") != NULL, "Executable of one process" );
+	free(buf);
+	ok( np_proc_args(0) == NULL && np_proc_exe(-1) == NULL, "No such process" );
+
+	fd = mkstemp(fixture);
+	write(fd, meminfo, strlen(meminfo));
+	close(fd);
+	buf = np_proc_load(fixture, &len);
+	ok( buf != NULL && np_proc_value(buf, "SwapFree:", &value) && value / 1024.0 == old_swap_free(fixture),
+	    "Free swap agrees with the fgets parser" );
+	free(buf);
+	unlink(fixture);
+
+	if (old_swap_free(PROC_MEMINFO) >= 0)
+		ok( np_swap_summary(&total_mb, &free_mb) == OK && free_mb >= 0 && free_mb <= total_mb,
+		    "Swap summary of this system" );
+	else
+		skip(1, "%s is not readable", PROC_MEMINFO);
+
+	return exit_status();
+}
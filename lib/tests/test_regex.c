@@ -0,0 +1,149 @@
+/*****************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*
+*****************************************************************************/
+
+#include "common.h"
+#include "utils_base.h"
+#include "utils_regex.h"
+
+#include "tap.h"
+
+#define PROC_LINES 2000
+#define MOUNT_LINES 500
+
+static int
+literal_is (const char *re, int cflags, const char *expected)
+{
+	char *literal = np_regex_literal(re, cflags);
+	int result;
+
+	if (literal == NULL || expected == NULL)
+		result = (literal == expected);
+	else
+		result = (strcmp(literal, expected) == 0);
+	if (!result)
+		diag("literal of '%s' is '%s', expected '%s'", re,
+		     literal ? literal : "(null)", expected ? expected : "(null)");
+	free(literal);
+	return result;
+}
+
+/* true if np_regex_match agrees with a plain regexec on every line */
+static int
+same_matches (const char *re, int cflags, char **lines, int count)
+{
+	regex_t plain;
+	np_regex fast;
+	int i, mismatches = 0;
+
+	if (regcomp(&plain, re, cflags) != 0)
+		return FALSE;
+	if (np_regex_compile(&fast, re, cflags) != 0) {
+		regfree(&plain);
+		return FALSE;
+	}
+	for (i = 0; i < count; i++)
+		if ((regexec(&plain, lines[i], 0, NULL, 0) == 0) != np_regex_match(&fast, lines[i]))
+			mismatches++;
+	if (mismatches)
+		diag("'%s' disagrees with regexec on %d lines", re, mismatches);
+	regfree(&plain);
+	np_regex_free(&fast);
+	return mismatches == 0;
+}
+
+int
+main (int argc, char **argv)
+{
+	static const char *commands[] = { "/usr/sbin/sshd -D", "/usr/bin/python3 /opt/app/worker.py --queue mail",
+		"/usr/lib/postgresql/15/bin/postgres -D /var/lib/postgresql", "nginx: worker process",
+		"/usr/sbin/cron -f", "/bin/bash -c sleep 60", "/usr/bin/java -Xmx2g -jar /srv/Tomcat/app.jar" };
+	static const char *fstypes[] = { "ext4", "xfs", "tmpfs", "nfs4", "proc", "cgroup2" };
+	char *procs[PROC_LINES], *mounts[MOUNT_LINES];
+	np_regex re;
+	np_regex_set set = NP_REGEX_SET_INIT;
+	regex_t plain;
+	char errbuf[128];
+	int i, plain_hits, fast_hits;
+
+	plan_tests(35);
+
+	ok( literal_is("worker", REG_EXTENDED, "worker"), "Plain string is its own literal" );
+	ok( literal_is("^/usr/bin/python", REG_EXTENDED, "/usr/bin/python"), "Anchors are skipped" );
+	ok( literal_is("abc*def", REG_EXTENDED, "def"), "A starred character leaves the preceding run" );
+	ok( literal_is("ab?cdefg", REG_EXTENDED, "cdefg"), "An optional character ends the run" );
+	ok( literal_is("x{2}yz", REG_EXTENDED, "yz"), "An interval ends the run" );
+	ok( literal_is("abc+", REG_EXTENDED, "abc"), "Plus keeps the repeated character" );
+	ok( literal_is("(foo|bar)baz", REG_EXTENDED, "baz"), "Groups are skipped" );
+	ok( literal_is("foo|bar", REG_EXTENDED, NULL), "Top level alternation has no literal" );
+	ok( literal_is("foo|", REG_EXTENDED, NULL), "Trailing alternation has no literal" );
+	ok( literal_is("a[0-9]+bcd", REG_EXTENDED, "bcd"), "Bracket expressions end the run" );
+	ok( literal_is("[]x]yz", REG_EXTENDED, "yz"), "Closing bracket first in a list is part of it" );
+	ok( literal_is("a\\.conf", REG_EXTENDED, "a.conf"), "Escaped characters are literal" );
+	ok( literal_is("var.log", REG_EXTENDED, "var"), "Dot ends the run" );
+	ok( literal_is("Tomcat", REG_EXTENDED|REG_ICASE, NULL), "Letters are not literal when ignoring case" );
+	ok( literal_is("/srv/12", REG_EXTENDED|REG_ICASE, "/12"), "Only non-letters are literal when ignoring case" );
+	ok( literal_is("a+b", 0, "a+b"), "Plus is literal in a basic regex" );
+	ok( literal_is("a\\(bc\\)de", 0, "de"), "Basic regex groups are skipped" );
+	ok( literal_is("", REG_EXTENDED, NULL), "Empty regex has no literal" );
+
+	ok( np_regex_compile(&re, "(", REG_EXTENDED) != 0, "Invalid regex fails to compile" );
+	ok( np_regex_error(REG_EPAREN, NULL, errbuf, sizeof(errbuf)) > 0 && errbuf[0] != '\0', "Errors are described without a compiled regex" );
+
+	for (i = 0; i < PROC_LINES; i++)
+		asprintf(&procs[i], "%s --id %d", commands[i % 7], i);
+	for (i = 0; i < MOUNT_LINES; i++)
+		asprintf(&mounts[i], "/dev/sd%c%d /srv/data%d %s rw,relatime 0 0", 'a' + i % 26, i % 9, i, fstypes[i % 6]);
+
+	ok( same_matches("worker", REG_EXTENDED, procs, PROC_LINES), "Literal pattern matches like regexec" );
+	ok( same_matches("^/usr/(s)?bin/(sshd|cron)", REG_EXTENDED, procs, PROC_LINES), "Grouped pattern matches like regexec" );
+	ok( same_matches("--id 1[0-9]*7$", REG_EXTENDED, procs, PROC_LINES), "Anchored pattern matches like regexec" );
+	ok( same_matches("tomcat", REG_EXTENDED|REG_ICASE, procs, PROC_LINES), "Case insensitive pattern matches like regexec" );
+	ok( same_matches("python|java", REG_EXTENDED, procs, PROC_LINES), "Alternation matches like regexec" );
+	ok( same_matches("/srv/data4[0-9]* ", REG_EXTENDED, mounts, MOUNT_LINES), "Mount point pattern matches like regexec" );
+	ok( same_matches(" \\(tmpfs\\|proc\\) ", 0, mounts, MOUNT_LINES), "Basic regex matches like regexec" );
+
+	ok( np_regex_set_add(&set, "^nginx", REG_EXTENDED) == 0, "Add first pattern to set" );
+	ok( np_regex_set_add(&set, "postgres", REG_EXTENDED) == 0, "Add second pattern to set" );
+	ok( np_regex_set_add(&set, "(", REG_EXTENDED) != 0 && set.count == 2, "Invalid pattern is not added to set" );
+	ok( np_regex_set_match(&set, "nginx: master process") == 0, "Set reports first pattern" );
+	ok( np_regex_set_match(&set, "/usr/lib/postgresql/15/bin/postgres") == 1, "Set reports second pattern" );
+	ok( np_regex_set_match(&set, "/usr/sbin/sshd") == -1, "Set reports no match" );
+	np_regex_set_free(&set);
+	ok( set.count == 0 && np_regex_set_match(&set, "nginx") == -1, "Freed set matches nothing" );
+
+	/* the check_procs --ereg-argument-array loop, with and without prefilter */
+	regcomp(&plain, "queue mail", REG_EXTENDED|REG_NOSUB);
+	np_regex_compile(&re, "queue mail", REG_EXTENDED);
+	plain_hits = fast_hits = 0;
+	for (i = 0; i < PROC_LINES; i++) {
+		if (regexec(&plain, procs[i], 0, NULL, 0) == 0)
+			plain_hits++;
+		if (np_regex_match(&re, procs[i]))
+			fast_hits++;
+	}
+	ok( fast_hits > 0 && plain_hits == fast_hits, "Prefiltered loop finds the same matches" );
+	regfree(&plain);
+	np_regex_free(&re);
+
+	for (i = 0; i < PROC_LINES; i++)
+		free(procs[i]);
+	for (i = 0; i < MOUNT_LINES; i++)
+		free(mounts[i]);
+
+	return exit_status();
+}
@@ -0,0 +1,103 @@
+/*****************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*
+*****************************************************************************/
+
+#include "common.h"
+#include "utils_base.h"
+#include "utils_str.h"
+
+#include "tap.h"
+
+int
+main (int argc, char **argv)
+{
+	np_str s = NP_STR_INIT;
+	char *released;
+	char item[64];
+	size_t expected = 0;
+	int i;
+
+	plan_tests(20);
+
+	ok( strcmp(np_str_get(&s), "") == 0, "Empty builder reads as empty string" );
+	released = np_str_release(&s);
+	ok( released != NULL && strcmp(released, "") == 0, "Releasing an empty builder gives an empty string" );
+	free(released);
+
+	np_str_add(&s, "abc");
+	np_str_addn(&s, "defgh", 2);
+	ok( strcmp(np_str_get(&s), "abcde") == 0 && s.len == 5, "add and addn append" );
+
+	for (i = 0; i < 30; i++)
+		np_str_addf(&s, "%d,", i);
+	ok( s.len == strlen(s.data) && s.len == 5 + 10 * 2 + 20 * 3, "addf grows past the initial size" );
+	ok( strcmp(s.data + s.len - 3, "29,") == 0, "addf keeps the last item intact" );
+
+	np_str_free(&s);
+	ok( s.data == NULL && s.len == 0 && strcmp(np_str_get(&s), "") == 0, "Freed builder is empty again" );
+
+	np_str_addf(&s, "%0200d", 7);
+	ok( s.len == 200 && s.data[199] == '7', "A single addf larger than the buffer is formatted whole" );
+	released = np_str_release(&s);
+	ok( s.data == NULL && strlen(released) == 200, "Released buffer belongs to the caller" );
+	free(released);
+
+	np_str_add_label(&s, "simple");
+	ok( strcmp(np_str_get(&s), "simple=") == 0, "Plain labels are not quoted" );
+	np_str_free(&s);
+	np_str_add_label(&s, "with space");
+	ok( strcmp(np_str_get(&s), "'with space'=") == 0, "Labels with spaces are quoted" );
+	np_str_free(&s);
+	np_str_add_label(&s, "a=b");
+	ok( strcmp(np_str_get(&s), "'a=b'=") == 0, "Labels with = are quoted" );
+	np_str_free(&s);
+
+	np_str_perfdata(&s, "time", 10, "ms", TRUE, 20, TRUE, 30, TRUE, 0, TRUE, 100);
+	ok( strcmp(np_str_get(&s), "time=10ms;20;30;0;100") == 0, "perfdata with all fields" );
+	np_str_free(&s);
+	np_str_perfdata(&s, "time", 10, "", FALSE, 0, FALSE, 0, FALSE, 0, TRUE, 100);
+	ok( strcmp(np_str_get(&s), "time=10;;;;100") == 0, "perfdata without thresholds or min" );
+	np_str_free(&s);
+	np_str_fperfdata(&s, "load 1", 0.5, "", TRUE, 1, FALSE, 0, FALSE, 0, FALSE, 0);
+	ok( strcmp(np_str_get(&s), "'load 1'=0.500000;1.000000;;") == 0, "fperfdata quotes and formats doubles" );
+	np_str_free(&s);
+	np_str_sperfdata(&s, "rt", 1.5, "s", "2", NULL, TRUE, 0, FALSE, 0);
+	ok( strcmp(np_str_get(&s), "rt=1.500000s;2;;0.000000") == 0, "sperfdata uses threshold strings" );
+	np_str_free(&s);
+	np_str_sperfdata_int(&s, "users", 3, "", "5", "10:", TRUE, 0, FALSE, 0);
+	ok( strcmp(np_str_get(&s), "users=3;5;10:;0") == 0, "sperfdata_int uses threshold strings" );
+	np_str_free(&s);
+
+	np_str_perfdata(&s, "a", 1, "", FALSE, 0, FALSE, 0, FALSE, 0, FALSE, 0);
+	np_str_add(&s, " ");
+	np_str_perfdata(&s, "b", 2, "B", FALSE, 0, FALSE, 0, FALSE, 0, FALSE, 0);
+	ok( strcmp(np_str_get(&s), "a=1;;; b=2B;;;") == 0, "perfdata items are appended, not replaced" );
+	np_str_free(&s);
+
+	/* many small items, as a plugin with a long list of disks collects */
+	for (i = 0; i < 5000; i++) {
+		expected += snprintf(item, sizeof(item), " disk%d=%ldMB;%ld;%ld;0;%ld", i, (long) i * 3, 800L, 900L, 1000L);
+		np_str_addf(&s, " disk%d=%ldMB;%ld;%ld;0;%ld", i, (long) i * 3, 800L, 900L, 1000L);
+	}
+	ok( s.len == expected && strlen(s.data) == expected, "Many items add up to the full length" );
+	ok( strcmp(s.data + s.len - strlen(item), item) == 0, "The last of many items is intact" );
+	ok( s.size < 2 * (s.len + 1) + 64, "Buffer overhead is bounded by doubling" );
+
+	np_str_free(&s);
+
+	return exit_status();
+}
@@ -27,6 +27,39 @@
 
 #include "utils_base.c"
 
+/* threshold pairs the compiled evaluation is compared against get_status with */
+char *compiled_tests[][2] = {
+	{ "30", "60" },
+	{ "-10:-2", "-30:20" },
+	{ "@10:20", "~:50" },
+	{ "10:", "@~:5" },
+	{ "@~:", NULL },
+	{ NULL, "~:" },
+	{ NULL, NULL },
+};
+
+/* TRUE if get_status_compiled agrees with get_status over a sweep of values */
+int
+compiled_matches(char *warn, char *crit)
+{
+	double values[] = { -1e300, -HUGE_VAL, HUGE_VAL, 1e300, NAN };
+	thresholds *my_thresholds = NULL;
+	compiled_thresholds compiled;
+	double value;
+	size_t i;
+
+	if (_set_thresholds(&my_thresholds, warn, crit) != 0 ||
+	    parse_compiled_thresholds(&compiled, warn, crit) != 0)
+		return FALSE;
+	for (value = -40; value <= 70; value += 0.25)
+		if (get_status(value, my_thresholds) != get_status_compiled(value, &compiled))
+			return FALSE;
+	for (i = 0; i < sizeof(values) / sizeof(values[0]); i++)
+		if (get_status(values[i], my_thresholds) != get_status_compiled(values[i], &compiled))
+			return FALSE;
+	return TRUE;
+}
+
 int
 main (int argc, char **argv)
 {
@@ -39,8 +72,10 @@ main (int argc, char **argv)
 	state_key *temp_state_key = NULL;
 	state_data *temp_state_data;
 	time_t	current_time;
+	struct stat st;
+	compiled_thresholds compiled;
 
-	plan_tests(185);
+	plan_tests(201);
 
 	ok( this_nagios_plugin==NULL, "nagios_plugin not initialised");
 
@@ -199,6 +234,22 @@ main (int argc, char **argv)
 	ok( get_status(19, thresholds) == STATE_WARNING, "19 - warning");
 	ok( get_status(21, thresholds) == STATE_CRITICAL, "21 - critical");
 
+	ok( parse_compiled_thresholds(&compiled, "2:1", NULL) == NP_RANGE_UNPARSEABLE, "Compiled '2:1' rejected");
+	compile_thresholds(&compiled, thresholds);
+	ok( compiled.start[NP_RANGE_CRITICAL] == -30 && compiled.end[NP_RANGE_CRITICAL] == 20 &&
+	    compiled.start[NP_RANGE_WARNING] == -10 && compiled.end[NP_RANGE_WARNING] == -2, "Compiled bounds copied");
+	ok( get_status_compiled(-31, &compiled) == STATE_CRITICAL, "-31 - compiled critical");
+	ok( get_status_compiled(-10, &compiled) == STATE_OK, "-10 - compiled ok");
+	ok( get_status_compiled(19, &compiled) == STATE_WARNING, "19 - compiled warning");
+	for (i = 0; i < (int) (sizeof(compiled_tests) / sizeof(compiled_tests[0])); i++) {
+		temp_string = NULL;
+		asprintf(&temp_string, "Compiled matches get_status for (%s, %s)",
+		         compiled_tests[i][0] ? compiled_tests[i][0] : "NULL",
+		         compiled_tests[i][1] ? compiled_tests[i][1] : "NULL");
+		ok( compiled_matches(compiled_tests[i][0], compiled_tests[i][1]), temp_string);
+		free(temp_string);
+	}
+
 	char *test;
 	test = np_escaped_string("bob\\n");
 	ok( strcmp(test, "bob\n") == 0, "bob\\n ok");
@@ -351,6 +402,8 @@ main (int argc, char **argv)
 	ok( !strcmp(temp_state_key->plugin_name, "check_test"), "Got plugin name" );
 	ok( !strcmp(temp_state_key->name, "allowedchars_in_keyname"), "Got key name with valid chars" );
 	ok( !strcmp(temp_state_key->_filename, state_path), "Got internal filename" );
+	sprintf(state_path, "/usr/local/nagios/var/%lu/check_test", (unsigned long)geteuid());
+	ok( !strcmp(np_state_directory(), state_path), "Got state directory" );
 
 
 	/* Don't do this test just yet. Will die */
@@ -445,6 +498,21 @@ main (int argc, char **argv)
 	/* Check time is set to current_time */
 	ok(system("cmp var/generated var/statefile > /dev/null")!=0, "Generated file should be different this time");
 	ok(this_nagios_plugin->state->state_data->time-current_time<=1, "Has time generated from current time");
+
+	ok(stat("var/generated", &st)==0 && (st.st_mode & 0777)==0640, "State file is readable by the group");
+	np_state_set_secret();
+	np_state_write_string(0, "Secret to read");
+	ok(stat("var/generated", &st)==0 && (st.st_mode & 0777)==0600, "Secret state file is readable by its owner only");
+	this_nagios_plugin->state->secret = FALSE;
+
+	/* String data longer than the read buffer */
+	temp_string = malloc(5001);
+	memset(temp_string, 'x', 5000);
+	temp_string[5000] = '\0';
+	np_state_write_string(0, temp_string);
+	temp_state_data = np_state_read();
+	ok(temp_state_data && !strcmp((char *)temp_state_data->data, temp_string), "Read back long string data");
+	free(temp_string);
 	
 
 	/* Don't know how to automatically test this. Need to be able to redefine die and catch the error */
@@ -0,0 +1,145 @@
+/*****************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*
+*****************************************************************************/
+
+#include "common.h"
+#include "utils_base.h"
+#include "utils_utmp.h"
+
+#include "tap.h"
+
+#include <fcntl.h>
+
+#define MANY_RECORDS 20000
+
+#ifdef HAVE_UTMPX_H
+static void
+add_record (int fd, short type, const char *user, const char *line, const char *host)
+{
+	struct utmpx ut;
+
+	memset(&ut, 0, sizeof(ut));
+	ut.ut_type = type;
+	strncpy(ut.ut_user, user, sizeof(ut.ut_user));
+	strncpy(ut.ut_line, line, sizeof(ut.ut_line));
+	strncpy(ut.ut_host, host, sizeof(ut.ut_host));
+	if (write(fd, &ut, sizeof(ut)) != sizeof(ut))
+		die(STATE_UNKNOWN, "Cannot write test record: %s\n", strerror(errno));
+}
+
+static int
+count_users (np_utmp *u)
+{
+	size_t i;
+	int users = 0;
+
+	for (i = 0; i < u->count; i++)
+		if (u->records[i].ut_type == USER_PROCESS)
+			users++;
+	return users;
+}
+#endif
+
+int
+main (int argc, char **argv)
+{
+#ifdef HAVE_UTMPX_H
+	char path[] = "/tmp/test_utmp.XXXXXX", buf[sizeof(((struct utmpx *) 0)->ut_user) + 1];
+	struct utmpx *putmpx;
+	np_utmp u;
+	ino_t inode;
+	off_t end;
+	int fd, i, old_users;
+
+	plan_tests(17);
+
+	if ((fd = mkstemp(path)) < 0) {
+		skip(17, "cannot create temporary file");
+		return exit_status();
+	}
+	add_record(fd, BOOT_TIME, "reboot", "~", "");
+	add_record(fd, USER_PROCESS, "root", "tty1", "");
+	add_record(fd, USER_PROCESS, "alice", "pts/0", "10.0.0.5");
+	add_record(fd, DEAD_PROCESS, "", "pts/1", "");
+	add_record(fd, USER_PROCESS, "bob", "pts/2", ":0");
+	/* a partly written record at the end is left out */
+	if (write(fd, "xx", 2) != 2)
+		die(STATE_UNKNOWN, "Cannot write %s: %s\n", path, strerror(errno));
+	close(fd);
+
+	ok( np_utmp_open(&u, path, 0, 0) == OK, "File is mapped" );
+	ok( u.count == 5 && u.end == 5 * sizeof(struct utmpx), "Only whole records are counted" );
+	ok( !u.restarted, "Mapping from the start is not a restart" );
+	ok( count_users(&u) == 3, "Three user sessions" );
+	ok( strcmp(np_utmp_field(buf, u.records[2].ut_user), "alice") == 0, "User name is read" );
+	ok( np_utmp_session_type(&u.records[1]) == NP_UTMP_CONSOLE, "Terminal without host is console" );
+	ok( np_utmp_session_type(&u.records[2]) == NP_UTMP_SSH, "Session with a host is ssh" );
+	ok( np_utmp_session_type(&u.records[4]) == NP_UTMP_CONSOLE, "X display is console" );
+	inode = u.inode;
+	end = u.end;
+	np_utmp_close(&u);
+
+	fd = open(path, O_WRONLY);
+	if (fd < 0 || ftruncate(fd, end) != 0)
+		die(STATE_UNKNOWN, "Cannot truncate %s: %s\n", path, strerror(errno));
+	lseek(fd, 0, SEEK_END);
+	add_record(fd, USER_PROCESS, "carol", "pts/3", "192.0.2.7");
+	close(fd);
+	ok( np_utmp_open(&u, path, inode, end) == OK && u.count == 1, "Only the new record is mapped" );
+	ok( strcmp(np_utmp_field(buf, u.records[0].ut_user), "carol") == 0 && !u.restarted, "New record is read" );
+	np_utmp_close(&u);
+	ok( np_utmp_open(&u, path, inode, end + 3) == OK && u.count == 1, "Offset is rounded to a record" );
+	np_utmp_close(&u);
+	ok( np_utmp_open(&u, path, inode, end * 4) == OK && u.restarted && u.count == 6, "Truncated file is read from the start" );
+	np_utmp_close(&u);
+	ok( np_utmp_open(&u, path, inode + 1, end) == OK && u.restarted && u.count == 6, "Replaced file is read from the start" );
+	np_utmp_close(&u);
+	ok( np_utmp_open(&u, path, inode, end + sizeof(struct utmpx)) == OK && u.count == 0 && u.records == NULL, "Nothing new at the end" );
+	np_utmp_close(&u);
+	ok( np_utmp_open(&u, "/nonexistent/utmp", 0, 0) == ERROR, "Missing file is an error" );
+
+	/* larger than a page, to map from an unaligned offset */
+	if ((fd = open(path, O_WRONLY|O_TRUNC)) < 0)
+		die(STATE_UNKNOWN, "Cannot open %s: %s\n", path, strerror(errno));
+	for (i = 0; i < MANY_RECORDS; i++)
+		add_record(fd, i % 4 ? USER_PROCESS : DEAD_PROCESS, "user", "pts/9", "198.51.100.1");
+	close(fd);
+	ok( np_utmp_open(&u, path, 0, 7 * sizeof(struct utmpx)) == OK && u.count == MANY_RECORDS - 7 &&
+	    u.records[1].ut_type == DEAD_PROCESS, "Unaligned offset is mapped" );
+	np_utmp_close(&u);
+
+	/* the getutxent loop check_users used before */
+	utmpxname(path);
+	setutxent();
+	old_users = 0;
+	while ((putmpx = getutxent()) != NULL)
+		if (putmpx->ut_type == USER_PROCESS)
+			old_users++;
+	endutxent();
+	np_utmp_open(&u, path, 0, 0);
+	i = count_users(&u);
+	np_utmp_close(&u);
+	ok( i == old_users && i == MANY_RECORDS * 3 / 4, "Same sessions as getutxent" );
+
+	unlink(path);
+#else
+	plan_tests(1);
+	skip(1, "No utmpx support");
+#endif
+
+	return exit_status();
+}
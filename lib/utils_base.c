@@ -30,6 +30,7 @@
 #include <ctype.h>
 #include <fcntl.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <unistd.h>
 #include <sys/types.h>
 
@@ -109,12 +110,22 @@ void set_range_end (range *this, double value) {
 range
 *parse_range_string (char *str) {
 	range *temp_range;
+
+	temp_range = (range *) calloc(1, sizeof(range));
+
+	if (parse_range(str, temp_range) == 0)
+		return temp_range;
+	free(temp_range);
+	return NULL;
+}
+
+/* Fills in a caller supplied range, returns 0 or NP_RANGE_UNPARSEABLE */
+int
+parse_range (char *str, range *temp_range) {
 	double start;
 	double end;
 	char *end_str;
 
-	temp_range = (range *) calloc(1, sizeof(range));
-
 	/* Set defaults */
 	temp_range->start = 0;
 	temp_range->start_infinity = FALSE;
@@ -147,10 +158,9 @@ range
 	if (temp_range->start_infinity ||
 		temp_range->end_infinity ||
 		temp_range->start <= temp_range->end) {
-		return temp_range;
+		return 0;
 	}
-	free(temp_range);
-	return NULL;
+	return NP_RANGE_UNPARSEABLE;
 }
 
 /* returns 0 if okay, otherwise 1 */
@@ -278,6 +288,59 @@ get_status(double value, thresholds *my_thresholds)
 	return STATE_OK;
 }
 
+/* An unset range alerts on nothing: OUTSIDE of -inf:+inf */
+static void
+compile_range(compiled_thresholds *compiled, int index, range *my_range)
+{
+	compiled->start[index] = my_range ? my_range->start : 0;
+	compiled->end[index] = my_range ? my_range->end : 0;
+	compiled->start_infinity[index] = my_range ? (my_range->start_infinity != FALSE) : 1;
+	compiled->end_infinity[index] = my_range ? (my_range->end_infinity != FALSE) : 1;
+	compiled->alert_outside[index] = my_range ? (my_range->alert_on == OUTSIDE) : 1;
+}
+
+void
+compile_thresholds(compiled_thresholds *compiled, thresholds *my_thresholds)
+{
+	compile_range(compiled, NP_RANGE_CRITICAL, my_thresholds ? my_thresholds->critical : NULL);
+	compile_range(compiled, NP_RANGE_WARNING, my_thresholds ? my_thresholds->warning : NULL);
+}
+
+/* Like _set_thresholds, straight into caller supplied storage */
+int
+parse_compiled_thresholds(compiled_thresholds *compiled, char *warn_string, char *critical_string)
+{
+	range warning, critical;
+
+	if (warn_string && parse_range(warn_string, &warning))
+		return NP_RANGE_UNPARSEABLE;
+	if (critical_string && parse_range(critical_string, &critical))
+		return NP_RANGE_UNPARSEABLE;
+	compile_range(compiled, NP_RANGE_CRITICAL, critical_string ? &critical : NULL);
+	compile_range(compiled, NP_RANGE_WARNING, warn_string ? &warning : NULL);
+	return 0;
+}
+
+/* Same result as check_range: the value is inside unless a finite end
+ * excludes it, then the answer is flipped for OUTSIDE ranges. Only
+ * bitwise operations, so there is no branch per value */
+#define COMPILED_RANGE_ALERT(c, i, value) \
+	(((((c)->start[i] <= (value)) | (c)->start_infinity[i]) & \
+	  (((value) <= (c)->end[i]) | (c)->end_infinity[i])) ^ (c)->alert_outside[i])
+
+/* critical (2) wins over warning (1) */
+#define COMPILED_STATUS(critical, warning) \
+	(((critical) << 1) | ((warning) & ((critical) ^ 1)))
+
+int
+get_status_compiled(double value, const compiled_thresholds *compiled)
+{
+	int critical = COMPILED_RANGE_ALERT(compiled, NP_RANGE_CRITICAL, value);
+	int warning = COMPILED_RANGE_ALERT(compiled, NP_RANGE_WARNING, value);
+
+	return COMPILED_STATUS(critical, warning);
+}
+
 char *np_escaped_string (const char *string) {
 	char *data;
 	int i, j=0;
@@ -395,6 +458,53 @@ int translate_state (char *state_text) {
        return ERROR;
 }
 
+/*
+ * Map a whole file, so only the pages that are looked at get read. Files
+ * that cannot be mapped, such as pipes, are an ERROR
+ */
+int np_map_file(np_mapped_file *file, const char *path) {
+	struct stat st;
+	int fd, saved_errno;
+
+	memset(file, 0, sizeof(np_mapped_file));
+	file->data = "";
+	if((fd=open(path, O_RDONLY))<0)
+		return ERROR;
+	if(fstat(fd, &st)!=0) {
+		saved_errno = errno;
+		close(fd);
+		errno = saved_errno;
+		return ERROR;
+	}
+	if(!S_ISREG(st.st_mode)) {
+		close(fd);
+		errno = EINVAL;
+		return ERROR;
+	}
+	if(st.st_size > 0) {
+		file->map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+		if(file->map==MAP_FAILED) {
+			saved_errno = errno;
+			file->map = NULL;
+			close(fd);
+			errno = saved_errno;
+			return ERROR;
+		}
+		file->data = file->map;
+		file->len = st.st_size;
+	}
+	close(fd);
+	return OK;
+}
+
+void np_unmap_file(np_mapped_file *file) {
+	if(file->map)
+		munmap(file->map, file->len);
+	file->map = NULL;
+	file->data = "";
+	file->len = 0;
+}
+
 /*
  * Returns a string to use as a keyname, based on an md5 hash of argv, thus
  * hopefully a unique key per service/plugin invocation. Use the extra-opts
@@ -454,6 +564,21 @@ char* _np_state_calculate_location_prefix(){
 	return NP_STATE_DIR_PREFIX;
 }
 
+/*
+ * Returns the directory this plugin keeps its state files in. Plugins can
+ * use it for other per-plugin runtime files. Requires np_init to be called
+ */
+char *np_state_directory() {
+	char *dir = NULL;
+
+	if(!this_nagios_plugin)
+		die(STATE_UNKNOWN, "%s\n", _("This requires np_init to be called"));
+
+	if (asprintf(&dir, "%s/%lu/%s", _np_state_calculate_location_prefix(), (unsigned long)geteuid(), this_nagios_plugin->plugin_name) < 0)
+		die(STATE_UNKNOWN, "%s %s\n", _("Cannot allocate memory:"), strerror(errno));
+	return dir;
+}
+
 /*
  * Initiatializer for state routines.
  * Sets variables. Generates filename. Returns np_state_key. die with
@@ -501,6 +626,16 @@ void np_enable_state(char *keyname, int expected_data_version) {
 	this_nagios_plugin->state = this_state;
 }
 
+/*
+ * Marks the state as secret, np_state_write_string then leaves the file
+ * readable by its owner only. Requires np_enable_state to be called
+ */
+void np_state_set_secret() {
+	if(!this_nagios_plugin || !this_nagios_plugin->state)
+		die(STATE_UNKNOWN, "%s\n", _("This requires np_enable_state to be called"));
+	this_nagios_plugin->state->secret = TRUE;
+}
+
 /*
  * Will return NULL if no data is available (first run). If key currently
  * exists, read data. If state file format version is not expected, return
@@ -545,6 +680,7 @@ state_data *np_state_read() {
 int _np_state_read_file(FILE *f) {
 	int status=FALSE;
 	size_t pos;
+	size_t size=1024;
 	char *line;
 	int i;
 	int failure=0;
@@ -553,14 +689,23 @@ int _np_state_read_file(FILE *f) {
 
 	time(&current_time);
 
-	/* Note: This introduces a limit of 1024 bytes in the string data */
-	line = (char *) calloc(1, 1024);
+	line = (char *) calloc(1, size);
 	if(!line)
 		die(STATE_UNKNOWN, "%s %s\n", _("Cannot allocate memory:"), strerror(errno));
 
-	while(!failure && (fgets(line,1024,f))!=NULL){
+	while(!failure && (fgets(line,size,f))!=NULL){
 		pos=strlen(line);
-		if(line[pos-1]=='\n')
+		/* Grow the buffer for string data longer than it */
+		while(pos==size-1 && line[pos-1]!='\n') {
+			size*=2;
+			line = (char *) realloc(line, size);
+			if(!line)
+				die(STATE_UNKNOWN, "%s %s\n", _("Cannot allocate memory:"), strerror(errno));
+			if(fgets(line+pos,size-pos,f)==NULL)
+				break;
+			pos+=strlen(line+pos);
+		}
+		if(pos && line[pos-1]=='\n')
 			line[pos-1]='\0';
 
 		if(line[0] == '#') continue;
@@ -673,7 +818,7 @@ void np_state_write_string(time_t data_time, char *data_string) {
 	fprintf(fp,"%lu\n",current_time);
 	fprintf(fp,"%s\n",data_string);
 	
-	fchmod(fd, S_IRUSR | S_IWUSR | S_IRGRP);
+	fchmod(fd, this_nagios_plugin->state->secret ? S_IRUSR | S_IWUSR : S_IRUSR | S_IWUSR | S_IRGRP);
 	
 	fflush(fp);
 
@@ -32,6 +32,20 @@ typedef struct thresholds_struct {
 	char    *critical_string;
 	} thresholds;
 
+/* Thresholds flattened for evaluating many values: index 0 holds the
+   critical range, index 1 the warning range. Infinite ends and unset
+   ranges are flags, so no pointers are followed and no branches taken */
+#define NP_RANGE_CRITICAL 0
+#define NP_RANGE_WARNING  1
+
+typedef struct compiled_thresholds_struct {
+	double	start[2];
+	double	end[2];
+	int	start_infinity[2];
+	int	end_infinity[2];
+	int	alert_outside[2];	/* 1 for OUTSIDE, 0 for INSIDE */
+	} compiled_thresholds;
+
 #define NP_STATE_FORMAT_VERSION 1
 
 typedef struct state_data_struct {
@@ -45,6 +59,7 @@ typedef struct state_key_struct {
 	char       *name;
 	char       *plugin_name;
 	int        data_version;
+	int        secret;	/* state file readable by its owner only */
 	char       *_filename;
 	state_data *state_data;
 	} state_key;
@@ -57,11 +72,15 @@ typedef struct np_struct {
 	} nagios_plugin;
 
 range *parse_range_string (char *);
+int parse_range (char *, range *);
 int _set_thresholds(thresholds **, char *, char *);
 void set_thresholds(thresholds **, char *, char *);
 void print_thresholds(const char *, thresholds *);
 int check_range(double, range *);
 int get_status(double, thresholds *);
+void compile_thresholds(compiled_thresholds *, thresholds *);
+int parse_compiled_thresholds(compiled_thresholds *, char *, char *);
+int get_status_compiled(double, const compiled_thresholds *);
 
 /* All possible characters in a threshold range */
 #define NP_THRESHOLDS_CHARS "-0123456789.:@~"
@@ -102,9 +121,23 @@ char *np_extract_value(const char*, const char*, char);
 #define np_extract_ntpvar(l, n) np_extract_value(l, n, ',')
 
 
+/* A whole file mapped read only. The data is not NUL terminated, and is
+ * an empty string for an empty file */
+typedef struct np_mapped_file_struct {
+	const char	*data;
+	size_t	len;
+	void	*map;
+	} np_mapped_file;
+
+/* Returns OK, or ERROR with errno set */
+int np_map_file(np_mapped_file *, const char *);
+void np_unmap_file(np_mapped_file *);
+
 void np_enable_state(char *, int);
 state_data *np_state_read(void);
 void np_state_write_string(time_t, char *);
+void np_state_set_secret(void);
+char *np_state_directory(void);
 
 void np_init(char *, int argc, char **argv);
 void np_set_args(int argc, char **argv);
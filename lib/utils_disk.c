@@ -185,10 +185,10 @@ np_seen_name(struct name_list *list, const char *name)
 }
 
 int
-np_regex_match_mount_entry (struct mount_entry* me, regex_t* re)
+np_regex_match_mount_entry (struct mount_entry* me, np_regex* re)
 {
-  if (regexec(re, me->me_devname, (size_t) 0, NULL, 0) == 0 ||
-      regexec(re, me->me_mountdir, (size_t) 0, NULL, 0) == 0 ) {
+  if (np_regex_match(re, me->me_devname) ||
+      np_regex_match(re, me->me_mountdir)) {
     return TRUE;
   } else {
     return FALSE;
@@ -2,7 +2,7 @@
 
 #include "mountlist.h"
 #include "utils_base.h"
-#include "regex.h"
+#include "utils_regex.h"
 
 struct name_list
 {
@@ -39,4 +39,4 @@ struct parameter_list *np_del_parameter(struct parameter_list *item, struct para
   
 int search_parameter_list (struct parameter_list *list, const char *name);
 void np_set_best_match(struct parameter_list *desired, struct mount_entry *mount_list, int exact);
-int np_regex_match_mount_entry (struct mount_entry* me, regex_t* re);
+int np_regex_match_mount_entry (struct mount_entry* me, np_regex* re);
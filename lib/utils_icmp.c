@@ -0,0 +1,112 @@
+/*****************************************************************************
+*
+* Library for ICMP echo replies
+*
+* License: GPL
+* Copyright (c) 2014 Nagios Plugins Development Team
+*
+* Description:
+*
+* This file tells the replies and errors np_net_ping reads from its ICMP
+* socket apart, without any socket of its own. These are tested by libtap
+*
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*
+*****************************************************************************/
+
+#include "common.h"
+#include "utils_icmp.h"
+#include <netinet/in_systm.h>
+#include <netinet/ip.h>
+#include <netinet/ip_icmp.h>
+#ifdef USE_IPV6
+# include <netinet/icmp6.h>
+#endif
+
+int
+np_icmp_error (int family, int type, int code)
+{
+#ifdef USE_IPV6
+	if (family == AF_INET6) {
+		if (type == ICMP6_TIME_EXCEEDED)
+			return ETIMEDOUT;
+		if (type != ICMP6_DST_UNREACH)
+			return 0;
+		if (code == ICMP6_DST_UNREACH_NOROUTE)
+			return ENETUNREACH;
+		if (code == ICMP6_DST_UNREACH_ADMIN)
+			return EACCES;
+		return EHOSTUNREACH;
+	}
+#endif
+	if (type == ICMP_TIMXCEED)
+		return ETIMEDOUT;
+	if (type != ICMP_UNREACH)
+		return 0;
+	switch (code) {
+	case ICMP_UNREACH_NET:
+	case ICMP_UNREACH_NET_UNKNOWN:
+		return ENETUNREACH;
+	case ICMP_UNREACH_PROTOCOL:
+	case ICMP_UNREACH_PORT:
+		return ECONNREFUSED;
+	case ICMP_UNREACH_NET_PROHIB:
+	case ICMP_UNREACH_HOST_PROHIB:
+	case ICMP_UNREACH_FILTER_PROHIB:
+		return EACCES;
+	}
+	return EHOSTUNREACH;
+}
+
+enum np_icmp_reply
+np_icmp_parse (const unsigned char *packet, int len, int family, int raw,
+               unsigned short ident, unsigned short *seq, int *error)
+{
+	int echo_reply = ICMP_ECHOREPLY, hlen, err;
+
+#ifdef USE_IPV6
+	if (family == AF_INET6)
+		echo_reply = ICMP6_ECHO_REPLY;
+#endif
+
+	/* raw IPv4 sockets, and datagram ones on some systems, get the IP header */
+	if (family == AF_INET && len >= 20 && (packet[0] >> 4) == 4) {
+		hlen = (packet[0] & 0x0f) * 4;
+		if (hlen < 20 || hlen > len)
+			return NP_ICMP_OTHER;
+		packet += hlen;
+		len -= hlen;
+	}
+	if (len < 8)
+		return NP_ICMP_OTHER;
+
+	if (packet[0] != echo_reply) {
+		/* raw sockets see errors as packets quoting our request */
+		if (!raw || len < 9 || (err = np_icmp_error (family, packet[0], packet[1])) == 0)
+			return NP_ICMP_OTHER;
+		hlen = 8 + (family == AF_INET ? (packet[8] & 0x0f) * 4 : 40);
+		if (len < hlen + 8 || memcmp (&packet[hlen + 4], &ident, 2) != 0)
+			return NP_ICMP_OTHER;
+		*error = err;
+		return NP_ICMP_ERROR;
+	}
+	if (raw && memcmp (&packet[4], &ident, 2) != 0)
+		return NP_ICMP_OTHER;
+
+	memcpy (seq, &packet[6], 2);
+	*seq = ntohs (*seq);
+	return NP_ICMP_ECHO_REPLY;
+}
@@ -0,0 +1,22 @@
+/* Header file for utils_icmp */
+
+/* What np_icmp_parse found in a packet read from an ICMP echo socket */
+enum np_icmp_reply {
+	NP_ICMP_OTHER,                /* not an answer to our echo requests */
+	NP_ICMP_ECHO_REPLY,           /* an echo reply, the sequence number is set */
+	NP_ICMP_ERROR                 /* an error about our requests, the errno is set */
+};
+
+/*
+ * Classify one packet read from an ICMP socket of the given family.  Raw
+ * sockets see every ICMP packet of the host, so replies and errors are only
+ * taken when they carry ident (in network byte order); datagram sockets only
+ * get what the kernel matched to them.  An IPv4 header in front of the
+ * message is skipped.
+ */
+enum np_icmp_reply np_icmp_parse (const unsigned char *packet, int len,
+                                  int family, int raw, unsigned short ident,
+                                  unsigned short *seq, int *error);
+
+/* errno for an ICMP error message about our echo requests, 0 for others */
+int np_icmp_error (int family, int type, int code);
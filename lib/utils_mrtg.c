@@ -0,0 +1,144 @@
+/*****************************************************************************
+*
+* Library for reading MRTG logs
+*
+* License: GPL
+* Copyright (c) 2014 Nagios Plugins Development Team
+*
+* Description:
+*
+* This file contains the reader check_mrtg and check_mrtgtraf share. It
+* maps a log and parses only its first two lines, and keeps the counters
+* between runs so rates can be computed from them. These are tested by
+* libtap
+*
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*
+*****************************************************************************/
+
+#include "common.h"
+#include "utils_base.h"
+#include "utils_mrtg.h"
+
+/* copies the line at *pos into line and moves *pos past it. Returns FALSE
+ * if there is no complete line left */
+static int
+next_line (const char *buf, size_t len, size_t *pos, char *line, size_t size)
+{
+	const char *end;
+	size_t n;
+
+	if (*pos >= len || (end = memchr (buf + *pos, '\n', len - *pos)) == NULL)
+		return FALSE;
+	n = end - (buf + *pos);
+	if (n > size - 1)
+		n = size - 1;
+	memcpy (line, buf + *pos, n);
+	line[n] = '\0';
+	*pos = end - buf + 1;
+	return TRUE;
+}
+
+int
+np_mrtg_parse (const char *buf, size_t len, np_mrtg_log *log)
+{
+	char line[MAX_INPUT_BUFFER];
+	unsigned long timestamp;
+	size_t pos = 0;
+
+	memset (log, 0, sizeof (np_mrtg_log));
+
+	/* <time> <counter 1> <counter 2> */
+	if (!next_line (buf, len, &pos, line, sizeof (line)))
+		return ERROR;
+	if (sscanf (line, "%lu %llu %llu", &timestamp, &log->counter[0], &log->counter[1]) == 3)
+		log->counter_time = timestamp;
+
+	/* <time> <average 1> <average 2> <maximum 1> <maximum 2> */
+	if (!next_line (buf, len, &pos, line, sizeof (line)) ||
+	    sscanf (line, "%lu %lu %lu %lu %lu", &timestamp, &log->average[0], &log->average[1],
+	            &log->maximum[0], &log->maximum[1]) != 5)
+		return ERROR;
+	log->timestamp = timestamp;
+	return OK;
+}
+
+int
+np_mrtg_read (const char *path, np_mrtg_log *log)
+{
+	np_mapped_file file;
+	int result;
+
+	if (np_map_file (&file, path) != OK)
+		return ERROR;
+	result = np_mrtg_parse (file.data, file.len, log);
+	np_unmap_file (&file);
+	return result;
+}
+
+/* entries are "<time> <counter 1> <counter 2> <rate 1> <rate 2> <path>",
+ * separated by tabs as the state data is a single line */
+int
+np_mrtg_rates (const char *state, const char *path, const np_mrtg_log *log, double *rate)
+{
+	const char *entry, *name, *end;
+	unsigned long long counter[2];
+	unsigned long timestamp;
+	double saved[2];
+	size_t pathlen = strlen (path);
+	int n;
+
+	if (state == NULL || log->counter_time == 0)
+		return FALSE;
+
+	for (entry = state; *entry; entry = *end ? end + 1 : end) {
+		end = strchr (entry, '\t');
+		if (end == NULL)
+			end = entry + strlen (entry);
+		if (sscanf (entry, "%lu %llu %llu %lf %lf %n", &timestamp, &counter[0], &counter[1],
+		            &saved[0], &saved[1], &n) != 5)
+			continue;
+		name = entry + n;
+		if ((size_t) (end - name) != pathlen || strncmp (name, path, pathlen) != 0)
+			continue;
+
+		if ((time_t) timestamp == log->counter_time) {
+			if (saved[0] < 0 || saved[1] < 0)
+				return FALSE;
+			rate[0] = saved[0];
+			rate[1] = saved[1];
+			return TRUE;
+		}
+		/* a counter reset or wrap, or an older log put back */
+		if ((time_t) timestamp > log->counter_time || log->counter[0] < counter[0] || log->counter[1] < counter[1])
+			return FALSE;
+		rate[0] = (log->counter[0] - counter[0]) / (double) (log->counter_time - timestamp);
+		rate[1] = (log->counter[1] - counter[1]) / (double) (log->counter_time - timestamp);
+		return TRUE;
+	}
+	return FALSE;
+}
+
+void
+np_mrtg_state_add (np_str *state, const char *path, const np_mrtg_log *log, const double *rate)
+{
+	if (log->counter_time == 0)
+		return;
+	if (state->len > 0)
+		np_str_add (state, "\t");
+	np_str_addf (state, "%lu %llu %llu %f %f %s", (unsigned long) log->counter_time,
+	             log->counter[0], log->counter[1], rate ? rate[0] : -1.0, rate ? rate[1] : -1.0, path);
+}
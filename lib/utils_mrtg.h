@@ -0,0 +1,33 @@
+#ifndef NAGIOS_UTILS_MRTG_H_INCLUDED
+#define NAGIOS_UTILS_MRTG_H_INCLUDED
+/* Header file for the MRTG log reader of check_mrtg and check_mrtgtraf */
+
+#include "utils_str.h"
+
+/* The head of an MRTG log: the counters MRTG saw on its last run, then the
+ * newest entry. Index 0 is the first variable (incoming traffic), index 1
+ * the second (outgoing traffic) */
+typedef struct np_mrtg_log {
+	time_t	counter_time;	/* 0 if the first line has no counters */
+	unsigned long long counter[2];
+	time_t	timestamp;
+	unsigned long average[2];
+	unsigned long maximum[2];
+} np_mrtg_log;
+
+/* Parses the first two lines of a log. Returns OK, or ERROR if the first
+ * entry is missing or incomplete */
+int np_mrtg_parse (const char *, size_t, np_mrtg_log *);
+/* Maps the log and parses its head, the rest of the file is never read.
+ * Returns OK, or ERROR with errno set if the file cannot be mapped */
+int np_mrtg_read (const char *, np_mrtg_log *);
+
+/* Rates per second of both counters since the entry for a log in state
+ * data written by np_mrtg_state_add. If MRTG has not run since, the rates
+ * saved in that entry are used again. Returns FALSE if there is no entry
+ * or the counters went back */
+int np_mrtg_rates (const char *, const char *, const np_mrtg_log *, double *);
+/* Appends the entry for a log, rates may be NULL */
+void np_mrtg_state_add (np_str *, const char *, const np_mrtg_log *, const double *);
+
+#endif /* NAGIOS_UTILS_MRTG_H_INCLUDED */
@@ -0,0 +1,411 @@
+/*****************************************************************************
+*
+* Library of readers for Linux /proc files
+*
+* License: GPL
+* Copyright (c) 2014 Nagios Plugins Development Team
+*
+* Description:
+*
+* This file contains parsers for /proc/meminfo, /proc/swaps, /proc/vmstat,
+* the /proc/pressure files and the per process files, so plugins get these
+* figures without running external commands. These are tested by libtap
+*
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*
+*****************************************************************************/
+
+#include "common.h"
+#include "utils_base.h"
+#include "utils_proc.h"
+
+#include <fcntl.h>
+#include <dirent.h>
+#ifdef HAVE_SYS_STAT_H
+# include <sys/stat.h>
+#endif
+#ifdef HAVE_SYS_SYSINFO_H
+# include <sys/sysinfo.h>
+#endif
+
+#define NP_PROC_MIN_SIZE 4096
+
+char *
+np_proc_load (const char *path, size_t *len)
+{
+	char *buf = NULL, *tmp;
+	size_t size = 0, used = 0;
+	ssize_t n;
+	int fd;
+
+	if ((fd = open (path, O_RDONLY)) < 0)
+		return NULL;
+
+	for (;;) {
+		if (size - used < NP_PROC_MIN_SIZE / 4) {
+			size = size ? size * 2 : NP_PROC_MIN_SIZE;
+			if ((tmp = realloc (buf, size)) == NULL) {
+				free (buf);
+				close (fd);
+				return NULL;
+			}
+			buf = tmp;
+		}
+		n = read (fd, buf + used, size - used - 1);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0) {
+			free (buf);
+			close (fd);
+			return NULL;
+		}
+		if (n == 0)
+			break;
+		used += n;
+	}
+
+	close (fd);
+	buf[used] = '\0';
+	if (len)
+		*len = used;
+	return buf;
+}
+
+int
+np_proc_value (const char *buf, const char *key, unsigned long long *value)
+{
+	size_t keylen = strlen (key);
+	const char *line;
+	char *end;
+
+	for (line = buf; line && *line; line = strchr (line, '\n'), line = line ? line + 1 : NULL) {
+		if (strncmp (line, key, keylen) != 0 || (line[keylen] != ' ' && line[keylen] != '\t'))
+			continue;
+		*value = strtoull (line + keylen, &end, 10);
+		return end != line + keylen;
+	}
+	return FALSE;
+}
+
+int
+np_swap_summary (double *total_mb, double *free_mb)
+{
+	unsigned long long total, avail;
+	char *buf;
+	int found;
+#ifdef HAVE_SYS_SYSINFO_H
+	struct sysinfo si;
+#endif
+
+	if ((buf = np_proc_load (PROC_MEMINFO, NULL)) != NULL) {
+		/* always in kB */
+		found = np_proc_value (buf, "SwapTotal:", &total) && np_proc_value (buf, "SwapFree:", &avail);
+		free (buf);
+		if (found) {
+			*total_mb = total / 1024.0;
+			*free_mb = avail / 1024.0;
+			return OK;
+		}
+	}
+
+#ifdef HAVE_SYS_SYSINFO_H
+	if (sysinfo (&si) == 0) {
+		*total_mb = (double) si.totalswap * si.mem_unit / (1024 * 1024);
+		*free_mb = (double) si.freeswap * si.mem_unit / (1024 * 1024);
+		return OK;
+	}
+#endif
+	return ERROR;
+}
+
+/* Filename Type Size Used Priority, sizes in kB. Names have spaces
+ * escaped as \040 by the kernel, so they are single words */
+np_swap_device *
+np_swap_devices_parse (const char *buf)
+{
+	np_swap_device *list = NULL, **tail = &list, *dev;
+	const char *line, *next;
+	char name[4096], type[32];
+	unsigned long long size, used;
+
+	/* skip the header */
+	if ((line = strchr (buf, '\n')) == NULL)
+		return NULL;
+
+	for (line++; *line; line = next) {
+		next = strchr (line, '\n');
+		next = next ? next + 1 : line + strlen (line);
+		if (sscanf (line, "%4095s %31s %llu %llu", name, type, &size, &used) != 4)
+			continue;
+		dev = calloc (1, sizeof (np_swap_device));
+		if (dev == NULL || (dev->name = strdup (name)) == NULL)
+			die (STATE_UNKNOWN, _("Insufficient memory\n"));
+		dev->total_mb = size / 1024.0;
+		dev->used_mb = used / 1024.0;
+		*tail = dev;
+		tail = &dev->next;
+	}
+	return list;
+}
+
+np_swap_device *
+np_swap_devices (void)
+{
+	np_swap_device *list;
+	char *buf;
+
+	if ((buf = np_proc_load (PROC_SWAPS, NULL)) == NULL)
+		return NULL;
+	list = np_swap_devices_parse (buf);
+	free (buf);
+	return list;
+}
+
+void
+np_swap_devices_free (np_swap_device *list)
+{
+	np_swap_device *next;
+
+	for (; list; list = next) {
+		next = list->next;
+		free (list->name);
+		free (list);
+	}
+}
+
+/* some avg10=0.00 avg60=0.00 avg300=0.00 total=0 */
+int
+np_pressure_parse (const char *buf, np_pressure *some, np_pressure *full)
+{
+	const char *line;
+	np_pressure *p;
+	int found = FALSE;
+
+	memset (some, 0, sizeof (np_pressure));
+	memset (full, 0, sizeof (np_pressure));
+	for (line = buf; line && *line; line = strchr (line, '\n'), line = line ? line + 1 : NULL) {
+		if (strncmp (line, "some ", 5) == 0)
+			p = some;
+		else if (strncmp (line, "full ", 5) == 0)
+			p = full;
+		else
+			continue;
+		if (sscanf (line + 5, "avg10=%lf avg60=%lf avg300=%lf total=%llu",
+		            &p->avg10, &p->avg60, &p->avg300, &p->total) == 4)
+			found = TRUE;
+	}
+	return found;
+}
+
+int
+np_pressure_read (const char *path, np_pressure *some, np_pressure *full)
+{
+	char *buf;
+	int found;
+
+	if ((buf = np_proc_load (path, NULL)) == NULL)
+		return FALSE;
+	found = np_pressure_parse (buf, some, full);
+	free (buf);
+	return found;
+}
+
+int
+np_proc_loadavg (double *la)
+{
+	char *buf;
+	int n;
+
+	if ((buf = np_proc_load (PROC_DIR "/loadavg", NULL)) != NULL) {
+		n = sscanf (buf, "%lf %lf %lf", &la[0], &la[1], &la[2]);
+		free (buf);
+		if (n == 3)
+			return OK;
+	}
+#ifdef HAVE_GETLOADAVG
+	if (getloadavg (la, 3) == 3)
+		return OK;
+#endif
+	return ERROR;
+}
+
+int
+np_proc_uptime (double *uptime)
+{
+	char *buf;
+	int n;
+
+	if ((buf = np_proc_load (PROC_DIR "/uptime", NULL)) == NULL)
+		return ERROR;
+	n = sscanf (buf, "%lf", uptime);
+	free (buf);
+	return n == 1 ? OK : ERROR;
+}
+
+/* fills everything but args from /proc/<pid>/stat */
+static int
+read_proc_stat (const char *dir, np_proc_entry *p, double uptime, long hz, long pagesize)
+{
+	char path[PATH_MAX + sizeof "/stat"], *buf, *lparen, *rparen;
+	unsigned long utime, stime, vsize;
+	unsigned long long starttime;
+	long rss;
+	int n;
+
+	snprintf (path, sizeof (path), "%s/stat", dir);
+	buf = np_proc_load (path, NULL);
+	if (buf == NULL)
+		return ERROR;
+
+	/* the command name is in parentheses and may contain both */
+	if ((lparen = strchr (buf, '(')) == NULL || (rparen = strrchr (buf, ')')) == NULL || rparen < lparen) {
+		free (buf);
+		return ERROR;
+	}
+	n = rparen - lparen - 1;
+	if (n > (int) sizeof (p->prog) - 1)
+		n = sizeof (p->prog) - 1;
+	memcpy (p->prog, lparen + 1, n);
+	p->prog[n] = '\0';
+
+	n = sscanf (rparen + 1, " %c %d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu"
+	            " %*d %*d %*d %*d %*d %*d %llu %lu %ld",
+	            &p->state, &p->ppid, &utime, &stime, &starttime, &vsize, &rss);
+	free (buf);
+	if (n != 7)
+		return ERROR;
+
+	p->vsz = vsize / 1024;
+	p->rss = rss * (pagesize / 1024);
+	p->elapsed = uptime - (double) starttime / hz;
+	if (p->elapsed < 0)
+		p->elapsed = 0;
+	/* the same as ps: CPU time over the whole life of the process */
+	p->pcpu = p->elapsed > 0 ? 100.0 * (utime + stime) / hz / p->elapsed : 0;
+	return OK;
+}
+
+/* the command line with its NUL separators turned into spaces */
+static char *
+read_proc_args (const char *dir, const char *prog)
+{
+	char path[PATH_MAX], *buf, *args;
+	size_t len, i;
+
+	snprintf (path, sizeof (path), "%s/cmdline", dir);
+	buf = np_proc_load (path, &len);
+	while (buf && len > 0 && buf[len - 1] == '\0')
+		len--;
+	if (buf == NULL || len == 0) {
+		free (buf);
+		if ((args = malloc (strlen (prog) + 3)) == NULL)
+			die (STATE_UNKNOWN, _("Insufficient memory\n"));
+		sprintf (args, "[%s]", prog);
+		return args;
+	}
+	for (i = 0; i < len; i++)
+		if (buf[i] == '\0')
+			buf[i] = ' ';
+	buf[len] = '\0';
+	if ((args = realloc (buf, len + 1)) == NULL)
+		return buf;
+	return args;
+}
+
+np_proc_entry *
+np_proc_scan (size_t *count)
+{
+	np_proc_entry *list = NULL, *tmp;
+	size_t n = 0, size = 0;
+	struct dirent *de;
+	struct stat st;
+	double uptime = 0;
+	long hz = sysconf (_SC_CLK_TCK), pagesize = sysconf (_SC_PAGESIZE);
+	char dir[PATH_MAX], *end;
+	pid_t pid;
+	DIR *d;
+
+	if ((d = opendir (PROC_DIR)) == NULL)
+		return NULL;
+	np_proc_uptime (&uptime);
+	if (hz <= 0)
+		hz = 100;
+
+	while ((de = readdir (d)) != NULL) {
+		pid = strtol (de->d_name, &end, 10);
+		if (*end != '\0' || end == de->d_name)
+			continue;
+		if (n == size) {
+			size = size ? size * 2 : 256;
+			if ((tmp = realloc (list, size * sizeof (np_proc_entry))) == NULL)
+				die (STATE_UNKNOWN, _("Insufficient memory\n"));
+			list = tmp;
+		}
+		memset (&list[n], 0, sizeof (np_proc_entry));
+		list[n].pid = pid;
+
+		snprintf (dir, sizeof (dir), "%s/%s", PROC_DIR, de->d_name);
+		/* the owner of the directory is the effective uid, as ps shows */
+		if (stat (dir, &st) == 0 && read_proc_stat (dir, &list[n], uptime, hz, pagesize) == OK) {
+			list[n].uid = st.st_uid;
+			list[n].args = read_proc_args (dir, list[n].prog);
+			n++;
+		}
+	}
+	closedir (d);
+
+	*count = n;
+	if (list == NULL)
+		list = calloc (1, sizeof (np_proc_entry));
+	return list;
+}
+
+void
+np_proc_scan_free (np_proc_entry *list, size_t count)
+{
+	size_t i;
+
+	for (i = 0; i < count; i++)
+		free (list[i].args);
+	free (list);
+}
+
+char *
+np_proc_args (pid_t pid)
+{
+	char dir[PATH_MAX];
+	struct stat st;
+
+	snprintf (dir, sizeof (dir), "%s/%ld", PROC_DIR, (long) pid);
+	if (pid <= 0 || stat (dir, &st) != 0)
+		return NULL;
+	return read_proc_args (dir, "");
+}
+
+char *
+np_proc_exe (pid_t pid)
+{
+	char path[PATH_MAX], exe[PATH_MAX], *result;
+	ssize_t n;
+
+	snprintf (path, sizeof (path), "%s/%ld/exe", PROC_DIR, (long) pid);
+	if (pid <= 0 || (n = readlink (path, exe, sizeof (exe) - 1)) <= 0)
+		return NULL;
+	exe[n] = '\0';
+	if ((result = strdup (exe)) == NULL)
+		die (STATE_UNKNOWN, _("Insufficient memory\n"));
+	return result;
+}
@@ -0,0 +1,90 @@
+#ifndef NAGIOS_UTILS_PROC_H_INCLUDED
+#define NAGIOS_UTILS_PROC_H_INCLUDED
+/* Header file for the readers of Linux /proc files */
+
+#ifndef PROC_MEMINFO
+# define PROC_MEMINFO "/proc/meminfo"
+#endif
+#ifndef PROC_SWAPS
+# define PROC_SWAPS "/proc/swaps"
+#endif
+#ifndef PROC_VMSTAT
+# define PROC_VMSTAT "/proc/vmstat"
+#endif
+#ifndef PROC_PRESSURE_MEMORY
+# define PROC_PRESSURE_MEMORY "/proc/pressure/memory"
+#endif
+
+#ifndef PROC_DIR
+# define PROC_DIR "/proc"
+#endif
+
+/* One line of /proc/swaps, sizes in MB */
+typedef struct np_swap_device {
+	char	*name;
+	double	total_mb;
+	double	used_mb;
+	struct np_swap_device *next;
+} np_swap_device;
+
+/* One line of a /proc/pressure file, the averages are percentages */
+typedef struct np_pressure {
+	double	avg10;
+	double	avg60;
+	double	avg300;
+	unsigned long long total;	/* microseconds stalled */
+} np_pressure;
+
+/* One process, in the units ps(1) reports them */
+typedef struct np_proc_entry {
+	pid_t	pid;
+	pid_t	ppid;
+	uid_t	uid;
+	char	state;
+	char	prog[16];	/* the kernel's command name, at most 15 characters */
+	char	*args;	/* the command line, or [prog] for kernel threads */
+	long	vsz;	/* kB */
+	long	rss;	/* kB */
+	double	pcpu;	/* CPU time over elapsed time, in percent */
+	long	elapsed;	/* seconds */
+} np_proc_entry;
+
+/* Reads the whole file into a new NUL terminated buffer, without stdio.
+ * /proc files report no size, so the buffer grows until read returns 0.
+ * Returns NULL if the file cannot be read */
+char *np_proc_load (const char *, size_t *);
+
+/* The number following a key at the start of a line, e.g. "SwapFree:" in
+ * /proc/meminfo or "pswpin" in /proc/vmstat. Returns FALSE if not found */
+int np_proc_value (const char *, const char *, unsigned long long *);
+
+/* Total and free swap in MB from PROC_MEMINFO, or from sysinfo(2) where
+ * that file is missing. Returns OK or ERROR */
+int np_swap_summary (double *, double *);
+
+np_swap_device *np_swap_devices_parse (const char *);
+/* The devices listed in PROC_SWAPS, NULL if there are none */
+np_swap_device *np_swap_devices (void);
+void np_swap_devices_free (np_swap_device *);
+
+/* Fills the "some" and "full" lines, a missing line is left zeroed.
+ * Returns FALSE if neither line is present */
+int np_pressure_parse (const char *, np_pressure *, np_pressure *);
+int np_pressure_read (const char *, np_pressure *, np_pressure *);
+
+/* The 1, 5 and 15 minute load averages. Returns OK or ERROR */
+int np_proc_loadavg (double *);
+/* Seconds since boot. Returns OK or ERROR */
+int np_proc_uptime (double *);
+
+/* All processes in PROC_DIR, in one pass. Processes that exit during the
+ * scan are left out. Returns NULL if PROC_DIR cannot be read */
+np_proc_entry *np_proc_scan (size_t *);
+void np_proc_scan_free (np_proc_entry *, size_t);
+
+/* The command line of one process as np_proc_scan gives it, and the file
+ * it runs from. NULL if there is no such process or it cannot be read */
+char *np_proc_args (pid_t);
+char *np_proc_exe (pid_t);
+
+#endif /* NAGIOS_UTILS_PROC_H_INCLUDED */
@@ -0,0 +1,263 @@
+/*****************************************************************************
+* 
+* Library of regular expression functions for plugins
+* 
+* License: GPL
+* Copyright (c) 2014 Nagios Plugins Development Team
+* 
+* Description:
+* 
+* This file contains a regex wrapper that compiles patterns once and skips
+* the regex engine for subjects lacking a literal every match needs. These
+* are tested by libtap
+* 
+* 
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+* 
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+* 
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+* 
+* 
+*****************************************************************************/
+
+#include "common.h"
+#include "utils_base.h"
+#include "utils_regex.h"
+#include <ctype.h>
+
+/* What a piece of a pattern means for the literal we are collecting */
+enum {
+	TOKEN_LITERAL,		/* an ordinary character */
+	TOKEN_OPTIONAL,		/* *, ? or an interval: the previous character may be absent */
+	TOKEN_REPEAT,		/* +: the previous character is still required */
+	TOKEN_OTHER,		/* anything else ends the literal */
+	TOKEN_OPEN,
+	TOKEN_CLOSE,
+	TOKEN_ALTERNATION
+};
+
+/* skip a bracket expression, p points after the '[' */
+static const char *
+skip_bracket (const char *p)
+{
+	char delim;
+
+	if (*p == '^')
+		p++;
+	if (*p == ']')
+		p++;
+	while (*p && *p != ']') {
+		if (*p == '[' && (p[1] == ':' || p[1] == '.' || p[1] == '=')) {
+			delim = p[1];
+			for (p += 2; *p && !(*p == delim && p[1] == ']'); p++)
+				;
+			if (*p)
+				p += 2;
+		} else {
+			p++;
+		}
+	}
+	return *p ? p + 1 : p;
+}
+
+/* skip the contents of an interval, p points after the '{' */
+static const char *
+skip_interval (const char *p, int extended)
+{
+	while (*p && !(extended ? *p == '}' : (*p == '\\' && p[1] == '}')))
+		p++;
+	if (*p)
+		p += extended ? 1 : 2;
+	return p;
+}
+
+/*
+ * Returns the longest run of characters every match of the pattern has
+ * to contain, or NULL. It is conservative: anything it doesn't fully
+ * understand ends the current run, groups are skipped and a top level
+ * alternation means there is no required literal. Non-ASCII bytes end a
+ * run, so a multibyte character is never split, and with REG_ICASE so do
+ * letters, as they may match characters from other cases or scripts.
+ */
+char *
+np_regex_literal (const char *pattern, int cflags)
+{
+	int extended = (cflags & REG_EXTENDED) != 0;
+	int icase = (cflags & REG_ICASE) != 0;
+	const char *p = pattern;
+	char *run, *best = NULL;
+	size_t run_len = 0, best_len = 0;
+	int depth = 0, last_literal = FALSE, token;
+	unsigned char c;
+
+	if ((run = malloc(strlen(pattern) + 1)) == NULL)
+		die(STATE_UNKNOWN, "%s\n", _("Could not allocate memory"));
+
+	while (*p) {
+		c = (unsigned char) *p++;
+		token = TOKEN_LITERAL;
+		if (c == '[') {
+			p = skip_bracket(p);
+			token = TOKEN_OTHER;
+		} else if (c == '\\') {
+			if ((c = (unsigned char) *p) == '\0')
+				break;
+			p++;
+			if (extended)
+				token = strchr(".[]()*+?{}|^$\\/", c) ? TOKEN_LITERAL : TOKEN_OTHER;
+			else if (c == '(')
+				token = TOKEN_OPEN;
+			else if (c == ')')
+				token = TOKEN_CLOSE;
+			else if (c == '{') {
+				p = skip_interval(p, FALSE);
+				token = TOKEN_OPTIONAL;
+			} else if (c == '?')
+				token = TOKEN_OPTIONAL;
+			else if (c == '+')
+				token = TOKEN_REPEAT;
+			else if (c == '|')
+				token = TOKEN_ALTERNATION;
+			else
+				token = strchr(".[]*^$\\/", c) ? TOKEN_LITERAL : TOKEN_OTHER;
+		} else if (c == '*') {
+			token = TOKEN_OPTIONAL;
+		} else if (c == '.' || c == '^' || c == '$') {
+			token = TOKEN_OTHER;
+		} else if (extended) {
+			if (c == '(')
+				token = TOKEN_OPEN;
+			else if (c == ')')
+				token = TOKEN_CLOSE;
+			else if (c == '|')
+				token = TOKEN_ALTERNATION;
+			else if (c == '?')
+				token = TOKEN_OPTIONAL;
+			else if (c == '+')
+				token = TOKEN_REPEAT;
+			else if (c == '{') {
+				p = skip_interval(p, TRUE);
+				token = TOKEN_OPTIONAL;
+			}
+		}
+		if (token == TOKEN_LITERAL && (c >= 0x80 || (icase && isalpha(c))))
+			token = TOKEN_OTHER;
+
+		if (token == TOKEN_LITERAL && depth == 0) {
+			run[run_len++] = c;
+			last_literal = TRUE;
+			continue;
+		}
+		if (token == TOKEN_ALTERNATION && depth == 0) {
+			free(run);
+			free(best);
+			return NULL;
+		}
+		/* a quantified character is not required */
+		if (token == TOKEN_OPTIONAL && depth == 0 && last_literal)
+			run_len--;
+		if (token == TOKEN_OPEN)
+			depth++;
+		else if (token == TOKEN_CLOSE && depth > 0)
+			depth--;
+		if (run_len > best_len) {
+			free(best);
+			best = strndup(run, run_len);
+			best_len = run_len;
+		}
+		run_len = 0;
+		last_literal = FALSE;
+	}
+	if (run_len > best_len) {
+		free(best);
+		best = strndup(run, run_len);
+		best_len = run_len;
+	}
+	free(run);
+	if (best_len == 0) {
+		free(best);
+		return NULL;
+	}
+	return best;
+}
+
+int
+np_regex_compile (np_regex *re, const char *pattern, int cflags)
+{
+	int err;
+
+	re->literal = NULL;
+	/* Without submatches the matcher never leaves its DFA pass */
+	if ((err = regcomp(&re->re, pattern, cflags | REG_NOSUB)) != 0)
+		return err;
+	re->literal = np_regex_literal(pattern, cflags);
+	return 0;
+}
+
+int
+np_regex_match (const np_regex *re, const char *string)
+{
+	if (re->literal && strstr(string, re->literal) == NULL)
+		return FALSE;
+	return regexec(&re->re, string, (size_t) 0, NULL, 0) == 0;
+}
+
+size_t
+np_regex_error (int err, const np_regex *re, char *buf, size_t size)
+{
+	return regerror(err, re ? &re->re : NULL, buf, size);
+}
+
+void
+np_regex_free (np_regex *re)
+{
+	regfree(&re->re);
+	free(re->literal);
+	re->literal = NULL;
+}
+
+int
+np_regex_set_add (np_regex_set *set, const char *pattern, int cflags)
+{
+	int err;
+
+	if (set->count == set->size) {
+		set->size = set->size ? set->size * 2 : 4;
+		if ((set->patterns = realloc(set->patterns, set->size * sizeof(np_regex))) == NULL)
+			die(STATE_UNKNOWN, "%s\n", _("Could not allocate memory"));
+	}
+	if ((err = np_regex_compile(&set->patterns[set->count], pattern, cflags)) == 0)
+		set->count++;
+	return err;
+}
+
+int
+np_regex_set_match (const np_regex_set *set, const char *string)
+{
+	size_t i;
+
+	for (i = 0; i < set->count; i++)
+		if (np_regex_match(&set->patterns[i], string))
+			return (int) i;
+	return -1;
+}
+
+void
+np_regex_set_free (np_regex_set *set)
+{
+	size_t i;
+
+	for (i = 0; i < set->count; i++)
+		np_regex_free(&set->patterns[i]);
+	free(set->patterns);
+	set->patterns = NULL;
+	set->count = set->size = 0;
+}
@@ -0,0 +1,43 @@
+#ifndef NAGIOS_UTILS_REGEX_H_INCLUDED
+#define NAGIOS_UTILS_REGEX_H_INCLUDED
+/* Header file for the compile-once regular expression matcher */
+
+#include "regex.h"
+
+/*
+ * An np_regex is compiled once with REG_NOSUB and remembers the longest
+ * literal string every match has to contain. np_regex_match looks for
+ * that literal with strstr before running regexec, which rules out most
+ * non-matching subjects without touching the regex engine.
+ */
+typedef struct np_regex {
+	regex_t	re;
+	char	*literal;	/* NULL if no literal is required */
+} np_regex;
+
+/* A set of patterns matched against the same subject */
+typedef struct np_regex_set {
+	np_regex *patterns;
+	size_t	count;
+	size_t	size;
+} np_regex_set;
+
+#define NP_REGEX_SET_INIT { NULL, 0, 0 }
+
+/* Returns 0 or a regcomp error code, see np_regex_error. The np_regex
+ * may be NULL there, e.g. after np_regex_set_add failed */
+int np_regex_compile (np_regex *, const char *, int);
+int np_regex_match (const np_regex *, const char *);
+size_t np_regex_error (int, const np_regex *, char *, size_t);
+void np_regex_free (np_regex *);
+
+int np_regex_set_add (np_regex_set *, const char *, int);
+/* Index of the first pattern that matches, -1 if none does */
+int np_regex_set_match (const np_regex_set *, const char *);
+void np_regex_set_free (np_regex_set *);
+
+/* The literal np_regex_compile would extract, for testing. Returns a
+ * new string or NULL */
+char *np_regex_literal (const char *, int);
+
+#endif /* NAGIOS_UTILS_REGEX_H_INCLUDED */
@@ -0,0 +1,221 @@
+/*****************************************************************************
+* 
+* Library of string building functions for plugin output
+* 
+* License: GPL
+* Copyright (c) 2014 Nagios Plugins Development Team
+* 
+* Description:
+* 
+* This file contains a growable string buffer, used to collect plugin
+* output and perfdata. These are tested by libtap
+* 
+* 
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+* 
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+* 
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+* 
+* 
+*****************************************************************************/
+
+#include "common.h"
+#include "utils_base.h"
+#include "utils_str.h"
+
+#include <stdarg.h>
+
+#define NP_STR_MIN_SIZE 64
+
+void
+np_str_init (np_str *s)
+{
+	s->data = NULL;
+	s->len = 0;
+	s->size = 0;
+}
+
+void
+np_str_reserve (np_str *s, size_t extra)
+{
+	size_t size;
+
+	if (s->len + extra < s->size)
+		return;
+	for (size = s->size ? s->size : NP_STR_MIN_SIZE; size <= s->len + extra; size *= 2)
+		;
+	if ((s->data = realloc (s->data, size)) == NULL)
+		die (STATE_UNKNOWN, _("Could not allocate memory\n"));
+	s->size = size;
+}
+
+void
+np_str_addn (np_str *s, const char *text, size_t len)
+{
+	np_str_reserve (s, len);
+	memcpy (s->data + s->len, text, len);
+	s->len += len;
+	s->data[s->len] = '\0';
+}
+
+void
+np_str_add (np_str *s, const char *text)
+{
+	np_str_addn (s, text, strlen (text));
+}
+
+void
+np_str_addf (np_str *s, const char *fmt, ...)
+{
+	va_list ap;
+	int n;
+
+	/* format straight into the free space, retry once if it was too small */
+	np_str_reserve (s, 0);
+	va_start (ap, fmt);
+	n = vsnprintf (s->data + s->len, s->size - s->len, fmt, ap);
+	va_end (ap);
+	if (n < 0)
+		die (STATE_UNKNOWN, _("Could not format output\n"));
+
+	if ((size_t) n >= s->size - s->len) {
+		np_str_reserve (s, n);
+		va_start (ap, fmt);
+		vsnprintf (s->data + s->len, s->size - s->len, fmt, ap);
+		va_end (ap);
+	}
+	s->len += n;
+}
+
+/* perfdata labels with spaces, quotes or '=' need to be quoted */
+void
+np_str_add_label (np_str *s, const char *label)
+{
+	if (strpbrk (label, "'= "))
+		np_str_addf (s, "'%s'=", label);
+	else
+		np_str_addf (s, "%s=", label);
+}
+
+const char *
+np_str_get (np_str *s)
+{
+	return s->data ? s->data : "";
+}
+
+/* hand the buffer over to the caller, the builder is empty afterwards */
+char *
+np_str_release (np_str *s)
+{
+	char *data = s->data ? s->data : strdup ("");
+
+	np_str_init (s);
+	return data;
+}
+
+void
+np_str_free (np_str *s)
+{
+	free (s->data);
+	np_str_init (s);
+}
+
+void
+np_str_perfdata (np_str *s, const char *label, long int val, const char *uom,
+                 int warnp, long int warn, int critp, long int crit,
+                 int minp, long int minv, int maxp, long int maxv)
+{
+	np_str_add_label (s, label);
+	np_str_addf (s, "%ld%s;", val, uom);
+
+	if (warnp)
+		np_str_addf (s, "%ld", warn);
+	np_str_add (s, ";");
+
+	if (critp)
+		np_str_addf (s, "%ld", crit);
+	np_str_add (s, ";");
+
+	if (minp)
+		np_str_addf (s, "%ld", minv);
+
+	if (maxp)
+		np_str_addf (s, ";%ld", maxv);
+}
+
+void
+np_str_fperfdata (np_str *s, const char *label, double val, const char *uom,
+                  int warnp, double warn, int critp, double crit,
+                  int minp, double minv, int maxp, double maxv)
+{
+	np_str_add_label (s, label);
+	np_str_addf (s, "%f%s;", val, uom);
+
+	if (warnp)
+		np_str_addf (s, "%f", warn);
+	np_str_add (s, ";");
+
+	if (critp)
+		np_str_addf (s, "%f", crit);
+	np_str_add (s, ";");
+
+	if (minp)
+		np_str_addf (s, "%f", minv);
+
+	if (maxp)
+		np_str_addf (s, ";%f", maxv);
+}
+
+void
+np_str_sperfdata (np_str *s, const char *label, double val, const char *uom,
+                  const char *warn, const char *crit,
+                  int minp, double minv, int maxp, double maxv)
+{
+	np_str_add_label (s, label);
+	np_str_addf (s, "%f%s;", val, uom);
+
+	if (warn != NULL)
+		np_str_add (s, warn);
+	np_str_add (s, ";");
+
+	if (crit != NULL)
+		np_str_add (s, crit);
+	np_str_add (s, ";");
+
+	if (minp)
+		np_str_addf (s, "%f", minv);
+
+	if (maxp)
+		np_str_addf (s, ";%f", maxv);
+}
+
+void
+np_str_sperfdata_int (np_str *s, const char *label, int val, const char *uom,
+                      const char *warn, const char *crit,
+                      int minp, int minv, int maxp, int maxv)
+{
+	np_str_add_label (s, label);
+	np_str_addf (s, "%d%s;", val, uom);
+
+	if (warn != NULL)
+		np_str_add (s, warn);
+	np_str_add (s, ";");
+
+	if (crit != NULL)
+		np_str_add (s, crit);
+	np_str_add (s, ";");
+
+	if (minp)
+		np_str_addf (s, "%d", minv);
+
+	if (maxp)
+		np_str_addf (s, ";%d", maxv);
+}
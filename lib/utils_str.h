@@ -0,0 +1,46 @@
+#ifndef NAGIOS_UTILS_STR_H_INCLUDED
+#define NAGIOS_UTILS_STR_H_INCLUDED
+/* Header file for the string builder used for plugin output and perfdata */
+
+/*
+ * An np_str grows its buffer geometrically, so appending n pieces costs
+ * O(total length) instead of the O(n^2) of xasprintf(&s, "%s...", s).
+ * A zeroed np_str (or NP_STR_INIT) is an empty string; np_str_get never
+ * returns NULL.
+ */
+typedef struct np_str {
+	char *data;
+	size_t len;
+	size_t size;
+} np_str;
+
+#define NP_STR_INIT { NULL, 0, 0 }
+
+void np_str_init (np_str *s);
+void np_str_reserve (np_str *s, size_t extra);
+void np_str_add (np_str *s, const char *text);
+void np_str_addn (np_str *s, const char *text, size_t len);
+void np_str_addf (np_str *s, const char *fmt, ...)
+	__attribute__((format(printf, 2, 3)));
+void np_str_add_label (np_str *s, const char *label);
+const char *np_str_get (np_str *s);
+char *np_str_release (np_str *s);
+void np_str_free (np_str *s);
+
+/* Append one perfdata item, formatted like perfdata(), fperfdata(),
+ * sperfdata() and sperfdata_int() in plugins/utils.c. Nothing is added
+ * in front of it, so separate items with np_str_add (s, " ") */
+void np_str_perfdata (np_str *s, const char *label, long int val, const char *uom,
+                      int warnp, long int warn, int critp, long int crit,
+                      int minp, long int minv, int maxp, long int maxv);
+void np_str_fperfdata (np_str *s, const char *label, double val, const char *uom,
+                       int warnp, double warn, int critp, double crit,
+                       int minp, double minv, int maxp, double maxv);
+void np_str_sperfdata (np_str *s, const char *label, double val, const char *uom,
+                       const char *warn, const char *crit,
+                       int minp, double minv, int maxp, double maxv);
+void np_str_sperfdata_int (np_str *s, const char *label, int val, const char *uom,
+                           const char *warn, const char *crit,
+                           int minp, int minv, int maxp, int maxv);
+
+#endif /* NAGIOS_UTILS_STR_H_INCLUDED */
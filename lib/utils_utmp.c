@@ -0,0 +1,103 @@
+/*****************************************************************************
+*
+* Library of readers for utmpx and wtmpx files
+*
+* License: GPL
+* Copyright (c) 2014 Nagios Plugins Development Team
+*
+* Description:
+*
+* This file maps utmpx(5) style files read only, so plugins can walk the
+* session records without getutxent() copying each one, and read only the
+* part of wtmp written since their last run. These are tested by libtap
+*
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*
+*****************************************************************************/
+
+#include "common.h"
+#include "utils_base.h"
+#include "utils_utmp.h"
+
+#ifdef HAVE_UTMPX_H
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#ifdef HAVE_SYS_STAT_H
+# include <sys/stat.h>
+#endif
+
+int
+np_utmp_open (np_utmp *u, const char *path, ino_t inode, off_t offset)
+{
+	struct stat st;
+	off_t start, pagesize = sysconf (_SC_PAGESIZE);
+	int fd;
+
+	memset (u, 0, sizeof (np_utmp));
+	if ((fd = open (path, O_RDONLY)) < 0)
+		return ERROR;
+	if (fstat (fd, &st) != 0) {
+		close (fd);
+		return ERROR;
+	}
+
+	/* a rotated or truncated file is read again from the start */
+	offset -= offset % (off_t) sizeof (struct utmpx);
+	if (offset < 0 || (inode != 0 && st.st_ino != inode) || offset > st.st_size) {
+		u->restarted = TRUE;
+		offset = 0;
+	}
+	u->inode = st.st_ino;
+	u->count = (st.st_size - offset) / sizeof (struct utmpx);
+	u->end = offset + u->count * sizeof (struct utmpx);
+
+	if (u->count > 0) {
+		/* mmap wants a page aligned offset */
+		if (pagesize <= 0)
+			pagesize = 4096;
+		start = offset - offset % pagesize;
+		u->maplen = u->end - start;
+		u->map = mmap (NULL, u->maplen, PROT_READ, MAP_SHARED, fd, start);
+		if (u->map == MAP_FAILED) {
+			u->map = NULL;
+			close (fd);
+			return ERROR;
+		}
+		u->records = (const struct utmpx *) ((char *) u->map + (offset - start));
+	}
+	close (fd);
+	return OK;
+}
+
+void
+np_utmp_close (np_utmp *u)
+{
+	if (u->map)
+		munmap (u->map, u->maplen);
+	memset (u, 0, sizeof (np_utmp));
+}
+
+int
+np_utmp_session_type (const struct utmpx *ut)
+{
+	/* X displays record ":0" or ":0.0" as their host */
+	if (ut->ut_host[0] == '\0' || ut->ut_host[0] == ':')
+		return NP_UTMP_CONSOLE;
+	return NP_UTMP_SSH;
+}
+
+#endif /* HAVE_UTMPX_H */
@@ -0,0 +1,54 @@
+#ifndef NAGIOS_UTILS_UTMP_H_INCLUDED
+#define NAGIOS_UTILS_UTMP_H_INCLUDED
+/* Header file for the mmap reader of utmpx(5) and wtmpx files */
+
+#ifdef HAVE_UTMPX_H
+#include <utmpx.h>
+
+#ifndef UTMPX_FILE
+# ifdef _PATH_UTMPX
+#  define UTMPX_FILE _PATH_UTMPX
+# else
+#  define UTMPX_FILE "/var/run/utmp"
+# endif
+#endif
+#ifndef WTMPX_FILE
+# ifdef _PATH_WTMPX
+#  define WTMPX_FILE _PATH_WTMPX
+# else
+#  define WTMPX_FILE "/var/log/wtmp"
+# endif
+#endif
+
+/* The whole records of a file mapped read only, from a given offset on */
+typedef struct np_utmp {
+	void	*map;
+	size_t	maplen;
+	const struct utmpx *records;
+	size_t	count;
+	off_t	end;	/* offset after the last whole record */
+	ino_t	inode;
+	int	restarted;	/* the file was replaced or truncated since the offset */
+} np_utmp;
+
+#define NP_UTMP_SSH	0
+#define NP_UTMP_CONSOLE	1
+
+/* Maps path from offset on, or from the start if the file no longer has the
+ * given inode or is shorter than offset. Pass 0 for both to map it all.
+ * Returns OK or ERROR */
+int np_utmp_open (np_utmp *, const char *, ino_t, off_t);
+void np_utmp_close (np_utmp *);
+
+/* NP_UTMP_SSH for sessions from a remote host, NP_UTMP_CONSOLE for local
+ * terminals and X displays */
+int np_utmp_session_type (const struct utmpx *);
+
+/* The user, line and host fields are not always NUL terminated. These copy
+ * one into a buffer of at least sizeof (field) + 1 */
+#define np_utmp_field(buf, field) \
+	(memcpy ((buf), (field), sizeof (field)), (buf)[sizeof (field)] = '\0', (buf))
+
+#endif /* HAVE_UTMPX_H */
+
+#endif /* NAGIOS_UTILS_UTMP_H_INCLUDED */
@@ -149,6 +149,7 @@ typedef struct dhcp_packet_struct {
 } dhcp_packet;
 
 typedef struct dhcp_offer_struct {
+  int interface;      /* index of the interface the offer arrived on */
   struct in_addr
       server_address; /* address of DHCP server that sent this offer */
   struct in_addr offered_address; /* the IP address that was offered to us */
@@ -164,6 +165,21 @@ typedef struct requested_server_struct {
   struct requested_server_struct *next;
 } requested_server;
 
+/* each interface we probe gets its own socket and transaction id, so
+ * offers can be matched to the interface they answer */
+typedef struct dhcp_interface_struct {
+  char name[IFNAMSIZ];
+  int sock;
+  u_int32_t xid;
+  unsigned char hardware_address[MAX_DHCP_CHADDR_LENGTH];
+  struct in_addr ip; /* our address on this interface (unicast mode) */
+  int valid_responses;
+  int requested_responses;
+  int received_requested_address;
+  u_int32_t max_lease_time;
+  char *responses_none;
+} dhcp_interface;
+
 #define BOOTREQUEST 1
 #define BOOTREPLY 2
 
@@ -204,7 +220,8 @@ unsigned char *user_specified_mac = NULL;
 
 char network_interface_name[IFNAMSIZ] = "eth0";
 
-u_int32_t packet_xid = 0;
+dhcp_interface *interfaces = NULL;
+int num_interfaces = 0;
 
 u_int32_t dhcp_lease_time = 0;
 u_int32_t dhcp_renewal_time = 0;
@@ -215,13 +232,9 @@ int dhcpoffer_timeout = 2;
 dhcp_offer *dhcp_offer_list = NULL;
 requested_server *requested_server_list = NULL;
 
-int valid_responses = 0; /* number of valid DHCPOFFERs we received */
 int requested_servers = 0;
-int requested_responses = 0;
-char *responses_none;
 
 int request_specific_address = FALSE;
-int received_requested_address = FALSE;
 int verbose = 0;
 struct in_addr requested_address;
 
@@ -236,22 +249,27 @@ void print_hardware_address(const unsigned char *);
 int get_hardware_address(int, char *);
 int get_ip_address(int, char *);
 
-int send_dhcp_discover(int);
-int get_dhcp_offer(int);
+int add_interface(const char *);
+int send_dhcp_discover(dhcp_interface *);
+int get_dhcp_offer(void);
+int all_requested_servers_answered(void);
 
 int get_results(void);
+int get_interface_results(int);
+void print_interface_results(int);
 
-int add_dhcp_offer(struct in_addr, dhcp_packet *);
+int add_dhcp_offer(int, struct in_addr, dhcp_packet *);
 int free_dhcp_offer_list(void);
 int free_requested_server_list(void);
 
-int create_dhcp_socket(void);
+int create_dhcp_socket(const char *);
 int close_dhcp_socket(int);
 int send_dhcp_packet(void *, int, int, struct sockaddr_in *);
 int receive_dhcp_packet(void *, int, int, int, struct sockaddr_in *);
 
 int main(int argc, char **argv) {
-  int dhcp_socket;
+  int i;
+  dhcp_interface *iface;
   int result = STATE_UNKNOWN;
 
   setlocale(LC_ALL, "");
@@ -272,28 +290,42 @@ int main(int argc, char **argv) {
   /* this plugin almost certainly needs root permissions. */
   np_warn_if_not_root();
 
-  /* create socket for DHCP communications */
-  dhcp_socket = create_dhcp_socket();
-
-  /* get hardware address of client machine */
-  if (user_specified_mac != NULL) {
-    memcpy(client_hardware_address, user_specified_mac, 6);
-  } else {
-    get_hardware_address(dhcp_socket, network_interface_name);
+  /* default to a single interface if -i was not given */
+  if (num_interfaces == 0) {
+    add_interface(network_interface_name);
   }
 
-  if (unicast) { /* get IP address of client machine */
-    get_ip_address(dhcp_socket, network_interface_name);
-  }
+  for (i = 0; i < num_interfaces; i++) {
+    iface = &interfaces[i];
+
+    /* create socket for DHCP communications */
+    iface->sock = create_dhcp_socket(iface->name);
+
+    /* get hardware address of client machine */
+    if (user_specified_mac != NULL) {
+      memcpy(client_hardware_address, user_specified_mac, 6);
+    } else {
+      get_hardware_address(iface->sock, iface->name);
+    }
+    memcpy(iface->hardware_address, client_hardware_address,
+           sizeof(iface->hardware_address));
 
-  /* send DHCPDISCOVER packet */
-  send_dhcp_discover(dhcp_socket);
+    if (unicast) { /* get IP address of client machine */
+      get_ip_address(iface->sock, iface->name);
+      iface->ip = my_ip;
+    }
 
-  /* wait for a DHCPOFFER packet */
-  get_dhcp_offer(dhcp_socket);
+    /* send DHCPDISCOVER packet */
+    send_dhcp_discover(iface);
+  }
 
-  /* close socket we created */
-  close_dhcp_socket(dhcp_socket);
+  /* wait for DHCPOFFER packets on all interfaces at once */
+  get_dhcp_offer();
+
+  /* close sockets we created */
+  for (i = 0; i < num_interfaces; i++) {
+    close_dhcp_socket(interfaces[i].sock);
+  }
 
   /* determine state/plugin output to return */
   result = get_results();
@@ -301,10 +333,28 @@ int main(int argc, char **argv) {
   /* free allocated memory */
   free_dhcp_offer_list();
   free_requested_server_list();
+  free(interfaces);
 
   return result;
 }
 
+/* adds an interface to probe */
+int add_interface(const char *name) {
+  dhcp_interface *iface;
+
+  interfaces = realloc(interfaces, (num_interfaces + 1) * sizeof(*interfaces));
+  if (interfaces == NULL) {
+    die(STATE_UNKNOWN, _("Could not allocate memory for interfaces\n"));
+  }
+
+  iface = &interfaces[num_interfaces++];
+  bzero(iface, sizeof(*iface));
+  strncpy(iface->name, name, sizeof(iface->name) - 1);
+  iface->sock = -1;
+
+  return OK;
+}
+
 /* determines hardware address on client machine */
 int get_hardware_address(int sock, char *interface_name) {
 
@@ -455,7 +505,7 @@ int get_ip_address(int sock, char *interface_name) {
 }
 
 /* sends a DHCPDISCOVER broadcast message in an attempt to find DHCP servers */
-int send_dhcp_discover(int sock) {
+int send_dhcp_discover(dhcp_interface *iface) {
   dhcp_packet discover_packet;
   struct sockaddr_in sockaddr_broadcast;
   unsigned short opts;
@@ -478,17 +528,17 @@ int send_dhcp_discover(int sock) {
    * to srand & random if not.
    */
   int randfd = open("/dev/urandom", O_RDONLY);
-  if (randfd > 2 && read(randfd, (char *)&packet_xid, sizeof(uint32_t)) >= 0) {
-    /* no-op as we have successfully filled packet_xid */
+  if (randfd > 2 && read(randfd, (char *)&iface->xid, sizeof(uint32_t)) >= 0) {
+    /* no-op as we have successfully filled the xid */
   } else {
     /* fallback bad rand */
-    srand(time(NULL));
-    packet_xid = random();
+    srand(time(NULL) + (iface - interfaces));
+    iface->xid = random();
   }
   if (randfd > 2) {
     close(randfd);
   }
-  discover_packet.xid = htonl(packet_xid);
+  discover_packet.xid = htonl(iface->xid);
 
   /* WHAT THE HECK IS UP WITH THIS?!?  IF I DON'T MAKE THIS CALL, ONLY ONE
    * SERVER RESPONSE IS PROCESSED!!!! */
@@ -505,7 +555,7 @@ int send_dhcp_discover(int sock) {
   discover_packet.flags = unicast ? 0 : htons(DHCP_BROADCAST_FLAG);
 
   /* our hardware address */
-  memcpy(discover_packet.chaddr, client_hardware_address,
+  memcpy(discover_packet.chaddr, iface->hardware_address,
          ETHERNET_HARDWARE_ADDRESS_LENGTH);
 
   /* first four bytes of options field is magic cookie (as per RFC 2132) */
@@ -534,7 +584,7 @@ int send_dhcp_discover(int sock) {
 
   /* unicast fields */
   if (unicast) {
-    discover_packet.giaddr.s_addr = my_ip.s_addr;
+    discover_packet.giaddr.s_addr = iface->ip.s_addr;
   }
 
   /* see RFC 1542, 4.1.1 */
@@ -548,9 +598,9 @@ int send_dhcp_discover(int sock) {
   bzero(&sockaddr_broadcast.sin_zero, sizeof(sockaddr_broadcast.sin_zero));
 
   if (verbose) {
-    printf(_("DHCPDISCOVER to %s port %d\n"),
+    printf(_("DHCPDISCOVER to %s port %d on %s\n"),
            inet_ntoa(sockaddr_broadcast.sin_addr),
-           ntohs(sockaddr_broadcast.sin_port));
+           ntohs(sockaddr_broadcast.sin_port), iface->name);
     printf("DHCPDISCOVER XID: %u (0x%X)\n", ntohl(discover_packet.xid),
            ntohl(discover_packet.xid));
     printf("DHCDISCOVER ciaddr:  %s\n", inet_ntoa(discover_packet.ciaddr));
@@ -560,7 +610,7 @@ int send_dhcp_discover(int sock) {
   }
 
   /* send the DHCPDISCOVER packet out */
-  send_dhcp_packet(&discover_packet, sizeof(discover_packet), sock,
+  send_dhcp_packet(&discover_packet, sizeof(discover_packet), iface->sock,
                    &sockaddr_broadcast);
 
   if (verbose) {
@@ -570,111 +620,165 @@ int send_dhcp_discover(int sock) {
   return OK;
 }
 
-/* waits for a DHCPOFFER message from one or more DHCP servers */
-int get_dhcp_offer(int sock) {
+/* waits for DHCPOFFER messages from one or more DHCP servers on all
+ * interfaces, returning early once every requested server has answered
+ * on every interface */
+int get_dhcp_offer(void) {
   dhcp_packet offer_packet;
   struct sockaddr_in source;
   struct sockaddr_in via;
+  struct pollfd *pfds;
+  dhcp_interface *iface;
   int result = OK;
   int responses = 0;
-  int x;
-  time_t start_time;
-  time_t current_time;
+  int valid_responses = 0;
+  int i, x, nfound;
+  struct timeval start_time;
+  long remaining;
 
-  time(&start_time);
+  pfds = malloc(num_interfaces * sizeof(struct pollfd));
+  if (pfds == NULL) {
+    die(STATE_UNKNOWN, _("Could not allocate memory for poll\n"));
+  }
+  for (i = 0; i < num_interfaces; i++) {
+    pfds[i].fd = interfaces[i].sock;
+    pfds[i].events = POLLIN;
+  }
+
+  gettimeofday(&start_time, NULL);
 
   /* receive as many responses as we can */
-  for (responses = 0, valid_responses = 0;;) {
-    time(&current_time);
-    if ((current_time - start_time) >= dhcpoffer_timeout) {
+  for (;;) {
+    remaining = dhcpoffer_timeout * 1000L - deltime(start_time) / 1000;
+    if (remaining <= 0) {
       break;
     }
 
-    if (verbose) {
-      printf("\n\n");
+    if (requested_servers > 0 && all_requested_servers_answered()) {
+      if (verbose) {
+        printf(_("All requested servers answered, not waiting any longer\n"));
+      }
+      break;
     }
 
-    bzero(&source, sizeof(source));
-    bzero(&via, sizeof(via));
-    bzero(&offer_packet, sizeof(offer_packet));
-
-    result = receive_dhcp_packet(&offer_packet, sizeof(offer_packet), sock,
-                                 dhcpoffer_timeout, &source);
-
-    if (result != OK) {
+    for (i = 0; i < num_interfaces; i++) {
+      pfds[i].revents = 0;
+    }
+    nfound = poll(pfds, num_interfaces, remaining);
+    if (nfound < 0 && errno != EINTR) {
       if (verbose) {
-        printf(_("Result=ERROR\n"));
+        printf("poll() failed, errno: (%d) -> %s\n", errno, strerror(errno));
       }
-      continue;
-    } else {
+      break;
+    }
+    if (nfound <= 0) {
       if (verbose) {
-        printf(_("Result=OK\n"));
+        printf(_("No (more) data received (nfound: %d)\n"), nfound);
       }
-      responses++;
+      continue;
     }
 
-    /* The "source" is either a server or a relay. */
-    /* Save a copy of "source" into "via" even if it's via itself */
-    memcpy(&via, &source, sizeof(source));
-
-    if (verbose) {
-      printf(_("DHCPOFFER from IP address %s"), inet_ntoa(source.sin_addr));
-      printf(_(" via %s\n"), inet_ntoa(via.sin_addr));
-      printf("DHCPOFFER XID: %u (0x%X)\n", ntohl(offer_packet.xid),
-             ntohl(offer_packet.xid));
-    }
+    for (i = 0; i < num_interfaces; i++) {
+      if (!(pfds[i].revents & POLLIN)) {
+        continue;
+      }
 
-    /* check packet xid to see if its the same as the one we used in the
-     * discover packet */
-    if (ntohl(offer_packet.xid) != packet_xid) {
       if (verbose) {
-        printf(_("DHCPOFFER XID (%u) did not match DHCPDISCOVER XID (%u) - "
-                 "ignoring packet\n"),
-               ntohl(offer_packet.xid), packet_xid);
+        printf("\n\n");
       }
-      continue;
-    }
 
-    /* check hardware address */
-    result = OK;
-    if (verbose) {
-      printf("DHCPOFFER chaddr: ");
-    }
+      bzero(&source, sizeof(source));
+      bzero(&via, sizeof(via));
+      bzero(&offer_packet, sizeof(offer_packet));
+
+      result = receive_dhcp_packet(&offer_packet, sizeof(offer_packet),
+                                   pfds[i].fd, 0, &source);
+
+      if (result != OK) {
+        if (verbose) {
+          printf(_("Result=ERROR\n"));
+        }
+        continue;
+      } else {
+        if (verbose) {
+          printf(_("Result=OK\n"));
+        }
+        responses++;
+      }
+
+      /* The "source" is either a server or a relay. */
+      /* Save a copy of "source" into "via" even if it's via itself */
+      memcpy(&via, &source, sizeof(source));
 
-    for (x = 0; x < ETHERNET_HARDWARE_ADDRESS_LENGTH; x++) {
       if (verbose) {
-        printf("%02X", (unsigned char)offer_packet.chaddr[x]);
+        printf(_("DHCPOFFER from IP address %s"), inet_ntoa(source.sin_addr));
+        printf(_(" via %s\n"), inet_ntoa(via.sin_addr));
+        printf("DHCPOFFER XID: %u (0x%X)\n", ntohl(offer_packet.xid),
+               ntohl(offer_packet.xid));
+      }
+
+      /* find the interface whose discover packet this answers */
+      iface = NULL;
+      for (x = 0; x < num_interfaces; x++) {
+        if (ntohl(offer_packet.xid) == interfaces[x].xid) {
+          iface = &interfaces[x];
+          break;
+        }
+      }
+      if (iface == NULL) {
+        if (verbose) {
+          printf(_("DHCPOFFER XID (%u) did not match any DHCPDISCOVER XID - "
+                   "ignoring packet\n"),
+                 ntohl(offer_packet.xid));
+        }
+        continue;
       }
 
-      if (offer_packet.chaddr[x] != client_hardware_address[x]) {
-        result = ERROR;
+      /* check hardware address */
+      result = OK;
+      if (verbose) {
+        printf("DHCPOFFER chaddr: ");
       }
-    }
 
-    if (verbose) {
-      printf("\n");
-    }
+      for (x = 0; x < ETHERNET_HARDWARE_ADDRESS_LENGTH; x++) {
+        if (verbose) {
+          printf("%02X", (unsigned char)offer_packet.chaddr[x]);
+        }
+
+        if (offer_packet.chaddr[x] != iface->hardware_address[x]) {
+          result = ERROR;
+        }
+      }
 
-    if (result == ERROR) {
       if (verbose) {
-        printf(_("DHCPOFFER hardware address did not match our own - ignoring "
-                 "packet\n"));
+        printf("\n");
       }
-      continue;
-    }
 
-    if (verbose) {
-      printf("DHCPOFFER ciaddr: %s\n", inet_ntoa(offer_packet.ciaddr));
-      printf("DHCPOFFER yiaddr: %s\n", inet_ntoa(offer_packet.yiaddr));
-      printf("DHCPOFFER siaddr: %s\n", inet_ntoa(offer_packet.siaddr));
-      printf("DHCPOFFER giaddr: %s\n", inet_ntoa(offer_packet.giaddr));
-    }
+      if (result == ERROR) {
+        if (verbose) {
+          printf(_("DHCPOFFER hardware address did not match our own - "
+                   "ignoring packet\n"));
+        }
+        continue;
+      }
 
-    add_dhcp_offer(source.sin_addr, &offer_packet);
+      if (verbose) {
+        printf("DHCPOFFER interface: %s\n", iface->name);
+        printf("DHCPOFFER ciaddr: %s\n", inet_ntoa(offer_packet.ciaddr));
+        printf("DHCPOFFER yiaddr: %s\n", inet_ntoa(offer_packet.yiaddr));
+        printf("DHCPOFFER siaddr: %s\n", inet_ntoa(offer_packet.siaddr));
+        printf("DHCPOFFER giaddr: %s\n", inet_ntoa(offer_packet.giaddr));
+      }
 
-    valid_responses++;
+      add_dhcp_offer(iface - interfaces, source.sin_addr, &offer_packet);
+
+      iface->valid_responses++;
+      valid_responses++;
+    }
   }
 
+  free(pfds);
+
   if (verbose) {
     printf(_("Total responses seen on the wire: %d\n"), responses);
     printf(_("Valid responses for this machine: %d\n"), valid_responses);
@@ -683,6 +787,35 @@ int get_dhcp_offer(int sock) {
   return OK;
 }
 
+/* checks whether every requested server has sent an offer on every
+ * interface, so we can stop waiting */
+int all_requested_servers_answered(void) {
+  requested_server *temp_server;
+  dhcp_offer *temp_offer;
+  int i, found;
+
+  for (i = 0; i < num_interfaces; i++) {
+    for (temp_server = requested_server_list; temp_server != NULL;
+         temp_server = temp_server->next) {
+      found = FALSE;
+      for (temp_offer = dhcp_offer_list; temp_offer != NULL;
+           temp_offer = temp_offer->next) {
+        if (temp_offer->interface == i &&
+            temp_offer->server_address.s_addr ==
+                temp_server->server_address.s_addr) {
+          found = TRUE;
+          break;
+        }
+      }
+      if (!found) {
+        return FALSE;
+      }
+    }
+  }
+
+  return TRUE;
+}
+
 /* sends a DHCP packet */
 int send_dhcp_packet(void *buffer, int buffer_size, int sock,
                      struct sockaddr_in *dest) {
@@ -763,7 +896,7 @@ int receive_dhcp_packet(void *buffer, int buffer_size, int sock, int timeout,
 }
 
 /* creates a socket for DHCP communication */
-int create_dhcp_socket(void) {
+int create_dhcp_socket(const char *interface_name) {
   struct sockaddr_in myname;
   struct ifreq interface;
   int sock;
@@ -805,18 +938,18 @@ int create_dhcp_socket(void) {
 
     /* bind socket to interface */
 #if defined(__linux__)
-  strncpy(interface.ifr_ifrn.ifrn_name, network_interface_name, IFNAMSIZ - 1);
+  strncpy(interface.ifr_ifrn.ifrn_name, interface_name, IFNAMSIZ - 1);
   interface.ifr_ifrn.ifrn_name[IFNAMSIZ - 1] = '\0';
   if (setsockopt(sock, SOL_SOCKET, SO_BINDTODEVICE, (char *)&interface,
                  sizeof(interface)) < 0) {
     printf(_("Error: Could not bind socket to interface %s.  Check your "
              "privileges...\n"),
-           network_interface_name);
+           interface_name);
     exit(STATE_UNKNOWN);
   }
 
 #else
-  strncpy(interface.ifr_name, network_interface_name, IFNAMSIZ - 1);
+  strncpy(interface.ifr_name, interface_name, IFNAMSIZ - 1);
   interface.ifr_name[IFNAMSIZ - 1] = '\0';
 #endif
 
@@ -863,7 +996,8 @@ int add_requested_server(struct in_addr server_address) {
 }
 
 /* adds a DHCP OFFER to list in memory */
-int add_dhcp_offer(struct in_addr source, dhcp_packet *offer_packet) {
+int add_dhcp_offer(int interface, struct in_addr source,
+                   dhcp_packet *offer_packet) {
   dhcp_offer *new_offer;
   int x;
   unsigned option_type;
@@ -965,6 +1099,7 @@ int add_dhcp_offer(struct in_addr source, dhcp_packet *offer_packet) {
    * DHCPOFFER from.  If 'serv_ident' isn't available for some reason, we
    * use 'source'.
    */
+  new_offer->interface = interface;
   new_offer->server_address = serv_ident.s_addr ? serv_ident : source;
   new_offer->offered_address = offer_packet->yiaddr;
   new_offer->lease_time = dhcp_lease_time;
@@ -1014,31 +1149,83 @@ int free_requested_server_list(void) {
 
 /* gets state and plugin output to return */
 int get_results(void) {
+  int i;
+  int result = STATE_OK;
+
+  for (i = 0; i < num_interfaces; i++) {
+    result = max_state(result, get_interface_results(i));
+  }
+
+  if (result == 0) {
+    printf("OK: ");
+  } else if (result == 1) {
+    printf("WARNING: ");
+  } else if (result == 2) {
+    printf("CRITICAL: ");
+  } else if (result == 3) {
+    printf("UNKNOWN: ");
+  }
+
+  if (num_interfaces == 1) {
+    print_interface_results(0);
+    printf("\n");
+    if (requested_servers > 0 && interfaces[0].valid_responses > 0 &&
+        requested_servers != interfaces[0].requested_responses) {
+      printf("No response from:%s\n", interfaces[0].responses_none);
+    }
+    return result;
+  }
+
+  /* one summary per interface, then the missing servers per interface */
+  for (i = 0; i < num_interfaces; i++) {
+    printf("%s%s: ", i ? "; " : "", interfaces[i].name);
+    print_interface_results(i);
+  }
+  printf("\n");
+  for (i = 0; i < num_interfaces; i++) {
+    if (requested_servers > 0 && interfaces[i].valid_responses > 0 &&
+        requested_servers != interfaces[i].requested_responses) {
+      printf("No response on %s from:%s\n", interfaces[i].name,
+             interfaces[i].responses_none);
+    }
+  }
+
+  return result;
+}
+
+/* checks the offers received on one interface and returns its state */
+int get_interface_results(int interface) {
+  dhcp_interface *iface = &interfaces[interface];
   dhcp_offer *temp_offer;
   requested_server *temp_server;
   int result;
-  u_int32_t max_lease_time = 0;
 
-  received_requested_address = FALSE;
-  responses_none = strdup("");
+  iface->received_requested_address = FALSE;
+  iface->responses_none = strdup("");
+  iface->max_lease_time = 0;
 
   /* checks responses from requested servers */
-  requested_responses = 0;
+  iface->requested_responses = 0;
   if (requested_servers > 0) {
     for (temp_server = requested_server_list; temp_server != NULL;
          temp_server = temp_server->next) {
+      temp_server->answered = FALSE;
       for (temp_offer = dhcp_offer_list; temp_offer != NULL;
            temp_offer = temp_offer->next) {
+        if (temp_offer->interface != interface) {
+          continue;
+        }
+
         /* get max lease time we were offered */
-        if (temp_offer->lease_time > max_lease_time ||
+        if (temp_offer->lease_time > iface->max_lease_time ||
             temp_offer->lease_time == DHCP_INFINITE_TIME) {
-          max_lease_time = temp_offer->lease_time;
+          iface->max_lease_time = temp_offer->lease_time;
         }
 
         /* see if we got the address we requested */
         if (!memcmp(&requested_address, &temp_offer->offered_address,
                     sizeof(requested_address))) {
-          received_requested_address = TRUE;
+          iface->received_requested_address = TRUE;
         }
 
         /* see if the servers we wanted a response from talked to us or not */
@@ -1054,14 +1241,14 @@ int get_results(void) {
             printf(_("\n"));
           }
           if (temp_server->answered == FALSE) {
-            requested_responses++;
+            iface->requested_responses++;
             temp_server->answered = TRUE;
           }
         }
       }
       if (temp_server->answered == FALSE) {
         /* Add the no response server to the responses_none string */
-        xasprintf(&responses_none, "%s %s", responses_none,
+        xasprintf(&iface->responses_none, "%s %s", iface->responses_none,
                   inet_ntoa(temp_server->server_address));
         if (verbose) {
           printf(_("No Response From: %s\n"),
@@ -1074,78 +1261,72 @@ int get_results(void) {
   else {
     for (temp_offer = dhcp_offer_list; temp_offer != NULL;
          temp_offer = temp_offer->next) {
+      if (temp_offer->interface != interface) {
+        continue;
+      }
       /* get max lease time we were offered */
-      if (temp_offer->lease_time > max_lease_time ||
+      if (temp_offer->lease_time > iface->max_lease_time ||
           temp_offer->lease_time == DHCP_INFINITE_TIME) {
-        max_lease_time = temp_offer->lease_time;
+        iface->max_lease_time = temp_offer->lease_time;
       }
       /* see if we got the address we requested */
       if (!memcmp(&requested_address, &temp_offer->offered_address,
                   sizeof(requested_address))) {
-        received_requested_address = TRUE;
+        iface->received_requested_address = TRUE;
       }
     }
   }
 
   result = STATE_OK;
-  if (valid_responses == 0) {
+  if (iface->valid_responses == 0) {
     result = STATE_CRITICAL;
-  } else if (requested_servers > 0 && requested_responses == 0) {
+  } else if (requested_servers > 0 && iface->requested_responses == 0) {
     result = STATE_CRITICAL;
-  } else if (requested_responses < requested_servers) {
+  } else if (iface->requested_responses < requested_servers) {
     result = STATE_WARNING;
   } else if (request_specific_address == TRUE &&
-             received_requested_address == FALSE) {
+             iface->received_requested_address == FALSE) {
     result = STATE_WARNING;
   }
 
-  if (result == 0) {
-    printf("OK: ");
-  } else if (result == 1) {
-    printf("WARNING: ");
-  } else if (result == 2) {
-    printf("CRITICAL: ");
-  } else if (result == 3) {
-    printf("UNKNOWN: ");
-  }
+  return result;
+}
+
+/* prints the summary of the offers received on one interface */
+void print_interface_results(int interface) {
+  dhcp_interface *iface = &interfaces[interface];
 
   /* we didn't receive any DHCPOFFERs */
-  if (dhcp_offer_list == NULL) {
-    printf(_("No DHCPOFFERs were received.\n"));
-    return result;
+  if (iface->valid_responses == 0) {
+    printf(_("No DHCPOFFERs were received."));
+    return;
   }
 
-  printf(_("Received %d DHCPOFFER(s)"), valid_responses);
+  printf(_("Received %d DHCPOFFER(s)"), iface->valid_responses);
 
   if (requested_servers > 0) {
-    printf(
-        _(", %s%d of %d requested servers responded"),
-        ((requested_responses < requested_servers) && requested_responses > 0)
-            ? "only "
-            : "",
-        requested_responses, requested_servers);
+    printf(_(", %s%d of %d requested servers responded"),
+           ((iface->requested_responses < requested_servers) &&
+            iface->requested_responses > 0)
+               ? "only "
+               : "",
+           iface->requested_responses, requested_servers);
   }
 
   if (request_specific_address == TRUE) {
     printf(_(", requested address (%s) was %soffered"),
            inet_ntoa(requested_address),
-           (received_requested_address == TRUE) ? "" : _("not "));
+           (iface->received_requested_address == TRUE) ? "" : _("not "));
   }
 
   printf(_(", max lease time = "));
-  if (max_lease_time == DHCP_INFINITE_TIME) {
+  if (iface->max_lease_time == DHCP_INFINITE_TIME) {
     printf(_("Infinity"));
   } else {
-    printf("%lu sec", (unsigned long)max_lease_time);
+    printf("%lu sec", (unsigned long)iface->max_lease_time);
   }
 
-  printf(".\n");
-
-  if (requested_servers > 0 && requested_servers != requested_responses) {
-    printf("No response from:%s\n", responses_none);
-  }
-
-  return result;
+  printf(".");
 }
 
 /* process command-line arguments */
@@ -1222,10 +1403,14 @@ int process_arguments(int argc, char **argv) {
       }
       break;
 
-    case 'i': /* interface name */
-      strncpy(network_interface_name, optarg,
-              sizeof(network_interface_name) - 1);
-      network_interface_name[sizeof(network_interface_name) - 1] = '\x0';
+    case 'i': /* interface name, may be repeated */
+#if !defined(__linux__)
+      if (num_interfaces > 0) {
+        usage4(_("Probing several interfaces at once is only supported on "
+                 "Linux"));
+      }
+#endif
+      add_interface(optarg);
       break;
 
     case 'u': /* unicast testing */
@@ -1461,10 +1646,17 @@ void print_help(void) {
   printf("    %s\n", _("Seconds to wait for DHCPOFFER before timeout occurs"));
   printf(" %s\n", "-i, --interface=STRING");
   printf("    %s\n", _("Interface to to use for listening (i.e. eth0)"));
+  printf("    %s\n", _("May be repeated to send DHCPDISCOVERs on several interfaces"));
+  printf("    %s\n", _("at once; each interface must then receive the offers"));
   printf(" %s\n", "-m, --mac=STRING");
   printf("    %s\n", _("MAC address to use in the DHCP request"));
   printf(" %s\n", "-u, --unicast");
   printf("    %s\n", _("Unicast testing: mimic a DHCP relay, requires -s"));
+  printf("\n");
+  printf("%s\n", _("Notes:"));
+  printf(" %s\n", _("When -s is given, the plugin stops waiting as soon as every requested"));
+  printf(" %s\n", _("server has answered on every interface instead of waiting for the"));
+  printf(" %s\n", _("whole timeout."));
   printf(UT_SUPPORT);
   return;
 }
@@ -1473,6 +1665,6 @@ void print_usage(void) {
   printf("%s\n", _("Usage:"));
   printf(" %s [-v] [-u] [-s serverip] [-r requestedip] [-t timeout]\n",
          progname);
-  printf("                  [-i interface] [-m mac]\n");
+  printf("                  [-i interface [-i interface ...]] [-m mac]\n");
   return;
 }
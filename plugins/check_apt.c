@@ -36,7 +36,7 @@ const char *email = "devel@nagios-plugins.org";
 #include "common.h"
 #include "runcmd.h"
 #include "utils.h"
-#include "regex.h"
+#include "utils_regex.h"
 
 /* some constants */
 typedef enum { UPGRADE, DIST_UPGRADE, NO_UPGRADE } upgrade_type;
@@ -68,7 +68,7 @@ int run_update(void);
 /* run an apt-get upgrade */
 int run_upgrade(int *pkgcount, int *secpkgcount);
 /* add another clause to a regexp */
-char* add_to_regexp(char *expr, const char *next);
+void add_to_regexp(np_regex_set *set, const char *next);
 
 /* configuration variables */
 static int verbose = 0;      /* -v */
@@ -77,9 +77,9 @@ static int only_critical = 0;    /* whether to warn about non-critical updates *
 static upgrade_type upgrade = UPGRADE; /* which type of upgrade to do */
 static char *upgrade_opts = NULL; /* options to override defaults for upgrade */
 static char *update_opts = NULL; /* options to override defaults for update */
-static char *do_include = NULL;  /* regexp to only include certain packages */
-static char *do_exclude = NULL;  /* regexp to only exclude certain packages */
-static char *do_critical = NULL;  /* regexp specifying critical packages */
+static np_regex_set do_include = NP_REGEX_SET_INIT;  /* regexps to only include certain packages */
+static np_regex_set do_exclude = NP_REGEX_SET_INIT;  /* regexps to only exclude certain packages */
+static np_regex_set do_critical = NP_REGEX_SET_INIT;  /* regexps specifying critical packages */
 static char *input_filename = NULL; /* input filename for testing */
 /* number of packages available for upgrade to return WARNING status */
 static int packages_warning = 1;
@@ -200,13 +200,13 @@ int process_arguments (int argc, char **argv) {
 			}
 			break;
 		case 'i':
-			do_include=add_to_regexp(do_include, optarg);
+			add_to_regexp(&do_include, optarg);
 			break;
 		case 'e':
-			do_exclude=add_to_regexp(do_exclude, optarg);
+			add_to_regexp(&do_exclude, optarg);
 			break;
 		case 'c':
-			do_critical=add_to_regexp(do_critical, optarg);
+			add_to_regexp(&do_critical, optarg);
 			break;
 		case 'o':
 			only_critical=1;
@@ -229,41 +229,14 @@ int process_arguments (int argc, char **argv) {
 
 /* run an apt-get upgrade */
 int run_upgrade(int *pkgcount, int *secpkgcount){
-	int i=0, result=STATE_UNKNOWN, regres=0, pc=0, spc=0;
+	int i=0, result=STATE_UNKNOWN, pc=0, spc=0;
 	struct output chld_out, chld_err;
-	regex_t ireg, ereg, sreg;
-	char *cmdline=NULL, rerrbuf[64];
-
-	/* initialize ereg as it is possible it is printed while uninitialized */
-	memset(&ereg, '\0', sizeof(ereg.buffer));
+	char *cmdline=NULL;
 
 	if(upgrade==NO_UPGRADE) return STATE_OK;
 
-	/* compile the regexps */
-	if (do_include != NULL) {
-		regres=regcomp(&ireg, do_include, REG_EXTENDED);
-		if (regres!=0) {
-			regerror(regres, &ireg, rerrbuf, 64);
-			die(STATE_UNKNOWN, _("%s: Error compiling regexp: %s"), progname, rerrbuf);
-		}
-	}
-   
-	if(do_exclude!=NULL){
-		regres=regcomp(&ereg, do_exclude, REG_EXTENDED);
-		if(regres!=0) {
-			regerror(regres, &ereg, rerrbuf, 64);
-			die(STATE_UNKNOWN, _("%s: Error compiling regexp: %s"),
-			    progname, rerrbuf);
-		}
-	}
-   
-	const char *crit_ptr = (do_critical != NULL) ? do_critical : SECURITY_RE;
-	regres=regcomp(&sreg, crit_ptr, REG_EXTENDED);
-	if(regres!=0) {
-		regerror(regres, &ereg, rerrbuf, 64);
-		die(STATE_UNKNOWN, _("%s: Error compiling regexp: %s"),
-		    progname, rerrbuf);
-	}
+	/* the -i/-e/-c patterns are compiled while parsing the arguments */
+	if(do_critical.count==0) add_to_regexp(&do_critical, SECURITY_RE);
 
 	cmdline=construct_cmdline(upgrade, upgrade_opts);
 	if (input_filename != NULL) {
@@ -299,13 +272,12 @@ int run_upgrade(int *pkgcount, int *secpkgcount){
 		}
 		/* if it is a package we care about */
 		if (strncmp(PKGINST_PREFIX, chld_out.line[i], strlen(PKGINST_PREFIX)) == 0 &&
-		    (do_include == NULL || regexec(&ireg, chld_out.line[i], 0, NULL, 0) == 0)) {
+		    (do_include.count == 0 || np_regex_set_match(&do_include, chld_out.line[i]) >= 0)) {
 			/* if we're not excluding, or it's not in the
 			 * list of stuff to exclude */
-			if(do_exclude==NULL ||
-			   regexec(&ereg, chld_out.line[i], 0, NULL, 0)!=0){
+			if(np_regex_set_match(&do_exclude, chld_out.line[i]) < 0){
 				pc++;
-				if(regexec(&sreg, chld_out.line[i], 0, NULL, 0)==0){
+				if(np_regex_set_match(&do_critical, chld_out.line[i]) >= 0){
 					spc++;
 					if(verbose) printf("*");
 				}
@@ -328,9 +300,9 @@ int run_upgrade(int *pkgcount, int *secpkgcount){
 			}
 		}
 	}
-	if (do_include != NULL) regfree(&ireg);
-	regfree(&sreg);
-	if(do_exclude!=NULL) regfree(&ereg);
+	np_regex_set_free(&do_include);
+	np_regex_set_free(&do_critical);
+	np_regex_set_free(&do_exclude);
 	free(cmdline);
 	return result;
 }
@@ -374,22 +346,18 @@ int run_update(void){
 	return result;
 }
 
-char* add_to_regexp(char *expr, const char *next){
-	char *re=NULL;
+/* each pattern is kept separately rather than joined with '|', so every
+ * one of them keeps its own literal prefilter */
+void add_to_regexp(np_regex_set *set, const char *next){
+	char rerrbuf[64];
+	int regres;
 
-	if(expr==NULL){
-		re=malloc(sizeof(char)*(strlen("()")+strlen(next)+1));
-		if(!re) die(STATE_UNKNOWN, "malloc failed!\n");
-		sprintf(re, "(%s)", next);
-	} else {
-		/* resize it, adding an extra char for the new '|' separator */
-		re=realloc(expr, sizeof(char)*(strlen(expr)+1+strlen(next)+1));
-		if(!re) die(STATE_UNKNOWN, "realloc failed!\n");
-		/* append it starting at ')' in the old re */
-		sprintf((char*)(re+strlen(re)-1), "|%s)", next);
+	regres=np_regex_set_add(set, next, REG_EXTENDED);
+	if(regres!=0) {
+		np_regex_error(regres, NULL, rerrbuf, 64);
+		die(STATE_UNKNOWN, _("%s: Error compiling regexp: %s"),
+		    progname, rerrbuf);
 	}
-
-	return re;
 }
 
 char* construct_cmdline(upgrade_type u, const char *opts){
@@ -34,14 +34,37 @@ const char *email = "devel@nagios-plugins.org";
 #include "utils.h"
 #include "netutils.h"
 #include "utils_cmd.h"
+#include "sha1.h"
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <fcntl.h>
+#include <sys/wait.h>
 
 #ifndef NP_MAXARGS
 #define NP_MAXARGS 1024
 #endif
 
+#define DEFAULT_PARALLEL 16
+
+/* one host of a --host-list run */
+typedef struct ssh_job {
+	char *host;
+	char *shortname;
+	pid_t pid;
+	int fd[2];		/* stdout and stderr of ssh, -1 once closed */
+	output out[2];
+	time_t deadline;
+} ssh_job;
+
 int process_arguments (int, char **);
 int validate_arguments (void);
 void comm_append (const char *);
+void setup_multiplex (void);
+int ssh_master (void);
+void update_master_stats (int);
+int write_passive_results (FILE *, const char *, output *);
+void read_host_list (const char *);
+int run_host_list (FILE *);
 void print_help (void);
 void print_usage (void);
 
@@ -58,16 +81,23 @@ char *host_shortname = NULL;
 char **service;
 int passive = FALSE;
 int verbose = FALSE;
+int multiplex = FALSE;
+int master_persist = 300;	/* seconds an unused master connection is kept */
+char *control_dir = NULL;
+char *control_path = NULL;
+char **master_argv = NULL;	/* ssh and its options, without host and command */
+int master_argc = 0;
+char *master_stats = NULL;	/* perfdata about master connection reuse */
+ssh_job *jobs = NULL;
+int njobs = 0;
+int parallel = DEFAULT_PARALLEL;
 
 int
 main (int argc, char **argv)
 {
 
-	char *status_text;
-	int cresult;
 	int result = STATE_UNKNOWN;
 	int i;
-	time_t local_time;
 	FILE *fp = NULL;
 	output chld_out, chld_err;
 
@@ -85,12 +115,6 @@ main (int argc, char **argv)
 	if (process_arguments (argc, argv) == ERROR)
 		usage_va(_("Could not parse arguments"));
 
-	/* Set signal handling and alarm timeout */
-	if (signal (SIGALRM, timeout_alarm_handler) == SIG_ERR) {
-		usage_va(_("Cannot catch SIGALRM"));
-	}
-	alarm (timeout_interval);
-
 	/* run the command */
 	if (verbose) {
 		printf ("Command: %s\n", commargv[0]);
@@ -98,6 +122,25 @@ main (int argc, char **argv)
 			printf ("Argument %i: %s\n", i, commargv[i]);
 	}
 
+	/* the timeout applies to each host of a host list separately */
+	if (jobs) {
+		if (!(fp = fopen (outputfile, "a"))) {
+			printf (_("SSH WARNING: could not open %s\n"), outputfile);
+			exit (STATE_UNKNOWN);
+		}
+		return run_host_list (fp);
+	}
+
+	/* Set signal handling and alarm timeout */
+	if (signal (SIGALRM, timeout_alarm_handler) == SIG_ERR) {
+		usage_va(_("Cannot catch SIGALRM"));
+	}
+	alarm (timeout_interval);
+
+	/* route the command through a master connection to the host */
+	if (multiplex)
+		update_master_stats (ssh_master ());
+
 	result = cmd_run_array (commargv, &chld_out, &chld_err, 0);
 
 	if (skip_stdout == -1) /* --skip-stdout specified without argument */
@@ -120,10 +163,15 @@ main (int argc, char **argv)
 		 * such as ssh or other remote execution error */
 		int chld_return_code = result;
 		result = min(result, STATE_UNKNOWN);
-		if (chld_out.lines > skip_stdout)
-			for (i = skip_stdout; i < chld_out.lines; i++)
-				puts (chld_out.line[i]);
-		else
+		if (chld_out.lines > skip_stdout) {
+			for (i = skip_stdout; i < chld_out.lines; i++) {
+				if (i == skip_stdout && master_stats)
+					printf ("%s%s%s\n", chld_out.line[i],
+					        strchr (chld_out.line[i], '|') ? " " : " | ", master_stats);
+				else
+					puts (chld_out.line[i]);
+			}
+		} else
 			printf (_("%s - check_by_ssh: Remote command '%s' returned status %d\n"),
 			        state_text(result), remotecmd, chld_return_code);
 		return result;
@@ -140,24 +188,43 @@ main (int argc, char **argv)
 		exit (STATE_UNKNOWN);
 	}
 
+	if (write_passive_results (fp, host_shortname, &chld_out) == ERROR)
+		die (STATE_UNKNOWN, _("%s: Error parsing output\n"), progname);
+
+	/* Multiple commands and passive checking should always return OK */
+	return result;
+}
+
+
+/* write the results of the commands run on one host to the command file,
+ * returns ERROR if the output does not match the commands */
+int
+write_passive_results (FILE *fp, const char *shortname, output *out)
+{
+	char *status_text;
+	int cresult;
+	time_t local_time;
+	unsigned int n = 0;
+	int i;
+
+	/* check all of it first, a host gets either all or none of its results */
+	for(i = skip_stdout; i < (int) out->lines; i += 2)
+		if (i + 1 == (int) out->lines || strstr (out->line[i + 1], "STATUS CODE: ") == NULL)
+			return ERROR;
+
 	local_time = time (NULL);
-	commands = 0;
-	for(i = skip_stdout; i < chld_out.lines; i++) {
-		status_text = chld_out.line[i++];
-		if (i == chld_out.lines || strstr (chld_out.line[i], "STATUS CODE: ") == NULL)
-			die (STATE_UNKNOWN, _("%s: Error parsing output\n"), progname);
-
-		if (service[commands] && status_text
-			&& sscanf (chld_out.line[i], "STATUS CODE: %d", &cresult) == 1)
+	for(i = skip_stdout; i < (int) out->lines; i++) {
+		status_text = out->line[i++];
+		if (n < services && service[n] && status_text
+			&& sscanf (out->line[i], "STATUS CODE: %d", &cresult) == 1)
 		{
 			fprintf (fp, "[%d] PROCESS_SERVICE_CHECK_RESULT;%s;%s;%d;%s\n",
-			         (int) local_time, host_shortname, service[commands++],
+			         (int) local_time, shortname, service[n++],
 			         cresult, status_text);
 		}
 	}
-	
-	/* Multiple commands and passive checking should always return OK */
-	return result;
+
+	return OK;
 }
 
 /* process command-line arguments */
@@ -194,6 +261,9 @@ process_arguments (int argc, char **argv)
 		{"ssh-option", required_argument, 0, 'o'},
 		{"quiet", no_argument, 0, 'q'},
 		{"configfile", optional_argument, 0, 'F'},
+		{"multiplex", optional_argument, 0, 'M'},
+		{"host-list", required_argument, 0, 'L'},
+		{"parallel", required_argument, 0, 'P'},
 		{0, 0, 0, 0}
 	};
 
@@ -205,7 +275,7 @@ process_arguments (int argc, char **argv)
 			strcpy (argv[c], "-t");
 
 	while (1) {
-		c = getopt_long (argc, argv, "Vvh1246fqt:H:O:p:i:u:l:C:S::E::n:s:o:F:", longopts,
+		c = getopt_long (argc, argv, "Vvh1246fqt:H:O:p:i:u:l:C:S::E::n:s:o:F:M::L:P:", longopts,
 		                 &option);
 
 		if (c == -1 || c == EOF)
@@ -314,6 +384,23 @@ process_arguments (int argc, char **argv)
 			comm_append("-F");
 			comm_append(optarg);
 			break;
+		case 'M':									/* keep a master connection */
+			multiplex = TRUE;
+			if (optarg != NULL) {
+				if (!is_intpos (optarg))
+					usage_va(_("multiplex argument must be a positive integer"));
+				master_persist = atoi (optarg);
+			}
+			break;
+		case 'L':									/* file with the hosts to check */
+			read_host_list (optarg);
+			hostname = jobs[0].host;
+			break;
+		case 'P':									/* hosts checked at the same time */
+			if (!is_intpos (optarg))
+				usage_va(_("parallel argument must be a positive integer"));
+			parallel = atoi (optarg);
+			break;
 		default:									/* help */
 			usage5();
 		}
@@ -342,6 +429,16 @@ process_arguments (int argc, char **argv)
 	if (remotecmd == NULL || strlen (remotecmd) <= 1)
 		usage_va(_("No remotecmd"));
 
+	if (multiplex && jobs)
+		usage_va(_("Master connections can not be used with a host list"));
+
+	/* only a master connection needs the state directory */
+	if (multiplex) {
+		np_init ((char *) progname, argc, argv);
+		setup_multiplex ();
+	}
+
+	/* for a host list, run_host_list() replaces this with each host */
 	comm_append(hostname);
 	comm_append(remotecmd);
 
@@ -364,6 +461,431 @@ comm_append (const char *str)
 
 }
 
+/*
+ * Read the hosts to check from a file with one host per line, optionally
+ * followed by its short name in the nagios configuration.  Empty lines and
+ * lines starting with '#' are ignored.
+ */
+void
+read_host_list (const char *filename)
+{
+	FILE *fp;
+	char line[MAX_INPUT_BUFFER];
+	char *host, *shortname;
+
+	if (strcmp (filename, "-") == 0)
+		fp = stdin;
+	else if ((fp = fopen (filename, "r")) == NULL)
+		die (STATE_UNKNOWN, _("%s: Could not open host list %s: %s\n"),
+		     progname, filename, strerror (errno));
+
+	while (fgets (line, sizeof (line), fp)) {
+		if ((host = strtok (line, " \t\r\n")) == NULL || *host == '#')
+			continue;
+		host_or_die (host);
+		shortname = strtok (NULL, " \t\r\n");
+
+		jobs = realloc (jobs, (njobs + 1) * sizeof (ssh_job));
+		if (jobs == NULL)
+			die (STATE_UNKNOWN, _("Can not (re)allocate 'jobs' buffer\n"));
+		memset (&jobs[njobs], 0, sizeof (ssh_job));
+		jobs[njobs].host = strdup (host);
+		jobs[njobs].shortname = strdup (shortname ? shortname : host);
+		jobs[njobs].fd[0] = jobs[njobs].fd[1] = -1;
+		njobs++;
+	}
+
+	if (fp != stdin)
+		fclose (fp);
+	if (njobs == 0)
+		die (STATE_UNKNOWN, _("%s: No hosts in host list %s\n"), progname, filename);
+}
+
+
+/* start ssh for one host of the host list */
+static int
+start_job (ssh_job *job)
+{
+	int pfd[2], pfderr[2];
+
+	commargv[commargc - 2] = job->host;
+	if (pipe (pfd) < 0)
+		return ERROR;
+	if (pipe (pfderr) < 0) {
+		close (pfd[0]);
+		close (pfd[1]);
+		return ERROR;
+	}
+
+	if ((job->pid = fork ()) < 0) {
+		close (pfd[0]);
+		close (pfd[1]);
+		close (pfderr[0]);
+		close (pfderr[1]);
+		return ERROR;
+	}
+
+	if (job->pid == 0) {
+		close (pfd[0]);
+		close (pfderr[0]);
+		dup2 (pfd[1], STDOUT_FILENO);
+		dup2 (pfderr[1], STDERR_FILENO);
+		close (pfd[1]);
+		close (pfderr[1]);
+		execv (commargv[0], commargv);
+		_exit (STATE_UNKNOWN);
+	}
+
+	close (pfd[1]);
+	close (pfderr[1]);
+	/* keep the pipes of running hosts out of the ssh started later */
+	fcntl (pfd[0], F_SETFD, FD_CLOEXEC);
+	fcntl (pfderr[0], F_SETFD, FD_CLOEXEC);
+	job->fd[0] = pfd[0];
+	job->fd[1] = pfderr[0];
+	job->deadline = time (NULL) + timeout_interval;
+
+	return OK;
+}
+
+
+/* split the output collected for a host into lines */
+static void
+split_output (output *op)
+{
+	size_t i = 0;
+
+	op->line = NULL;
+	op->lines = 0;
+	while (i < op->buflen) {
+		op->line = realloc (op->line, (op->lines + 1) * sizeof (char *));
+		op->line[op->lines++] = &op->buf[i];
+		while (i < op->buflen && op->buf[i] != '\n')
+			i++;
+		op->buf[i++] = '\0';
+	}
+}
+
+
+/* report every service of a host that could not be checked as UNKNOWN */
+static void
+write_host_failure (FILE *fp, ssh_job *job, const char *reason)
+{
+	unsigned int i;
+
+	for (i = 0; i < services; i++)
+		fprintf (fp, "[%d] PROCESS_SERVICE_CHECK_RESULT;%s;%s;%d;%s - check_by_ssh: %s\n",
+		         (int) time (NULL), job->shortname, service[i], STATE_UNKNOWN,
+		         state_text (STATE_UNKNOWN), reason);
+}
+
+
+/* collect ssh's exit status and write the host's results, returns TRUE if
+ * the host was checked */
+static int
+finish_job (FILE *fp, ssh_job *job, int timed_out)
+{
+	char *reason = NULL;
+	int status, i;
+
+	for (i = 0; i < 2; i++) {
+		if (job->fd[i] >= 0)
+			close (job->fd[i]);
+		job->fd[i] = -1;
+	}
+	if (timed_out)
+		kill (job->pid, SIGKILL);
+	while (waitpid (job->pid, &status, 0) < 0 && errno == EINTR)
+		;
+
+	split_output (&job->out[0]);
+	split_output (&job->out[1]);
+
+	if (timed_out)
+		xasprintf (&reason, _("Remote command timed out after %d seconds"), timeout_interval);
+	else if ((int) job->out[1].lines > (skip_stderr < 0 ? (int) job->out[1].lines : skip_stderr))
+		xasprintf (&reason, _("Remote command execution failed: %s"),
+		           job->out[1].line[skip_stderr]);
+	else if (!WIFEXITED (status) || WEXITSTATUS (status) > STATE_UNKNOWN)
+		xasprintf (&reason, _("Remote command '%s' returned status %d"), remotecmd,
+		           WIFEXITED (status) ? WEXITSTATUS (status) : -1);
+	else if (write_passive_results (fp, job->shortname, &job->out[0]) == ERROR)
+		xasprintf (&reason, "%s", _("Error parsing output"));
+
+	if (reason)
+		write_host_failure (fp, job, reason);
+	/* results are visible to nagios as soon as each host is done */
+	fflush (fp);
+
+	if (verbose)
+		printf ("%s: %s\n", job->host, reason ? reason : _("OK"));
+
+	for (i = 0; i < 2; i++) {
+		free (job->out[i].buf);
+		free (job->out[i].line);
+		memset (&job->out[i], 0, sizeof (output));
+	}
+
+	return reason == NULL;
+}
+
+
+/*
+ * Run the command on all hosts of the host list, at most 'parallel' at a
+ * time.  Each host gets its own timeout, so a host that hangs only costs
+ * its own slot.
+ */
+int
+run_host_list (FILE *fp)
+{
+	struct pollfd *pfd;
+	ssh_job **pjob;
+	char buf[4096];
+	struct timeval tv;
+	time_t now, next_deadline;
+	int next = 0, running = 0, failed = 0, timeouts = 0;
+	ssize_t len;
+	int i, j, n, ret;
+
+	pfd = calloc (2 * parallel, sizeof (struct pollfd));
+	pjob = calloc (2 * parallel, sizeof (ssh_job *));
+	if (pfd == NULL || pjob == NULL)
+		die (STATE_UNKNOWN, _("Can not allocate poll buffers\n"));
+
+	gettimeofday (&tv, NULL);
+	fcntl (fileno (fp), F_SETFD, FD_CLOEXEC);
+	setenv ("LC_ALL", "C", 1);
+
+	while (next < njobs || running > 0) {
+		while (running < parallel && next < njobs) {
+			if (start_job (&jobs[next]) == OK) {
+				running++;
+			} else {
+				write_host_failure (fp, &jobs[next], _("Could not start ssh"));
+				fflush (fp);
+				failed++;
+			}
+			next++;
+		}
+
+		/* wait for output or the first host to run out of time */
+		n = 0;
+		now = time (NULL);
+		next_deadline = now + timeout_interval;
+		for (i = 0; i < next; i++) {
+			if (jobs[i].fd[0] < 0 && jobs[i].fd[1] < 0)
+				continue;
+			if (jobs[i].deadline < next_deadline)
+				next_deadline = jobs[i].deadline;
+			for (j = 0; j < 2; j++) {
+				if (jobs[i].fd[j] < 0)
+					continue;
+				pfd[n].fd = jobs[i].fd[j];
+				pfd[n].events = POLLIN;
+				pfd[n].revents = 0;
+				pjob[n++] = &jobs[i];
+			}
+		}
+		if (n == 0)
+			continue;
+
+		ret = poll (pfd, n, next_deadline > now ? (next_deadline - now) * 1000 : 0);
+		if (ret < 0 && errno != EINTR)
+			die (STATE_UNKNOWN, _("%s: poll() failed: %s\n"), progname, strerror (errno));
+
+		for (i = 0; ret > 0 && i < n; i++) {
+			if (pfd[i].revents == 0)
+				continue;
+			j = (pfd[i].fd == pjob[i]->fd[0]) ? 0 : 1;
+			len = read (pfd[i].fd, buf, sizeof (buf));
+			if (len > 0) {
+				output *op = &pjob[i]->out[j];
+				op->buf = realloc (op->buf, op->buflen + len + 1);
+				memcpy (op->buf + op->buflen, buf, len);
+				op->buflen += len;
+			} else if (len == 0 || errno != EINTR) {
+				close (pjob[i]->fd[j]);
+				pjob[i]->fd[j] = -1;
+				if (pjob[i]->fd[0] < 0 && pjob[i]->fd[1] < 0) {
+					if (!finish_job (fp, pjob[i], FALSE))
+						failed++;
+					running--;
+				}
+			}
+		}
+
+		now = time (NULL);
+		for (i = 0; i < next; i++) {
+			if ((jobs[i].fd[0] >= 0 || jobs[i].fd[1] >= 0) && jobs[i].deadline <= now) {
+				finish_job (fp, &jobs[i], TRUE);
+				failed++;
+				timeouts++;
+				running--;
+			}
+		}
+	}
+
+	fclose (fp);
+
+	printf (_("%s - check_by_ssh: %d of %d hosts checked"),
+	        state_text (failed ? STATE_WARNING : STATE_OK), njobs - failed, njobs);
+	if (failed)
+		printf (_(", %d failed (%d timed out)"), failed, timeouts);
+	printf ("|%s %s %s %s\n",
+	        fperfdata ("hosts", njobs, "", FALSE, 0, FALSE, 0, TRUE, 0, FALSE, 0),
+	        fperfdata ("failed", failed, "", FALSE, 0, FALSE, 0, TRUE, 0, TRUE, njobs),
+	        fperfdata ("timeouts", timeouts, "", FALSE, 0, FALSE, 0, TRUE, 0, TRUE, njobs),
+	        fperfdata ("time", (double) deltime (tv) / 1.0e6, "s", FALSE, 0, FALSE, 0, TRUE, 0, FALSE, 0));
+
+	return failed ? STATE_WARNING : STATE_OK;
+}
+
+
+/*
+ * The master connection's socket lives in the state directory, named after
+ * a hash of the ssh options and host so different users, ports or keys get
+ * their own master.  The command itself only ever uses an existing master
+ * (ControlMaster=no); ssh_master() starts one if there is none.
+ */
+void
+setup_multiplex (void)
+{
+	struct sha1_ctx ctx;
+	struct sockaddr_un sun;
+	unsigned char digest[20];
+	char key[17];
+	char *option;
+	int i;
+
+	sha1_init_ctx (&ctx);
+	for (i = 1; i < commargc; i++)
+		sha1_process_bytes (commargv[i], strlen (commargv[i]) + 1, &ctx);
+	sha1_process_bytes (hostname, strlen (hostname), &ctx);
+	sha1_finish_ctx (&ctx, digest);
+	for (i = 0; i < 8; i++)
+		sprintf (&key[2 * i], "%02x", digest[i]);
+
+	control_dir = np_state_directory ();
+	xasprintf (&control_path, "%s/%s", control_dir, key);
+	/* ssh binds to a temporary name 17 characters longer first */
+	if (strlen (control_path) + 17 >= sizeof (sun.sun_path))
+		die (STATE_UNKNOWN, _("%s: Path for master connection socket too long: %s\n"),
+		     progname, control_path);
+
+	master_argc = commargc;
+	master_argv = calloc (commargc + 12, sizeof (char *));
+	if (master_argv == NULL)
+		die (STATE_UNKNOWN, _("Can not (re)allocate 'master_argv' buffer\n"));
+	for (i = 0; i < commargc; i++)
+		master_argv[i] = commargv[i];
+
+	xasprintf (&option, "ControlPath=%s", control_path);
+	comm_append ("-o");
+	comm_append (option);
+	comm_append ("-o");
+	comm_append ("ControlMaster=no");
+
+	xasprintf (&option, "master_%s", key);
+	np_enable_state (option, 1);
+}
+
+
+/* make sure a master connection to the host is up, returns TRUE if one was
+ * running already */
+int
+ssh_master (void)
+{
+	output chld_out, chld_err;
+	char *option;
+	char *p;
+	int n, fd, status;
+	pid_t pid;
+
+	/* health check of a running master */
+	n = master_argc;
+	xasprintf (&option, "ControlPath=%s", control_path);
+	master_argv[n++] = "-o";
+	master_argv[n++] = option;
+	master_argv[n++] = "-O";
+	master_argv[n++] = "check";
+	master_argv[n++] = hostname;
+	master_argv[n] = NULL;
+	if (cmd_run_array (master_argv, &chld_out, &chld_err, 0) == 0) {
+		if (verbose)
+			printf (_("Reusing master connection %s\n"), control_path);
+		return TRUE;
+	}
+
+	/* no master answering, remove what a dead one may have left behind */
+	unlink (control_path);
+	for (p = control_dir + 1; *p; p++) {
+		if (*p == '/') {
+			*p = '\0';
+			mkdir (control_dir, S_IRWXU);
+			*p = '/';
+		}
+	}
+	mkdir (control_dir, S_IRWXU);
+
+	n = master_argc + 2;
+	master_argv[n++] = "-o";
+	master_argv[n++] = "ControlMaster=yes";
+	master_argv[n++] = "-o";
+	xasprintf (&master_argv[n++], "ControlPersist=%d", master_persist);
+	master_argv[n++] = "-N";
+	master_argv[n++] = "-f";
+	master_argv[n++] = hostname;
+	master_argv[n] = NULL;
+	if (verbose)
+		printf (_("Starting master connection %s\n"), control_path);
+
+	/* ssh -f stays in the background with our stdout and stderr unless
+	 * they are redirected, which would make cmd_run_array() wait for it */
+	if ((pid = fork ()) < 0)
+		return FALSE;
+	if (pid == 0) {
+		if ((fd = open ("/dev/null", O_RDWR)) >= 0) {
+			dup2 (fd, STDIN_FILENO);
+			dup2 (fd, STDOUT_FILENO);
+			dup2 (fd, STDERR_FILENO);
+		}
+		execv (master_argv[0], master_argv);
+		_exit (STATE_UNKNOWN);
+	}
+	if (waitpid (pid, &status, 0) == pid && verbose &&
+	    (!WIFEXITED (status) || WEXITSTATUS (status) != 0))
+		printf ("%s\n", _("Could not start master connection, connecting directly"));
+
+	return FALSE;
+}
+
+
+/* count master connection reuse in the state file */
+void
+update_master_stats (int reused)
+{
+	state_data *previous;
+	unsigned long hits = 0, misses = 0;
+	char *data;
+
+	previous = np_state_read ();
+	if (previous != NULL)
+		sscanf ((char *) previous->data, "%lu %lu", &hits, &misses);
+	if (reused)
+		hits++;
+	else
+		misses++;
+
+	xasprintf (&data, "%lu %lu", hits, misses);
+	np_state_write_string (0, data);
+
+	xasprintf (&master_stats, "ssh_master_reused=%d ssh_master_reuse=%.0f%%;;;0;100",
+	           reused, 100.0 * hits / (hits + misses));
+	if (verbose)
+		printf (_("Master connection reused %lu of %lu times\n"), hits, hits + misses);
+}
+
+
 int
 validate_arguments (void)
 {
@@ -373,7 +895,10 @@ validate_arguments (void)
 	if (passive && commands != services)
 		die (STATE_UNKNOWN, _("%s: In passive mode, you must provide a service name for each command.\n"), progname);
 
-	if (passive && host_shortname == NULL)
+	if (jobs && !passive)
+		die (STATE_UNKNOWN, _("%s: A host list can only be used in passive mode.\n"), progname);
+
+	if (passive && host_shortname == NULL && jobs == NULL)
 		die (STATE_UNKNOWN, _("%s: In passive mode, you must provide the host short name from the nagios configs.\n"), progname);
 
 	return OK;
@@ -428,6 +953,17 @@ print_help (void)
   printf ("    %s\n", _("Call ssh with '-o OPTION' (may be used multiple times) [optional]"));
   printf (" %s\n","-F, --configfile");
   printf ("    %s\n", _("Tell ssh to use this configfile [optional]"));
+  printf (" %s\n","-M, --multiplex[=SECONDS]");
+  printf ("    %s\n", _("Run the command over a master connection to the host, which is started if"));
+  printf ("    %s\n", _("needed and closed after SECONDS without use (default: 300). Its socket is"));
+  printf ("    %s\n", _("kept in the state directory [optional]"));
+  printf (" %s\n","-L, --host-list=FILE");
+  printf ("    %s\n", _("Run the commands in passive mode on every host listed in FILE ('-' for"));
+  printf ("    %s\n", _("stdin), one host per line with an optional short name after it. Results"));
+  printf ("    %s\n", _("are written as soon as a host is done, the timeout applies to each host"));
+  printf (" %s\n","-P, --parallel=INTEGER");
+  printf ("    %s\n", _("Number of hosts from the host list checked at the same time"));
+  printf ("    %s %d)\n", _("(default:"), DEFAULT_PARALLEL);
   printf (" %s\n","-q, --quiet");
   printf ("    %s\n", _("Tell ssh to suppress warning and diagnostic messages [optional]"));
 	printf (UT_CONN_TIMEOUT, DEFAULT_SOCKET_TIMEOUT);
@@ -443,6 +979,7 @@ print_help (void)
   printf("\n");
   printf (" %s\n", _("To use passive mode, provide multiple '-C' options, and provide"));
   printf (" %s\n", _("all of -O, -s, and -n options (servicelist order must match '-C'options)"));
+  printf (" %s\n", _("With '-L', -n is taken from the host list instead."));
   printf ("\n");
   printf ("%s\n", _("Examples:"));
   printf (" %s\n", "$ check_by_ssh -H localhost -n lh -s c1:c2:c3 -C uptime -C uptime -C uptime -O /tmp/foo");
@@ -463,6 +1000,7 @@ print_usage (void)
 	printf (" %s -H <host> -C <command> [-fqv] [-1|-2] [-4|-6]\n"
 	        "       [-S [lines]] [-E [lines]] [-t timeout] [-i identity]\n"
 	        "       [-l user] [-n name] [-s servicelist] [-O outputfile]\n"
-	        "       [-p port] [-o ssh-option] [-F configfile]\n",
+	        "       [-p port] [-o ssh-option] [-F configfile] [-M [seconds]]\n"
+	        "       [-L hostlist [-P parallel]]\n",
 	        progname);
 }
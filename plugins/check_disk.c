@@ -218,9 +218,9 @@ main (int argc, char **argv)
 {
   int result = STATE_UNKNOWN;
   int disk_result = STATE_UNKNOWN;
-  char *output = NULL;
+  np_str output = NP_STR_INIT;
   char *details;
-  char *perf;
+  np_str perf = NP_STR_INIT;
   char *preamble;
   char *flag_header = NULL;
   char *label_name;
@@ -245,9 +245,7 @@ main (int argc, char **argv)
 #endif
 
   preamble = strdup (" - free space:");
-  output = strdup ("");
   details = strdup ("");
-  perf = strdup ("");
   stat_buf = malloc(sizeof *stat_buf);
 
   setlocale (LC_ALL, "");
@@ -502,13 +500,13 @@ main (int argc, char **argv)
       } else {
           label_name = (!strcmp(me->me_mountdir, "none") || display_mntp) ? me->me_devname : me->me_mountdir;
           /* Nb: *_high_tide are unset when == ULONG_MAX */
-          xasprintf (&perf, "%s %s", perf,
-                     perfdata (label_name,
-                               path->dused_units, units,
-                               (warning_high_tide != ULONG_MAX ? TRUE : FALSE), warning_high_tide,
-                               (critical_high_tide != ULONG_MAX ? TRUE : FALSE), critical_high_tide,
-                               TRUE, 0,
-                               TRUE, path->dtotal_units));
+          np_str_add (&perf, " ");
+          np_str_perfdata (&perf, label_name,
+                           path->dused_units, units,
+                           (warning_high_tide != ULONG_MAX ? TRUE : FALSE), warning_high_tide,
+                           (critical_high_tide != ULONG_MAX ? TRUE : FALSE), critical_high_tide,
+                           TRUE, 0,
+                           TRUE, path->dtotal_units);
 
           if (inode_perfdata_enabled) {
 
@@ -526,23 +524,25 @@ main (int argc, char **argv)
               print_inode_perfdata_critical = TRUE;
             }
 
-            xasprintf (&perf, "%s %s", perf,
-                       perfdata (inode_label_name,
-                                  path->dused_inodes_percent, "%",
-                                  print_inode_perfdata_warning, (print_inode_perfdata_warning ? path->freeinodes_percent->warning->end : 0),
-                                  print_inode_perfdata_critical, (print_inode_perfdata_critical ? path->freeinodes_percent->critical->end : 0),
-                                  TRUE, 0,
-                                  TRUE, 100));
+            np_str_add (&perf, " ");
+            np_str_perfdata (&perf, inode_label_name,
+                             path->dused_inodes_percent, "%",
+                             print_inode_perfdata_warning, (print_inode_perfdata_warning ? path->freeinodes_percent->warning->end : 0),
+                             print_inode_perfdata_critical, (print_inode_perfdata_critical ? path->freeinodes_percent->critical->end : 0),
+                             TRUE, 0,
+                             TRUE, 100);
 
             raw_used_inodes_name = calloc(strlen(label_name) + 1 + 11, 1);
             raw_used_inodes_name = strcat(raw_used_inodes_name, label_name);
             raw_used_inodes_name = strcat(raw_used_inodes_name, "_inode_used");
-            xasprintf(&perf, "%s %s", perf, perfdata(raw_used_inodes_name, path->inodes_total - path->inodes_free, "", FALSE, 0, FALSE, 0, TRUE, 0, TRUE, path->inodes_total));
+            np_str_add (&perf, " ");
+            np_str_perfdata (&perf, raw_used_inodes_name, path->inodes_total - path->inodes_free, "", FALSE, 0, FALSE, 0, TRUE, 0, TRUE, path->inodes_total);
 
             raw_free_inodes_name = calloc(strlen(label_name) + 1 + 11, 1);
             raw_free_inodes_name = strcat(raw_free_inodes_name, label_name);
             raw_free_inodes_name = strcat(raw_free_inodes_name, "_inode_free");
-            xasprintf(&perf, "%s %s", perf, perfdata(raw_free_inodes_name, path->inodes_free, "", FALSE, 0, FALSE, 0, TRUE, 0, TRUE, path->inodes_total));
+            np_str_add (&perf, " ");
+            np_str_perfdata (&perf, raw_free_inodes_name, path->inodes_free, "", FALSE, 0, FALSE, 0, TRUE, 0, TRUE, path->inodes_total);
           }
 
       }
@@ -557,8 +557,7 @@ main (int argc, char **argv)
           else {
               xasprintf(&flag_header, "");
           }
-          xasprintf (&output, "%s %s %.0f %s (%.2f%%",
-                     output,
+          np_str_addf (&output, " %s %.0f %s (%.2f%%",
                      (!strcmp(me->me_mountdir, "none") || display_mntp) ? me->me_devname : me->me_mountdir,
                      (double)path->dfree_units,
                      units,
@@ -566,15 +565,15 @@ main (int argc, char **argv)
           /* Whether or not to put all disks on new line */
           if (newlines) {
               if (path->dused_inodes_percent < 0) {
-                  xasprintf(&output, "%s inode=-)%s;\n", output, (disk_result ? "]" : ""));
+                  np_str_addf (&output, " inode=-)%s;\n", (disk_result ? "]" : ""));
               } else {
-                  xasprintf(&output, "%s inode=%.0f%%)%s;\n", output, path->dfree_inodes_percent, ((disk_result && verbose) ? "]" : ""));
+                  np_str_addf (&output, " inode=%.0f%%)%s;\n", path->dfree_inodes_percent, ((disk_result && verbose) ? "]" : ""));
               }
           } else {
               if (path->dused_inodes_percent < 0) {
-                  xasprintf(&output, "%s inode=-)%s;", output, (disk_result ? "]" : ""));
+                  np_str_addf (&output, " inode=-)%s;", (disk_result ? "]" : ""));
               } else {
-                  xasprintf(&output, "%s inode=%.0f%%)%s;", output, path->dfree_inodes_percent, ((disk_result && verbose) ? "]" : ""));
+                  np_str_addf (&output, " inode=%.0f%%)%s;", path->dfree_inodes_percent, ((disk_result && verbose) ? "]" : ""));
               }
           }
 
@@ -598,12 +597,12 @@ main (int argc, char **argv)
         print_human_disk_entries(&human_disk_entries[0], num_human_disk_entries);
     } else {
         if (verbose >= 2)
-            xasprintf (&output, "%s%s", output, details);
+            np_str_add (&output, details);
 
         if (newlines) {
-            printf ("DISK %s%s\n%s|%s\n", state_text (result), (erronly && result==STATE_OK) ? "" : preamble, output, perf);
+            printf ("DISK %s%s\n%s|%s\n", state_text (result), (erronly && result==STATE_OK) ? "" : preamble, np_str_get (&output), np_str_get (&perf));
         } else {
-            printf ("DISK %s%s%s|%s\n", state_text (result), (erronly && result==STATE_OK) ? "" : preamble, output, perf);
+            printf ("DISK %s%s%s|%s\n", state_text (result), (erronly && result==STATE_OK) ? "" : preamble, np_str_get (&output), np_str_get (&perf));
         }
 
     }
@@ -646,7 +645,7 @@ process_arguments (int argc, char **argv)
   struct parameter_list *temp_path_select_list = NULL;
   struct mount_entry *me, *temp_me;
   int result = OK;
-  regex_t re;
+  np_regex re;
   int cflags = REG_NOSUB | REG_EXTENDED;
   int default_cflags = cflags;
   char errbuf[MAX_INPUT_BUFFER];
@@ -910,9 +909,9 @@ process_arguments (int argc, char **argv)
     case 'i':
       if (!path_selected)
         die (STATE_UNKNOWN, "DISK %s: %s\n", _("UNKNOWN"), _("Paths need to be selected before using -i/-I. Use -A to select all paths explicitly"));
-      err = regcomp(&re, optarg, cflags);
+      err = np_regex_compile(&re, optarg, cflags);
       if (err != 0) {
-        regerror (err, &re, errbuf, MAX_INPUT_BUFFER);
+        np_regex_error (err, &re, errbuf, MAX_INPUT_BUFFER);
         die (STATE_UNKNOWN, "DISK %s: %s - %s\n",_("UNKNOWN"), _("Could not compile regular expression"), errbuf);
       }
 
@@ -940,7 +939,7 @@ process_arguments (int argc, char **argv)
         }
       }
 
-
+      np_regex_free(&re);
       cflags = default_cflags;
       break;
 
@@ -956,9 +955,9 @@ process_arguments (int argc, char **argv)
         die (STATE_UNKNOWN, "DISK %s: %s", _("UNKNOWN"), _("Must set a threshold value before using -r/-R\n"));
       }
 
-      err = regcomp(&re, optarg, cflags);
+      err = np_regex_compile(&re, optarg, cflags);
       if (err != 0) {
-        regerror (err, &re, errbuf, MAX_INPUT_BUFFER);
+        np_regex_error (err, &re, errbuf, MAX_INPUT_BUFFER);
         die (STATE_UNKNOWN, "DISK %s: %s - %s\n",_("UNKNOWN"), _("Could not compile regular expression"), errbuf);
       }
 
@@ -981,6 +980,7 @@ process_arguments (int argc, char **argv)
         die (STATE_UNKNOWN, "DISK %s: %s - %s\n",_("UNKNOWN"),
             _("Regular expression did not match any path or disk"), optarg);
 
+      np_regex_free(&re);
       fnd = FALSE;
       path_selected = TRUE;
       np_set_best_match(path_select_list, mount_list, exact_match);
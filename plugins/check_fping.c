@@ -41,11 +41,20 @@ const char *email = "devel@nagios-plugins.org";
 enum {
   PACKET_COUNT = 1,
   PACKET_SIZE = 56,
+  PACKET_INTERVAL = 1000,       /* fping's default for -p */
+  TARGET_TIMEOUT = 500,         /* fping's default for -t */
   PL = 0,
   RTA = 1
 };
 
+enum {
+  ICMP_SOCKET_OPTION = CHAR_MAX + 1
+};
+
 int textscan (char *buf);
+void report_rta (double loss, double rta);
+void report_loss (double loss);
+void fping_socket (void);
 int process_arguments (int, char **);
 int get_threshold (char *arg, char *rv[2]);
 void print_help (void);
@@ -59,6 +68,7 @@ int packet_count = PACKET_COUNT;
 int target_timeout = 0;
 int packet_interval = 0;
 int verbose = FALSE;
+int use_icmp_socket = FALSE;
 int cpl;
 int wpl;
 double crta;
@@ -94,6 +104,10 @@ main (int argc, char **argv)
 
   server = strscpy (server, server_name);
 
+  /* ping from within the plugin if we can get an ICMP socket */
+  if (use_icmp_socket)
+    fping_socket ();
+
   /* compose the command */
   if (target_timeout)
     xasprintf(&option_string, "%s-t %d ", option_string, target_timeout);
@@ -213,21 +227,7 @@ textscan (char *buf)
     rtastr = 1 + index (rtastr, '/');
     loss = strtod (losstr, NULL);
     rta = strtod (rtastr, NULL);
-    if (cpl_p == TRUE && loss > cpl)
-      status = STATE_CRITICAL;
-    else if (crta_p == TRUE  && rta > crta)
-      status = STATE_CRITICAL;
-    else if (wpl_p == TRUE && loss > wpl)
-      status = STATE_WARNING;
-    else if (wrta_p == TRUE && rta > wrta)
-      status = STATE_WARNING;
-    else
-      status = STATE_OK;
-    die (status,
-          _("FPING %s - %s (loss=%.0f%%, rta=%f ms)|%s %s\n"),
-         state_text (status), server_name, loss, rta,
-         perfdata ("loss", (long int)loss, "%", wpl_p, wpl, cpl_p, cpl, TRUE, 0, TRUE, 100),
-         fperfdata ("rta", rta/1.0e3, "s", wrta_p, wrta/1.0e3, crta_p, crta/1.0e3, TRUE, 0, FALSE, 0));
+    report_rta (loss, rta);
 
   }
   else if(strstr (buf, "xmt/rcv/%loss") ) {
@@ -241,18 +241,7 @@ textscan (char *buf)
     losstr = 1 + strstr (losstr, "/");
     losstr = 1 + strstr (losstr, "/");
     loss = strtod (losstr, NULL);
-    if (atoi(losstr) == 100)
-      status = STATE_CRITICAL;
-    else if (cpl_p == TRUE && loss > cpl)
-      status = STATE_CRITICAL;
-    else if (wpl_p == TRUE && loss > wpl)
-      status = STATE_WARNING;
-    else
-      status = STATE_OK;
-    /* loss=%.0f%%;%d;%d;0;100 */
-    die (status, _("FPING %s - %s (loss=%.0f%% )|%s\n"),
-         state_text (status), server_name, loss ,
-         perfdata ("loss", (long int)loss, "%", wpl_p, wpl, cpl_p, cpl, TRUE, 0, TRUE, 100));
+    report_loss (loss);
 
   }
   else {
@@ -264,6 +253,95 @@ textscan (char *buf)
 
 
 
+/* exit with the result for a host that answered */
+void
+report_rta (double loss, double rta)
+{
+  int status;
+
+  if (cpl_p == TRUE && loss > cpl)
+    status = STATE_CRITICAL;
+  else if (crta_p == TRUE  && rta > crta)
+    status = STATE_CRITICAL;
+  else if (wpl_p == TRUE && loss > wpl)
+    status = STATE_WARNING;
+  else if (wrta_p == TRUE && rta > wrta)
+    status = STATE_WARNING;
+  else
+    status = STATE_OK;
+  die (status,
+        _("FPING %s - %s (loss=%.0f%%, rta=%f ms)|%s %s\n"),
+       state_text (status), server_name, loss, rta,
+       perfdata ("loss", (long int)loss, "%", wpl_p, wpl, cpl_p, cpl, TRUE, 0, TRUE, 100),
+       fperfdata ("rta", rta/1.0e3, "s", wrta_p, wrta/1.0e3, crta_p, crta/1.0e3, TRUE, 0, FALSE, 0));
+}
+
+
+
+/* exit with the result for a host without round trip times */
+void
+report_loss (double loss)
+{
+  int status;
+
+  if ((int) loss == 100)
+    status = STATE_CRITICAL;
+  else if (cpl_p == TRUE && loss > cpl)
+    status = STATE_CRITICAL;
+  else if (wpl_p == TRUE && loss > wpl)
+    status = STATE_WARNING;
+  else
+    status = STATE_OK;
+  /* loss=%.0f%%;%d;%d;0;100 */
+  die (status, _("FPING %s - %s (loss=%.0f%% )|%s\n"),
+       state_text (status), server_name, loss ,
+       perfdata ("loss", (long int)loss, "%", wpl_p, wpl, cpl_p, cpl, TRUE, 0, TRUE, 100));
+}
+
+
+
+/* ping the host without fping, returns only if no ICMP socket could be
+ * opened or fping options are needed that the plugin can not handle */
+void
+fping_socket (void)
+{
+  np_ping_stats stats;
+
+  if (sourceip || sourceif) {
+    if (verbose)
+      printf ("%s\n", _("Source address or interface given, using fping"));
+    return;
+  }
+
+  switch (np_net_ping (server_name, packet_count, packet_size,
+                       packet_interval ? packet_interval : PACKET_INTERVAL,
+                       target_timeout ? target_timeout : TARGET_TIMEOUT, &stats)) {
+  case NP_PING_NO_SOCKET:
+    if (verbose)
+      printf (_("Could not open ICMP socket (%s), using fping\n"), strerror (errno));
+    return;
+  case NP_PING_NO_HOST:
+    die (STATE_CRITICAL, _("FPING UNKNOWN - %s not found\n"), server_name);
+  }
+
+  if (stats.error == EACCES)
+    die (STATE_UNKNOWN, _("FPING UNKNOWN - %s parameter error\n"), server_name);
+  else if (stats.error)
+    die (STATE_CRITICAL, _("FPING CRITICAL - %s is unreachable\n"), server_name);
+
+  if (verbose)
+    printf ("%s : xmt/rcv/%%loss = %d/%d/%d%%, min/avg/max = %.3f/%.3f/%.3f\n",
+            stats.address, stats.sent, stats.received,
+            100 * (stats.sent - stats.received) / stats.sent,
+            stats.rta_min, stats.rta_avg, stats.rta_max);
+
+  if (stats.received)
+    report_rta (100.0 * (stats.sent - stats.received) / stats.sent, stats.rta_avg);
+  report_loss (100.0);
+}
+
+
+
 /* process command-line arguments */
 int
 process_arguments (int argc, char **argv)
@@ -287,6 +365,7 @@ process_arguments (int argc, char **argv)
     {"help", no_argument, 0, 'h'},
     {"use-ipv4", no_argument, 0, '4'},
     {"use-ipv6", no_argument, 0, '6'},
+    {"icmp-socket", no_argument, 0, ICMP_SOCKET_OPTION},
     {0, 0, 0, 0}
   };
 
@@ -395,6 +474,9 @@ process_arguments (int argc, char **argv)
       else
         usage (_("Interval must be a positive integer"));
       break;
+    case ICMP_SOCKET_OPTION:
+      use_icmp_socket = TRUE;
+      break;
     }
   }
 
@@ -486,6 +568,10 @@ print_help (void)
   printf ("    %s\n", _("name or IP Address of sourceip"));
   printf (" %s\n", "-I, --sourceif=IF");
   printf ("    %s\n", _("source interface name"));
+  printf (" %s\n", "--icmp-socket");
+  printf ("    %s\n", _("send the ICMP packets from the plugin instead of running fping. Falls back"));
+  printf ("    %s\n", _("to fping if the system does not allow the plugin an ICMP socket, or for -S"));
+  printf ("    %s\n", _("and -I"));
   printf (UT_VERBOSE);
   printf ("\n");
   printf (" %s\n", _("THRESHOLD is <rta>,<pl>%% where <rta> is the round trip average travel time (ms)"));
@@ -504,4 +590,5 @@ print_usage (void)
 {
   printf ("%s\n", _("Usage:"));
   printf (" %s <host_address> -w limit -c limit [-b size] [-n number] [-T number] [-i number]\n", progname);
+  printf (" [--icmp-socket]\n");
 }
@@ -120,6 +120,8 @@ int onredirect = STATE_OK;
 int followsticky = STICKY_NONE;
 int use_ssl = FALSE;
 int use_sni = FALSE;
+int resume_tls = FALSE;
+char *tls_perfdata = "";
 int verbose = FALSE;
 int show_extended_perfdata = FALSE;
 int show_output_body_as_perfdata = FALSE;
@@ -145,6 +147,8 @@ int server_port_check(int ssl_flag);
 char *perfd_time (double microsec);
 char *perfd_time_connect (double microsec);
 char *perfd_time_ssl (double microsec);
+char *perfd_time_tls (double elapsed_time);
+char *perfd_tls_resumed (int resumed);
 char *perfd_time_firstbyte (double microsec);
 char *perfd_time_headers (double microsec);
 char *perfd_time_transfer (double microsec);
@@ -173,6 +177,8 @@ main (int argc, char **argv)
     /* Parse extra opts if any */
     argv=np_extra_opts (&argc, argv, progname);
 
+    np_init ((char *) progname, argc, argv);
+
     if (process_arguments (argc, argv) == ERROR)
         usage4 (_("Could not parse arguments"));
 
@@ -230,7 +236,8 @@ process_arguments (int argc, char **argv)
         SNI_OPTION,
         VERIFY_HOST,
         CONTINUE_AFTER_CHECK_CERT,
-        PROXY_PROTOCOL
+        PROXY_PROTOCOL,
+        TLS_RESUME
     };
 
     int option = 0;
@@ -241,6 +248,7 @@ process_arguments (int argc, char **argv)
         {"ssl", optional_argument, 0, 'S'},
         {"sni", no_argument, 0, SNI_OPTION},
         {"verify-host", no_argument, 0, VERIFY_HOST},
+        {"tls-resume", no_argument, 0, TLS_RESUME},
         {"post", required_argument, 0, 'P'},
         {"method", required_argument, 0, 'j'},
         {"IP-address", required_argument, 0, 'I'},
@@ -412,6 +420,9 @@ enable_ssl:
         case VERIFY_HOST:
             check_hostname = 1;
             break;
+        case TLS_RESUME:
+            resume_tls = TRUE;
+            break;
         case 'f': /* onredirect */
             if (!strcmp (optarg, "stickyport"))
                 onredirect = STATE_DEPENDENT, followsticky = STICKY_HOST|STICKY_PORT;
@@ -1094,6 +1105,9 @@ check_http (void)
 #ifdef HAVE_SSL
     elapsed_time_connect = (double)microsec_connect / 1.0e6;
     if (use_ssl == TRUE) {
+        /* redirects may lead to another server, so set the session key here */
+        if (resume_tls)
+            np_net_ssl_resume_sessions (host_name ? host_name : server_address, server_port);
         gettimeofday (&tv_temp, NULL);
         result = np_net_ssl_init_with_hostname_version_and_cert(sd, (use_sni ? host_name : NULL), ssl_version, client_cert, client_privkey);
         if (verbose) printf ("SSL initialized\n");
@@ -1101,6 +1115,16 @@ check_http (void)
             die (STATE_CRITICAL, NULL);
         microsec_ssl = deltime (tv_temp);
         elapsed_time_ssl = (double)microsec_ssl / 1.0e6;
+        if (resume_tls) {
+            if (verbose)
+                printf ("TLS session %s in %.6f seconds\n",
+                        np_net_ssl_session_resumed () ? "resumed" : "not resumed",
+                        np_net_ssl_handshake_time ());
+            xasprintf (&tls_perfdata, "%s%s%s ",
+                       show_extended_perfdata ? "" : perfd_time_tls (np_net_ssl_handshake_time ()),
+                       show_extended_perfdata ? "" : " ",
+                       perfd_tls_resumed (np_net_ssl_session_resumed ()));
+        }
         if (check_cert == TRUE) {
             result = np_net_ssl_check_cert(days_till_exp_warn, days_till_exp_crit);
             if (continue_after_check_cert == FALSE) {
@@ -1524,7 +1548,7 @@ check_http (void)
     /* check elapsed time */
     if (show_extended_perfdata) {
         xasprintf (&msg,
-                   _("%s - %d bytes in %.3f second response time %s|%s %s %s %s %s %s %s %s"),
+                   _("%s - %d bytes in %.3f second response time %s|%s %s %s %s %s %s %s %s%s"),
                    msg, page_len, elapsed_time,
                    (display_html ? "</A>" : ""),
                    perfd_time (elapsed_time),
@@ -1534,15 +1558,17 @@ check_http (void)
                    perfd_time_headers (elapsed_time_headers),
                    perfd_time_firstbyte (elapsed_time_firstbyte),
                    perfd_time_transfer (elapsed_time_transfer),
+                   tls_perfdata,
                    (result == STATE_OK && show_output_body_as_perfdata ? page : ""));
     }
     else {
         xasprintf (&msg,
-                   _("%s - %d bytes in %.3f second response time %s|%s %s %s"),
+                   _("%s - %d bytes in %.3f second response time %s|%s %s %s%s"),
                    msg, page_len, elapsed_time,
                    (display_html ? "</A>" : ""),
                    perfd_time (elapsed_time),
                    perfd_size (page_len),
+                   tls_perfdata,
                    (result == STATE_OK && show_output_body_as_perfdata ? page : ""));
     }
 
@@ -1759,6 +1785,16 @@ char *perfd_time_ssl (double elapsed_time_ssl)
     return fperfdata ("time_ssl", elapsed_time_ssl, "s", FALSE, 0, FALSE, 0, FALSE, 0, FALSE, 0);
 }
 
+char *perfd_time_tls (double elapsed_time)
+{
+    return fperfdata ("time_tls", elapsed_time, "s", FALSE, 0, FALSE, 0, FALSE, 0, FALSE, 0);
+}
+
+char *perfd_tls_resumed (int resumed)
+{
+    return perfdata ("tls_resumed", resumed, "", FALSE, 0, FALSE, 0, TRUE, 0, TRUE, 1);
+}
+
 char *perfd_time_headers (double elapsed_time_headers)
 {
     return fperfdata ("time_headers", elapsed_time_headers, "s", FALSE, 0, FALSE, 0, FALSE, 0, FALSE, 0);
@@ -1828,6 +1864,9 @@ print_help (void)
     printf (" %s\n", "--verify-host");
     printf ("    %s\n", _("Verify SSL certificate is for the -H hostname (with --sni and -S)"));
 #endif
+    printf (" %s\n", "--tls-resume");
+    printf ("    %s\n", _("Keep the TLS session in the state directory and resume it on the next check"));
+    printf ("    %s\n", _("of the same host and port. Adds tls_resumed and handshake time perfdata"));
     printf (" %s\n", "-C, --certificate=INTEGER[,INTEGER]");
     printf ("    %s\n", _("Minimum number of days a certificate has to be valid. Port defaults to 443"));
     printf ("    %s\n", _("(When this option is used the URL is not checked by default. You can use"));
@@ -1975,9 +2014,9 @@ print_usage (void)
 
 #if OPENSSL_VERSION_NUMBER >= 0x10002000L
     printf ("       [-A string] [-k string] [-S <version>] [--sni] [--verify-host]\n");
-    printf ("       [-C <warn_age>[,<crit_age>]] [-T <content-type>] [-j method]\n");
+    printf ("       [--tls-resume] [-C <warn_age>[,<crit_age>]] [-T <content-type>] [-j method]\n");
 #else
     printf ("       [-A string] [-k string] [-S <version>] [--sni] [-C <warn_age>[,<crit_age>]]\n");
-    printf ("       [-T <content-type>] [-j method]\n");
+    printf ("       [--tls-resume] [-T <content-type>] [-j method]\n");
 #endif
 }
@@ -50,12 +50,15 @@ enum {
 int process_arguments (int, char **);
 int validate_arguments (void);
 int ldap_check_cert (LDAP *ld);
+int check_replicas (void);
 void print_help (void);
 void print_usage (void);
 
 char ld_defattr[] = "(objectclass=*)";
 char *ld_attr = ld_defattr;
 char *ld_uri = NULL;
+char **ld_uris = NULL;
+int ld_uri_count = 0;
 char *ld_host = NULL;
 char *ld_base = NULL;
 char *ld_passwd = NULL;
@@ -73,6 +76,10 @@ thresholds *entries_thresholds = NULL;
 struct timeval tv;
 char* warn_entries = NULL;
 char* crit_entries = NULL;
+int compare_replicas = FALSE;
+thresholds *lag_thresholds = NULL;
+char *warn_lag = NULL;
+char *crit_lag = NULL;
 int starttls = FALSE;
 int ssl_on_connect = FALSE;
 int verbose = 0;
@@ -131,6 +138,11 @@ main (int argc, char *argv[])
 	/* set socket timeout */
 	alarm (timeout_interval);
 
+#ifdef HAVE_LDAP_INITIALIZE
+	if (ld_uri_count > 1)
+		return check_replicas ();
+#endif
+
 	/* get the start time */
 	gettimeofday (&tv, NULL);
 
@@ -301,6 +313,374 @@ main (int argc, char *argv[])
 	return status;
 }
 
+#ifdef HAVE_LDAP_INITIALIZE
+/* one directory server of a multi-URI check */
+typedef struct ldap_replica {
+	char *uri;
+	LDAP *ld;
+	int phase;
+	int bind_id;
+	int search_id;            /* entry count search, -1 if not used */
+	int csn_id;               /* contextCSN read, -1 if not used */
+	struct timeval start;
+	double time;
+	int entries;
+	int csn_count;
+	int *csn_sid;             /* serverID and time of each contextCSN value */
+	double *csn_time;
+	double lag;
+	int status;
+	int failed;
+	char *message;
+} ldap_replica;
+
+#define REPLICA_BIND 0
+#define REPLICA_SEARCH 1
+#define REPLICA_DONE 2
+
+static void
+replica_fail (ldap_replica *r, const char *what, int rc)
+{
+	xasprintf (&r->message, "%s: %s", what, ldap_err2string (rc));
+	r->status = STATE_CRITICAL;
+	r->failed = TRUE;
+	r->phase = REPLICA_DONE;
+}
+
+/* contextCSN is YYYYmmddHHMMSS.ffffffZ#count#sid#mod, keep time and sid */
+static void
+replica_read_csn (ldap_replica *r, LDAPMessage *entry)
+{
+	struct berval **values;
+	struct tm stamp;
+	double fraction;
+	char *sid;
+	int i, n;
+
+	if ((values = ldap_get_values_len (r->ld, entry, "contextCSN")) == NULL)
+		return;
+	n = ldap_count_values_len (values);
+	r->csn_sid = malloc (sizeof (int) * n);
+	r->csn_time = malloc (sizeof (double) * n);
+	if (r->csn_sid == NULL || r->csn_time == NULL)
+		die (STATE_UNKNOWN, _("Could not allocate memory\n"));
+	for (i = 0; i < n; i++) {
+		char csn[64];
+		snprintf (csn, sizeof (csn), "%.*s", (int) values[i]->bv_len, values[i]->bv_val);
+		memset (&stamp, 0, sizeof (stamp));
+		fraction = 0;
+		if (sscanf (csn, "%4d%2d%2d%2d%2d%2d%lf", &stamp.tm_year, &stamp.tm_mon,
+		            &stamp.tm_mday, &stamp.tm_hour, &stamp.tm_min, &stamp.tm_sec,
+		            &fraction) < 6)
+			continue;
+		stamp.tm_year -= 1900;
+		stamp.tm_mon--;
+		/* the sid is the third #-separated field */
+		if ((sid = strchr (csn, '#')) == NULL || (sid = strchr (sid + 1, '#')) == NULL)
+			continue;
+		r->csn_sid[r->csn_count] = strtol (sid + 1, NULL, 16);
+		r->csn_time[r->csn_count] = (double) timegm (&stamp) + fraction;
+		r->csn_count++;
+	}
+	ldap_value_free_len (values);
+}
+
+static void
+replica_start (ldap_replica *r)
+{
+	struct berval cred;
+	struct timeval timeout;
+	int rc;
+
+	gettimeofday (&r->start, NULL);
+	r->phase = REPLICA_BIND;
+	r->search_id = r->csn_id = -1;
+
+	if ((rc = ldap_initialize (&r->ld, r->uri)) != LDAP_SUCCESS) {
+		replica_fail (r, _("Could not initialize"), rc);
+		return;
+	}
+#ifdef HAVE_LDAP_SET_OPTION
+	ldap_set_option (r->ld, LDAP_OPT_PROTOCOL_VERSION, &ld_protocol);
+	timeout.tv_sec = timeout_interval;
+	timeout.tv_usec = 0;
+	ldap_set_option (r->ld, LDAP_OPT_NETWORK_TIMEOUT, &timeout);
+#ifdef LDAP_OPT_CONNECT_ASYNC
+	/* let all servers connect at the same time */
+	ldap_set_option (r->ld, LDAP_OPT_CONNECT_ASYNC, LDAP_OPT_ON);
+#endif
+#endif
+
+	if (ssl_on_connect) {
+#if defined(HAVE_LDAP_SET_OPTION) && defined(LDAP_OPT_X_TLS)
+		int tls = LDAP_OPT_X_TLS_HARD;
+		if ((rc = ldap_set_option (r->ld, LDAP_OPT_X_TLS, &tls)) != LDAP_SUCCESS) {
+			replica_fail (r, _("Could not init TLS"), rc);
+			return;
+		}
+#else
+		replica_fail (r, _("TLS not supported by the libraries"), LDAP_NOT_SUPPORTED);
+		return;
+#endif
+	} else if (starttls) {
+#ifdef HAVE_LDAP_START_TLS_S
+		if ((rc = ldap_start_tls_s (r->ld, NULL, NULL)) != LDAP_SUCCESS) {
+			replica_fail (r, _("Could not init startTLS"), rc);
+			return;
+		}
+#else
+		replica_fail (r, _("startTLS not supported by the library"), LDAP_NOT_SUPPORTED);
+		return;
+#endif
+	}
+
+	cred.bv_val = ld_passwd;
+	cred.bv_len = ld_passwd ? strlen (ld_passwd) : 0;
+	rc = ldap_sasl_bind (r->ld, ld_binddn, LDAP_SASL_SIMPLE, &cred, NULL, NULL, &r->bind_id);
+	if (rc != LDAP_SUCCESS)
+		replica_fail (r, _("Could not bind"), rc);
+}
+
+/* the bind went through, send the searches */
+static void
+replica_search (ldap_replica *r)
+{
+	char *csn_attrs[] = { "contextCSN", NULL };
+	char *no_attrs[] = { LDAP_NO_ATTRS, NULL };
+	int rc;
+
+	r->phase = REPLICA_SEARCH;
+	if (entries_thresholds != NULL || compare_replicas) {
+		rc = ldap_search_ext (r->ld, ld_base, LDAP_SCOPE_SUBTREE, ld_attr, no_attrs, 0,
+		                      NULL, NULL, NULL, 0, &r->search_id);
+		if (rc != LDAP_SUCCESS) {
+			replica_fail (r, _("Could not search"), rc);
+			return;
+		}
+	}
+	if (entries_thresholds == NULL || compare_replicas) {
+		rc = ldap_search_ext (r->ld, ld_base, LDAP_SCOPE_BASE,
+		                      compare_replicas ? ld_defattr : ld_attr,
+		                      compare_replicas ? csn_attrs : no_attrs, 0,
+		                      NULL, NULL, NULL, 0, &r->csn_id);
+		if (rc != LDAP_SUCCESS)
+			replica_fail (r, _("Could not search"), rc);
+	}
+}
+
+/* handle one complete response of a replica */
+static void
+replica_result (ldap_replica *r, LDAPMessage *res)
+{
+	int msgid = ldap_msgid (res);
+	int rc = LDAP_SUCCESS;
+	LDAPMessage *entry;
+
+	if (ldap_parse_result (r->ld, res, &rc, NULL, NULL, NULL, NULL, 0) != LDAP_SUCCESS)
+		rc = LDAP_DECODING_ERROR;
+
+	if (msgid == r->bind_id) {
+		if (rc != LDAP_SUCCESS)
+			replica_fail (r, _("Could not bind"), rc);
+		else
+			replica_search (r);
+	} else if (msgid == r->search_id) {
+		if (rc != LDAP_SUCCESS)
+			replica_fail (r, _("Could not search"), rc);
+		else
+			r->entries = ldap_count_entries (r->ld, res);
+		r->search_id = -1;
+	} else if (msgid == r->csn_id) {
+		if (rc != LDAP_SUCCESS)
+			replica_fail (r, _("Could not search"), rc);
+		else if (compare_replicas && (entry = ldap_first_entry (r->ld, res)) != NULL)
+			replica_read_csn (r, entry);
+		r->csn_id = -1;
+	}
+
+	if (r->phase == REPLICA_SEARCH && r->search_id == -1 && r->csn_id == -1) {
+		r->time = (double) deltime (r->start) / 1.0e6;
+		r->phase = REPLICA_DONE;
+	}
+}
+
+/* replication lag of each replica against the newest change of every serverID */
+static void
+replica_lag (ldap_replica *replicas, int count)
+{
+	int i, j, k, l, found;
+	double newest;
+
+	for (i = 0; i < count; i++) {
+		for (j = 0; j < replicas[i].csn_count; j++) {
+			newest = replicas[i].csn_time[j];
+			for (k = 0; k < count; k++)
+				for (l = 0; l < replicas[k].csn_count; l++)
+					if (replicas[k].csn_sid[l] == replicas[i].csn_sid[j] &&
+					    replicas[k].csn_time[l] > newest)
+						newest = replicas[k].csn_time[l];
+			if (newest - replicas[i].csn_time[j] > replicas[i].lag)
+				replicas[i].lag = newest - replicas[i].csn_time[j];
+		}
+		/* a serverID missing from a replica has never been replicated there */
+		for (k = 0; k < count; k++)
+			for (l = 0; l < replicas[k].csn_count; l++) {
+				found = FALSE;
+				for (j = 0; j < replicas[i].csn_count; j++)
+					if (replicas[i].csn_sid[j] == replicas[k].csn_sid[l])
+						found = TRUE;
+				if (!found && !replicas[i].failed && !replicas[i].message) {
+					xasprintf (&replicas[i].message, _("no contextCSN of serverID %03x"),
+					           replicas[k].csn_sid[l]);
+					replicas[i].status = max_state (replicas[i].status, STATE_WARNING);
+				}
+			}
+	}
+}
+
+/* several -U: bind and search on all servers at once and compare them */
+int
+check_replicas (void)
+{
+	ldap_replica *replicas;
+	LDAPMessage *res;
+	struct pollfd *pfd;
+	struct timeval zero = { 0, 0 }, start;
+	char *perf = NULL, *label;
+	int i, rc, fd, nfd, running, ok = 0, status = STATE_OK;
+	int entries_min = -1, entries_max = -1;
+	double time_max = 0, lag_max = 0;
+
+	replicas = calloc (ld_uri_count, sizeof (ldap_replica));
+	pfd = calloc (ld_uri_count, sizeof (struct pollfd));
+	if (replicas == NULL || pfd == NULL)
+		die (STATE_UNKNOWN, _("Could not allocate memory\n"));
+
+	gettimeofday (&start, NULL);
+	for (i = 0; i < ld_uri_count; i++) {
+		replicas[i].uri = ld_uris[i];
+		replica_start (&replicas[i]);
+	}
+
+	while (1) {
+		running = nfd = 0;
+		for (i = 0; i < ld_uri_count; i++) {
+			if (replicas[i].phase == REPLICA_DONE)
+				continue;
+			running++;
+			if (ldap_get_option (replicas[i].ld, LDAP_OPT_DESC, &fd) == LDAP_OPT_SUCCESS && fd >= 0) {
+				pfd[nfd].fd = fd;
+				pfd[nfd].events = POLLIN;
+				nfd++;
+			}
+		}
+		if (running == 0)
+			break;
+		/* stop short of the alarm, so the servers that answered are reported */
+		if (deltime (start) >= timeout_interval * 1000000L - 500000L) {
+			for (i = 0; i < ld_uri_count; i++)
+				if (replicas[i].phase != REPLICA_DONE)
+					replica_fail (&replicas[i], _("No answer"), LDAP_TIMEOUT);
+			break;
+		}
+
+		/* a connection still being set up has no descriptor yet, so never block long */
+		poll (pfd, nfd, 100);
+
+		for (i = 0; i < ld_uri_count; i++) {
+			ldap_replica *r = &replicas[i];
+			while (r->phase != REPLICA_DONE &&
+			       (rc = ldap_result (r->ld, LDAP_RES_ANY, LDAP_MSG_ALL, &zero, &res)) != 0) {
+				if (rc == -1) {
+					ldap_get_option (r->ld, LDAP_OPT_RESULT_CODE, &rc);
+					replica_fail (r, _("Connection failed"), rc);
+					break;
+				}
+				replica_result (r, res);
+				ldap_msgfree (res);
+			}
+		}
+	}
+
+	if (compare_replicas)
+		replica_lag (replicas, ld_uri_count);
+
+	for (i = 0; i < ld_uri_count; i++) {
+		ldap_replica *r = &replicas[i];
+		if (r->ld)
+			ldap_unbind_ext (r->ld, NULL, NULL);
+		if (!r->failed) {
+			if (crit_time != UNDEFINED && r->time > crit_time)
+				r->status = max_state (r->status, STATE_CRITICAL);
+			else if (warn_time != UNDEFINED && r->time > warn_time)
+				r->status = max_state (r->status, STATE_WARNING);
+			if (entries_thresholds != NULL)
+				r->status = max_state (r->status, get_status (r->entries, entries_thresholds));
+			if (lag_thresholds != NULL)
+				r->status = max_state (r->status, get_status (r->lag, lag_thresholds));
+
+			if (r->time > time_max)
+				time_max = r->time;
+			if (r->lag > lag_max)
+				lag_max = r->lag;
+			if (entries_min == -1 || r->entries < entries_min)
+				entries_min = r->entries;
+			if (r->entries > entries_max)
+				entries_max = r->entries;
+		}
+		if (r->status == STATE_OK)
+			ok++;
+		status = max_state (status, r->status);
+		if (r->failed)
+			continue;
+
+		/* perfdata labels without the scheme of the URI */
+		label = strstr (r->uri, "://") ? strstr (r->uri, "://") + 3 : r->uri;
+		xasprintf (&label, "time_%.*s", (int) strcspn (label, "/"), label);
+		xasprintf (&perf, "%s %s", perf ? perf : "",
+		           fperfdata (label, r->time, "s",
+		                      (int)warn_time, warn_time, (int)crit_time, crit_time,
+		                      TRUE, 0, FALSE, 0));
+	}
+
+	printf (_("LDAP %s - %d of %d servers OK, slowest %.3f seconds"),
+	        state_text (status), ok, ld_uri_count, time_max);
+	/* without an answer there is nothing to compare */
+	if (compare_replicas && entries_min >= 0)
+		printf (_(", contextCSN lag %.0f seconds, %d to %d entries"),
+		        lag_max, entries_min, entries_max);
+	printf ("|%s", perfdata ("servers_ok", ok, "", FALSE, 0, FALSE, 0,
+	                         TRUE, 0, TRUE, ld_uri_count));
+	if (compare_replicas && entries_min >= 0)
+		printf (" %s %s",
+		        sperfdata ("lag", lag_max, "s", warn_lag, crit_lag, TRUE, 0, FALSE, 0),
+		        perfdata ("entries_diff", entries_max - entries_min, "",
+		                  FALSE, 0, FALSE, 0, TRUE, 0, FALSE, 0));
+	printf ("%s\n", perf ? perf : "");
+
+	for (i = 0; i < ld_uri_count; i++) {
+		ldap_replica *r = &replicas[i];
+		if (r->status == STATE_OK && !verbose)
+			continue;
+		printf ("%s %s - ", r->uri, state_text (r->status));
+		if (r->failed)
+			printf ("%s\n", r->message);
+		else {
+			printf (_("%.3f seconds"), r->time);
+			if (entries_thresholds != NULL || compare_replicas)
+				printf (_(", %d entries"), r->entries);
+			if (compare_replicas)
+				printf (_(", contextCSN lag %.0f seconds"), r->lag);
+			if (r->message)
+				printf (", %s", r->message);
+			putchar ('\n');
+		}
+	}
+
+	return status;
+}
+#endif /* HAVE_LDAP_INITIALIZE */
+
 /* process command-line arguments */
 int
 process_arguments (int argc, char **argv)
@@ -308,6 +688,12 @@ process_arguments (int argc, char **argv)
 	int c;
 	char *temp;
 
+	enum {
+		COMPARE_OPTION = CHAR_MAX + 1,
+		WARN_LAG_OPTION,
+		CRIT_LAG_OPTION
+	};
+
 	int option = 0;
 	/* initialize the long option struct */
 	static struct option longopts[] = {
@@ -335,6 +721,9 @@ process_arguments (int argc, char **argv)
 		{"warn-entries", required_argument, 0, 'W'},
 		{"crit-entries", required_argument, 0, 'C'},
 		{"verbose", no_argument, 0, 'v'},
+		{"compare", no_argument, 0, COMPARE_OPTION},
+		{"warn-lag", required_argument, 0, WARN_LAG_OPTION},
+		{"crit-lag", required_argument, 0, CRIT_LAG_OPTION},
 		{0, 0, 0, 0}
 	};
 
@@ -362,8 +751,12 @@ process_arguments (int argc, char **argv)
 		case 't':									/* timeout period */
 			timeout_interval = parse_timeout_string(optarg);
 			break;
-		case 'U':
+		case 'U': /* may be repeated to check several servers at once */
 			ld_uri = optarg;
+			ld_uris = realloc (ld_uris, sizeof (char *) * (ld_uri_count + 1));
+			if (ld_uris == NULL)
+				die (STATE_UNKNOWN, _("Could not allocate memory\n"));
+			ld_uris[ld_uri_count++] = optarg;
 			break;
 		case 'H':
 			ld_host = optarg;
@@ -395,6 +788,17 @@ process_arguments (int argc, char **argv)
 		case 'C':
 			crit_entries = optarg;
 			break;
+		case COMPARE_OPTION:
+			compare_replicas = TRUE;
+			break;
+		case WARN_LAG_OPTION:
+			warn_lag = optarg;
+			compare_replicas = TRUE;
+			break;
+		case CRIT_LAG_OPTION:
+			crit_lag = optarg;
+			compare_replicas = TRUE;
+			break;
 #ifdef HAVE_LDAP_SET_OPTION
 		case '2':
 			ld_protocol = 2;
@@ -490,6 +894,14 @@ validate_arguments ()
 		set_thresholds(&entries_thresholds,
 			warn_entries, crit_entries);
 	}
+
+	if (ld_uri_count > 1) {
+		if (check_cert)
+			usage_va(_("%s cannot be combined with several %s"), "-A/--age", "-U/--uri");
+		if (warn_lag != NULL || crit_lag != NULL)
+			set_thresholds(&lag_thresholds, warn_lag, crit_lag);
+	} else if (compare_replicas)
+		usage4 (_("--compare needs at least two -U/--uri"));
 	return OK;
 }
 
@@ -545,6 +957,12 @@ print_help (void)
   printf ("    %s\n", _("Number of found entries to result in warning status"));
   printf (" %s\n", "-C, --crit-entries=INTEGER");
   printf ("    %s\n", _("Number of found entries to result in critical status"));
+  printf (" %s\n", "--compare");
+  printf ("    %s\n", _("With several -U, compare contextCSN and entry counts of the servers"));
+  printf (" %s\n", "--warn-lag=SECONDS");
+  printf ("    %s\n", _("contextCSN replication lag to result in warning status (implies --compare)"));
+  printf (" %s\n", "--crit-lag=SECONDS");
+  printf ("    %s\n", _("contextCSN replication lag to result in critical status (implies --compare)"));
 
 	printf (UT_CONN_TIMEOUT, DEFAULT_SOCKET_TIMEOUT);
 
@@ -558,6 +976,10 @@ print_help (void)
 	printf (" %s\n", _("This detection is deprecated, please use 'check_ldap' with the '--starttls' or '--ssl' flags"));
 	printf (" %s\n", _("to define the behaviour explicitly instead."));
 	printf (" %s\n", _("The parameters --warn-entries and --crit-entries are optional."));
+	printf ("\n");
+	printf (" %s\n", _("-U can be given several times, e.g. once per replica. All servers are then"));
+	printf (" %s\n", _("bound and searched at the same time, each one within the timeout, and"));
+	printf (" %s\n", _("-w/-c and the entry thresholds apply to every server."));
 
 	printf (UT_SUPPORT);
 }
@@ -567,7 +989,8 @@ print_usage (void)
 {
   printf ("%s\n", _("Usage:"));
   printf (" %s (-H <host>|-U <uri>) -b <base_dn> [-p <port>] [-a <attr>] [-D <binddn>]\n", progname);
-  printf ("       [-P <password>] [-w <warn_time>] [-c <crit_time>] [-t timeout] [-A <age>]%s\n",
+  printf ("       [-P <password>] [-w <warn_time>] [-c <crit_time>] [-t timeout] [-A <age>]\n");
+  printf ("       [-U <uri> ...] [--compare] [--warn-lag <secs>] [--crit-lag <secs>]%s\n",
 #ifdef HAVE_LDAP_SET_OPTION
 			"\n       [-2|-3] [-4|-6]"
 #else
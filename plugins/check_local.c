@@ -0,0 +1,1064 @@
+/*****************************************************************************
+*
+* Nagios check_local plugin
+*
+* License: GPL
+* Copyright (c) 2014 Nagios Plugins Development Team
+*
+* Description:
+*
+* This file contains the check_local plugin
+*
+* Runs many load, swap, users, uptime, procs and disk checks in one process.
+* The system is looked at once: one read of each /proc file, one scan of
+* the process table, one read of utmp and one pass over the mount table.
+* Each check definition is a section of an ini file and is evaluated
+* against that snapshot.
+*
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*
+*****************************************************************************/
+
+const char *progname = "check_local";
+const char *copyright = "2014";
+const char *email = "devel@nagios-plugins.org";
+
+#include "common.h"
+#include "utils.h"
+#include "utils_base.h"
+#include "utils_disk.h"
+#include "utils_proc.h"
+#include "utils_regex.h"
+#include "utils_str.h"
+#include "parse_ini.h"
+#include "fsusage.h"
+#include "mountlist.h"
+
+#include <pwd.h>
+#include "utils_utmp.h"
+
+typedef struct local_check local_check;
+
+struct local_check {
+	char *name;					/* the ini section */
+	const char *label;
+	int argc;
+	char **argv;
+	int result;
+	np_str text;
+	np_str perf;
+	local_check *next;
+};
+
+int process_arguments (int, char **);
+void print_help (void);
+void print_usage (void);
+
+static int run_load (local_check *);
+static int run_swap (local_check *);
+static int run_users (local_check *);
+static int run_uptime (local_check *);
+static int run_procs (local_check *);
+static int run_disk (local_check *);
+
+static const struct {
+	const char *plugin;
+	const char *label;
+	int (*run) (local_check *);
+} check_types[] = {
+	{ "load", "LOAD", run_load },
+	{ "swap", "SWAP", run_swap },
+	{ "users", "USERS", run_users },
+	{ "uptime", "UPTIME", run_uptime },
+	{ "procs", "PROCS", run_procs },
+	{ "disk", "DISK", run_disk },
+	{ NULL, NULL, NULL }
+};
+
+/* what a mounted file system looked like, statvfs'd at most once */
+typedef struct mount_usage {
+	struct mount_entry *me;
+	struct fs_usage fsu;
+	int state;					/* 0 not read yet, OK or ERROR */
+} mount_usage;
+
+/* everything the checks look at, each part read once and only if a
+ * definition needs it */
+static struct {
+	int have_load, have_swap, have_uptime, have_users, have_procs, have_mounts;
+	int load_ok, swap_ok, uptime_ok, users_ok;
+	double load[3];
+	double swap_total_mb, swap_free_mb;
+	double uptime;
+	int users;
+	np_proc_entry *procs;
+	size_t nprocs;
+	struct mount_entry *mount_list;
+	mount_usage *mounts;
+	size_t nmounts;
+} snapshot;
+
+char *ini_file = NULL;
+struct name_list *check_names = NULL;
+int verbose = 0;
+
+
+int
+main (int argc, char **argv)
+{
+	local_check *checks = NULL, *c;
+	np_arg_list *args, *next;
+	struct name_list *n;
+	char *locator;
+	int i, result = STATE_OK;
+
+	setlocale (LC_ALL, "");
+	bindtextdomain (PACKAGE, LOCALEDIR);
+	textdomain (PACKAGE);
+	setlocale (LC_NUMERIC, "POSIX");
+
+	/* Parse extra opts if any */
+	argv = np_extra_opts (&argc, argv, progname);
+
+	if (process_arguments (argc, argv) == ERROR)
+		usage4 (_("Could not parse arguments"));
+
+	/* Set signal handling and alarm timeout */
+	if (signal (SIGALRM, timeout_alarm_handler) == SIG_ERR)
+		die (STATE_UNKNOWN, _("Cannot catch SIGALRM"));
+	alarm (timeout_interval);
+
+	/* without --check, the [check_local] section lists the definitions */
+	if (check_names == NULL) {
+		xasprintf (&locator, "%s@%s", progname, ini_file);
+		for (args = np_get_defaults (locator, progname); args; args = next) {
+			next = args->next;
+			/* np_add_name keeps the pointer, so the string stays */
+			if (strncmp (args->arg, "--check=", 8) == 0)
+				np_add_name (&check_names, args->arg + 8);
+			else
+				free (args->arg);
+			free (args);
+		}
+		free (locator);
+		if (check_names == NULL)
+			die (STATE_UNKNOWN, _("No check definitions in [%s] of %s\n"), progname, ini_file);
+	}
+
+	/* np_add_name prepends, so the list is in reverse order */
+	for (n = check_names; n; n = n->next) {
+		c = calloc (1, sizeof (local_check));
+		if (c == NULL)
+			die (STATE_UNKNOWN, _("Insufficient memory\n"));
+		c->name = (char *) n->name;
+		c->next = checks;
+		checks = c;
+	}
+	for (c = checks; c; c = c->next) {
+		const char *plugin = NULL;
+
+		/* the section is indexed after the first lookup, so this is cheap */
+		xasprintf (&locator, "%s@%s", c->name, ini_file);
+		args = np_get_defaults (locator, c->name);
+		free (locator);
+
+		c->argv = malloc (sizeof (char *) * 2);
+		c->argv[c->argc++] = c->name;
+		for (; args; args = next) {
+			next = args->next;
+			if (strncmp (args->arg, "--plugin=", 9) == 0)
+				plugin = args->arg + 9;
+			else {
+				c->argv = realloc (c->argv, sizeof (char *) * (c->argc + 2));
+				c->argv[c->argc++] = args->arg;
+			}
+			free (args);
+		}
+		c->argv[c->argc] = NULL;
+
+		if (plugin && strncmp (plugin, "check_", 6) == 0)
+			plugin += 6;
+		for (i = 0; plugin && check_types[i].plugin; i++)
+			if (strcmp (plugin, check_types[i].plugin) == 0)
+				break;
+
+		if (plugin == NULL || check_types[i].plugin == NULL) {
+			c->label = "LOCAL";
+			c->result = STATE_UNKNOWN;
+			np_str_addf (&c->text, _("Unknown or missing plugin '%s'"), plugin ? plugin : "");
+		} else {
+			c->label = check_types[i].label;
+			if (verbose >= 2)
+				printf ("%s: %s with %d arguments\n", c->name, check_types[i].plugin, c->argc - 1);
+			/* every definition parses its own argument vector */
+			optind = 0;
+			opterr = 0;
+			c->result = check_types[i].run (c);
+		}
+		result = max_state_alt (result, c->result);
+	}
+
+	for (c = checks; c; c = c->next)
+		printf ("%s %s %s - %s%s%s\n", c->name, c->label, state_text (c->result),
+		        np_str_get (&c->text), c->perf.len ? "|" : "", np_str_get (&c->perf));
+
+	return result;
+}
+
+
+
+/* the snapshot, gathered on first use */
+
+static int
+get_load (void)
+{
+	if (!snapshot.have_load) {
+		snapshot.have_load = TRUE;
+		snapshot.load_ok = np_proc_loadavg (snapshot.load) == OK;
+	}
+	return snapshot.load_ok;
+}
+
+static int
+get_swap (void)
+{
+	if (!snapshot.have_swap) {
+		snapshot.have_swap = TRUE;
+		snapshot.swap_ok = np_swap_summary (&snapshot.swap_total_mb, &snapshot.swap_free_mb) == OK;
+	}
+	return snapshot.swap_ok;
+}
+
+static int
+get_uptime (void)
+{
+	if (!snapshot.have_uptime) {
+		snapshot.have_uptime = TRUE;
+		snapshot.uptime_ok = np_proc_uptime (&snapshot.uptime) == OK;
+	}
+	return snapshot.uptime_ok;
+}
+
+static int
+get_users (void)
+{
+#ifdef HAVE_UTMPX_H
+	struct utmpx *putmpx;
+	np_utmp utmp;
+	size_t i;
+
+	if (!snapshot.have_users) {
+		snapshot.have_users = TRUE;
+		snapshot.users_ok = TRUE;
+		if (np_utmp_open (&utmp, UTMPX_FILE, 0, 0) == OK) {
+			for (i = 0; i < utmp.count; i++)
+				if (utmp.records[i].ut_type == USER_PROCESS)
+					snapshot.users++;
+			np_utmp_close (&utmp);
+		} else {
+			setutxent ();
+			while ((putmpx = getutxent ()) != NULL)
+				if (putmpx->ut_type == USER_PROCESS)
+					snapshot.users++;
+			endutxent ();
+		}
+	}
+#endif
+	return snapshot.users_ok;
+}
+
+static int
+get_procs (void)
+{
+	if (!snapshot.have_procs) {
+		snapshot.have_procs = TRUE;
+		snapshot.procs = np_proc_scan (&snapshot.nprocs);
+		if (verbose >= 2)
+			printf (_("Scanned %lu processes\n"), (unsigned long) snapshot.nprocs);
+	}
+	return snapshot.procs != NULL;
+}
+
+static int
+get_mounts (void)
+{
+	struct mount_entry *me;
+	size_t i = 0;
+
+	if (!snapshot.have_mounts) {
+		snapshot.have_mounts = TRUE;
+		snapshot.mount_list = read_file_system_list (0);
+		for (me = snapshot.mount_list; me; me = me->me_next)
+			snapshot.nmounts++;
+		snapshot.mounts = calloc (snapshot.nmounts + 1, sizeof (mount_usage));
+		for (me = snapshot.mount_list; me; me = me->me_next)
+			snapshot.mounts[i++].me = me;
+	}
+	return snapshot.nmounts > 0;
+}
+
+static struct fs_usage *
+get_usage (mount_usage *m)
+{
+	if (m->state == 0)
+		m->state = get_fs_usage (m->me->me_mountdir, m->me->me_devname, &m->fsu) == 0 ? OK : ERROR;
+	return m->state == OK ? &m->fsu : NULL;
+}
+
+
+
+/* warning and critical thresholds of a definition, as ranges */
+static int
+range_thresholds (local_check *c, thresholds **t, char *warning, char *critical)
+{
+	if (_set_thresholds (t, warning, critical) != 0) {
+		np_str_add (&c->text, _("Invalid threshold"));
+		return ERROR;
+	}
+	return OK;
+}
+
+static int
+invalid_option (local_check *c)
+{
+	np_str_addf (&c->text, _("Invalid option %s"), c->argv[optind - 1]);
+	return STATE_UNKNOWN;
+}
+
+
+/* check_load: -w/-c as one or three load averages, -r per CPU */
+static void
+load_triplet (const char *arg, double *th)
+{
+	char *p;
+	int i;
+
+	for (i = 0; i < 3; i++) {
+		th[i] = strtod (arg, &p);
+		if (p == arg || *p != ',')
+			break;
+		arg = p + 1;
+	}
+	/* fewer than three values repeat the last one */
+	for (i++; i < 3; i++)
+		th[i] = th[i - 1];
+}
+
+static int
+run_load (local_check *c)
+{
+	static const int nums[3] = { 1, 5, 15 };
+	static struct option longopts[] = {
+		{"warning", required_argument, 0, 'w'},
+		{"critical", required_argument, 0, 'c'},
+		{"percpu", no_argument, 0, 'r'},
+		{0, 0, 0, 0}
+	};
+	double wload[3] = { 0, 0, 0 }, cload[3] = { 0, 0, 0 }, la[3];
+	long numcpus;
+	int opt, i, percpu = FALSE, have_warn = FALSE, have_crit = FALSE, result = STATE_OK;
+
+	while ((opt = getopt_long (c->argc, c->argv, "w:c:r", longopts, NULL)) != -1) {
+		switch (opt) {
+		case 'w':
+			load_triplet (optarg, wload);
+			have_warn = TRUE;
+			break;
+		case 'c':
+			load_triplet (optarg, cload);
+			have_crit = TRUE;
+			break;
+		case 'r':
+			percpu = TRUE;
+			break;
+		default:
+			return invalid_option (c);
+		}
+	}
+	if (!have_warn || !have_crit) {
+		np_str_add (&c->text, _("Warning and critical thresholds are required"));
+		return STATE_UNKNOWN;
+	}
+
+	if (!get_load ()) {
+		np_str_add (&c->text, _("Could not read the load average"));
+		return STATE_UNKNOWN;
+	}
+	memcpy (la, snapshot.load, sizeof (la));
+	if (percpu && (numcpus = GET_NUMBER_OF_CPUS ()) > 0)
+		for (i = 0; i < 3; i++)
+			la[i] /= numcpus;
+
+	np_str_addf (&c->text, percpu ? _("load average per CPU: %.2f, %.2f, %.2f") : _("load average: %.2f, %.2f, %.2f"),
+	             la[0], la[1], la[2]);
+	for (i = 0; i < 3; i++) {
+		if (la[i] > cload[i])
+			result = STATE_CRITICAL;
+		else if (la[i] > wload[i])
+			result = max_state (result, STATE_WARNING);
+		np_str_addf (&c->perf, "%sload%d=%.3f;%.3f;%.3f;0;", i ? " " : "", nums[i], la[i], wload[i], cload[i]);
+	}
+	return result;
+}
+
+
+/* check_swap: -w/-c as bytes free or PERCENT% free, -n state without swap */
+static int
+swap_threshold (const char *arg, double *bytes, int *percent)
+{
+	if (is_intnonneg ((char *) arg))
+		*bytes = atof (arg);
+	else if (strchr (arg, '%') && sscanf (arg, "%d%%", percent) == 1)
+		;
+	else
+		return ERROR;
+	return OK;
+}
+
+static int
+run_swap (local_check *c)
+{
+	static struct option longopts[] = {
+		{"warning", required_argument, 0, 'w'},
+		{"critical", required_argument, 0, 'c'},
+		{"no-swap", required_argument, 0, 'n'},
+		{0, 0, 0, 0}
+	};
+	double warn_bytes = 0, crit_bytes = 0, free_bytes, total_mb, free_mb;
+	int warn_percent = 0, crit_percent = 0, no_swap_state = STATE_CRITICAL;
+	int opt, percent_used, result = STATE_OK;
+
+	while ((opt = getopt_long (c->argc, c->argv, "w:c:n:", longopts, NULL)) != -1) {
+		switch (opt) {
+		case 'w':
+			if (swap_threshold (optarg, &warn_bytes, &warn_percent) == ERROR)
+				return invalid_option (c);
+			break;
+		case 'c':
+			if (swap_threshold (optarg, &crit_bytes, &crit_percent) == ERROR)
+				return invalid_option (c);
+			break;
+		case 'n':
+			if ((no_swap_state = translate_state (optarg)) == ERROR)
+				return invalid_option (c);
+			break;
+		default:
+			return invalid_option (c);
+		}
+	}
+
+	if (!get_swap ()) {
+		np_str_add (&c->text, _("Could not read the swap usage"));
+		return STATE_UNKNOWN;
+	}
+	total_mb = snapshot.swap_total_mb;
+	free_mb = snapshot.swap_free_mb;
+	free_bytes = free_mb * 1024 * 1024;
+	percent_used = total_mb > 0 ? 100 * (total_mb - free_mb) / total_mb : 100;
+
+	/* the same order of tests as check_swap */
+	if (free_mb == 0)
+		result = no_swap_state;
+	else if (crit_percent != 0 && percent_used >= 100 - crit_percent)
+		result = STATE_CRITICAL;
+	else if (crit_bytes > 0 && free_bytes <= crit_bytes)
+		result = STATE_CRITICAL;
+	else if (warn_percent != 0 && percent_used >= 100 - warn_percent)
+		result = STATE_WARNING;
+	else if (warn_bytes > 0 && free_bytes <= warn_bytes)
+		result = STATE_WARNING;
+
+	np_str_addf (&c->text, _("%d%% free (%d MB out of %d MB)"), 100 - percent_used, (int) free_mb, (int) total_mb);
+	if (total_mb == 0)
+		np_str_add (&c->text, _(" - Swap is either disabled, not present, or of zero size."));
+	np_str_perfdata (&c->perf, "swap", (long) free_mb, "MB",
+	                 TRUE, (long) max (warn_bytes / (1024 * 1024), warn_percent / 100.0 * total_mb),
+	                 TRUE, (long) max (crit_bytes / (1024 * 1024), crit_percent / 100.0 * total_mb),
+	                 TRUE, 0, TRUE, (long) total_mb);
+	return result;
+}
+
+
+/* check_users: -w/-c ranges on the number of logged in users */
+static int
+run_users (local_check *c)
+{
+	static struct option longopts[] = {
+		{"warning", required_argument, 0, 'w'},
+		{"critical", required_argument, 0, 'c'},
+		{0, 0, 0, 0}
+	};
+	char *warning = NULL, *critical = NULL;
+	thresholds *thlds = NULL;
+	int opt;
+
+	while ((opt = getopt_long (c->argc, c->argv, "w:c:", longopts, NULL)) != -1) {
+		switch (opt) {
+		case 'w':
+			warning = optarg;
+			break;
+		case 'c':
+			critical = optarg;
+			break;
+		default:
+			return invalid_option (c);
+		}
+	}
+	if (range_thresholds (c, &thlds, warning, critical) == ERROR)
+		return STATE_UNKNOWN;
+
+	if (!get_users ()) {
+		np_str_add (&c->text, _("Could not read utmp"));
+		return STATE_UNKNOWN;
+	}
+	np_str_addf (&c->text, _("%d users currently logged in"), snapshot.users);
+	np_str_sperfdata_int (&c->perf, "users", snapshot.users, "", warning, critical, TRUE, 0, FALSE, 0);
+	return get_status (snapshot.users, thlds);
+}
+
+
+/* check_uptime: -w/-c ranges in the unit given by -u, minutes by default */
+static int
+run_uptime (local_check *c)
+{
+	static struct option longopts[] = {
+		{"warning", required_argument, 0, 'w'},
+		{"critical", required_argument, 0, 'c'},
+		{"timeunit", required_argument, 0, 'u'},
+		{0, 0, 0, 0}
+	};
+	char *warning = NULL, *critical = NULL, *timeunit = "minutes";
+	thresholds *thlds = NULL;
+	double uptime;
+	int opt, seconds;
+
+	while ((opt = getopt_long (c->argc, c->argv, "w:c:u:", longopts, NULL)) != -1) {
+		switch (opt) {
+		case 'w':
+			warning = optarg;
+			break;
+		case 'c':
+			critical = optarg;
+			break;
+		case 'u':
+			timeunit = optarg;
+			break;
+		default:
+			return invalid_option (c);
+		}
+	}
+	if (range_thresholds (c, &thlds, warning, critical) == ERROR)
+		return STATE_UNKNOWN;
+
+	if (!get_uptime ()) {
+		np_str_add (&c->text, _("Could not read the uptime"));
+		return STATE_UNKNOWN;
+	}
+	seconds = (int) snapshot.uptime;
+	if (strcmp (timeunit, "seconds") == 0)
+		uptime = seconds;
+	else if (strcmp (timeunit, "minutes") == 0)
+		uptime = seconds / 60;
+	else if (strcmp (timeunit, "hours") == 0)
+		uptime = seconds / 3600;
+	else if (strcmp (timeunit, "days") == 0)
+		uptime = seconds / 86400;
+	else {
+		np_str_add (&c->text, _("Wrong -u argument, expected: seconds, minutes, hours, or days"));
+		return STATE_UNKNOWN;
+	}
+
+	np_str_addf (&c->text, _("%u day(s) %u hour(s) %u minute(s)"),
+	             seconds / 86400, (seconds % 86400) / 3600, (seconds % 3600) / 60);
+	np_str_sperfdata (&c->perf, "uptime", uptime, "", warning, critical, FALSE, 0, FALSE, 0);
+	return get_status (uptime, thlds);
+}
+
+
+/* check_procs: the same filters and metrics, applied to the process scan */
+enum {
+	METRIC_PROCS,
+	METRIC_VSZ,
+	METRIC_RSS,
+	METRIC_CPU,
+	METRIC_ELAPSED
+};
+
+static int
+run_procs (local_check *c)
+{
+	enum {
+		EREG_ARGS = CHAR_MAX + 1
+	};
+	static struct option longopts[] = {
+		{"warning", required_argument, 0, 'w'},
+		{"critical", required_argument, 0, 'c'},
+		{"metric", required_argument, 0, 'm'},
+		{"state", required_argument, 0, 's'},
+		{"ppid", required_argument, 0, 'p'},
+		{"user", required_argument, 0, 'u'},
+		{"command", required_argument, 0, 'C'},
+		{"argument-array", required_argument, 0, 'a'},
+		{"ereg-argument-array", required_argument, 0, EREG_ARGS},
+		{"rss", required_argument, 0, 'r'},
+		{"vsz", required_argument, 0, 'z'},
+		{"pcpu", required_argument, 0, 'P'},
+		{"no-kthreads", no_argument, 0, 'k'},
+		{"exclude-process", required_argument, 0, 'X'},
+		{0, 0, 0, 0}
+	};
+	static const char *metric_names[] = { "PROCS", "VSZ", "RSS", "CPU", "ELAPSED" };
+	char *warning = NULL, *critical = NULL, *statopts = NULL, *prog = NULL, *args = NULL;
+	struct name_list *exclude = NULL;
+	thresholds *thlds = NULL;
+	np_regex re_args;
+	int have_re = FALSE, have_ppid = FALSE, have_uid = FALSE, kthreads = TRUE;
+	int metric = METRIC_PROCS, opt, err, status, procs = 0, warn = 0, crit = 0;
+	int result = STATE_OK;
+	long vsz = -1, rss = -1;
+	double pcpu = -1, total = 0;
+	pid_t ppid = 0, kthread_ppid = 0, self = getpid (), parent = getppid ();
+	uid_t uid = 0;
+	struct passwd *pw;
+	np_str fmt = NP_STR_INIT;
+	char *word, errbuf[MAX_INPUT_BUFFER];
+	size_t i;
+
+	while ((opt = getopt_long (c->argc, c->argv, "w:c:m:s:p:u:C:a:r:z:P:kX:", longopts, NULL)) != -1) {
+		switch (opt) {
+		case 'w':
+			warning = optarg;
+			break;
+		case 'c':
+			critical = optarg;
+			break;
+		case 'm':
+			for (metric = 0; metric <= METRIC_ELAPSED; metric++)
+				if (strcmp (optarg, metric_names[metric]) == 0)
+					break;
+			if (metric > METRIC_ELAPSED)
+				return invalid_option (c);
+			break;
+		case 's':
+			statopts = optarg;
+			np_str_addf (&fmt, _("%sSTATE = %s"), fmt.len ? " " : "", statopts);
+			break;
+		case 'p':
+			ppid = atoi (optarg);
+			have_ppid = TRUE;
+			np_str_addf (&fmt, _("%sPPID = %d"), fmt.len ? " " : "", (int) ppid);
+			break;
+		case 'u':
+			if (is_integer (optarg))
+				pw = getpwuid (atoi (optarg));
+			else
+				pw = getpwnam (optarg);
+			if (pw == NULL) {
+				np_str_addf (&c->text, _("UID %s was not found"), optarg);
+				return STATE_UNKNOWN;
+			}
+			uid = pw->pw_uid;
+			have_uid = TRUE;
+			np_str_addf (&fmt, _("%suser '%s'"), fmt.len ? " " : "", pw->pw_name);
+			break;
+		case 'C':
+			prog = optarg;
+			np_str_addf (&fmt, _("%scommand name '%s'"), fmt.len ? " " : "", prog);
+			break;
+		case 'a':
+			args = optarg;
+			np_str_addf (&fmt, _("%sargs '%s'"), fmt.len ? " " : "", args);
+			break;
+		case EREG_ARGS:
+			if (have_re)
+				np_regex_free (&re_args);
+			if ((err = np_regex_compile (&re_args, optarg, REG_EXTENDED)) != 0) {
+				np_regex_error (err, NULL, errbuf, MAX_INPUT_BUFFER);
+				np_str_addf (&c->text, "%s - %s", _("Could not compile regular expression"), errbuf);
+				return STATE_UNKNOWN;
+			}
+			have_re = TRUE;
+			np_str_addf (&fmt, _("%sregex args '%s'"), fmt.len ? " " : "", optarg);
+			break;
+		case 'r':
+			rss = atol (optarg);
+			np_str_addf (&fmt, _("%sRSS >= %ld"), fmt.len ? " " : "", rss);
+			break;
+		case 'z':
+			vsz = atol (optarg);
+			np_str_addf (&fmt, _("%sVSZ >= %ld"), fmt.len ? " " : "", vsz);
+			break;
+		case 'P':
+			pcpu = atof (optarg);
+			np_str_addf (&fmt, _("%sPCPU >= %.2f"), fmt.len ? " " : "", pcpu);
+			break;
+		case 'k':
+			kthreads = FALSE;
+			np_str_addf (&fmt, _("%swithout kernel threads"), fmt.len ? " " : "");
+			break;
+		case 'X':
+			/* the definition owns its arguments, so split in place */
+			np_str_addf (&fmt, _("%sexclude progs '%s'"), fmt.len ? " " : "", optarg);
+			for (word = strtok (optarg, ","); word; word = strtok (NULL, ","))
+				np_add_name (&exclude, word);
+			break;
+		default:
+			return invalid_option (c);
+		}
+	}
+	if (range_thresholds (c, &thlds, warning, critical) == ERROR)
+		return STATE_UNKNOWN;
+
+	if (!get_procs ()) {
+		np_str_add (&c->text, _("Unable to read the process table"));
+		return STATE_UNKNOWN;
+	}
+
+	if (!kthreads)
+		for (i = 0; i < snapshot.nprocs; i++)
+			if (strcmp (snapshot.procs[i].prog, "kthreadd") == 0)
+				kthread_ppid = snapshot.procs[i].pid;
+
+	for (i = 0; i < snapshot.nprocs; i++) {
+		np_proc_entry *e = &snapshot.procs[i];
+		double value = 0;
+
+		/* ourselves and the agent that started us */
+		if (e->pid == self || e->pid == parent)
+			continue;
+		if (kthread_ppid && (e->ppid == kthread_ppid || e->pid == kthread_ppid))
+			continue;
+		if (exclude && np_find_name (exclude, e->prog))
+			continue;
+		if ((statopts && !strchr (statopts, e->state)) ||
+		    (have_ppid && e->ppid != ppid) ||
+		    (have_uid && e->uid != uid) ||
+		    (prog && strcmp (prog, e->prog) != 0) ||
+		    (args && strstr (e->args, args) == NULL) ||
+		    (have_re && !np_regex_match (&re_args, e->args)) ||
+		    (vsz >= 0 && e->vsz < vsz) ||
+		    (rss >= 0 && e->rss < rss) ||
+		    (pcpu >= 0 && e->pcpu < pcpu))
+			continue;
+
+		procs++;
+		if (verbose >= 3)
+			printf ("%s: matched pid=%d ppid=%d uid=%d vsz=%ld rss=%ld pcpu=%.2f stat=%c etime=%ld prog=%s args=%s\n",
+			        c->name, (int) e->pid, (int) e->ppid, (int) e->uid, e->vsz, e->rss, e->pcpu,
+			        e->state, e->elapsed, e->prog, e->args);
+		if (metric == METRIC_PROCS)
+			continue;
+
+		if (metric == METRIC_VSZ)
+			value = e->vsz;
+		else if (metric == METRIC_RSS)
+			value = e->rss;
+		else if (metric == METRIC_CPU)
+			value = e->pcpu;
+		else if (metric == METRIC_ELAPSED)
+			value = e->elapsed;
+		total += value;
+		status = get_status (value, thlds);
+		if (status == STATE_WARNING)
+			warn++;
+		else if (status == STATE_CRITICAL)
+			crit++;
+		result = max_state (result, status);
+	}
+	if (have_re)
+		np_regex_free (&re_args);
+	while (exclude) {
+		struct name_list *next = exclude->next;
+		free (exclude);
+		exclude = next;
+	}
+
+	if (metric == METRIC_PROCS)
+		result = get_status (procs, thlds);
+	else if (result == STATE_WARNING)
+		np_str_addf (&c->text, _("%d warn out of "), warn);
+	else if (result == STATE_CRITICAL)
+		np_str_addf (&c->text, _("%d crit, %d warn out of "), crit, warn);
+	np_str_addf (&c->text, ngettext ("%d process", "%d processes", (unsigned long) procs), procs);
+	if (fmt.len)
+		np_str_addf (&c->text, _(" with %s"), np_str_get (&fmt));
+	np_str_free (&fmt);
+
+	if (metric == METRIC_PROCS)
+		np_str_addf (&c->perf, "procs=%d;%s;%s;0;", procs, warning ? warning : "", critical ? critical : "");
+	else
+		np_str_addf (&c->perf, "procs=%d;;;0; procs_warn=%d;;;0; procs_crit=%d;;;0; proc%s=%g;",
+		             procs, warn, crit, metric == METRIC_VSZ ? "vsz" : metric == METRIC_RSS ? "rss" :
+		             metric == METRIC_CPU ? "pcpu" : "seconds", total);
+	return result;
+}
+
+
+/* check_disk: -w/-c as free MB or PERCENT% free, -p paths, -X types */
+static int
+disk_threshold (const char *arg, double *mb, double *percent)
+{
+	char *end;
+	double value = strtod (arg, &end);
+
+	if (end == arg || value < 0)
+		return ERROR;
+	if (*end == '%')
+		*percent = value;
+	else if (*end == '\0')
+		*mb = value;
+	else
+		return ERROR;
+	return OK;
+}
+
+static int
+run_disk (local_check *c)
+{
+	static struct option longopts[] = {
+		{"warning", required_argument, 0, 'w'},
+		{"critical", required_argument, 0, 'c'},
+		{"path", required_argument, 0, 'p'},
+		{"partition", required_argument, 0, 'p'},
+		{"exclude_device", required_argument, 0, 'x'},
+		{"exclude-type", required_argument, 0, 'X'},
+		{"local", no_argument, 0, 'l'},
+		{"exact-match", no_argument, 0, 'E'},
+		{0, 0, 0, 0}
+	};
+	struct name_list *dev_exclude = NULL, *fs_exclude = NULL, *seen = NULL;
+	struct parameter_list *paths = NULL, *p;
+	double warn_mb = -1, crit_mb = -1, warn_pct = -1, crit_pct = -1;
+	int opt, local_only = FALSE, exact = FALSE, result = STATE_OK, checked = 0;
+	size_t i;
+
+	while ((opt = getopt_long (c->argc, c->argv, "w:c:p:x:X:lE", longopts, NULL)) != -1) {
+		switch (opt) {
+		case 'w':
+			if (disk_threshold (optarg, &warn_mb, &warn_pct) == ERROR)
+				return invalid_option (c);
+			break;
+		case 'c':
+			if (disk_threshold (optarg, &crit_mb, &crit_pct) == ERROR)
+				return invalid_option (c);
+			break;
+		case 'p':
+			if (!np_find_parameter (paths, optarg))
+				np_add_parameter (&paths, optarg);
+			break;
+		case 'x':
+			np_add_name (&dev_exclude, optarg);
+			break;
+		case 'X':
+			np_add_name (&fs_exclude, optarg);
+			break;
+		case 'l':
+			local_only = TRUE;
+			break;
+		case 'E':
+			exact = TRUE;
+			break;
+		default:
+			return invalid_option (c);
+		}
+	}
+
+	if (!get_mounts ()) {
+		np_str_add (&c->text, _("Unable to read the mount table"));
+		return STATE_UNKNOWN;
+	}
+
+	/* a path selects the file system it lives on, as in check_disk */
+	np_set_best_match (paths, snapshot.mount_list, exact);
+	for (p = paths; p; p = p->name_next)
+		if (!p->best_match) {
+			np_str_addf (&c->text, _("%s not found"), p->name);
+			return STATE_CRITICAL;
+		}
+
+	np_str_add (&c->text, _("free space:"));
+	for (i = 0; i < snapshot.nmounts; i++) {
+		struct mount_entry *me = snapshot.mounts[i].me;
+		struct fs_usage *fsu;
+		double total_mb, used_mb, free_mb, free_pct, w, cr;
+		int status = STATE_OK;
+
+		if (paths) {
+			for (p = paths; p && p->best_match != me; p = p->name_next)
+				;
+			if (!p)
+				continue;
+		} else if (me->me_dummy || (local_only && me->me_remote))
+			continue;
+		if (np_find_name (dev_exclude, me->me_devname) || np_find_name (fs_exclude, me->me_type) ||
+		    np_seen_name (seen, me->me_mountdir))
+			continue;
+		if ((fsu = get_usage (&snapshot.mounts[i])) == NULL || fsu->fsu_blocks == 0)
+			continue;
+		np_add_name (&seen, me->me_mountdir);
+		checked++;
+
+		total_mb = (double) fsu->fsu_blocks * fsu->fsu_blocksize / (1024 * 1024);
+		used_mb = (double) (fsu->fsu_blocks - fsu->fsu_bfree) * fsu->fsu_blocksize / (1024 * 1024);
+		free_mb = (double) fsu->fsu_bavail * fsu->fsu_blocksize / (1024 * 1024);
+		free_pct = used_mb + free_mb > 0 ? 100 * free_mb / (used_mb + free_mb) : 100;
+
+		if ((crit_pct >= 0 && free_pct < crit_pct) || (crit_mb >= 0 && free_mb < crit_mb))
+			status = STATE_CRITICAL;
+		else if ((warn_pct >= 0 && free_pct < warn_pct) || (warn_mb >= 0 && free_mb < warn_mb))
+			status = STATE_WARNING;
+		result = max_state (result, status);
+
+		np_str_addf (&c->text, " %s %.0f MiB (%.2f%%);", me->me_mountdir, free_mb, free_pct);
+		/* perfdata is used space, so the thresholds are turned around */
+		w = warn_pct >= 0 ? total_mb * (100 - warn_pct) / 100 : warn_mb >= 0 ? total_mb - warn_mb : -1;
+		cr = crit_pct >= 0 ? total_mb * (100 - crit_pct) / 100 : crit_mb >= 0 ? total_mb - crit_mb : -1;
+		np_str_addf (&c->perf, "%s", c->perf.len ? " " : "");
+		np_str_perfdata (&c->perf, me->me_mountdir, (long) used_mb, "MiB",
+		                 w >= 0, (long) w, cr >= 0, (long) cr, TRUE, 0, TRUE, (long) total_mb);
+	}
+
+	if (checked == 0) {
+		np_str_free (&c->text);
+		np_str_add (&c->text, _("No file systems matched"));
+		return STATE_UNKNOWN;
+	}
+	return result;
+}
+
+
+
+/* process command-line arguments */
+int
+process_arguments (int argc, char **argv)
+{
+	int c;
+	int option = 0;
+	static struct option longopts[] = {
+		{"file", required_argument, 0, 'f'},
+		{"check", required_argument, 0, 'C'},
+		{"timeout", required_argument, 0, 't'},
+		{"verbose", no_argument, 0, 'v'},
+		{"version", no_argument, 0, 'V'},
+		{"help", no_argument, 0, 'h'},
+		{0, 0, 0, 0}
+	};
+
+	if (argc < 2)
+		return ERROR;
+
+	while (1) {
+		c = getopt_long (argc, argv, "+hVvf:C:t:", longopts, &option);
+
+		if (c == -1 || c == EOF)
+			break;
+
+		switch (c) {
+		case 'f':									/* ini file with the definitions */
+			ini_file = optarg;
+			break;
+		case 'C':									/* one definition */
+			np_add_name (&check_names, optarg);
+			break;
+		case 't':									/* timeout period */
+			timeout_interval = parse_timeout_string (optarg);
+			break;
+		case 'v':									/* verbose */
+			verbose++;
+			break;
+		case 'V':									/* version */
+			print_revision (progname, NP_VERSION);
+			exit (STATE_OK);
+		case 'h':									/* help */
+			print_help ();
+			exit (STATE_OK);
+		case '?':									/* error */
+			usage5 ();
+		}
+	}
+
+	if (ini_file == NULL)
+		usage4 (_("An ini file must be given with -f"));
+	return OK;
+}
+
+
+
+void
+print_help (void)
+{
+	print_revision (progname, NP_VERSION);
+
+	printf (_(COPYRIGHT), copyright, email);
+
+	printf ("%s\n", _("Runs many local checks in one process, looking at the system only once."));
+	printf ("%s\n", _("Each check is a section of an ini file and prints one result line."));
+
+	printf ("\n\n");
+
+	print_usage ();
+
+	printf (UT_HELP_VRSN);
+	printf (UT_EXTRA_OPTS);
+
+	printf (" %s\n", "-f, --file=PATH");
+	printf ("    %s\n", _("Ini file with the check definitions"));
+	printf (" %s\n", "-C, --check=SECTION");
+	printf ("    %s\n", _("Run this definition, may be repeated. Default: the check= lines of [check_local]"));
+	printf (UT_PLUG_TIMEOUT, DEFAULT_SOCKET_TIMEOUT);
+	printf (UT_VERBOSE);
+
+	printf ("\n");
+	printf ("%s\n", _("Notes:"));
+	printf (" %s\n", _("Every definition has a plugin= line naming load, swap, users, uptime, procs"));
+	printf (" %s\n", _("or disk. Its other lines are long options of that plugin:"));
+	printf ("  %s\n", "load:   warning, critical, percpu");
+	printf ("  %s\n", "swap:   warning, critical, no-swap");
+	printf ("  %s\n", "users:  warning, critical");
+	printf ("  %s\n", "uptime: warning, critical, timeunit");
+	printf ("  %s\n", "procs:  warning, critical, metric, state, ppid, user, command, argument-array,");
+	printf ("  %s\n", "        ereg-argument-array, rss, vsz, pcpu, no-kthreads, exclude-process");
+	printf ("  %s\n", "disk:   warning, critical (free MB or free %), path, exclude_device,");
+	printf ("  %s\n", "        exclude-type, local, exact-match");
+	printf (" %s\n", _("The exit status is the worst result of all definitions."));
+
+	printf ("\n");
+	printf ("%s\n", _("Examples:"));
+	printf (" %s\n", "[check_local]");
+	printf (" %s\n", "check=load");
+	printf (" %s\n", "check=sshd");
+	printf (" %s\n", "[load]");
+	printf (" %s\n", "plugin=load");
+	printf (" %s\n", "warning=5,4,3");
+	printf (" %s\n", "critical=10,8,6");
+	printf (" %s\n", "[sshd]");
+	printf (" %s\n", "plugin=procs");
+	printf (" %s\n", "command=sshd");
+	printf (" %s\n", "critical=1:");
+	printf ("\n");
+	printf (" %s\n", "check_local -f /etc/nagios/local.ini");
+
+	printf (UT_SUPPORT);
+}
+
+
+
+void
+print_usage (void)
+{
+	printf ("%s\n", _("Usage:"));
+	printf ("%s -f <ini file> [-C <section>]... [-t <timeout>] [-v]\n", progname);
+}
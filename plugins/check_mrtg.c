@@ -35,9 +35,16 @@ const char *email = "devel@nagios-plugins.org";
 
 #include "common.h"
 #include "utils.h"
+#include "utils_str.h"
+#include "utils_mrtg.h"
+
+#ifdef HAVE_GLOB_H
+# include <glob.h>
+#endif
 
 int process_arguments (int, char **);
 int validate_arguments (void);
+int check_log (const char *, const char *, state_data *, np_str *, char **, char **);
 void print_help (void);
 void print_usage (void);
 
@@ -49,20 +56,22 @@ unsigned long value_warning_threshold = 0L;
 unsigned long value_critical_threshold = 0L;
 char *label;
 char *units;
+int use_rates = FALSE;
+int multiple_logs = FALSE;
 
 int
 main (int argc, char **argv)
 {
-	int result = STATE_OK;
-	FILE *fp;
-	int line;
-	char input_buffer[MAX_INPUT_BUFFER];
-	char *temp_buffer;
-	time_t current_time;
-	time_t timestamp = 0L;
-	unsigned long average_value_rate = 0L;
-	unsigned long maximum_value_rate = 0L;
-	unsigned long rate = 0L;
+	int result = STATE_OK, state;
+	int counts[4] = { 0, 0, 0, 0 };
+	state_data *previous = NULL;
+	np_str state_text_data = NP_STR_INIT;
+	char *text, *perf, *summary = "", *details = "", *name, *end;
+#ifdef HAVE_GLOB_H
+	glob_t logs;
+#endif
+	char **paths = &log_file;
+	size_t npaths = 1, n;
 
 	setlocale (LC_ALL, "");
 	bindtextdomain (PACKAGE, LOCALEDIR);
@@ -74,84 +83,120 @@ main (int argc, char **argv)
 	if (process_arguments (argc, argv) == ERROR)
 		usage4 (_("Could not parse arguments\n"));
 
-	/* open the MRTG log file for reading */
-	fp = fopen (log_file, "r");
-	if (fp == NULL) {
-		printf (_("Unable to open MRTG log file\n"));
-		return STATE_UNKNOWN;
+	/* the state store for the counters needs this */
+	np_init ((char *) progname, argc, argv);
+
+#ifdef HAVE_GLOB_H
+	/* many logs in one run */
+	if (strpbrk (log_file, "*?[") != NULL) {
+		if (glob (log_file, 0, NULL, &logs) != 0 || logs.gl_pathc == 0)
+			die (STATE_UNKNOWN, _("No MRTG log files match %s\n"), log_file);
+		paths = logs.gl_pathv;
+		npaths = logs.gl_pathc;
+		multiple_logs = TRUE;
 	}
+#endif
 
-	line = 0;
-	while (fgets (input_buffer, MAX_INPUT_BUFFER - 1, fp)) {
+	if (use_rates) {
+		np_enable_state (NULL, 1);
+		previous = np_state_read ();
+	}
 
-		line++;
+	if (!multiple_logs) {
+		result = check_log (log_file, NULL, previous, &state_text_data, &text, &perf);
+		if (use_rates)
+			np_state_write_string (0, (char *) np_str_get (&state_text_data));
+		if (*perf)
+			printf ("%s - %s|%s\n", state_text(result), text, perf);
+		else
+			printf ("%s\n", text);
+		return result;
+	}
 
-		/* skip the first line of the log file */
-		if (line == 1)
-			continue;
+	for (n = 0; n < npaths; n++) {
+		/* the file name without directory and .log is the perfdata prefix */
+		name = strdup ((end = strrchr (paths[n], '/')) ? end + 1 : paths[n]);
+		if ((end = strrchr (name, '.')) != NULL && strcmp (end, ".log") == 0)
+			*end = '\0';
+		state = check_log (paths[n], name, previous, &state_text_data, &text, &perf);
+		counts[state]++;
+		result = max_state_alt (result, state);
+		xasprintf (&details, "%s%s: %s %s\n", details, name, state_text (state), text);
+		if (*perf)
+			xasprintf (&summary, "%s%s%s", summary, *summary ? " " : "", perf);
+	}
+	if (use_rates)
+		np_state_write_string (0, (char *) np_str_get (&state_text_data));
 
-		/* break out of read loop if we've passed the number of entries we want to read */
-		if (line > 2)
-			break;
+	printf (_("%s - %lu logs, %d critical, %d warning, %d unknown|%s\n%s"),
+	        state_text (result), (unsigned long) npaths, counts[STATE_CRITICAL],
+	        counts[STATE_WARNING], counts[STATE_UNKNOWN], summary, details);
+	return result;
+}
 
-		/* grab the timestamp */
-		temp_buffer = strtok (input_buffer, " ");
-		timestamp = strtoul (temp_buffer, NULL, 10);
-
-		/* grab the average value 1 rate */
-		temp_buffer = strtok (NULL, " ");
-		if (variable_number == 1)
-			average_value_rate = strtoul (temp_buffer, NULL, 10);
-
-		/* grab the average value 2 rate */
-		temp_buffer = strtok (NULL, " ");
-		if (variable_number == 2)
-			average_value_rate = strtoul (temp_buffer, NULL, 10);
-
-		/* grab the maximum value 1 rate */
-		temp_buffer = strtok (NULL, " ");
-		if (variable_number == 1)
-			maximum_value_rate = strtoul (temp_buffer, NULL, 10);
-
-		/* grab the maximum value 2 rate */
-		temp_buffer = strtok (NULL, " ");
-		if (variable_number == 2)
-			maximum_value_rate = strtoul (temp_buffer, NULL, 10);
-	}
 
-	/* close the log file */
-	fclose (fp);
 
-	/* if we couldn't read enough data, return an unknown error */
-	if (line <= 2) {
-		printf (_("Unable to process MRTG log file\n"));
+/* checks one log. Without a name this is the only log, and the messages
+ * are the ones the plugin always printed; with one, the perfdata label
+ * starts with the name. The perfdata is empty if there is no value */
+int
+check_log (const char *path, const char *name, state_data *previous, np_str *state, char **text, char **perf)
+{
+	int result = STATE_OK;
+	np_mrtg_log log;
+	time_t current_time;
+	unsigned long rate = 0L;
+	double counter_rate[2];
+	const char *aggregation;
+	char *perf_label = label;
+	int have_rates = FALSE;
+
+	*perf = "";
+
+	/* map the MRTG log file, only the first two lines are read */
+	errno = 0;
+	if (np_mrtg_read (path, &log) != OK) {
+		xasprintf (text, "%s", errno ? _("Unable to open MRTG log file") : _("Unable to process MRTG log file"));
 		return STATE_UNKNOWN;
 	}
 
+	if (use_rates) {
+		have_rates = np_mrtg_rates (previous ? (char *) previous->data : NULL, path, &log, counter_rate);
+		np_mrtg_state_add (state, path, &log, have_rates ? counter_rate : NULL);
+	}
+
 	/* make sure the MRTG data isn't too old */
 	time (&current_time);
 	if (expire_minutes > 0
-			&& (current_time - timestamp) > (expire_minutes * 60)) {
-		printf (_("MRTG data has expired (%d minutes old)\n"),
-		        (int) ((current_time - timestamp) / 60));
+			&& (current_time - log.timestamp) > (expire_minutes * 60)) {
+		xasprintf (text, _("MRTG data has expired (%d minutes old)"),
+		           (int) ((current_time - log.timestamp) / 60));
 		return STATE_WARNING;
 	}
 
 	/* else check the incoming/outgoing rates */
-	if (use_average == TRUE)
-		rate = average_value_rate;
-	else
-		rate = maximum_value_rate;
+	if (have_rates) {
+		aggregation = _("Rate");
+		rate = (unsigned long) counter_rate[variable_number - 1];
+	}
+	else if (use_average == TRUE) {
+		aggregation = _("Avg");
+		rate = log.average[variable_number - 1];
+	}
+	else {
+		aggregation = _("Max");
+		rate = log.maximum[variable_number - 1];
+	}
 
 	if (rate > value_critical_threshold)
 		result = STATE_CRITICAL;
 	else if (rate > value_warning_threshold)
 		result = STATE_WARNING;
 
-	printf("%s - %s. %s = %lu %s|%s\n", state_text(result),
-	       (use_average == TRUE) ? _("Avg") : _("Max"),
-	       label, rate, units,
-	       perfdata(label, (long) rate, units,
+	if (name != NULL)
+		xasprintf (&perf_label, "%s_%s", name, label);
+	xasprintf (text, "%s. %s = %lu %s", aggregation, label, rate, units);
+	xasprintf (perf, "%s", perfdata(perf_label, (long) rate, units,
 		        (int) value_warning_threshold, (long) value_warning_threshold,
 		        (int) value_critical_threshold, (long) value_critical_threshold,
 		        0, 0, 0, 0));
@@ -177,7 +222,7 @@ process_arguments (int argc, char **argv)
 		{"warning", required_argument, 0, 'w'},
 		{"label", required_argument, 0, 'l'},
 		{"units", required_argument, 0, 'u'},
-		{"variable", required_argument, 0, 'v'},
+		{"rate", no_argument, 0, 'r'},
 		{"version", no_argument, 0, 'V'},
 		{"help", no_argument, 0, 'h'},
 		{0, 0, 0, 0}
@@ -196,7 +241,7 @@ process_arguments (int argc, char **argv)
 	}
 
 	while (1) {
-		c = getopt_long (argc, argv, "hVF:e:a:v:c:w:l:u:", longopts,
+		c = getopt_long (argc, argv, "hVrF:e:a:v:c:w:l:u:", longopts,
 									 &option);
 
 		if (c == -1 || c == EOF)
@@ -232,6 +277,9 @@ process_arguments (int argc, char **argv)
 		case 'u':									/* timeout */
 			units = optarg;
 			break;
+		case 'r':									/* rates from the counters */
+			use_rates = TRUE;
+			break;
 		case 'V':									/* version */
 			print_revision (progname, NP_VERSION);
 			exit (STATE_OK);
@@ -329,7 +377,9 @@ print_help (void)
 	printf (UT_EXTRA_OPTS);
 
 	printf (" %s\n", "-F, --logfile=FILE");
-  printf ("   %s\n", _("The MRTG log file containing the data you want to monitor"));
+  printf ("   %s\n", _("The MRTG log file containing the data you want to monitor. A pattern such"));
+  printf ("   %s\n", _("as /var/www/mrtg/*.log checks every matching log, with the file names as"));
+  printf ("   %s\n", _("perfdata prefixes"));
   printf (" %s\n", "-e, --expires=MINUTES");
   printf ("   %s\n", _("Minutes before MRTG data is considered to be too old"));
   printf (" %s\n", "-a, --aggregation=AVG|MAX");
@@ -345,6 +395,10 @@ print_help (void)
   printf (" %s\n", "-u, --units=STRING");
   printf ("   %s\n", _("Option units label for data (Example: Packets/Sec, Errors/Sec,"));
   printf ("   %s\n", _("\"Bytes Per Second\", \"%% Utilization\")"));
+  printf (" %s\n", "-r, --rate");
+  printf ("   %s\n", _("Compute the rate from the counters MRTG saved on this and the last run of"));
+  printf ("   %s\n", _("the plugin, rather than from the newest log entry. The counters are kept"));
+  printf ("   %s\n", _("in the state directory, the first run uses the log entry"));
 
   printf ("\n");
 	printf (" %s\n", _("If the value exceeds the <vwl> threshold, a WARNING status is returned. If"));
@@ -381,5 +435,5 @@ print_usage (void)
 {
   printf ("%s\n", _("Usage:"));
 	printf ("%s -F log_file -a <AVG | MAX> -v variable -w warning -c critical\n",progname);
-  printf ("[-l label] [-u units] [-e expire_minutes] [-t timeout] [-v]\n");
+  printf ("[-l label] [-u units] [-e expire_minutes] [-t timeout] [-r]\n");
 }
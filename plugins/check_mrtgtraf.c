@@ -31,6 +31,12 @@
 
 #include "common.h"
 #include "utils.h"
+#include "utils_str.h"
+#include "utils_mrtg.h"
+
+#ifdef HAVE_GLOB_H
+# include <glob.h>
+#endif
 
 const char *progname = "check_mrtgtraf";
 const char *copyright = "1999-2014";
@@ -38,6 +44,7 @@ const char *email = "devel@nagios-plugins.org";
 
 int process_arguments (int, char **);
 int validate_arguments (void);
+int check_log (const char *, const char *, state_data *, np_str *, char **, char **);
 void print_help(void);
 void print_usage(void);
 
@@ -50,31 +57,23 @@ unsigned long incoming_critical_threshold = 0L;
 unsigned long outgoing_warning_threshold = 0L;
 unsigned long outgoing_critical_threshold = 0L;
 unsigned long max_interface_bandwidth = 0L;
+int use_rates = FALSE;
+int multiple_logs = FALSE;
 
 
 int
 main (int argc, char **argv)
 {
-	int result = STATE_OK;
-	FILE *fp;
-	int line;
-	char input_buffer[MAX_INPUT_BUFFER];
-	char *temp_buffer;
-	time_t current_time;
-	char *error_message;
-	time_t timestamp = 0L;
-	unsigned long average_incoming_rate = 0L;
-	unsigned long average_outgoing_rate = 0L;
-	unsigned long maximum_incoming_rate = 0L;
-	unsigned long maximum_outgoing_rate = 0L;
-	unsigned long incoming_rate = 0L;
-	unsigned long outgoing_rate = 0L;
-	double adjusted_incoming_rate = 0.0;
-	double adjusted_outgoing_rate = 0.0;
-	double incoming_percent = 0.0;
-	double outgoing_percent = 0.0;
-	char incoming_speed_rating[8];
-	char outgoing_speed_rating[8];
+	int result = STATE_OK, state;
+	int counts[4] = { 0, 0, 0, 0 };
+	state_data *previous = NULL;
+	np_str state_text_data = NP_STR_INIT;
+	char *text, *perf, *summary = "", *details = "", *name, *end;
+#ifdef HAVE_GLOB_H
+	glob_t logs;
+#endif
+	char **paths = &log_file;
+	size_t npaths = 1, n;
 
 	setlocale (LC_ALL, "");
 	bindtextdomain (PACKAGE, LOCALEDIR);
@@ -86,118 +85,152 @@ main (int argc, char **argv)
 	if (process_arguments (argc, argv) == ERROR)
 		usage4 (_("Could not parse arguments"));
 
-	/* open the MRTG log file for reading */
-	fp = fopen (log_file, "r");
-	if (fp == NULL)
-		usage4 (_("Unable to open MRTG log file"));
-
-	line = 0;
+	/* the state store for the counters needs this */
+	np_init ((char *) progname, argc, argv);
+
+#ifdef HAVE_GLOB_H
+	/* many interface logs in one run */
+	if (strpbrk (log_file, "*?[") != NULL) {
+		if (glob (log_file, 0, NULL, &logs) != 0 || logs.gl_pathc == 0)
+			die (STATE_UNKNOWN, _("No MRTG log files match %s\n"), log_file);
+		paths = logs.gl_pathv;
+		npaths = logs.gl_pathc;
+		multiple_logs = TRUE;
+	}
+#endif
 
-	while (fgets (input_buffer, MAX_INPUT_BUFFER - 1, fp)) {
+	if (use_rates) {
+		np_enable_state (NULL, 1);
+		previous = np_state_read ();
+	}
 
-		line++;
+	if (!multiple_logs) {
+		result = check_log (log_file, NULL, previous, &state_text_data, &text, &perf);
+		if (use_rates)
+			np_state_write_string (0, (char *) np_str_get (&state_text_data));
+		printf (_("Traffic %s - %s|%s\n"), state_text(result), text, perf);
+		return result;
+	}
 
-		/* skip the first line of the log file */
-		if (line == 1)
-			continue;
+	for (n = 0; n < npaths; n++) {
+		/* the file name without directory and .log is the perfdata prefix */
+		name = strdup ((end = strrchr (paths[n], '/')) ? end + 1 : paths[n]);
+		if ((end = strrchr (name, '.')) != NULL && strcmp (end, ".log") == 0)
+			*end = '\0';
+		state = check_log (paths[n], name, previous, &state_text_data, &text, &perf);
+		counts[state]++;
+		result = max_state_alt (result, state);
+		xasprintf (&details, "%s%s: %s %s\n", details, name, state_text (state), text);
+		xasprintf (&summary, "%s%s%s", summary, *summary ? " " : "", perf);
+	}
+	if (use_rates)
+		np_state_write_string (0, (char *) np_str_get (&state_text_data));
 
-		/* break out of read loop */
-		/* if we've passed the number of entries we want to read */
-		if (line > 2)
-			break;
+	printf (_("Traffic %s - %lu logs, %d critical, %d warning, %d unknown|%s\n%s"),
+	        state_text (result), (unsigned long) npaths, counts[STATE_CRITICAL],
+	        counts[STATE_WARNING], counts[STATE_UNKNOWN], summary, details);
+	return result;
+}
 
-		/* grab the timestamp */
-		temp_buffer = strtok (input_buffer, " ");
-		timestamp = strtoul (temp_buffer, NULL, 10);
-		if (verbose)
-			printf("%s %lu\n", _("Found timestamp of:"), timestamp);
 
-		/* grab the average incoming transfer rate */
-		temp_buffer = strtok (NULL, " ");
-		average_incoming_rate = strtoul (temp_buffer, NULL, 10);
-		if (verbose)
-			printf("%s %lu\n", _("Found average incoming rate of:"), average_incoming_rate);
 
-		/* grab the average outgoing transfer rate */
-		temp_buffer = strtok (NULL, " ");
-		average_outgoing_rate = strtoul (temp_buffer, NULL, 10);
-		if (verbose)
-			printf("%s %lu\n", _("Found average outgoing rate of:"), average_outgoing_rate);
+/* rates are in bytes per second, shown as B, KB or MB */
+static double
+adjust_rate (unsigned long rate, char *rating)
+{
+	if (rate < 1024) {
+		strcpy (rating, "B");
+		return (double) rate;
+	}
+	else if (rate < (1024 * 1024)) {
+		strcpy (rating, "KB");
+		return (double) (rate / 1024.0);
+	}
+	strcpy (rating, "MB");
+	return (double) (rate / 1024.0 / 1024.0);
+}
 
-		/* grab the maximum incoming transfer rate */
-		temp_buffer = strtok (NULL, " ");
-		maximum_incoming_rate = strtoul (temp_buffer, NULL, 10);
-		if (verbose)
-			printf("%s %lu\n", _("Found maximum incoming rate of:"), maximum_incoming_rate);
+/* checks one log. Without a name this is the only log, and errors end the
+ * plugin as they always did; with one, they are the state of this log and
+ * the perfdata labels start with the name */
+int
+check_log (const char *path, const char *name, state_data *previous, np_str *state, char **text, char **perf)
+{
+	int result = STATE_OK;
+	np_mrtg_log log;
+	time_t current_time;
+	unsigned long incoming_rate = 0L;
+	unsigned long outgoing_rate = 0L;
+	double adjusted_incoming_rate = 0.0;
+	double adjusted_outgoing_rate = 0.0;
+	double incoming_percent = 0.0;
+	double outgoing_percent = 0.0;
+	double counter_rate[2];
+	const char *aggregation;
+	char incoming_speed_rating[8];
+	char outgoing_speed_rating[8];
+	char *in_label = "in", *out_label = "out", *in_pct_label = "in_pct", *out_pct_label = "out_pct";
+	int have_rates = FALSE;
+
+	/* map the MRTG log file, only the first two lines are read */
+	errno = 0;
+	if (np_mrtg_read (path, &log) != OK) {
+		if (name == NULL)
+			usage4 (errno ? _("Unable to open MRTG log file") : _("Unable to process MRTG log file"));
+		xasprintf (text, "%s", errno ? _("Unable to open MRTG log file") : _("Unable to process MRTG log file"));
+		*perf = "";
+		return STATE_UNKNOWN;
+	}
+	if (verbose) {
+		printf("%s %lu\n", _("Found timestamp of:"), (unsigned long) log.timestamp);
+		printf("%s %lu\n", _("Found average incoming rate of:"), log.average[0]);
+		printf("%s %lu\n", _("Found average outgoing rate of:"), log.average[1]);
+		printf("%s %lu\n", _("Found maximum incoming rate of:"), log.maximum[0]);
+		printf("%s %lu\n", _("Found maximum outgoing rate of:"), log.maximum[1]);
+	}
 
-		/* grab the maximum outgoing transfer rate */
-		temp_buffer = strtok (NULL, " ");
-		maximum_outgoing_rate = strtoul (temp_buffer, NULL, 10);
+	if (use_rates) {
+		have_rates = np_mrtg_rates (previous ? (char *) previous->data : NULL, path, &log, counter_rate);
+		np_mrtg_state_add (state, path, &log, have_rates ? counter_rate : NULL);
 		if (verbose)
-			printf("%s %lu\n", _("Found maximum outgoing rate of:"), maximum_outgoing_rate);
+			printf("%s\n", have_rates ? _("Using rates from the counters of the last run.")
+			                           : _("No counters from the last run, using the log."));
 	}
 
-	/* close the log file */
-	fclose (fp);
-
-	/* if we couldn't read enough data, return an unknown error */
-	if (line <= 2)
-		usage4 (_("Unable to process MRTG log file"));
-
 	/* make sure the MRTG data isn't too old */
 	time (&current_time);
 	if ((expire_minutes > 0) &&
-	    (current_time - timestamp) > (expire_minutes * 60))
-		die (STATE_WARNING,	_("MRTG data has expired (%d minutes old)\n"),
-		     (int) ((current_time - timestamp) / 60));
+	    (current_time - log.timestamp) > (expire_minutes * 60)) {
+		if (name == NULL)
+			die (STATE_WARNING,	_("MRTG data has expired (%d minutes old)\n"),
+			     (int) ((current_time - log.timestamp) / 60));
+		xasprintf (text, _("MRTG data has expired (%d minutes old)"),
+		           (int) ((current_time - log.timestamp) / 60));
+		*perf = "";
+		return STATE_WARNING;
+	}
 
 	/* else check the incoming/outgoing rates */
-	if (use_average == TRUE) {
+	if (have_rates) {
+		aggregation = _("Rate");
+		incoming_rate = (unsigned long) counter_rate[0];
+		outgoing_rate = (unsigned long) counter_rate[1];
+	}
+	else if (use_average == TRUE) {
 		if (verbose) printf("%s\n", _("Using average rates not maximum."));
-		incoming_rate = average_incoming_rate;
-		outgoing_rate = average_outgoing_rate;
+		aggregation = _("Avg");
+		incoming_rate = log.average[0];
+		outgoing_rate = log.average[1];
 	}
 	else {
 		if (verbose) printf("%s\n", _("Using default maximum rates."));
-		incoming_rate = maximum_incoming_rate;
-		outgoing_rate = maximum_outgoing_rate;
+		aggregation = _("Max");
+		incoming_rate = log.maximum[0];
+		outgoing_rate = log.maximum[1];
 	}
 
-	/* report incoming traffic in Bytes/sec */
-	if (incoming_rate < 1024) {
-		strcpy (incoming_speed_rating, "B");
-		adjusted_incoming_rate = (double) incoming_rate;
-	}
-
-	/* report incoming traffic in KBytes/sec */
-	else if (incoming_rate < (1024 * 1024)) {
-		strcpy (incoming_speed_rating, "KB");
-		adjusted_incoming_rate = (double) (incoming_rate / 1024.0);
-	}
-
-	/* report incoming traffic in MBytes/sec */
-	else {
-		strcpy (incoming_speed_rating, "MB");
-		adjusted_incoming_rate = (double) (incoming_rate / 1024.0 / 1024.0);
-	}
-
-	/* report outgoing traffic in Bytes/sec */
-	if (outgoing_rate < 1024) {
-		strcpy (outgoing_speed_rating, "B");
-		adjusted_outgoing_rate = (double) outgoing_rate;
-	}
-
-	/* report outgoing traffic in KBytes/sec */
-	else if (outgoing_rate < (1024 * 1024)) {
-		strcpy (outgoing_speed_rating, "KB");
-		adjusted_outgoing_rate = (double) (outgoing_rate / 1024.0);
-	}
-
-	/* report outgoing traffic in MBytes/sec */
-	else {
-		strcpy (outgoing_speed_rating, "MB");
-		adjusted_outgoing_rate = (double) (outgoing_rate / 1024.0 / 1024.0);
-	}
+	adjusted_incoming_rate = adjust_rate (incoming_rate, incoming_speed_rating);
+	adjusted_outgoing_rate = adjust_rate (outgoing_rate, outgoing_speed_rating);
 
 	if (incoming_rate > incoming_critical_threshold
 			|| outgoing_rate > outgoing_critical_threshold) {
@@ -208,32 +241,37 @@ main (int argc, char **argv)
 		result = STATE_WARNING;
 	}
 
-	xasprintf (&error_message, _("%s. In = %0.1f %s/s, %s. Out = %0.1f %s/s|%s %s"),
-	          (use_average == TRUE) ? _("Avg") : _("Max"), adjusted_incoming_rate,
-	          incoming_speed_rating, (use_average == TRUE) ? _("Avg") : _("Max"),
-	          adjusted_outgoing_rate, outgoing_speed_rating,
-	          fperfdata("in", adjusted_incoming_rate, incoming_speed_rating,
+	if (name != NULL) {
+		xasprintf (&in_label, "%s_in", name);
+		xasprintf (&out_label, "%s_out", name);
+		xasprintf (&in_pct_label, "%s_in_pct", name);
+		xasprintf (&out_pct_label, "%s_out_pct", name);
+	}
+
+	xasprintf (text, _("%s. In = %0.1f %s/s, %s. Out = %0.1f %s/s"),
+	          aggregation, adjusted_incoming_rate, incoming_speed_rating,
+	          aggregation, adjusted_outgoing_rate, outgoing_speed_rating);
+	xasprintf (perf, "%s %s",
+	          fperfdata(in_label, adjusted_incoming_rate, incoming_speed_rating,
 	                   (int)incoming_warning_threshold, incoming_warning_threshold,
 	                   (int)incoming_critical_threshold, incoming_critical_threshold,
 	                   TRUE, 0, FALSE, 0),
-	          fperfdata("out", adjusted_outgoing_rate, outgoing_speed_rating,
+	          fperfdata(out_label, adjusted_outgoing_rate, outgoing_speed_rating,
 	                   (int)outgoing_warning_threshold, outgoing_warning_threshold,
 	                   (int)outgoing_critical_threshold, outgoing_critical_threshold,
 	                   TRUE, 0, FALSE, 0));
 	if (max_interface_bandwidth) {
 		incoming_percent = (incoming_rate * 100.0) / (double)max_interface_bandwidth;
 		outgoing_percent = (incoming_rate * 100.0) / (double)max_interface_bandwidth;
-		xasprintf(&error_message, "%s %s %s", error_message,
-			fperfdata("in_pct", incoming_percent, "%",
+		xasprintf(perf, "%s %s %s", *perf,
+			fperfdata(in_pct_label, incoming_percent, "%",
 					 FALSE, 0.0, FALSE, 0.0,
 					 TRUE, 0.0, TRUE, 100.0),
-			fperfdata("out_pct", outgoing_percent, "%",
+			fperfdata(out_pct_label, outgoing_percent, "%",
 					 FALSE, 0.0, FALSE, 0.0,
 					 TRUE, 0.0, TRUE, 100.0));
 	}
 
-	printf (_("Traffic %s - %s\n"), state_text(result), error_message);
-
 	return result;
 }
 
@@ -254,6 +292,7 @@ process_arguments (int argc, char **argv)
 		{"warning", required_argument, 0, 'w'},
 		{"verbose", no_argument, 0, 'v'},
 		{"interface-maximum", required_argument, 0, 'i'},
+		{"rate", no_argument, 0, 'r'},
 		{"version", no_argument, 0, 'V'},
 		{"help", no_argument, 0, 'h'},
 		{0, 0, 0, 0}
@@ -272,7 +311,7 @@ process_arguments (int argc, char **argv)
 	}
 
 	while (1) {
-		c = getopt_long (argc, argv, "hVvF:e:a:c:w:", longopts, &option);
+		c = getopt_long (argc, argv, "hVvrF:e:a:c:w:i:", longopts, &option);
 
 		if (c == -1 || c == EOF)
 			break;
@@ -301,6 +340,9 @@ process_arguments (int argc, char **argv)
 		case 'i':                                   /* max interface bandwidth */
 			max_interface_bandwidth = strtoul(optarg, NULL, 0);
 			break;
+		case 'r':                                   /* rates from the counters */
+			use_rates = TRUE;
+			break;
 		case 'v':
 			verbose = true;
 			break;
@@ -383,7 +425,8 @@ print_help (void)
   printf (UT_EXTRA_OPTS);
 
   printf (" %s\n", "-F, --filename=STRING");
-  printf ("    %s\n", _("File to read log from"));
+  printf ("    %s\n", _("File to read log from. A pattern such as /var/www/mrtg/*.log checks"));
+  printf ("    %s\n", _("every matching log, with the file names as perfdata prefixes"));
   printf (" %s\n", "-e, --expires=INTEGER");
   printf ("    %s\n", _("Minutes after which log expires"));
   printf (" %s\n", "-a, --aggregation=(AVG|MAX)");
@@ -397,6 +440,10 @@ print_help (void)
   printf (" %s\n", _("-i, --interface-maximum"));
   printf ("    %s\n", _("Define the maximum bandwidth on the port being monitored (Bytes/sec)"));
   printf ("    %s\n", _("This adds percentages to performance data output"));
+  printf (" %s\n", "-r, --rate");
+  printf ("    %s\n", _("Compute the rates from the counters MRTG saved on this and the last run"));
+  printf ("    %s\n", _("of the plugin, rather than from the newest log entry. The counters are"));
+  printf ("    %s\n", _("kept in the state directory, the first run uses the log entry"));
 
   printf ("\n");
   printf ("%s\n", _("Notes:"));
@@ -418,5 +465,5 @@ print_usage (void)
 {
 	printf (_("Usage"));
   printf (" %s -F <log_file> -a <AVG | MAX> -w <warning_pair>\n",progname);
-  printf ("-c <critical_pair> [-e expire_minutes]\n");
+  printf ("-c <critical_pair> [-e expire_minutes] [-i max_bandwidth] [-r]\n");
 }
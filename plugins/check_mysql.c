@@ -44,6 +44,7 @@ const char *email = "devel@nagios-plugins.org";
 #include <mysql.h>
 #include <mysqld_error.h>
 #include <errmsg.h>
+#include <ctype.h>
 
 char *db_user = NULL;
 char *db_host = NULL;
@@ -91,6 +92,33 @@ static const char *metric_counter[LENGTH_METRIC_COUNTER] = {
 
 thresholds *my_threshold = NULL;
 
+/* a status variable to report, from --metric or the lists above */
+typedef struct mysql_metric {
+	char *name;
+	int counter;              /* grows from server start */
+	int rate;                 /* report the change per second instead */
+	char *warning;
+	char *critical;
+	thresholds *thresholds;
+	int found;
+	double value;
+	double previous;          /* value of the last run, for rates */
+	int have_previous;
+	int status;
+	char *perf;
+} mysql_metric;
+
+static mysql_metric *metrics = NULL;
+static int nmetrics = 0;
+static int *metric_hash = NULL;     /* index into metrics, -1 for a free slot */
+static unsigned int metric_hash_size = 0;
+
+static void add_metric (const char *, int, int, char *, char *);
+static int find_metric (const char *);
+static void build_metric_hash (void);
+static char *metric_query (void);
+static void compute_rates (void);
+
 int process_arguments (int, char **);
 int validate_arguments (void);
 void print_help (void);
@@ -109,9 +137,13 @@ main (int argc, char **argv)
 	char *result = NULL;
 	char *error = NULL;
 	char slaveresult[SLAVERESULTSIZE];
-	char* perf;
-
-        perf = strdup ("");
+	np_str perf = NP_STR_INIT;
+	char *query;
+	char *alerts = NULL;
+	int status = STATE_OK;
+	int slave_status = STATE_OK;
+	int i;
+	MYSQL_RES *slave_res = NULL;
 
 	setlocale (LC_ALL, "");
 	bindtextdomain (PACKAGE, LOCALEDIR);
@@ -120,6 +152,8 @@ main (int argc, char **argv)
 	/* Parse extra opts if any */
 	argv=np_extra_opts (&argc, argv, progname);
 
+	np_init ((char *) progname, argc, argv);
+
 	if (process_arguments (argc, argv) == ERROR)
 		usage4 (_("Could not parse arguments"));
 
@@ -137,7 +171,9 @@ main (int argc, char **argv)
 	if (ssl)
 		mysql_ssl_set(&mysql,key,cert,ca_cert,ca_dir,ciphers);
 	/* establish a connection to the server and error checking */
-	if (!mysql_real_connect(&mysql,db_host,db_user,db_pass,db,db_port,db_socket,0)) {
+	/* the status and slave queries go out as one multi-statement */
+	if (!mysql_real_connect(&mysql,db_host,db_user,db_pass,db,db_port,db_socket,
+	                        check_slave ? CLIENT_MULTI_STATEMENTS : 0)) {
 		if (ignore_auth && mysql_errno (&mysql) == ER_ACCESS_DENIED_ERROR)
 		{
 			printf("MySQL OK - Version: %s (protocol %d)\n",
@@ -174,8 +210,14 @@ main (int argc, char **argv)
 			die (STATE_CRITICAL, "%s\n", mysql_error (&mysql));
 	}
 
-	/* try to fetch some perf data */
-	if (mysql_query (&mysql, "show global status") == 0) {
+	/* fetch only the selected status variables, plus the slave status */
+	query = metric_query ();
+	if (check_slave)
+		xasprintf (&query, "%s; show slave status", query);
+	if (verbose > 1)
+		printf ("Query: %s\n", query);
+
+	if (mysql_query (&mysql, query) == 0) {
 		if ( (res = mysql_store_result (&mysql)) == NULL) {
 			error = strdup(mysql_error(&mysql));
 			mysql_close (&mysql);
@@ -183,38 +225,54 @@ main (int argc, char **argv)
 		}
 
 		while ( (row = mysql_fetch_row (res)) != NULL) {
-			int i;
+			mysql_metric *m;
+
+			if ((i = find_metric (row[0])) < 0)
+				continue;
+			m = &metrics[i];
+			m->found = TRUE;
+			m->value = strtod (row[1], NULL);
+			if (verbose > 2)
+				printf ("%s = %s\n", m->name, row[1]);
+		}
+		mysql_free_result (res);
 
-			for(i = 0; i < LENGTH_METRIC_UNIT; i++) {
-				if (strcmp(row[0], metric_unit[i]) == 0) {
-					xasprintf(&perf, "%s%s ", perf, perfdata(metric_unit[i],
-						atol(row[1]), "", FALSE, 0, FALSE, 0, FALSE, 0, FALSE, 0));
-					continue;
-				}
-			}
-			for(i = 0; i < LENGTH_METRIC_COUNTER; i++) {
-				if (strcmp(row[0], metric_counter[i]) == 0) {
-					xasprintf(&perf, "%s%s ", perf, perfdata(metric_counter[i],
-						atol(row[1]), "c", FALSE, 0, FALSE, 0, FALSE, 0, FALSE, 0));
-					continue;
-				}
+		if (check_slave) {
+			if (mysql_next_result (&mysql) != 0) {
+				error = strdup(mysql_error(&mysql));
+				mysql_close (&mysql);
+				die (STATE_CRITICAL, _("slave query error: %s\n"), error);
 			}
+			slave_res = mysql_store_result (&mysql);
 		}
-		/* remove trailing space */
-                if (strlen(perf) > 0)
-                    perf[strlen(perf) - 1] = '\0';
-	}
 
-	if(check_slave) {
-		/* check the slave status */
-		if (mysql_query (&mysql, "show slave status") != 0) {
-			error = strdup(mysql_error(&mysql));
-			mysql_close (&mysql);
-			die (STATE_CRITICAL, _("slave query error: %s\n"), error);
+		compute_rates ();
+
+		/* perfdata in the order the metrics were selected */
+		for (i = 0; i < nmetrics; i++) {
+			mysql_metric *m = &metrics[i];
+
+			if (!m->perf)
+				continue;
+			if (perf.len)
+				np_str_add (&perf, " ");
+			np_str_add (&perf, m->perf);
+			if (m->status != STATE_OK)
+				xasprintf (&alerts, "%s %s %s (%g)", alerts ? alerts : "",
+				           m->name, state_text (m->status), m->value);
+			status = max_state (status, m->status);
 		}
+	}
+	else if (check_slave) {
+		/* a failing first statement ends the batch before the slave query */
+		error = strdup(mysql_error(&mysql));
+		mysql_close (&mysql);
+		die (STATE_CRITICAL, _("status query error: %s\n"), error);
+	}
 
+	if(check_slave) {
 		/* store the result */
-		if ( (res = mysql_store_result (&mysql)) == NULL) {
+		if ( (res = slave_res) == NULL) {
 			error = strdup(mysql_error(&mysql));
 			mysql_close (&mysql);
 			die (STATE_CRITICAL, _("slave store_result error: %s\n"), error);
@@ -234,7 +292,7 @@ main (int argc, char **argv)
 			die (STATE_CRITICAL, _("slave fetch row error: %s\n"), error);
 		}
 
-		if (mysql_field_count (&mysql) == 12) {
+		if (mysql_num_fields (res) == 12) {
 			/* mysql 3.23.x */
 			snprintf (slaveresult, SLAVERESULTSIZE, _("Slave running: %s"), row[6]);
 			if (strcmp (row[6], "Yes") != 0) {
@@ -293,23 +351,15 @@ main (int argc, char **argv)
 			/* Check Seconds Behind against threshold */
 			if ((seconds_behind_field != -1) && (strcmp (row[seconds_behind_field], "NULL") != 0)) {
 				double value = atof(row[seconds_behind_field]);
-				int status;
-
-				status = get_status(value, my_threshold);
-
-				xasprintf (&perf, "%s %s", perf, fperfdata ("seconds behind master", value, "s",
-        	                        TRUE, (double) warning_time,
-                	                TRUE, (double) critical_time,
-                        	        FALSE, 0,
-                                	FALSE, 0));
-
-				if (status == STATE_WARNING) {
-					printf("SLOW_SLAVE %s: %s|%s\n", _("WARNING"), slaveresult, perf);
-					exit(STATE_WARNING);
-				} else if (status == STATE_CRITICAL) {
-					printf("SLOW_SLAVE %s: %s|%s\n", _("CRITICAL"), slaveresult, perf);
-					exit(STATE_CRITICAL);
-				}
+
+				slave_status = get_status(value, my_threshold);
+
+				np_str_add (&perf, " ");
+				np_str_fperfdata (&perf, "seconds behind master", value, "s",
+				                  TRUE, (double) warning_time,
+				                  TRUE, (double) critical_time,
+				                  FALSE, 0,
+				                  FALSE, 0);
 			}
 		}
 
@@ -320,14 +370,166 @@ main (int argc, char **argv)
 	/* close the connection */
 	mysql_close (&mysql);
 
-	/* print out the result of stats */
-	if (check_slave) {
-		printf ("%s %s|%s\n", result, slaveresult, perf);
+	/* print out the result of stats, a lagging slave along with the metrics */
+	if (slave_status != STATE_OK) {
+		printf ("SLOW_SLAVE %s: %s%s|%s\n", state_text (slave_status), slaveresult,
+		        alerts ? alerts : "", np_str_get (&perf));
+		status = max_state (status, slave_status);
+	} else if (check_slave) {
+		printf ("%s %s%s|%s\n", result, slaveresult, alerts ? alerts : "", np_str_get (&perf));
 	} else {
-		printf ("%s|%s\n", result, perf);
+		printf ("%s%s|%s\n", result, alerts ? alerts : "", np_str_get (&perf));
+	}
+
+	return status;
+}
+
+
+static unsigned int
+metric_hash_value (const char *name)
+{
+	unsigned int h = 2166136261u;
+
+	/* status variable names are case insensitive */
+	while (*name)
+		h = (h ^ (unsigned char) tolower (*name++)) * 16777619u;
+	return h;
+}
+
+static void
+add_metric (const char *name, int counter, int rate, char *warning, char *critical)
+{
+	mysql_metric *m;
+
+	metrics = realloc (metrics, sizeof (mysql_metric) * (nmetrics + 1));
+	if (metrics == NULL)
+		die (STATE_UNKNOWN, _("Could not allocate memory\n"));
+	m = &metrics[nmetrics++];
+	memset (m, 0, sizeof (mysql_metric));
+	m->name = strdup (name);
+	m->counter = counter || rate;
+	m->rate = rate;
+	m->warning = warning;
+	m->critical = critical;
+	set_thresholds (&m->thresholds, warning, critical);
+}
+
+/* open addressing table, at most half full */
+static void
+build_metric_hash (void)
+{
+	unsigned int h;
+	int i;
+
+	for (metric_hash_size = 16; metric_hash_size < 2 * nmetrics; metric_hash_size *= 2)
+		;
+	metric_hash = malloc (sizeof (int) * metric_hash_size);
+	if (metric_hash == NULL)
+		die (STATE_UNKNOWN, _("Could not allocate memory\n"));
+	memset (metric_hash, -1, sizeof (int) * metric_hash_size);
+
+	for (i = 0; i < nmetrics; i++) {
+		h = metric_hash_value (metrics[i].name) & (metric_hash_size - 1);
+		while (metric_hash[h] != -1)
+			h = (h + 1) & (metric_hash_size - 1);
+		metric_hash[h] = i;
+	}
+}
+
+static int
+find_metric (const char *name)
+{
+	unsigned int h = metric_hash_value (name) & (metric_hash_size - 1);
+
+	while (metric_hash[h] != -1) {
+		if (strcasecmp (metrics[metric_hash[h]].name, name) == 0)
+			return metric_hash[h];
+		h = (h + 1) & (metric_hash_size - 1);
+	}
+	return -1;
+}
+
+/* let the server send only the variables we look at */
+static char *
+metric_query (void)
+{
+	char *query = NULL;
+	int i;
+
+	for (i = 0; i < nmetrics; i++)
+		xasprintf (&query, "%s%s'%s'", query ? query : "show global status where Variable_name in (",
+		           i ? "," : "", metrics[i].name);
+	xasprintf (&query, "%s)", query);
+	return query;
+}
+
+/* thresholds and perfdata of the fetched metrics, with the per second
+ * change of rate metrics taken against the values of the last run */
+static void
+compute_rates (void)
+{
+	state_data *previous = NULL;
+	np_str current = NP_STR_INIT;
+	char *data, *word, *value;
+	time_t now = time (NULL);
+	double interval = 0;
+	int i, have_rates = FALSE;
+
+	for (i = 0; i < nmetrics; i++)
+		if (metrics[i].rate)
+			have_rates = TRUE;
+
+	if (have_rates) {
+		np_enable_state (NULL, 1);
+		if ((previous = np_state_read ()) != NULL) {
+			interval = difftime (now, previous->time);
+			data = strdup ((char *) previous->data);
+			for (word = strtok (data, " "); word; word = strtok (NULL, " ")) {
+				if ((value = strchr (word, '=')) == NULL)
+					continue;
+				*value++ = '\0';
+				if ((i = find_metric (word)) >= 0) {
+					metrics[i].previous = strtod (value, NULL);
+					metrics[i].have_previous = TRUE;
+				}
+			}
+			free (data);
+		}
 	}
 
-	return STATE_OK;
+	for (i = 0; i < nmetrics; i++) {
+		mysql_metric *m = &metrics[i];
+
+		if (!m->found)
+			continue;
+
+		if (m->rate) {
+			np_str_addf (&current, "%s%s=%.0f", current.len ? " " : "", m->name, m->value);
+
+			/* nothing to compare with on the first run or after a restart */
+			if (!m->have_previous || interval <= 0 || m->value < m->previous)
+				continue;
+			m->value = (m->value - m->previous) / interval;
+		}
+
+		m->status = get_status (m->value, m->thresholds);
+		if (m->rate) {
+			char *label;
+			xasprintf (&label, "%s_rate", m->name);
+			m->perf = sperfdata (label, m->value, "", m->warning, m->critical,
+			                     TRUE, 0, FALSE, 0);
+		}
+		else if (m->warning || m->critical)
+			m->perf = sperfdata (m->name, m->value, m->counter ? "c" : "",
+			                     m->warning, m->critical, FALSE, 0, FALSE, 0);
+		else
+			m->perf = perfdata (m->name, (long) m->value, m->counter ? "c" : "",
+			                    FALSE, 0, FALSE, 0, FALSE, 0, FALSE, 0);
+	}
+
+	if (have_rates)
+		np_state_write_string (now, (char *) np_str_get (&current));
+	np_str_free (&current);
 }
 
 
@@ -362,6 +564,7 @@ process_arguments (int argc, char **argv)
 		{"cert", required_argument,0,'a'},
 		{"ca-dir", required_argument, 0, 'D'},
 		{"ciphers", required_argument, 0, 'L'},
+		{"metric", required_argument, 0, 'm'},
 		{0, 0, 0, 0}
 	};
 
@@ -369,7 +572,7 @@ process_arguments (int argc, char **argv)
 		return ERROR;
 
 	while (1) {
-		c = getopt_long (argc, argv, "hlvVnSP:p:u:d:H:s:c:w:a:k:C:D:L:f:g:", longopts, &option);
+		c = getopt_long (argc, argv, "hlvVnSP:p:u:d:H:s:c:w:a:k:C:D:L:f:g:m:", longopts, &option);
 
 		if (c == -1 || c == EOF)
 			break;
@@ -442,6 +645,24 @@ process_arguments (int argc, char **argv)
 			critical = optarg;
 			critical_time = strtod (critical, NULL);
 			break;
+		case 'm': {								/* NAME[/s][,WARN[,CRIT]] */
+			char *name = strdup (optarg), *warn = NULL, *crit = NULL, *p;
+			int rate = FALSE;
+
+			if ((warn = strchr (name, ',')) != NULL) {
+				*warn++ = '\0';
+				if ((crit = strchr (warn, ',')) != NULL)
+					*crit++ = '\0';
+			}
+			if ((p = strstr (name, "/s")) != NULL && p[2] == '\0') {
+				*p = '\0';
+				rate = TRUE;
+			}
+			if (!*name || name[strspn (name, "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789_")])
+				usage2 (_("Invalid status variable name"), optarg);
+			add_metric (name, FALSE, rate, (warn && *warn) ? warn : NULL, (crit && *crit) ? crit : NULL);
+			break;
+		}
 		case 'V':									/* version */
 			print_revision (progname, NP_VERSION);
 			exit (STATE_OK);
@@ -497,6 +718,19 @@ validate_arguments (void)
 	if (db == NULL)
 		db = strdup("");
 
+	/* the default metrics, in the order the server lists them */
+	if (nmetrics == 0) {
+		int u = 0, c = 0;
+		while (u < LENGTH_METRIC_UNIT || c < LENGTH_METRIC_COUNTER) {
+			if (c == LENGTH_METRIC_COUNTER ||
+			    (u < LENGTH_METRIC_UNIT && strcmp (metric_unit[u], metric_counter[c]) < 0))
+				add_metric (metric_unit[u++], FALSE, FALSE, NULL, NULL);
+			else
+				add_metric (metric_counter[c++], TRUE, FALSE, NULL, NULL);
+		}
+	}
+	build_metric_hash ();
+
 	return OK;
 }
 
@@ -559,6 +793,10 @@ print_help (void)
   printf ("    %s\n", _("Path to CA directory"));
   printf (" %s\n", "-L, --ciphers=STRING");
   printf ("    %s\n", _("List of valid SSL ciphers"));
+  printf (" %s\n", "-m, --metric=NAME[/s][,WARN[,CRIT]]");
+  printf ("    %s\n", _("Status variable to report, with optional threshold ranges (may be repeated)."));
+  printf ("    %s\n", _("With /s the change per second since the last check is reported instead."));
+  printf ("    %s\n", _("Default: a fixed set of thread, table, query cache and query counters"));
 
 
   printf ("\n");
@@ -582,4 +820,5 @@ print_usage (void)
   printf (" %s [-d database] [-H host] [-P port] [-s socket]\n",progname);
   printf ("       [-u user] [-p password] [-S] [-l] [-a cert] [-k key]\n");
   printf ("       [-C ca-cert] [-D ca-dir] [-L ciphers] [-f optfile] [-g group]\n");
+  printf ("       [-m metric[/s][,warn[,crit]] ...]\n");
 }
@@ -39,14 +39,39 @@ const char *email = "devel@nagios-plugins.org";
 #include "common.h"
 #include "runcmd.h"
 #include "utils.h"
+#include "utils_proc.h"
+
+#include <ctype.h>
+
+/* how far into the status log the info and program blocks are looked for */
+#define STATUS_HEAD_SIZE 65536
+
+typedef struct status_info {
+	unsigned long latest_entry_time;
+	pid_t nagios_pid;
+	size_t size;
+	unsigned long checks;
+	double latency_min;
+	double latency_max;
+	double latency_sum;
+} status_info;
 
 int process_arguments (int, char **);
+void parse_status (const char *, size_t, status_info *);
+void parse_latency (const char *, size_t, status_info *);
+int daemon_running (pid_t);
+int count_processes (const char *, int *);
 void print_help (void);
 void print_usage (void);
 
 char *status_log = NULL;
 char *process_string = NULL;
+char *lock_file = NULL;
 int expire_minutes = 0;
+int show_stats = FALSE;
+char *latency_warning = NULL;
+char *latency_critical = NULL;
+thresholds *latency_thresholds = NULL;
 
 int verbose = 0;
 
@@ -54,33 +79,14 @@ int
 main (int argc, char **argv)
 {
 	int result = STATE_UNKNOWN;
-	char input_buffer[MAX_INPUT_BUFFER];
-	unsigned long latest_entry_time = 0L;
-	unsigned long temp_entry_time = 0L;
+	np_mapped_file status;
+	status_info info;
 	int proc_entries = 0;
 	time_t current_time;
-	char *temp_ptr;
-	FILE *fp;
-	int procuid = 0;
-	int procpid = 0;
-	int procppid = 0;
-	int procjid = 0;
-	int procvsz = 0;
-	int procrss = 0;
-	char proc_cgroup_hierarchy[MAX_INPUT_BUFFER];
-	float procpcpu = 0;
-	char procstat[8];
-#ifdef PS_USES_PROCETIME
-	char procetime[MAX_INPUT_BUFFER];
-#endif /* PS_USES_PROCETIME */
-	char procprog[MAX_INPUT_BUFFER];
-	char *procargs;
-	int pos, cols;
-	int expected_cols = PS_COLS - 1;
-	const char *zombie = "Z";
-	char *temp_string;
-	output chld_out, chld_err;
-	size_t i;
+	struct timeval parse_start;
+	double parse_time = 0.0;
+	char *buf;
+	pid_t pid;
 
 	setlocale (LC_ALL, "");
 	bindtextdomain (PACKAGE, LOCALEDIR);
@@ -100,32 +106,216 @@ main (int argc, char **argv)
 	/* handle timeouts gracefully... */
 	alarm (timeout_interval);
 
-	/* open the status log */
-	fp = fopen (status_log, "r");
-	if (fp == NULL) {
+	/* map the status log, only the head is read unless statistics are wanted */
+	gettimeofday (&parse_start, NULL);
+	if (np_map_file (&status, status_log) != OK) {
 		die (STATE_CRITICAL, "NAGIOS %s: %s\n", _("CRITICAL"), _("Cannot open status log for reading!"));
 	}
+	parse_status (status.data, status.len, &info);
+	parse_time = (double) deltime (parse_start) / 1.0e6;
+	np_unmap_file (&status);
+
+	/* the daemon from its lock file or the pid in the status log, the
+	 * process table is only searched if neither names it */
+	pid = info.nagios_pid;
+	if (lock_file != NULL) {
+		if ((buf = np_proc_load (lock_file, NULL)) == NULL)
+			die (STATE_CRITICAL, "NAGIOS %s: %s\n", _("CRITICAL"), _("Cannot read lock file!"));
+		pid = strtol (buf, NULL, 10);
+		free (buf);
+	}
+	if (daemon_running (pid))
+		proc_entries = 1;
+	else if (lock_file == NULL)
+		proc_entries = count_processes (argv[0], &result);
 
-	/* get the date/time of the last item updated in the log */
-	while (fgets (input_buffer, MAX_INPUT_BUFFER - 1, fp)) {
-		if ((temp_ptr = strstr (input_buffer, "created=")) != NULL) {
-			temp_entry_time = strtoul (temp_ptr + 8, NULL, 10);
-			latest_entry_time = temp_entry_time;
+	/* reset the alarm handler */
+	alarm (0);
+
+	if (proc_entries == 0) {
+		die (STATE_CRITICAL, "NAGIOS %s: %s\n", _("CRITICAL"), _("Could not locate a running Nagios process!"));
+	}
+
+	if (info.latest_entry_time == 0L) {
+		die (STATE_CRITICAL, "NAGIOS %s: %s\n", _("CRITICAL"), _("Cannot parse Nagios log file for valid time"));
+	}
+
+	time (&current_time);
+	if ((int)(current_time - info.latest_entry_time) > (expire_minutes * 60)) {
+		result = STATE_WARNING;
+	} else {
+		result = STATE_OK;
+	}
+	if (show_stats && info.checks > 0)
+		result = max_state (result, get_status (info.latency_sum / info.checks, latency_thresholds));
+
+	printf ("NAGIOS %s: ", state_text (result));
+	printf (ngettext ("%d process", "%d processes", proc_entries), proc_entries);
+	printf (", ");
+	printf (
+	  ngettext ("status log updated %d second ago",
+	    "status log updated %d seconds ago",
+	    (int) (current_time - info.latest_entry_time) ),
+	    (int) (current_time - info.latest_entry_time) );
+	if (show_stats) {
+		if (info.checks > 0)
+			printf (_(", check latency %.3fs average over %lu checks"),
+			        info.latency_sum / info.checks, info.checks);
+		printf ("|%s %s", perfdata ("size", (long) info.size, "B", FALSE, 0, FALSE, 0, TRUE, 0, FALSE, 0),
+		        fperfdata ("parse_time", parse_time, "s", FALSE, 0, FALSE, 0, TRUE, 0, FALSE, 0));
+		if (info.checks > 0)
+			printf (" %s %s %s",
+			        fperfdata ("latency_min", info.latency_min, "s", FALSE, 0, FALSE, 0, TRUE, 0, FALSE, 0),
+			        sperfdata ("latency_avg", info.latency_sum / info.checks, "s",
+			                   latency_warning, latency_critical, TRUE, 0, FALSE, 0),
+			        fperfdata ("latency_max", info.latency_max, "s", FALSE, 0, FALSE, 0, TRUE, 0, FALSE, 0));
+	}
+	printf ("\n");
+
+	return result;
+}
+
+
+
+/* "created=" in the info block of a Nagios 2 or later status.dat, which
+ * is at the head of the file along with the daemon's pid. A Nagios 1
+ * status.log has a timestamp in brackets on every line instead, the last
+ * one is the newest */
+void
+parse_status (const char *data, size_t len, status_info *info)
+{
+	const char *line, *end, *key, *last = data + len;
+	char value[MAX_INPUT_BUFFER];
+	size_t n;
+
+	memset (info, 0, sizeof (status_info));
+
+	for (line = data; line < last && line - data < STATUS_HEAD_SIZE; line = end + 1) {
+		if ((end = memchr (line, '\n', last - line)) == NULL)
+			end = last;
+		for (key = line; key < end && (*key == '\t' || *key == ' '); key++)
+			;
+		n = end - key < (ptrdiff_t) sizeof (value) ? (size_t) (end - key) : sizeof (value) - 1;
+		memcpy (value, key, n);
+		value[n] = '\0';
+		/* the host, service and contact blocks follow the info and program blocks */
+		if (key == line && (strncmp (value, "host", 4) == 0 || strncmp (value, "service", 7) == 0 ||
+		                    strncmp (value, "contact", 7) == 0))
+			break;
+		if (info->latest_entry_time == 0 && strncmp (value, "created=", 8) == 0)
+			info->latest_entry_time = strtoul (value + 8, NULL, 10);
+		else if (info->nagios_pid == 0 && strncmp (value, "nagios_pid=", 11) == 0)
+			info->nagios_pid = strtol (value + 11, NULL, 10);
+		if (info->latest_entry_time && info->nagios_pid)
 			break;
-		} else if ((temp_ptr = strtok (input_buffer, "]")) != NULL) {
-			temp_entry_time = strtoul (temp_ptr + 1, NULL, 10);
-			if (temp_entry_time > latest_entry_time)
-				latest_entry_time = temp_entry_time;
+	}
+
+	/* scan back from the end for the newest bracketed timestamp, end
+	 * being the newline or the end of the data after each line */
+	end = last;
+	if (end > data && end[-1] == '\n')
+		end--;
+	for (; info->latest_entry_time == 0 && end > data; end = line - 1) {
+		for (line = end; line > data && line[-1] != '\n'; line--)
+			;
+		if (line < end && *line == '[' && end - line > 1 && isdigit ((unsigned char) line[1])) {
+			n = end - line < (ptrdiff_t) sizeof (value) ? (size_t) (end - line) : sizeof (value) - 1;
+			memcpy (value, line, n);
+			value[n] = '\0';
+			if (strchr (value, ']') != NULL)
+				info->latest_entry_time = strtoul (value + 1, NULL, 10);
 		}
+		if (line == data)
+			break;
+	}
+
+	info->size = len;
+	if (show_stats)
+		parse_latency (data, len, info);
+}
+
+/* the check_latency of every host and service status block, in one pass */
+void
+parse_latency (const char *data, size_t len, status_info *info)
+{
+	const char *line, *end, *key, *last = data + len;
+	char value[32];
+	size_t n;
+	double latency;
+
+	for (line = data; line < last; line = end + 1) {
+		if ((end = memchr (line, '\n', last - line)) == NULL)
+			end = last;
+		for (key = line; key < end && (*key == '\t' || *key == ' '); key++)
+			;
+		if (end - key <= 14 || memcmp (key, "check_latency=", 14) != 0)
+			continue;
+		n = end - key - 14 < (ptrdiff_t) sizeof (value) ? (size_t) (end - key - 14) : sizeof (value) - 1;
+		memcpy (value, key + 14, n);
+		value[n] = '\0';
+		latency = strtod (value, NULL);
+		if (info->checks == 0 || latency < info->latency_min)
+			info->latency_min = latency;
+		if (info->checks == 0 || latency > info->latency_max)
+			info->latency_max = latency;
+		info->latency_sum += latency;
+		info->checks++;
 	}
-	fclose (fp);
+}
+
+/* the pid is the daemon if it runs the command looked for */
+int
+daemon_running (pid_t pid)
+{
+	char *args, *exe;
+	int found;
+
+	if (pid <= 0)
+		return FALSE;
+	args = np_proc_args (pid);
+	exe = np_proc_exe (pid);
+	found = (args != NULL && strstr (args, process_string) != NULL) ||
+	        (exe != NULL && strstr (exe, process_string) != NULL);
+	if (verbose >= 2)
+		printf (_("Process %ld %s: %s\n"), (long) pid, found ? _("matches") : _("does not match"),
+		        args ? args : _("not running"));
+	free (args);
+	free (exe);
+	return found;
+}
+
+/* the number of processes with the command in their arguments, from ps */
+int
+count_processes (const char *self, int *result)
+{
+	int proc_entries = 0;
+	int procuid = 0;
+	int procpid = 0;
+	int procppid = 0;
+	int procjid = 0;
+	int procvsz = 0;
+	int procrss = 0;
+	char proc_cgroup_hierarchy[MAX_INPUT_BUFFER];
+	float procpcpu = 0;
+	char procstat[8];
+#ifdef PS_USES_PROCETIME
+	char procetime[MAX_INPUT_BUFFER];
+#endif /* PS_USES_PROCETIME */
+	char procprog[MAX_INPUT_BUFFER];
+	char *procargs;
+	int pos, cols;
+	int expected_cols = PS_COLS - 1;
+	const char *zombie = "Z";
+	char *temp_string;
+	output chld_out, chld_err;
+	size_t i;
 
 	if (verbose >= 2)
 		printf("command: %s\n", PS_COMMAND);
 
 	/* run the command to check for the Nagios process.. */
-	if((result = np_runcmd(PS_COMMAND, &chld_out, &chld_err, 0)) != 0)
-		result = STATE_WARNING;
+	if((*result = np_runcmd(PS_COMMAND, &chld_out, &chld_err, 0)) != 0)
+		*result = STATE_WARNING;
 
 	/* count the number of matching Nagios processes... */
 	for(i = 0; i < chld_out.lines; i++) {
@@ -150,7 +340,7 @@ main (int argc, char **argv)
 			}
 
 			/* May get empty procargs */
-			if (!strstr(procargs, argv[0]) && strstr(procargs, process_string) && strcmp(procargs,"")) {
+			if (!strstr(procargs, self) && strstr(procargs, process_string) && strcmp(procargs,"")) {
 				proc_entries++;
 				if (verbose >= 2) {
 					printf (_("Found process: %s %s\n"), procprog, procargs);
@@ -161,37 +351,9 @@ main (int argc, char **argv)
 
 	/* If we get anything on stderr, at least set warning */
 	if(chld_err.buflen)
-		(void)max_state (result, STATE_WARNING);
-
-	/* reset the alarm handler */
-	alarm (0);
-
-	if (proc_entries == 0) {
-		die (STATE_CRITICAL, "NAGIOS %s: %s\n", _("CRITICAL"), _("Could not locate a running Nagios process!"));
-	}
+		(void)max_state (*result, STATE_WARNING);
 
-	if (latest_entry_time == 0L) {
-		die (STATE_CRITICAL, "NAGIOS %s: %s\n", _("CRITICAL"), _("Cannot parse Nagios log file for valid time"));
-	}
-
-	time (&current_time);
-	if ((int)(current_time - latest_entry_time) > (expire_minutes * 60)) {
-		result = STATE_WARNING;
-	} else {
-		result = STATE_OK;
-	}
-
-	printf ("NAGIOS %s: ", (result == STATE_OK) ? _("OK") : _("WARNING"));
-	printf (ngettext ("%d process", "%d processes", proc_entries), proc_entries);
-	printf (", ");
-	printf (
-	  ngettext ("status log updated %d second ago",
-	    "status log updated %d seconds ago",
-	    (int) (current_time - latest_entry_time) ),
-	    (int) (current_time - latest_entry_time) );
-	printf ("\n");
-
-	return result;
+	return proc_entries;
 }
 
 
@@ -203,10 +365,18 @@ process_arguments (int argc, char **argv)
 	int c;
 
 	int option = 0;
+	enum {
+		LATENCY_WARNING = CHAR_MAX + 1,
+		LATENCY_CRITICAL
+	};
 	static struct option longopts[] = {
 		{"filename", required_argument, 0, 'F'},
 		{"expires", required_argument, 0, 'e'},
 		{"command", required_argument, 0, 'C'},
+		{"lock-file", required_argument, 0, 'L'},
+		{"stats", no_argument, 0, 's'},
+		{"latency-warning", required_argument, 0, LATENCY_WARNING},
+		{"latency-critical", required_argument, 0, LATENCY_CRITICAL},
 		{"timeout", optional_argument, 0, 't'},
 		{"version", no_argument, 0, 'V'},
 		{"help", no_argument, 0, 'h'},
@@ -229,7 +399,7 @@ process_arguments (int argc, char **argv)
 	}
 
 	while (1) {
-		c = getopt_long (argc, argv, "+hVvF:C:e:t:", longopts, &option);
+		c = getopt_long (argc, argv, "+hVvsF:C:L:e:t:", longopts, &option);
 
 		if (c == -1 || c == EOF || c == 1)
 			break;
@@ -247,6 +417,20 @@ process_arguments (int argc, char **argv)
 		case 'C':									/* command */
 			process_string = optarg;
 			break;
+		case 'L':									/* lock file */
+			lock_file = optarg;
+			break;
+		case 's':									/* statistics */
+			show_stats = TRUE;
+			break;
+		case LATENCY_WARNING:
+			latency_warning = optarg;
+			show_stats = TRUE;
+			break;
+		case LATENCY_CRITICAL:
+			latency_critical = optarg;
+			show_stats = TRUE;
+			break;
 		case 'e':									/* expiry time */
 			if (is_intnonneg (optarg))
 				expire_minutes = atoi (optarg);
@@ -272,6 +456,9 @@ process_arguments (int argc, char **argv)
 	if (process_string == NULL)
 		die (STATE_UNKNOWN, _("You must provide a process string\n"));
 
+	if (show_stats)
+		set_thresholds (&latency_thresholds, latency_warning, latency_critical);
+
 	return OK;
 }
 
@@ -287,7 +474,8 @@ print_help (void)
 	printf ("%s\n", _("This plugin checks the status of the Nagios process on the local machine"));
   printf ("%s\n", _("The plugin will check to make sure the Nagios status log is no older than"));
   printf ("%s\n", _("the number of minutes specified by the expires option."));
-  printf ("%s\n", _("It also checks the process table for a process matching the command argument."));
+  printf ("%s\n", _("It also checks that the Nagios daemon is running a command matching the"));
+  printf ("%s\n", _("command argument."));
 
   printf ("\n\n");
 
@@ -302,6 +490,15 @@ print_help (void)
   printf ("    %s\n", _("Minutes aging after which logfile is considered stale"));
   printf (" %s\n", "-C, --command=STRING");
   printf ("    %s\n", _("Substring to search for in process arguments"));
+  printf (" %s\n", "-L, --lock-file=FILE");
+  printf ("    %s\n", _("The lock_file of nagios.cfg, holding the pid of the daemon. Without it the"));
+  printf ("    %s\n", _("nagios_pid of the status log is used, and the process table is searched"));
+  printf ("    %s\n", _("only if that process does not match the command"));
+  printf (" %s\n", "-s, --stats");
+  printf ("    %s\n", _("Report the size of the status log, the time taken to parse it and the"));
+  printf ("    %s\n", _("check latency of its hosts and services. This reads the whole file"));
+  printf (" %s\n", "--latency-warning=RANGE, --latency-critical=RANGE");
+  printf ("    %s\n", _("Thresholds on the average check latency in seconds, these imply --stats"));
   printf (" %s\n", "-t, --timeout=INTEGER");
   printf ("    %s\n", _("Timeout for the plugin in seconds"));
   printf (UT_VERBOSE);
@@ -320,4 +517,5 @@ print_usage (void)
 {
   printf ("%s\n", _("Usage:"));
 	printf ("%s -F <status log file> -t <timeout_seconds> -e <expire_minutes> -C <process_string>\n", progname);
+	printf ("  [-L <lock file>] [-s] [--latency-warning=<range>] [--latency-critical=<range>]\n");
 }
@@ -74,7 +74,38 @@ int show_all=FALSE;
 
 char recv_buffer[MAX_INPUT_BUFFER];
 
+typedef struct nt_var {
+	enum checkvars vars_to_check;
+	char *value_list;
+	unsigned long warning_value;
+	unsigned long critical_value;
+	int check_warning_value;
+	int check_critical_value;
+	int show_all;
+} nt_var;
+
+nt_var *vars=NULL;
+int num_vars=0;
+
+/* requests sent up front, fetch_data() answers from here */
+typedef struct nt_request {
+	char *send_buffer;
+	char *reply;
+	int sd;
+} nt_request;
+
+nt_request *requests=NULL;
+int num_requests=0;
+
 void fetch_data (const char* address, int port, const char* sendb);
+int check_variable(char **, char **);
+void add_variable(enum checkvars);
+void select_variable(int);
+char *build_request(unsigned long);
+int cpuload_args(unsigned long *, int);
+void queue_requests(void);
+void queue_request(char *);
+void send_requests(void);
 int process_arguments(int, char **);
 void preparelist(char *string);
 int strtoularray(unsigned long *array, char *string, const char *delim);
@@ -82,6 +113,83 @@ void print_help(void);
 void print_usage(void);
 
 int main(int argc, char **argv){
+	int result = STATE_UNKNOWN;
+	int var_result;
+	char *output_message=NULL;
+	char *perfdata=NULL;
+	char *var_message;
+	char *var_perfdata;
+	char *sep;
+	int i;
+
+	setlocale (LC_ALL, "");
+	bindtextdomain (PACKAGE, LOCALEDIR);
+	textdomain (PACKAGE);
+
+	/* Parse extra opts if any */
+	argv=np_extra_opts (&argc, argv, progname);
+
+	if(process_arguments(argc,argv) == ERROR)
+		usage4 (_("Could not parse arguments"));
+
+	/* initialize alarm signal handling */
+	signal(SIGALRM,socket_timeout_alarm_handler);
+
+	/* set socket timeout */
+	alarm(timeout_interval);
+
+	/* NSClient answers one request per connection, so send all of them
+	 * at once and let the agent work on them in parallel */
+	for (i=0; i<num_vars; i++) {
+		select_variable(i);
+		queue_requests();
+	}
+	send_requests();
+
+	if (num_vars==1) {
+		select_variable(0);
+		result=check_variable(&output_message, &perfdata);
+	} else {
+		/* one line for all variables, perfdata collected at the end */
+		output_message=strdup("");
+		perfdata=strdup("");
+		for (i=0; i<num_vars; i++) {
+			select_variable(i);
+			var_perfdata=NULL;
+			var_result=check_variable(&var_message, &var_perfdata);
+			if (var_message==NULL)
+				var_message=strdup("");
+			result=(i==0) ? var_result : max_state(result, var_result);
+			if ((sep=strchr(var_message,'|'))!=NULL) {
+				*sep++=0;
+				while (*sep==' ')
+					sep++;
+				if (var_perfdata==NULL)
+					var_perfdata=sep;
+			}
+			xasprintf(&output_message,"%s%s%s",output_message,i?"; ":"",var_message);
+			while (var_perfdata!=NULL && *var_perfdata==' ')
+				var_perfdata++;
+			if (var_perfdata!=NULL && *var_perfdata)
+				xasprintf(&perfdata,"%s%s%s",perfdata,*perfdata?" ":"",var_perfdata);
+		}
+		if (*perfdata==0)
+			perfdata=NULL;
+	}
+
+	/* reset timeout */
+	alarm(0);
+
+	if (perfdata==NULL)
+		printf("%s\n",output_message);
+	else
+		printf("%s | %s\n",output_message,perfdata);
+	return result;
+}
+
+
+/* check the variable set up by select_variable() */
+int check_variable(char **output_message_ptr, char **perfdata_ptr){
 
 /* should be 	int result = STATE_UNKNOWN; */
 
@@ -116,27 +224,11 @@ int main(int argc, char **argv){
 	int isPercent = FALSE;
 	int allRight = FALSE;
 
-	setlocale (LC_ALL, "");
-	bindtextdomain (PACKAGE, LOCALEDIR);
-	textdomain (PACKAGE);
-
-	/* Parse extra opts if any */
-	argv=np_extra_opts (&argc, argv, progname);
-
-	if(process_arguments(argc,argv) == ERROR)
-		usage4 (_("Could not parse arguments"));
-
-	/* initialize alarm signal handling */
-	signal(SIGALRM,socket_timeout_alarm_handler);
-
-	/* set socket timeout */
-	alarm(timeout_interval);
-
 	switch (vars_to_check) {
 
 	case CHECK_CLIENTVERSION:
 
-		xasprintf(&send_buffer, "%s&1", req_password);
+		send_buffer = build_request(0);
 		fetch_data (server_address, server_port, send_buffer);
 		if (value_list != NULL && strcmp(recv_buffer, value_list) != 0) {
 			xasprintf (&output_message, _("Wrong client version - running: %s, required: %s"), recv_buffer, value_list);
@@ -160,15 +252,10 @@ int main(int argc, char **argv){
 			temp_string_perf = strdup (" ");
 
 			/* loop until one of the parameters is wrong or not present */
-			while (lvalue_list[0+offset]> (unsigned long)0 &&
-						 lvalue_list[0+offset]<=(unsigned long)17280 &&
-						 lvalue_list[1+offset]> (unsigned long)0 &&
-						 lvalue_list[1+offset]<=(unsigned long)100 &&
-						 lvalue_list[2+offset]> (unsigned long)0 &&
-						 lvalue_list[2+offset]<=(unsigned long)100) {
+			while (cpuload_args(lvalue_list, offset)) {
 
 				/* Send request and retrieve data */
-				xasprintf(&send_buffer,"%s&2&%lu",req_password,lvalue_list[0+offset]);
+				send_buffer = build_request(lvalue_list[0+offset]);
 				fetch_data (server_address, server_port, send_buffer);
 
 				utilization=strtoul(recv_buffer,NULL,10);
@@ -207,7 +294,7 @@ int main(int argc, char **argv){
 
 			output_message = strdup (_("wrong -l argument"));
 		} else {
-			xasprintf(&send_buffer, "%s&3", req_password);
+			send_buffer = build_request(0);
 			fetch_data (server_address, server_port, send_buffer);
 			uptime=strtoul(recv_buffer,NULL,10);
 			updays = uptime / 86400;
@@ -240,7 +327,7 @@ int main(int argc, char **argv){
 		else if (strlen(value_list)!=1)
 			output_message = strdup (_("wrong -l argument"));
 		else {
-			xasprintf(&send_buffer,"%s&4&%s", req_password, value_list);
+			send_buffer = build_request(0);
 			fetch_data (server_address, server_port, send_buffer);
 			fds=strtok(recv_buffer,"&");
 			tds=strtok(NULL,"&");
@@ -283,9 +370,7 @@ int main(int argc, char **argv){
 		if (value_list==NULL)
 			output_message = strdup (_("No service/process specified"));
 		else {
-			preparelist(value_list);		/* replace , between services with & to send the request */
-			xasprintf(&send_buffer,"%s&%u&%s&%s", req_password,(vars_to_check==CHECK_SERVICESTATE)?5:6,
-							 (show_all==TRUE) ? "ShowAll" : "ShowFail",value_list);
+			send_buffer = build_request(0);
 			fetch_data (server_address, server_port, send_buffer);
 			numstr = strtok(recv_buffer,"&");
 			if (numstr == NULL)
@@ -298,7 +383,7 @@ int main(int argc, char **argv){
 
 	case CHECK_MEMUSE:
 
-		xasprintf(&send_buffer,"%s&7", req_password);
+		send_buffer = build_request(0);
 		fetch_data (server_address, server_port, send_buffer);
 		numstr = strtok(recv_buffer,"&");
 		if (numstr == NULL)
@@ -356,13 +441,13 @@ int main(int argc, char **argv){
 			output_message = strdup (_("No counter specified"));
 		else
 		{
-			preparelist (value_list);	/* replace , between services with & to send the request */
+			send_buffer = build_request (0);
+			preparelist (value_list);	/* replace , between the parameters with & */
 			isPercent = (strchr (value_list, '%') != NULL);
 
 			strtok (value_list, "&");	/* burn the first parameters */
 			description = strtok (NULL, "&");
 			counter_unit = strtok (NULL, "&");
-			xasprintf (&send_buffer, "%s&8&%s", req_password, value_list);
 			fetch_data (server_address, server_port, send_buffer);
 			counter_value = atof (recv_buffer);
 
@@ -440,8 +525,7 @@ int main(int argc, char **argv){
 		if (value_list==NULL)
 			output_message = strdup (_("No counter specified"));
 		else {
-			preparelist(value_list);		/* replace , between services with & to send the request */
-			xasprintf(&send_buffer,"%s&9&%s", req_password,value_list);
+			send_buffer = build_request(0);
 			fetch_data (server_address, server_port, send_buffer);
 			age_in_minutes = atoi(strtok(recv_buffer,"&"));
 			description = strtok(NULL,"&");
@@ -470,7 +554,7 @@ int main(int argc, char **argv){
 		if (value_list==NULL)
 			output_message = strdup (_("No counter specified"));
 		else {
-			xasprintf(&send_buffer,"%s&10&%s", req_password,value_list);
+			send_buffer = build_request(0);
 			fetch_data (server_address, server_port, send_buffer);
 			if (!strncmp(recv_buffer,"ERROR",5)) {
 				printf("NSClient - %s\n",recv_buffer);
@@ -488,13 +572,8 @@ int main(int argc, char **argv){
 
 	}
 
-	/* reset timeout */
-	alarm(0);
-
-	if (perfdata==NULL)
-		printf("%s\n",output_message);
-	else
-		printf("%s | %s\n",output_message,perfdata);
+	*output_message_ptr = output_message;
+	*perfdata_ptr = perfdata;
 	return return_code;
 }
 
@@ -594,20 +673,40 @@ int process_arguments(int argc, char **argv){
 					vars_to_check=CHECK_INSTANCES;
 				else
 					return ERROR;
+				add_variable(vars_to_check);
 				break;
+			/* -l, -w, -c and -d apply to the -v given before them; given
+			 * before the first -v they are the default for all of them */
 			case 'l': /* value list */
-				value_list = optarg;
+				if (num_vars > 0)
+					vars[num_vars-1].value_list = optarg;
+				else
+					value_list = optarg;
 				break;
 			case 'w': /* warning threshold */
-				warning_value=strtoul(optarg,NULL,10);
-				check_warning_value=TRUE;
+				if (num_vars > 0) {
+					vars[num_vars-1].warning_value = strtoul(optarg,NULL,10);
+					vars[num_vars-1].check_warning_value = TRUE;
+				} else {
+					warning_value=strtoul(optarg,NULL,10);
+					check_warning_value=TRUE;
+				}
 				break;
 			case 'c': /* critical threshold */
-				critical_value=strtoul(optarg,NULL,10);
-				check_critical_value=TRUE;
+				if (num_vars > 0) {
+					vars[num_vars-1].critical_value = strtoul(optarg,NULL,10);
+					vars[num_vars-1].check_critical_value = TRUE;
+				} else {
+					critical_value=strtoul(optarg,NULL,10);
+					check_critical_value=TRUE;
+				}
 				break;
 			case 'd': /* Display select for services */
-				if (!strcmp(optarg,"SHOWALL"))
+				if (strcmp(optarg,"SHOWALL"))
+					break;
+				if (num_vars > 0)
+					vars[num_vars-1].show_all = TRUE;
+				else
 					show_all = TRUE;
 				break;
 			case 'u':
@@ -622,7 +721,7 @@ int process_arguments(int argc, char **argv){
 	if (server_address == NULL)
 		usage4 (_("You must provide a server address or host name"));
 
-	if (vars_to_check==CHECK_NONE)
+	if (num_vars==0)
 		return ERROR;
 
 	if (req_password == NULL)
@@ -633,10 +732,195 @@ int process_arguments(int argc, char **argv){
 
 
 
+/* remember a -v along with the options given before the first -v */
+void add_variable(enum checkvars var) {
+	vars = realloc(vars, (num_vars + 1) * sizeof(nt_var));
+	if (vars == NULL)
+		die(STATE_UNKNOWN, _("Could not realloc() units [%d]\n"), num_vars);
+	vars[num_vars].vars_to_check = var;
+	vars[num_vars].value_list = value_list;
+	vars[num_vars].warning_value = warning_value;
+	vars[num_vars].critical_value = critical_value;
+	vars[num_vars].check_warning_value = check_warning_value;
+	vars[num_vars].check_critical_value = check_critical_value;
+	vars[num_vars].show_all = show_all;
+	num_vars++;
+}
+
+/* make variable i the one check_variable() looks at */
+void select_variable(int i) {
+	vars_to_check = vars[i].vars_to_check;
+	/* the checks modify the list in place */
+	value_list = vars[i].value_list ? strdup(vars[i].value_list) : NULL;
+	warning_value = vars[i].warning_value;
+	critical_value = vars[i].critical_value;
+	check_warning_value = vars[i].check_warning_value;
+	check_critical_value = vars[i].check_critical_value;
+	show_all = vars[i].show_all;
+}
+
+/* the request NSClient gets for the selected variable, minutes being the
+ * average a CPU load request asks for.  NULL when the arguments make no
+ * request, check_variable() reports why */
+char *build_request(unsigned long minutes) {
+	char *send_buffer=NULL;
+	char *list=NULL;
+
+	/* replace , between services with & to send the request */
+	if (value_list!=NULL) {
+		list = strdup(value_list);
+		preparelist(list);
+	}
+
+	switch (vars_to_check) {
+	case CHECK_CLIENTVERSION:
+		xasprintf(&send_buffer, "%s&1", req_password);
+		break;
+	case CHECK_CPULOAD:
+		xasprintf(&send_buffer, "%s&2&%lu", req_password, minutes);
+		break;
+	case CHECK_UPTIME:
+		xasprintf(&send_buffer, "%s&3", req_password);
+		break;
+	case CHECK_USEDDISKSPACE:
+		if (value_list!=NULL && strlen(value_list)==1)
+			xasprintf(&send_buffer, "%s&4&%s", req_password, value_list);
+		break;
+	case CHECK_SERVICESTATE:
+	case CHECK_PROCSTATE:
+		if (list!=NULL)
+			xasprintf(&send_buffer, "%s&%u&%s&%s", req_password, (vars_to_check==CHECK_SERVICESTATE)?5:6,
+			          (show_all==TRUE) ? "ShowAll" : "ShowFail", list);
+		break;
+	case CHECK_MEMUSE:
+		xasprintf(&send_buffer, "%s&7", req_password);
+		break;
+	case CHECK_COUNTER:
+		/* only the counter, the other parameters are for the output */
+		if (list!=NULL)
+			xasprintf(&send_buffer, "%s&8&%.*s", req_password, (int) strcspn(list, "&"), list);
+		break;
+	case CHECK_FILEAGE:
+		if (list!=NULL)
+			xasprintf(&send_buffer, "%s&9&%s", req_password, list);
+		break;
+	case CHECK_INSTANCES:
+		if (value_list!=NULL)
+			xasprintf(&send_buffer, "%s&10&%s", req_password, value_list);
+		break;
+	default:
+		break;
+	}
+
+	free(list);
+	return send_buffer;
+}
+
+/* whether the -l list of CPULOAD holds another minutes,warning,critical
+ * triplet at offset */
+int cpuload_args(unsigned long *list, int offset) {
+	return offset+2<MAX_VALUE_LIST &&
+	       list[offset]>0 && list[offset]<=17280 &&
+	       list[offset+1]>0 && list[offset+1]<=100 &&
+	       list[offset+2]>0 && list[offset+2]<=100;
+}
+
+/* queue the requests check_variable() is going to send for the selected
+ * variable */
+void queue_requests(void) {
+	char *send_buffer;
+	unsigned long list[MAX_VALUE_LIST];
+	int offset;
+
+	if (vars_to_check==CHECK_CPULOAD) {
+		if (value_list==NULL || strtoularray(list,value_list,",")==FALSE)
+			return;
+		for (offset=0; cpuload_args(list, offset); offset+=3)
+			queue_request(build_request(list[offset]));
+	} else if ((send_buffer=build_request(0))!=NULL)
+		queue_request(send_buffer);
+}
+
+void queue_request(char *send_buffer) {
+	int i;
+
+	for (i=0; i<num_requests; i++)
+		if (!strcmp(requests[i].send_buffer, send_buffer))
+			return;
+
+	requests = realloc(requests, (num_requests + 1) * sizeof(nt_request));
+	if (requests == NULL)
+		die(STATE_UNKNOWN, _("Could not realloc() units [%d]\n"), num_requests);
+	requests[num_requests].send_buffer = send_buffer;
+	requests[num_requests].reply = NULL;
+	requests[num_requests].sd = -1;
+	num_requests++;
+}
+
+/* open a connection per queued request, send them all and collect the
+ * replies as they come in.  Requests that fail here are sent again by
+ * fetch_data(), which reports the error. */
+void send_requests(void) {
+	struct pollfd *pfd;
+	char buffer[MAX_INPUT_BUFFER];
+	int i, n, pending=0;
+
+	/* a single request gains nothing */
+	if (num_requests < 2)
+		return;
+
+	pfd = calloc(num_requests, sizeof(struct pollfd));
+	if (pfd == NULL)
+		die(STATE_UNKNOWN, _("Could not calloc() units [%d]\n"), num_requests);
+
+	for (i=0; i<num_requests; i++) {
+		pfd[i].fd = -1;
+		if (my_tcp_connect(server_address, server_port, &requests[i].sd) != STATE_OK)
+			continue;
+		n = strlen(requests[i].send_buffer);
+		if (send(requests[i].sd, requests[i].send_buffer, n, 0) != n) {
+			close(requests[i].sd);
+			continue;
+		}
+		pfd[i].fd = requests[i].sd;
+		pfd[i].events = POLLIN;
+		pending++;
+	}
+
+	while (pending > 0 && poll(pfd, num_requests, -1) > 0) {
+		for (i=0; i<num_requests; i++) {
+			if (pfd[i].fd < 0 || pfd[i].revents == 0)
+				continue;
+			/* like process_tcp_request(), the first chunk is the reply */
+			n = recv(pfd[i].fd, buffer, sizeof(buffer) - 1, 0);
+			if (n > 0) {
+				buffer[n] = 0;
+				requests[i].reply = strdup(buffer);
+			}
+			close(pfd[i].fd);
+			pfd[i].fd = -1;
+			pending--;
+		}
+	}
+
+	free(pfd);
+}
+
 void fetch_data (const char *address, int port, const char *sendb) {
-	int result;
+	int result = STATE_UNKNOWN;
+	int i;
+
+	for (i=0; i<num_requests; i++) {
+		if (requests[i].reply != NULL && !strcmp(requests[i].send_buffer, sendb)) {
+			strncpy(recv_buffer, requests[i].reply, sizeof(recv_buffer) - 1);
+			recv_buffer[sizeof(recv_buffer) - 1] = 0;
+			result = STATE_OK;
+			break;
+		}
+	}
 
-	result=process_tcp_request(address, port, sendb, recv_buffer,sizeof(recv_buffer));
+	if (result != STATE_OK)
+		result=process_tcp_request(address, port, sendb, recv_buffer,sizeof(recv_buffer));
 
 	if(result!=STATE_OK)
 		die (result, _("could not fetch information from server\n"));
@@ -719,7 +1003,9 @@ void print_help(void)
 	printf (" %s\n", "-V, --version");
 	printf ("   %s\n", _("Print version information"));
 	printf (" %s\n", "-v, --variable=STRING");
-	printf ("   %s\n\n", _("Variable to check"));
+	printf ("   %s\n", _("Variable to check, may be given several times to check all of them in one"));
+	printf ("   %s\n", _("run. -l, -w, -c and -d apply to the -v given before them, or to every"));
+	printf ("   %s\n\n", _("variable when given before the first -v"));
 	printf ("%s\n", _("Valid variables are:"));
 	printf (" %s", "CLIENTVERSION =");
 	printf (" %s\n", _("Get the NSClient version"));
@@ -795,6 +1081,6 @@ void print_usage(void)
 {
 	printf ("%s\n", _("Usage:"));
 	printf ("%s -H host -v variable [-p port] [-w warning] [-c critical]\n",progname);
-	printf ("[-l params] [-d SHOWALL] [-u](DEPRECATED) [-t timeout]\n");
+	printf ("[-l params] [-d SHOWALL] [-v variable ...] [-u](DEPRECATED) [-t timeout]\n");
 }
 
@@ -43,7 +43,8 @@ const char *email = "devel@nagios-plugins.org";
 #include "netutils.h"
 #include "utils.h"
 
-static char *server_address=NULL;
+static char **server_addresses=NULL;
+static int num_server_addresses=0;
 static int port=123;
 static int verbose=0;
 static int quiet=0;
@@ -59,8 +60,6 @@ static char *jcrit="-1:10000";
 static short do_truechimers=0;
 static char *twarn="0:";
 static char *tcrit="0:";
-static int syncsource_found=0;
-static int li_alarm=0;
 
 int process_arguments (int, char **);
 thresholds *offset_thresholds = NULL;
@@ -73,6 +72,22 @@ void print_usage (void);
 /* max size of control message data */
 #define MAX_CM_SIZE 468
 
+/* this structure holds the results of checking one server */
+typedef struct {
+	const char *host;
+	int responded;          /* 0 if the server never answered */
+	int syncsource_found;
+	int li_alarm;
+	int offset_result;
+	double offset;
+	double jitter;
+	int stratum;
+	int num_truechimers;
+	int result;             /* overall state for this server, only the
+	                           sync state until check_peer has run */
+	int oresult, jresult, sresult, tresult;
+} ntp_peer_results;
+
 /* this structure holds everything in an ntp control message as per rfc1305 */
 typedef struct {
 	uint8_t flags;       /* byte with leapindicator,vers,mode. see macros */
@@ -188,33 +203,245 @@ setup_control_request(ntp_control_message *p, uint8_t opcode, uint16_t seq){
 	/* Remaining fields are zero for requests */
 }
 
-/* This function does all the actual work; roughly here's what it does
- * beside setting the offest, jitter and stratum passed as argument:
+/* where the conversation with one server stands */
+enum { STAGE_READSTAT, STAGE_READVAR, STAGE_DONE };
+
+/* the state of the conversation with one server; it is kept here rather
+ * than on the stack so that all servers can be asked at the same time
+ * from one poll() loop */
+typedef struct {
+	ntp_peer_results *r;
+	int conn;
+	int stage;
+	ntp_assoc_status_pair *peers;
+	int npeers, peers_size, peer_offset;
+	int peer;               /* index of the peer the READVAR is about */
+	int min_peer_sel;
+	const char *getvar;
+	char *data;
+} ntp_conversation;
+
+void send_readstat(ntp_conversation *c){
+	ntp_control_message req;
+
+	setup_control_request(&req, OP_READSTAT, 1);
+	DBG(printf("sending READSTAT request to %s\n", c->r->host));
+	write(c->conn, &req, SIZEOF_NTPCM(req));
+	DBG(print_ntp_control_message(&req));
+}
+
+void send_readvar(ntp_conversation *c){
+	ntp_control_message req;
+
+	setup_control_request(&req, OP_READVAR, 2);
+	req.assoc = c->peers[c->peer].assoc;
+	/* Putting the wanted variable names in the request
+	 * cause the server to provide _only_ the requested values.
+	 * thus reducing net traffic, guaranteeing us only a single
+	 * datagram in reply, and making interpretation much simpler
+	 */
+	/* Older servers doesn't know what jitter is, so if we get an
+	 * error on the first pass we redo it with "dispersion" */
+	strncpy(req.data, c->getvar, MAX_CM_SIZE-1);
+	req.count = htons(strlen(c->getvar));
+	DBG(printf("sending READVAR request to %s...\n", c->r->host));
+	write(c->conn, &req, SIZEOF_NTPCM(req));
+	DBG(print_ntp_control_message(&req));
+}
+
+/* ask for the variables of the next peer worth looking at, or end the
+ * conversation when there is none left */
+void next_readvar(ntp_conversation *c){
+	/* Only query this server if it is the current sync source */
+	/* If there's no sync.peer, query all candidates and use the best one */
+	while(c->peer < c->npeers && PEER_SEL(c->peers[c->peer].status) < c->min_peer_sel)
+		c->peer++;
+	if(c->peer == c->npeers){
+		c->stage = STAGE_DONE;
+		c->r->responded = 1;
+		return;
+	}
+	if(verbose) printf("Getting offset, jitter and stratum for peer %.2x\n", ntohs(c->peers[c->peer].assoc));
+	free(c->data);
+	xasprintf(&c->data, "");
+	send_readvar(c);
+}
+
+void readstat_response(ntp_conversation *c, const ntp_control_message *req){
+	ntp_peer_results *r = c->r;
+	int i, num_candidates=0;
+	void *tmp;
+
+	if (LI(req->flags) == LI_ALARM) r->li_alarm = 1;
+	/* Each peer identifier is 4 bytes in the data section, which
+	 * we represent as a ntp_assoc_status_pair datatype.
+	 */
+	c->peers_size+=ntohs(req->count);
+	if((tmp=realloc(c->peers, c->peers_size)) == NULL)
+		die(STATE_UNKNOWN, "can not (re)allocate 'peers' buffer\n");
+	c->peers=tmp;
+	memcpy((void*)((ptrdiff_t)c->peers+c->peer_offset), (void*)req->data, ntohs(req->count));
+	c->npeers=c->peers_size/sizeof(ntp_assoc_status_pair);
+	c->peer_offset+=ntohs(req->count);
+
+	/* keep sending requests until the server stops setting the
+	 * REM_MORE bit, though usually this is only 1 packet. */
+	if(req->op&REM_MORE){
+		send_readstat(c);
+		return;
+	}
+
+	/* first, let's find out if we have a sync source, or if there are
+	 * at least some candidates. In the latter case we'll issue
+	 * a warning but go ahead with the check on them. */
+	for (i = 0; i < c->npeers; i++){
+		if(PEER_SEL(c->peers[i].status) >= PEER_TRUECHIMER){
+			r->num_truechimers++;
+			if(PEER_SEL(c->peers[i].status) >= PEER_INCLUDED){
+				num_candidates++;
+				if(PEER_SEL(c->peers[i].status) >= PEER_SYNCSOURCE){
+					r->syncsource_found=1;
+					c->min_peer_sel=PEER_SYNCSOURCE;
+				}
+			}
+		}
+	}
+	if(verbose) printf("%d candidate peers available\n", num_candidates);
+	if(verbose && r->syncsource_found) printf("synchronization source found\n");
+	if(! r->syncsource_found){
+		r->result = STATE_WARNING;
+		if(verbose) printf("warning: no synchronization source found\n");
+	}
+	if(r->li_alarm){
+		r->result = STATE_WARNING;
+		if(verbose) printf("warning: LI_ALARM bit is set\n");
+	}
+
+	c->stage = STAGE_READVAR;
+	c->peer = 0;
+	next_readvar(c);
+}
+
+/* take the offset, jitter and stratum from the variables of the current
+ * peer, when its offset is the best one so far */
+void parse_peer_vars(ntp_conversation *c){
+	ntp_peer_results *r = c->r;
+	double tmp_offset = 0;
+	char *value, *nptr;
+	int assoc = ntohs(c->peers[c->peer].assoc);
+
+	if(verbose > 1)
+		printf("Server responded: >>>%s<<<\n", c->data);
+
+	/* get the offset */
+	if(verbose)
+		printf("parsing offset from peer %.2x: ", assoc);
+
+	value = np_extract_ntpvar(c->data, "offset");
+	nptr=NULL;
+	/* Convert the value if we have one */
+	if(value != NULL)
+		tmp_offset = strtod(value, &nptr) / 1000;
+	/* If value is null or no conversion was performed */
+	if(value == NULL || value==nptr) {
+		if(verbose) printf("error: unable to read server offset response.\n");
+	} else {
+		if(verbose) printf("%.10g\n", tmp_offset);
+		if(r->offset_result == STATE_UNKNOWN || fabs(tmp_offset) < fabs(r->offset)) {
+			r->offset = tmp_offset;
+			r->offset_result = STATE_OK;
+		} else {
+			/* Skip this one; move to the next */
+			return;
+		}
+	}
+
+	if(do_jitter) {
+		/* get the jitter */
+		if(verbose) {
+			printf("parsing %s from peer %.2x: ", strstr(c->getvar, "dispersion") != NULL ? "dispersion" : "jitter", assoc);
+		}
+		value = np_extract_ntpvar(c->data, strstr(c->getvar, "dispersion") != NULL ? "dispersion" : "jitter");
+		nptr=NULL;
+		/* Convert the value if we have one */
+		if(value != NULL)
+			r->jitter = strtod(value, &nptr);
+		/* If value is null or no conversion was performed */
+		if(value == NULL || value==nptr) {
+			if(verbose) printf("error: unable to read server jitter/dispersion response.\n");
+			r->jitter = -1;
+		} else if(verbose) {
+			printf("%.10g\n", r->jitter);
+		}
+	}
+
+	if(do_stratum) {
+		/* get the stratum */
+		if(verbose) {
+			printf("parsing stratum from peer %.2x: ", assoc);
+		}
+		value = np_extract_ntpvar(c->data, "stratum");
+		nptr=NULL;
+		/* Convert the value if we have one */
+		if(value != NULL)
+			r->stratum = strtol(value, &nptr, 10);
+		if(value == NULL || value==nptr) {
+			if(verbose) printf("error: unable to read server stratum response.\n");
+			r->stratum = -1;
+		} else {
+			if(verbose) printf("%i\n", r->stratum);
+		}
+	}
+}
+
+void readvar_response(ntp_conversation *c, const ntp_control_message *req){
+	if(!(req->op&REM_ERROR))
+		xasprintf(&c->data, "%s%.*s", c->data, ntohs(req->count), req->data);
+	if(req->op&REM_MORE){
+		send_readvar(c);
+		return;
+	}
+
+	if(req->op&REM_ERROR) {
+		if(strstr(c->getvar, "jitter")) {
+			if(verbose) printf("The command failed. This is usually caused by servers refusing the 'jitter'\nvariable. Restarting with 'dispersion'...\n");
+			c->getvar = "stratum,offset,dispersion";
+			next_readvar(c);
+			return;
+		} else if(strlen(c->getvar)) {
+			if(verbose) printf("Server didn't like dispersion either; will retrieve everything\n");
+			c->getvar = "";
+			next_readvar(c);
+			return;
+		}
+	}
+
+	parse_peer_vars(c);
+	c->peer++;
+	next_readvar(c);
+}
+
+/* This function does all the actual work, for all servers at once; roughly
+ * here's what it does beside setting the offset, jitter and stratum of
+ * each server's results:
  *  - offset can be negative, so if it cannot get the offset, offset_result
  *    is set to UNKNOWN, otherwise OK.
  *  - jitter and stratum are set to -1 if they cannot be retrieved so any
  *    positive value means a success retrieving the value.
- *  - status is set to WARNING if there's no sync.peer (otherwise OK) and is
- *    the return value of the function.
- *  status is pretty much useless as syncsource_found is a global variable
- *  used later in main to check is the server was synchronized. It works
- *  so I left it alone */
-int ntp_request(const char *host, double *offset, int *offset_result, double *jitter, int *stratum, int *num_truechimers){
-	int conn=-1, i, npeers=0, num_candidates=0;
-	double tmp_offset = 0;
-	int min_peer_sel=PEER_INCLUDED;
-	int peers_size=0, peer_offset=0;
-	int status;
-	ntp_assoc_status_pair *peers=NULL;
+ *  - result is set to WARNING if there's no sync.peer (otherwise OK), and
+ *    syncsource_found and li_alarm tell check_peer why.
+ *  - responded stays 0 for servers which stop answering; a single server
+ *    that does so is CRITICAL right away.
+ *  Servers are not waited for one after the other: each one's requests
+ *  are sent as soon as its previous response is in, from one poll() loop,
+ *  so several servers take as long as the slowest of them. */
+void ntp_request(ntp_peer_results *results, int nservers){
+	int i, active=0, remaining=-1;
+	ssize_t len;
+	struct timeval start;
+	struct pollfd *ufds;
+	ntp_conversation *conv;
 	ntp_control_message req;
-	const char *getvar = "stratum,offset,jitter";
-	char *data, *value, *nptr;
-	void *tmp;
-
-	status = STATE_OK;
-	*offset_result = STATE_UNKNOWN;
-	*jitter = *stratum = -1;
-	*num_truechimers = 0;
 
 	/* Long-winded explanation:
 	 * Getting the sync peer offset, jitter and stratum requires a number of
@@ -232,184 +459,88 @@ int ntp_request(const char *host, double *offset, int *offset_result, double *ji
 	 * 4) Extract the offset, jitter and stratum value from the data[]
 	 *    (it's ASCII)
 	 */
-	my_udp_connect(server_address, port, &conn);
+	conv = (ntp_conversation *)calloc(nservers, sizeof(ntp_conversation));
+	ufds = (struct pollfd *)calloc(nservers, sizeof(struct pollfd));
+	if(conv == NULL || ufds == NULL)
+		die(STATE_UNKNOWN, _("Could not allocate memory for servers\n"));
+
+	for(i = 0; i < nservers; i++){
+		results[i].offset_result = STATE_UNKNOWN;
+		results[i].jitter = results[i].stratum = -1;
+		results[i].result = STATE_OK;
+		conv[i].r = &results[i];
+		conv[i].conn = -1;
+		conv[i].min_peer_sel = PEER_INCLUDED;
+		conv[i].getvar = "stratum,offset,jitter";
+		/* servers we cannot talk to are ignored by poll() */
+		ufds[i].fd = -1;
+		ufds[i].events = POLLIN;
+		if(my_udp_connect(results[i].host, port, &conv[i].conn) != STATE_OK)
+			continue;
+		ufds[i].fd = conv[i].conn;
+		send_readstat(&conv[i]);
+		active++;
+	}
 
-	/* keep sending requests until the server stops setting the
-	 * REM_MORE bit, though usually this is only 1 packet. */
-	do{
-		setup_control_request(&req, OP_READSTAT, 1);
-		DBG(printf("sending READSTAT request"));
-		write(conn, &req, SIZEOF_NTPCM(req));
-		DBG(print_ntp_control_message(&req));
-
-		do {
-			/* Attempt to read the largest size packet possible */
-			req.count=htons(MAX_CM_SIZE);
-			DBG(printf("receiving READSTAT response"))
-			if(read(conn, &req, SIZEOF_NTPCM(req)) == -1)
-				die(STATE_CRITICAL, "NTP CRITICAL: No response from NTP server\n");
+	gettimeofday(&start, NULL);
+	while(active > 0){
+		/* a single server may take until the alarm goes off; several
+		 * share the timeout, leaving a little of it for the output */
+		if(nservers > 1){
+			remaining = timeout_interval * 1000 - 500 - deltime(start) / 1000;
+			if(remaining <= 0)
+				break;
+		}
+		if(poll(ufds, nservers, remaining) == -1){
+			perror("polling ntp sockets");
+			die(STATE_UNKNOWN, "communication errors");
+		}
+
+		for(i = 0; i < nservers; i++){
+			if(ufds[i].revents == 0)
+				continue;
+			len = -1;
+			if(ufds[i].revents&POLLIN){
+				/* Attempt to read the largest size packet possible */
+				DBG(printf("receiving response from %s\n", results[i].host));
+				len = read(ufds[i].fd, &req, sizeof(req));
+			}
+			if(len == -1){
+				/* e.g. ICMP port unreachable; give up on this server */
+				DBG(printf("error on socket for %s, giving up on it\n", results[i].host));
+				ufds[i].fd = -1;
+				active--;
+				continue;
+			}
 			DBG(print_ntp_control_message(&req));
 			/* discard obviously invalid packets */
 			if (ntohs(req.count) > MAX_CM_SIZE)
 				die(STATE_CRITICAL, "NTP CRITICAL: Invalid packet received from NTP server\n");
-		} while (!(req.op&OP_READSTAT && ntohs(req.seq) == 1));
-
-		if (LI(req.flags) == LI_ALARM) li_alarm = 1;
-		/* Each peer identifier is 4 bytes in the data section, which
-	 	 * we represent as a ntp_assoc_status_pair datatype.
-	 	 */
-		peers_size+=ntohs(req.count);
-		if((tmp=realloc(peers, peers_size)) == NULL)
-			free(peers), die(STATE_UNKNOWN, "can not (re)allocate 'peers' buffer\n");
-		peers=tmp;
-		memcpy((void*)((ptrdiff_t)peers+peer_offset), (void*)req.data, ntohs(req.count));
-		npeers=peers_size/sizeof(ntp_assoc_status_pair);
-		peer_offset+=ntohs(req.count);
-	} while(req.op&REM_MORE);
-
-	/* first, let's find out if we have a sync source, or if there are
-	 * at least some candidates. In the latter case we'll issue
-	 * a warning but go ahead with the check on them. */
-	for (i = 0; i < npeers; i++){
-		if(PEER_SEL(peers[i].status) >= PEER_TRUECHIMER){
-			(*num_truechimers)++;
-			if(PEER_SEL(peers[i].status) >= PEER_INCLUDED){
-				num_candidates++;
-				if(PEER_SEL(peers[i].status) >= PEER_SYNCSOURCE){
-					syncsource_found=1;
-					min_peer_sel=PEER_SYNCSOURCE;
-				}
+			/* and responses to requests we are not waiting for */
+			if(conv[i].stage == STAGE_READSTAT && req.op&OP_READSTAT && ntohs(req.seq) == 1)
+				readstat_response(&conv[i], &req);
+			else if(conv[i].stage == STAGE_READVAR && req.op&OP_READVAR && ntohs(req.seq) == 2)
+				readvar_response(&conv[i], &req);
+			if(conv[i].stage == STAGE_DONE){
+				ufds[i].fd = -1;
+				active--;
 			}
 		}
 	}
-	if(verbose) printf("%d candidate peers available\n", num_candidates);
-	if(verbose && syncsource_found) printf("synchronization source found\n");
-	if(! syncsource_found){
-		status = STATE_WARNING;
-		if(verbose) printf("warning: no synchronization source found\n");
-	}
-	if(li_alarm){
-		status = STATE_WARNING;
-		if(verbose) printf("warning: LI_ALARM bit is set\n");
-	}
-
-
-	for (i = 0; i < npeers; i++){
-		/* Only query this server if it is the current sync source */
-		/* If there's no sync.peer, query all candidates and use the best one */
-		if (PEER_SEL(peers[i].status) >= min_peer_sel){
-			if(verbose) printf("Getting offset, jitter and stratum for peer %.2x\n", ntohs(peers[i].assoc));
-			xasprintf(&data, "");
-			do{
-				setup_control_request(&req, OP_READVAR, 2);
-				req.assoc = peers[i].assoc;
-				/* Putting the wanted variable names in the request
-				 * cause the server to provide _only_ the requested values.
-				 * thus reducing net traffic, guaranteeing us only a single
-				 * datagram in reply, and making interpretation much simpler
-				 */
-				/* Older servers doesn't know what jitter is, so if we get an
-				 * error on the first pass we redo it with "dispersion" */
-				strncpy(req.data, getvar, MAX_CM_SIZE-1);
-				req.count = htons(strlen(getvar));
-				DBG(printf("sending READVAR request...\n"));
-				write(conn, &req, SIZEOF_NTPCM(req));
-				DBG(print_ntp_control_message(&req));
-
-				do {
-					req.count = htons(MAX_CM_SIZE);
-					DBG(printf("receiving READVAR response...\n"));
-					read(conn, &req, SIZEOF_NTPCM(req));
-					DBG(print_ntp_control_message(&req));
-				} while (!(req.op&OP_READVAR && ntohs(req.seq) == 2));
-
-				if(!(req.op&REM_ERROR))
-					xasprintf(&data, "%s%s", data, req.data);
-			} while(req.op&REM_MORE);
-
-			if(req.op&REM_ERROR) {
-				if(strstr(getvar, "jitter")) {
-					if(verbose) printf("The command failed. This is usually caused by servers refusing the 'jitter'\nvariable. Restarting with 'dispersion'...\n");
-					getvar = "stratum,offset,dispersion";
-					i--;
-					continue;
-				} else if(strlen(getvar)) {
-					if(verbose) printf("Server didn't like dispersion either; will retrieve everything\n");
-					getvar = "";
-					i--;
-					continue;
-				}
-			}
-
-			if(verbose > 1)
-				printf("Server responded: >>>%s<<<\n", data);
-
-			/* get the offset */
-			if(verbose)
-				printf("parsing offset from peer %.2x: ", ntohs(peers[i].assoc));
-
-			value = np_extract_ntpvar(data, "offset");
-			nptr=NULL;
-			/* Convert the value if we have one */
-			if(value != NULL)
-				tmp_offset = strtod(value, &nptr) / 1000;
-			/* If value is null or no conversion was performed */
-			if(value == NULL || value==nptr) {
-				if(verbose) printf("error: unable to read server offset response.\n");
-			} else {
-				if(verbose) printf("%.10g\n", tmp_offset);
-				if(*offset_result == STATE_UNKNOWN || fabs(tmp_offset) < fabs(*offset)) {
-					*offset = tmp_offset;
-					*offset_result = STATE_OK;
-				} else {
-					/* Skip this one; move to the next */
-					continue;
-				}
-			}
-
-			if(do_jitter) {
-				/* get the jitter */
-				if(verbose) {
-					printf("parsing %s from peer %.2x: ", strstr(getvar, "dispersion") != NULL ? "dispersion" : "jitter", ntohs(peers[i].assoc));
-				}
-				value = np_extract_ntpvar(data, strstr(getvar, "dispersion") != NULL ? "dispersion" : "jitter");
-				nptr=NULL;
-				/* Convert the value if we have one */
-				if(value != NULL)
-					*jitter = strtod(value, &nptr);
-				/* If value is null or no conversion was performed */
-				if(value == NULL || value==nptr) {
-					if(verbose) printf("error: unable to read server jitter/dispersion response.\n");
-					*jitter = -1;
-				} else if(verbose) {
-					printf("%.10g\n", *jitter);
-				}
-			}
-
-			if(do_stratum) {
-				/* get the stratum */
-				if(verbose) {
-					printf("parsing stratum from peer %.2x: ", ntohs(peers[i].assoc));
-				}
-				value = np_extract_ntpvar(data, "stratum");
-				nptr=NULL;
-				/* Convert the value if we have one */
-				if(value != NULL)
-					*stratum = strtol(value, &nptr, 10);
-				if(value == NULL || value==nptr) {
-					if(verbose) printf("error: unable to read server stratum response.\n");
-					*stratum = -1;
-				} else {
-					if(verbose) printf("%i\n", *stratum);
-				}
-			}
-		} /* if (PEER_SEL(peers[i].status) >= min_peer_sel) */
-	} /* for (i = 0; i < npeers; i++) */
-
-	close(conn);
-	if(peers!=NULL) free(peers);
 
-	return status;
+	for(i = 0; i < nservers; i++){
+		if(!results[i].responded){
+			if(nservers == 1)
+				die(STATE_CRITICAL, "NTP CRITICAL: No response from NTP server\n");
+			if(verbose) printf("no response from %s\n", results[i].host);
+		}
+		if(conv[i].conn >= 0)
+			close(conv[i].conn);
+		free(conv[i].peers);
+		free(conv[i].data);
+	}
+	free(conv);
+	free(ufds);
 }
 
 int process_arguments(int argc, char **argv){
@@ -495,7 +626,12 @@ int process_arguments(int argc, char **argv){
 		case 'H':
 			if(is_host(optarg) == FALSE)
 				usage2(_("Invalid hostname/address"), optarg);
-			server_address = strdup(optarg);
+			/* -H may be given several times to check a set of servers */
+			server_addresses = realloc(server_addresses,
+			                           (num_server_addresses+1) * sizeof(char *));
+			if(server_addresses == NULL)
+				die(STATE_UNKNOWN, _("Could not allocate memory for hostnames\n"));
+			server_addresses[num_server_addresses++] = strdup(optarg);
 			break;
 		case 'p':
 			port=atoi(optarg);
@@ -520,49 +656,151 @@ int process_arguments(int argc, char **argv){
 		}
 	}
 
-	if(server_address == NULL){
+	if(num_server_addresses == 0){
 		usage4(_("Hostname was not supplied"));
 	}
 
 	return 0;
 }
 
-char *perfd_offset (double offset)
+char *perfd_offset (const char *label, double offset)
 {
-	return sperfdata ("offset", offset, "s",
+	return sperfdata (label, offset, "s",
 		offset_thresholds->warning_string,
 		offset_thresholds->critical_string,
 		FALSE, 0, FALSE, 0);
 }
 
-char *perfd_jitter (double jitter)
+char *perfd_jitter (const char *label, double jitter)
 {
-	return sperfdata ("jitter", jitter, "",
+	return sperfdata (label, jitter, "",
 		jitter_thresholds->warning_string,
 		jitter_thresholds->critical_string,
 		TRUE, 0, FALSE, 0);
 }
 
-char *perfd_stratum (int stratum)
+char *perfd_stratum (const char *label, int stratum)
 {
-	return sperfdata_int ("stratum", stratum, "",
+	return sperfdata_int (label, stratum, "",
 		stratum_thresholds->warning_string,
 		stratum_thresholds->critical_string,
 		TRUE, 0, TRUE, 16);
 }
 
-char *perfd_truechimers (int num_truechimers)
+char *perfd_truechimers (const char *label, int num_truechimers)
 {
-	return sperfdata_int ("truechimers", num_truechimers, "",
+	return sperfdata_int (label, num_truechimers, "",
 		truechimer_thresholds->warning_string,
 		truechimer_thresholds->critical_string,
 		TRUE, 0, FALSE, 0);
 }
 
+/* evaluate the results of one server against the thresholds */
+void check_peer(ntp_peer_results *r){
+	int result;
+
+	if(!r->responded) {
+		r->result = (quiet == 1 ? STATE_UNKNOWN : STATE_CRITICAL);
+		return;
+	}
+
+	/* This is either OK or WARNING (See comment preceding ntp_request) */
+	result = r->result;
+
+	if(r->offset_result == STATE_UNKNOWN) {
+		/* if there's no sync peer (this overrides ntp_request output): */
+		result = (quiet == 1 ? STATE_UNKNOWN : STATE_CRITICAL);
+	} else {
+		/* Be quiet if there's no candidates either */
+		if (quiet == 1 && result == STATE_WARNING)
+			result = STATE_UNKNOWN;
+		result = max_state_alt(result, get_status(fabs(r->offset), offset_thresholds));
+	}
+	r->oresult = result;
+
+	if(do_truechimers) {
+		r->tresult = get_status(r->num_truechimers, truechimer_thresholds);
+		result = max_state_alt(result, r->tresult);
+	}
+
+	if(do_stratum) {
+		r->sresult = get_status(r->stratum, stratum_thresholds);
+		result = max_state_alt(result, r->sresult);
+	}
+
+	if(do_jitter) {
+		r->jresult = get_status(r->jitter, jitter_thresholds);
+		result = max_state_alt(result, r->jresult);
+	}
+	r->result = result;
+}
+
+/* append the text and perfdata of one server's results; perfdata labels
+ * get the given prefix so several servers can share one output line */
+void format_peer(const ntp_peer_results *r, const char *prefix, char **result_line, char **perfdata_line){
+	char *label;
+
+	if(!r->responded){
+		xasprintf(result_line, "%s %s", *result_line, _("No response from NTP server"));
+		return;
+	}
+
+	if(!r->syncsource_found)
+		xasprintf(result_line, "%s %s,", *result_line, _("Server not synchronized"));
+	else if(r->li_alarm)
+		xasprintf(result_line, "%s %s,", *result_line, _("Server has the LI_ALARM bit set"));
+
+	if(r->offset_result == STATE_UNKNOWN){
+		xasprintf(result_line, "%s %s", *result_line, _("Offset unknown"));
+	} else if (r->oresult == STATE_WARNING) {
+		xasprintf(result_line, "%s %s %.10g secs (WARNING)", *result_line, _("Offset"), r->offset);
+	} else if (r->oresult == STATE_CRITICAL) {
+		xasprintf(result_line, "%s %s %.10g secs (CRITICAL)", *result_line, _("Offset"), r->offset);
+	} else {
+		xasprintf(result_line, "%s %s %.10g secs", *result_line, _("Offset"), r->offset);
+	}
+	xasprintf(&label, "%soffset", prefix);
+	xasprintf(perfdata_line, "%s%s%s", *perfdata_line, **perfdata_line ? " " : "", perfd_offset(label, r->offset));
+
+	if (do_jitter) {
+		if (r->jresult == STATE_WARNING) {
+			xasprintf(result_line, "%s, jitter=%f (WARNING)", *result_line, r->jitter);
+		} else if (r->jresult == STATE_CRITICAL) {
+			xasprintf(result_line, "%s, jitter=%f (CRITICAL)", *result_line, r->jitter);
+		} else {
+			xasprintf(result_line, "%s, jitter=%f", *result_line, r->jitter);
+		}
+		xasprintf(&label, "%sjitter", prefix);
+		xasprintf(perfdata_line, "%s %s", *perfdata_line, perfd_jitter(label, r->jitter));
+	}
+	if (do_stratum) {
+		if (r->sresult == STATE_WARNING) {
+			xasprintf(result_line, "%s, stratum=%i (WARNING)", *result_line, r->stratum);
+		} else if (r->sresult == STATE_CRITICAL) {
+			xasprintf(result_line, "%s, stratum=%i (CRITICAL)", *result_line, r->stratum);
+		} else {
+			xasprintf(result_line, "%s, stratum=%i", *result_line, r->stratum);
+		}
+		xasprintf(&label, "%sstratum", prefix);
+		xasprintf(perfdata_line, "%s %s", *perfdata_line, perfd_stratum(label, r->stratum));
+	}
+	if (do_truechimers) {
+		if (r->tresult == STATE_WARNING) {
+			xasprintf(result_line, "%s, truechimers=%i (WARNING)", *result_line, r->num_truechimers);
+		} else if (r->tresult == STATE_CRITICAL) {
+			xasprintf(result_line, "%s, truechimers=%i (CRITICAL)", *result_line, r->num_truechimers);
+		} else {
+			xasprintf(result_line, "%s, truechimers=%i", *result_line, r->num_truechimers);
+		}
+		xasprintf(&label, "%struechimers", prefix);
+		xasprintf(perfdata_line, "%s %s", *perfdata_line, perfd_truechimers(label, r->num_truechimers));
+	}
+}
+
 int main(int argc, char *argv[]){
-	int result, offset_result, stratum, num_truechimers, oresult, jresult, sresult, tresult;
-	double offset=0, jitter=0;
-	char *result_line, *perfdata_line;
+	int result, i, num_ok=0;
+	ntp_peer_results *results;
+	char *result_line, *perfdata_line, *prefix;
 
 	setlocale (LC_ALL, "");
 	setlocale (LC_NUMERIC, "C");
@@ -586,33 +824,20 @@ int main(int argc, char *argv[]){
 	/* set socket timeout */
 	alarm (timeout_interval);
 
-	/* This returns either OK or WARNING (See comment preceding ntp_request) */
-	result = ntp_request(server_address, &offset, &offset_result, &jitter, &stratum, &num_truechimers);
+	results = (ntp_peer_results *)calloc(num_server_addresses, sizeof(ntp_peer_results));
+	if(results == NULL)
+		die(STATE_UNKNOWN, _("Could not allocate memory for results\n"));
 
-	if(offset_result == STATE_UNKNOWN) {
-		/* if there's no sync peer (this overrides ntp_request output): */
-		result = (quiet == 1 ? STATE_UNKNOWN : STATE_CRITICAL);
-	} else {
-		/* Be quiet if there's no candidates either */
-		if (quiet == 1 && result == STATE_WARNING)
-			result = STATE_UNKNOWN;
-		result = max_state_alt(result, get_status(fabs(offset), offset_thresholds));
-	}
-	oresult = result;
-	
-	if(do_truechimers) {
-		tresult = get_status(num_truechimers, truechimer_thresholds);
-		result = max_state_alt(result, tresult);
-	}
+	for(i = 0; i < num_server_addresses; i++)
+		results[i].host = server_addresses[i];
+	ntp_request(results, num_server_addresses);
 
-	if(do_stratum) {
-		sresult = get_status(stratum, stratum_thresholds);
-		result = max_state_alt(result, sresult);
-	}
-
-	if(do_jitter) {
-		jresult = get_status(jitter, jitter_thresholds);
-		result = max_state_alt(result, jresult);
+	result = STATE_OK;
+	for(i = 0; i < num_server_addresses; i++){
+		check_peer(&results[i]);
+		result = max_state_alt(result, results[i].result);
+		if(results[i].result == STATE_OK)
+			num_ok++;
 	}
 
 	switch (result) {
@@ -629,56 +854,26 @@ int main(int argc, char *argv[]){
 			xasprintf(&result_line, _("NTP UNKNOWN:"));
 			break;
 	}
-	if(!syncsource_found)
-		xasprintf(&result_line, "%s %s,", result_line, _("Server not synchronized"));
-	else if(li_alarm)
-		xasprintf(&result_line, "%s %s,", result_line, _("Server has the LI_ALARM bit set"));
-
-	if(offset_result == STATE_UNKNOWN){
-		xasprintf(&result_line, "%s %s", result_line, _("Offset unknown"));
-		xasprintf(&perfdata_line, "");
-	} else if (oresult == STATE_WARNING) {
-		xasprintf(&result_line, "%s %s %.10g secs (WARNING)", result_line, _("Offset"), offset);
-	} else if (oresult == STATE_CRITICAL) {
-		xasprintf(&result_line, "%s %s %.10g secs (CRITICAL)", result_line, _("Offset"), offset);
+	xasprintf(&perfdata_line, "");
+
+	if(num_server_addresses == 1) {
+		format_peer(&results[0], "", &result_line, &perfdata_line);
 	} else {
-		xasprintf(&result_line, "%s %s %.10g secs", result_line, _("Offset"), offset);
-	}	
-	xasprintf(&perfdata_line, "%s", perfd_offset(offset));
-	
-	if (do_jitter) {
-		if (jresult == STATE_WARNING) {
-			xasprintf(&result_line, "%s, jitter=%f (WARNING)", result_line, jitter);
-		} else if (jresult == STATE_CRITICAL) {
-			xasprintf(&result_line, "%s, jitter=%f (CRITICAL)", result_line, jitter);
-		} else {
-			xasprintf(&result_line, "%s, jitter=%f", result_line, jitter);
-		}
-		xasprintf(&perfdata_line, "%s %s", perfdata_line, perfd_jitter(jitter));
-	}
-	if (do_stratum) {
-		if (sresult == STATE_WARNING) {
-			xasprintf(&result_line, "%s, stratum=%i (WARNING)", result_line, stratum);
-		} else if (sresult == STATE_CRITICAL) {
-			xasprintf(&result_line, "%s, stratum=%i (CRITICAL)", result_line, stratum);
-		} else {
-			xasprintf(&result_line, "%s, stratum=%i", result_line, stratum);
-		}
-		xasprintf(&perfdata_line, "%s %s", perfdata_line, perfd_stratum(stratum));
-	}
-	if (do_truechimers) {
-		if (tresult == STATE_WARNING) {
-			xasprintf(&result_line, "%s, truechimers=%i (WARNING)", result_line, num_truechimers);
-		} else if (tresult == STATE_CRITICAL) {
-			xasprintf(&result_line, "%s, truechimers=%i (CRITICAL)", result_line, num_truechimers);
-		} else {
-			xasprintf(&result_line, "%s, truechimers=%i", result_line, num_truechimers);
+		xasprintf(&result_line, _("%s %d of %d servers OK"), result_line, num_ok, num_server_addresses);
+		for(i = 0; i < num_server_addresses; i++){
+			xasprintf(&result_line, "%s; %s:", result_line, results[i].host);
+			xasprintf(&prefix, "%s_", results[i].host);
+			format_peer(&results[i], prefix, &result_line, &perfdata_line);
 		}
-		xasprintf(&perfdata_line, "%s %s", perfdata_line, perfd_truechimers(num_truechimers));
+		xasprintf(&perfdata_line, "%s%sservers_ok=%d;;;0;%d", perfdata_line,
+		          *perfdata_line ? " " : "", num_ok, num_server_addresses);
 	}
 	printf("%s|%s\n", result_line, perfdata_line);
 
-	if(server_address!=NULL) free(server_address);
+	for(i = 0; i < num_server_addresses; i++)
+		free(server_addresses[i]);
+	free(server_addresses);
+	free(results);
 	return result;
 }
 
@@ -697,6 +892,7 @@ void print_help(void){
 	printf (UT_EXTRA_OPTS);
 	printf (UT_IPv46);
 	printf (UT_HOST_PORT, 'p', "123");
+	printf ("    %s\n", _("-H may be repeated to check several servers in one run"));
 	printf (" %s\n", "-q, --quiet");
 	printf ("    %s\n", _("Returns UNKNOWN instead of CRITICAL or WARNING if server isn't synchronized"));
 	printf (" %s\n", "-w, --warning=THRESHOLD");
@@ -727,6 +923,10 @@ void print_help(void){
 	printf(" %s\n", _("checking the offset with the sync peer, the jitter and stratum. This"));
 	printf(" %s\n", _("plugin will not check the clock offset between the local host and NTP"));
 	printf(" %s\n", _("server; please use check_ntp_time for that purpose."));
+	printf(" %s\n", _("When several servers are given, each one is checked against the same"));
+	printf(" %s\n", _("thresholds, the worst state is returned and the perfdata labels are"));
+	printf(" %s\n", _("prefixed with the host name. All servers are asked at the same time"));
+	printf(" %s\n", _("and must answer within the one timeout."));
 	printf("\n");
 	printf(UT_THRESHOLDS_NOTES);
 
@@ -752,6 +952,6 @@ void
 print_usage(void)
 {
 	printf ("%s\n", _("Usage:"));
-	printf(" %s -H <host> [-4|-6] [-w <warn>] [-c <crit>] [-W <warn>] [-C <crit>]\n", progname);
+	printf(" %s -H <host> [-H <host> ...] [-4|-6] [-w <warn>] [-c <crit>] [-W <warn>] [-C <crit>]\n", progname);
 	printf("       [-j <warn>] [-k <crit>] [-v verbose]\n");
 }
@@ -42,7 +42,8 @@ const char *email = "devel@nagios-plugins.org";
 #include "netutils.h"
 #include "utils.h"
 
-static char *server_address=NULL;
+static char **server_addresses=NULL;
+static int num_server_addresses=0;
 static char *port="123";
 static int verbose=0;
 static int quiet=0;
@@ -52,6 +53,7 @@ static char *swarn="16";
 static char *scrit="16";
 int time_offset=0;
 static int delay=2;
+static int num_samples=4;
 
 int num_hosts;
 
@@ -60,9 +62,10 @@ thresholds *offset_thresholds = NULL;
 void print_help (void);
 void print_usage (void);
 
-/* number of times to perform each request to get a good average. */
-#ifndef AVG_NUM
-#define AVG_NUM 4
+/* maximum number of times to perform each request (-n); the sample with
+ * the lowest round trip delay is used, as ntpd's clock filter does. */
+#ifndef MAX_SAMPLES
+#define MAX_SAMPLES 16
 #endif
 /* max size of control message data */
 #define MAX_CM_SIZE 468
@@ -109,12 +112,19 @@ typedef struct {
 	uint8_t stratum;        /* copied verbatim from the ntp_message */
 	double rtdelay;         /* converted from the ntp_message */
 	double rtdisp;          /* converted from the ntp_message */
-	double offset[AVG_NUM]; /* offsets from each response */
+	double offset[MAX_SAMPLES]; /* offsets from each response */
+	double delay[MAX_SAMPLES];  /* round trip delays from each response */
+	double filtered_offset; /* offset of the sample with the lowest delay */
+	double min_delay;       /* lowest round trip delay of all samples */
+	double jitter;          /* rms deviation of the offsets from filtered_offset */
 	uint8_t flags;       /* byte with leapindicator,vers,mode. see macros */
+	const char *host;       /* the -H argument this peer was resolved from */
+	char addr[INET6_ADDRSTRLEN]; /* numeric address of the peer */
 } ntp_server_results;
 
 /* define this globally to be able to do other checks */
 ntp_server_results *servers=NULL;
+int best_server=-1;
 
 /* bits 1,2 are the leap indicator */
 #define LI_MASK 0xc0
@@ -177,8 +187,11 @@ ntp_server_results *servers=NULL;
 double ntp32_to_double(uint32_t n) {
 	double result = 0;
 	if (n) {
-		uint16_t l16 = ntohs((uint16_t) (n >> 16));
-		uint16_t r16 = ntohs((uint16_t) (n & ((1<<16) - 1)));
+		/* n is still in network byte order, so split it in memory order */
+		uint16_t half[2];
+		memcpy(half, &n, sizeof(half));
+		uint16_t l16 = ntohs(half[0]);
+		uint16_t r16 = ntohs(half[1]);
 		result = l16 + ((double) r16/65536.0);
 	}
 	return result;
@@ -190,8 +203,10 @@ double ntp32_to_double(uint32_t n) {
 double ntp64_to_double(uint64_t n) {
 	double result = 0;
 	if (n) {
-		uint32_t l32 = ntohl((uint32_t) (n >> 32));
-		uint32_t r32 = ntohl((uint32_t) (n & ((1ul<<32) - 1)));
+		uint32_t half[2];
+		memcpy(half, &n, sizeof(half));
+		uint32_t l32 = ntohl(half[0]);
+		uint32_t r32 = ntohl(half[1]);
 		result = (l32 - EPOCHDIFF)
 		       + (.00000001*(0.5+(double)(r32/42.94967296)));
 	}
@@ -207,11 +222,44 @@ double ntp64_to_double(uint64_t n) {
 /* convert a struct timeval to a double */
 #define TVasDOUBLE(x) (double)(x.tv_sec+(0.000001*x.tv_usec))
 
+/* convert an ntp 64-bit fp number to a struct timespec, keeping the full
+ * resolution of the fraction */
+struct timespec ntp64_to_ts(uint64_t n) {
+	struct timespec result = {};
+	if (n) {
+		uint32_t half[2];
+		memcpy(half, &n, sizeof(half));
+		result.tv_sec = ntohl(half[0]) - EPOCHDIFF;
+		result.tv_nsec = (long)(((uint64_t)ntohl(half[1]) * 1000000000ULL) >> 32);
+	}
+	return result;
+}
+
+/* difference a-b in seconds. Subtracting the seconds first keeps the
+ * nanoseconds, which would be lost in a double holding epoch time */
+static inline double ts_diff(const struct timespec *a, const struct timespec *b){
+	return (double)(a->tv_sec - b->tv_sec) + (a->tv_nsec - b->tv_nsec) * 1e-9;
+}
+
+/* get the current wall clock time at the best available resolution */
+static void get_realtime(struct timespec *ts){
+#ifdef CLOCK_REALTIME
+	if(clock_gettime(CLOCK_REALTIME, ts) == 0)
+		return;
+#endif
+	struct timeval t;
+	gettimeofday(&t, NULL);
+	ts->tv_sec = t.tv_sec;
+	ts->tv_nsec = t.tv_usec * 1000;
+}
+
 struct timeval ntp64_to_tv(uint64_t n) {
 	struct timeval result = {};
 	if (n) {
-		uint32_t l32 = ntohl((uint32_t) (n >> 32));
-		uint32_t r32 = ntohl((uint32_t) (n & ((1ul<<32) - 1)));
+		uint32_t half[2];
+		memcpy(half, &n, sizeof(half));
+		uint32_t l32 = ntohl(half[0]);
+		uint32_t r32 = ntohl(half[1]);
 		result.tv_sec = l32 - EPOCHDIFF;
 		result.tv_usec = (int)(0.5+(double)(r32/4294.967296));
 	}
@@ -248,14 +296,14 @@ struct timeval ntp64_to_tv(uint64_t n) {
 		printf("%u.%u.%u.%u", (x>>24)&0xff, (x>>16)&0xff, (x>>8)&0xff, x&0xff);\
 	}while(0);
 
-/* calculate the offset of the local clock */
-static inline double calc_offset(const ntp_message *m, const struct timeval *t){
-	double client_tx, peer_rx, peer_tx, client_rx;
-	client_tx = ntp64_to_double(m->origts);
-	peer_rx = ntp64_to_double(m->rxts);
-	peer_tx = ntp64_to_double(m->txts);
-	client_rx=TVasDOUBLE((*t));
-	return (.5*((peer_tx-client_rx)+(peer_rx-client_tx)));
+/* calculate the offset of the local clock and the round trip delay */
+static inline double calc_offset(const ntp_message *m, const struct timespec *t, double *rtdelay){
+	struct timespec client_tx, peer_rx, peer_tx;
+	client_tx = ntp64_to_ts(m->origts);
+	peer_rx = ntp64_to_ts(m->rxts);
+	peer_tx = ntp64_to_ts(m->txts);
+	*rtdelay = ts_diff(t, &client_tx) - ts_diff(&peer_tx, &peer_rx);
+	return (.5*(ts_diff(&peer_tx, t)+ts_diff(&peer_rx, &client_tx)));
 }
 
 /* print out a ntp packet in human readable/debuggable format */
@@ -285,7 +333,7 @@ void print_ntp_message(const ntp_message *p){
 }
 
 void setup_request(ntp_message *p){
-	struct timeval t;
+	struct timespec t;
 
 	memset(p, 0, sizeof(ntp_message));
 	LI_SET(p->flags, LI_ALARM);
@@ -296,16 +344,78 @@ void setup_request(ntp_message *p){
 	p->rtdelay_l16=htons(1);
 	p->rtdisp_l16=htons(1);
 
-	gettimeofday(&t, NULL);
+	get_realtime(&t);
 
 	/* This used to use TVtoNTP64 but we ran into issues with strict aliasing/type punning.
 	 * We only used the macro in one place, so it's inlined now */
-	if (t.tv_usec || t.tv_sec) {
+	if (t.tv_nsec || t.tv_sec) {
 		p->txts_l32 = htonl(t.tv_sec + EPOCHDIFF);
-		p->txts_r32 = htonl((uint64_t) ((4294.967296*t.tv_usec)+.5));
+		p->txts_r32 = htonl((uint32_t) (((uint64_t)t.tv_nsec << 32) / 1000000000ULL));
 	}
 }
 
+/* ask the kernel to timestamp incoming packets, so the time we spend
+ * waiting to be scheduled after the packet arrived is not counted */
+void enable_rx_timestamps(int sock){
+	int on = 1;
+#if defined(SO_TIMESTAMPNS)
+	if(setsockopt(sock, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on)) == 0)
+		return;
+#endif
+#if defined(SO_TIMESTAMP)
+	setsockopt(sock, SOL_SOCKET, SO_TIMESTAMP, &on, sizeof(on));
+#endif
+}
+
+/* read a response and the time it was received, preferring the kernel's
+ * receive timestamp over reading the clock after recvmsg() returns */
+ssize_t recv_ntp_message(int sock, ntp_message *m, struct timespec *rx){
+	struct msghdr msg;
+	struct iovec iov;
+	struct cmsghdr *cmsg;
+	union {
+		char buf[CMSG_SPACE(sizeof(struct timespec)) + CMSG_SPACE(sizeof(struct timeval))];
+		struct cmsghdr align;
+	} control;
+	ssize_t len;
+
+	memset(&msg, 0, sizeof(msg));
+	iov.iov_base = m;
+	iov.iov_len = sizeof(ntp_message);
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control.buf;
+	msg.msg_controllen = sizeof(control.buf);
+
+	len = recvmsg(sock, &msg, 0);
+	get_realtime(rx);
+	if(len < 0)
+		return len;
+
+	for(cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)){
+		if(cmsg->cmsg_level != SOL_SOCKET)
+			continue;
+#if defined(SO_TIMESTAMPNS)
+		if(cmsg->cmsg_type == SCM_TIMESTAMPNS){
+			memcpy(rx, CMSG_DATA(cmsg), sizeof(struct timespec));
+			DBG(printf("using kernel receive timestamp (ns)\n"));
+			break;
+		}
+#endif
+#if defined(SO_TIMESTAMP)
+		if(cmsg->cmsg_type == SCM_TIMESTAMP){
+			struct timeval tv;
+			memcpy(&tv, CMSG_DATA(cmsg), sizeof(struct timeval));
+			rx->tv_sec = tv.tv_sec;
+			rx->tv_nsec = tv.tv_usec * 1000;
+			DBG(printf("using kernel receive timestamp (us)\n"));
+			break;
+		}
+#endif
+	}
+	return len;
+}
+
 /* select the "best" server from a list of servers, and return its index.
  * this is done by filtering servers based on stratum, dispersion, and
  * finally round-trip delay. */
@@ -362,20 +472,45 @@ int best_offset_server(const ntp_server_results *slist, int nservers){
 	}
 }
 
+/* pick the offset of the sample with the lowest round trip delay, which
+ * is the least affected by queuing, and calculate the jitter of the
+ * server's samples around it */
+void calc_server_stats(ntp_server_results *srv){
+	int i, best=0;
+	double sum=0.;
+
+	srv->filtered_offset=srv->jitter=srv->min_delay=0.;
+	if(srv->num_responses==0) return;
+
+	for(i=1; i<srv->num_responses; i++){
+		if(srv->delay[i] < srv->delay[best])
+			best=i;
+	}
+	srv->filtered_offset=srv->offset[best];
+	srv->min_delay=srv->delay[best];
+
+	for(i=0; i<srv->num_responses; i++){
+		sum+=(srv->offset[i]-srv->filtered_offset)*(srv->offset[i]-srv->filtered_offset);
+	}
+	srv->jitter=sqrt(sum/srv->num_responses);
+}
+
 /* do everything we need to get the total average offset
  * - we use a certain amount of parallelization with poll() to ensure
  *   we don't waste time sitting around waiting for single packets.
+ *   All addresses of all given hosts share one poll() loop, so adding
+ *   servers does not add round trips.
  * - we also "manually" handle resolving host names and connecting, because
  *   we have to do it in a way that our lazy macros don't handle currently :( */
-double offset_request(const char *host, int *status){
-  int i=0, j=0, ga_result=0, *socklist=NULL, respnum=0;
+double offset_request(char **hosts, int nhosts, int *status){
+	int i=0, j=0, ga_result=0, *socklist=NULL, respnum=0;
 	int servers_completed=0, one_read=0, servers_readable=0, best_index=-1;
 	time_t now_time=0, start_ts=0;
 	ntp_message *req=NULL;
 	double avg_offset=0.;
 	num_hosts = 0;
-	struct timeval recv_time;
-	struct addrinfo *ai=NULL, *ai_tmp=NULL, hints;
+	struct timespec recv_time;
+	struct addrinfo **ai=NULL, *ai_tmp=NULL, hints;
 	struct pollfd *ufds=NULL;
 
 
@@ -385,15 +520,20 @@ double offset_request(const char *host, int *status){
 	hints.ai_protocol = IPPROTO_UDP;
 	hints.ai_socktype = SOCK_DGRAM;
 
-	/* fill in ai with the list of hosts resolved by the host name */
-	ga_result = getaddrinfo(host, port, &hints, &ai);
-	if(ga_result!=0){
-		die(STATE_UNKNOWN, "error getting address for %s: %s\n",
-		    host, gai_strerror(ga_result));
+	/* fill in ai with the list of hosts resolved by each host name */
+	ai=(struct addrinfo**)calloc(nhosts, sizeof(struct addrinfo*));
+	if(ai==NULL) die(STATE_UNKNOWN, "can not allocate address array");
+	for(j=0; j<nhosts; j++){
+		ga_result = getaddrinfo(hosts[j], port, &hints, &ai[j]);
+		if(ga_result!=0){
+			die(STATE_UNKNOWN, "error getting address for %s: %s\n",
+			    hosts[j], gai_strerror(ga_result));
+		}
+		/* count the number of returned hosts */
+		for(ai_tmp=ai[j]; ai_tmp!=NULL; ai_tmp=ai_tmp->ai_next){ num_hosts++; }
 	}
 
-	/* count the number of returned hosts, and allocate stuff accordingly */
-	for(ai_tmp=ai; ai_tmp!=NULL; ai_tmp=ai_tmp->ai_next){ num_hosts++; }
+	/* and allocate stuff accordingly */
 	req=(ntp_message*)malloc(sizeof(ntp_message)*num_hosts);
 	if(req==NULL) die(STATE_UNKNOWN, "can not allocate ntp message array");
 	socklist=(int*)malloc(sizeof(int)*num_hosts);
@@ -406,29 +546,37 @@ double offset_request(const char *host, int *status){
 	DBG(printf("Found %d peers to check\n", num_hosts));
 
 	/* setup each socket for writing, and the corresponding struct pollfd */
-	ai_tmp=ai;
-	for(i=0;ai_tmp;i++){
-		socklist[i]=socket(ai_tmp->ai_family, SOCK_DGRAM, IPPROTO_UDP);
-		if(socklist[i] == -1) {
-			perror(NULL);
-			die(STATE_UNKNOWN, "can not create new socket");
-		}
-		if(connect(socklist[i], ai_tmp->ai_addr, ai_tmp->ai_addrlen)){
-			/* don't die here, because it is enough if there is one server
-			   answering in time. This also would break for dual ipv4/6 stacked
-			   ntp servers when the client only supports on of them.
-			 */
-			DBG(printf("can't create socket connection on peer %i: %s\n", i, strerror(errno)));
-		} else {
-			ufds[i].fd=socklist[i];
+	for(i=0, j=0; j<nhosts; j++){
+		for(ai_tmp=ai[j]; ai_tmp; ai_tmp=ai_tmp->ai_next, i++){
+			servers[i].host=hosts[j];
+			if(getnameinfo(ai_tmp->ai_addr, ai_tmp->ai_addrlen,
+			               servers[i].addr, sizeof(servers[i].addr),
+			               NULL, 0, NI_NUMERICHOST) != 0)
+				strncpy(servers[i].addr, hosts[j], sizeof(servers[i].addr)-1);
+			/* sockets which never connect are ignored by poll() */
+			ufds[i].fd=-1;
 			ufds[i].events=POLLIN;
 			ufds[i].revents=0;
-			servers[i].connected=1;
+			socklist[i]=socket(ai_tmp->ai_family, SOCK_DGRAM, IPPROTO_UDP);
+			if(socklist[i] == -1) {
+				perror(NULL);
+				die(STATE_UNKNOWN, "can not create new socket");
+			}
+			enable_rx_timestamps(socklist[i]);
+			if(connect(socklist[i], ai_tmp->ai_addr, ai_tmp->ai_addrlen)){
+				/* don't die here, because it is enough if there is one server
+				   answering in time. This also would break for dual ipv4/6 stacked
+				   ntp servers when the client only supports on of them.
+				 */
+				DBG(printf("can't create socket connection on peer %i: %s\n", i, strerror(errno)));
+			} else {
+				ufds[i].fd=socklist[i];
+				servers[i].connected=1;
+			}
 		}
-		ai_tmp = ai_tmp->ai_next;
 	}
 
-	/* now do AVG_NUM checks to each host. We stop before timeout/2 seconds
+	/* now do num_samples checks to each host. We stop before timeout/2 seconds
 	 * have passed in order to ensure post-processing and jitter time. */
 	now_time=start_ts=time(NULL);
 	while(servers_completed<num_hosts && now_time-start_ts <= timeout_interval - 1){
@@ -441,16 +589,15 @@ double offset_request(const char *host, int *status){
 		for(i=0; i<num_hosts; i++){
 			if(servers[i].connected == 0)
 				continue;
-			if(servers[i].waiting<now_time && servers[i].num_responses<AVG_NUM){
+			if(servers[i].waiting<now_time && servers[i].num_responses<num_samples){
 				if(verbose && servers[i].num_requests != servers[i].num_responses) printf("re-");
-				if(verbose) printf("sending request to peer %d\n", i);
+				if(verbose) printf("sending request to peer %d (%s)\n", i, servers[i].addr);
 				setup_request(&req[i]);
 				write(socklist[i], &req[i], sizeof(ntp_message));
 				servers[i].waiting=now_time+delay;
 				if(servers[i].num_requests == servers[i].num_responses) {
 					servers[i].num_requests++;
 				}
-				break;
 			}
 		}
 
@@ -463,18 +610,25 @@ double offset_request(const char *host, int *status){
 
 		/* read from any sockets with pending data */
 		for(i=0; servers_readable && i<num_hosts; i++){
-			if(ufds[i].revents&POLLIN && servers[i].num_responses < AVG_NUM){
+			if(ufds[i].revents&(POLLERR|POLLHUP|POLLNVAL) ||
+			   (ufds[i].revents&POLLIN &&
+			    recv_ntp_message(ufds[i].fd, &req[i], &recv_time) != sizeof(ntp_message))){
+				/* e.g. ICMP port unreachable; stop polling this peer */
+				DBG(printf("error on socket for peer %d, giving up on it\n", i));
+				ufds[i].fd=-1;
+				servers[i].connected=0;
+				if(servers[i].num_responses < num_samples) servers_completed++;
+				servers_readable--;
+			} else if(ufds[i].revents&POLLIN && servers[i].num_responses < num_samples){
 				if(verbose) {
 					printf("response from peer %d: ", i);
 				}
 
-				read(ufds[i].fd, &req[i], sizeof(ntp_message));
-				gettimeofday(&recv_time, NULL);
 				DBG(print_ntp_message(&req[i]));
 				respnum=servers[i].num_responses++;
-				servers[i].offset[respnum]=calc_offset(&req[i], &recv_time)+time_offset;
+				servers[i].offset[respnum]=calc_offset(&req[i], &recv_time, &servers[i].delay[respnum])+time_offset;
 				if(verbose) {
-					printf("offset %.10g\n", servers[i].offset[respnum]);
+					printf("offset %.10g, delay %.10g\n", servers[i].offset[respnum], servers[i].delay[respnum]);
 				}
 				servers[i].stratum=req[i].stratum;
 				servers[i].rtdisp=ntp32_to_double(req[i].rtdisp);
@@ -483,7 +637,7 @@ double offset_request(const char *host, int *status){
 				servers[i].flags=req[i].flags;
 				servers_readable--;
 				one_read = 1;
-				if(servers[i].num_responses==AVG_NUM) servers_completed++;
+				if(servers[i].num_responses==num_samples) servers_completed++;
 			}
 		}
 		/* lather, rinse, repeat. */
@@ -496,16 +650,18 @@ double offset_request(const char *host, int *status){
 		die(timeout_state, "%s: No response from NTP server\n", state_text(timeout_state));
 	}
 
+	for(i=0; i<num_hosts; i++){
+		calc_server_stats(&servers[i]);
+	}
+
 	/* now, pick the best server from the list */
 	best_index=best_offset_server(servers, num_hosts);
+	best_server=best_index;
 	if(best_index < 0){
 		*status=STATE_UNKNOWN;
 	} else {
-		/* finally, calculate the average offset */
-		for(i=0; i<servers[best_index].num_responses;i++){
-			avg_offset+=servers[best_index].offset[j];
-		}
-		avg_offset/=servers[best_index].num_responses;
+		/* finally, use the filtered offset of the best server */
+		avg_offset=servers[best_index].filtered_offset;
 	}
 
 	/* cleanup */
@@ -514,9 +670,10 @@ double offset_request(const char *host, int *status){
 	free(ufds);
 
 	free(req);
-	freeaddrinfo(ai);
+	for(j=0; j<nhosts; j++){ freeaddrinfo(ai[j]); }
+	free(ai);
 
-	if(verbose) printf("overall average offset: %.10g\n", avg_offset);
+	if(verbose) printf("overall offset: %.10g\n", avg_offset);
 	return avg_offset;
 }
 
@@ -532,6 +689,7 @@ int process_arguments(int argc, char **argv){
 		{"quiet", no_argument, 0, 'q'},
 		{"time-offset", optional_argument, 0, 'o'},
 		{"delay", optional_argument, 0, 'd'},
+		{"samples", required_argument, 0, 'n'},
 		{"warning", required_argument, 0, 'w'},
 		{"critical", required_argument, 0, 'c'},
 		{"stratum-warn", required_argument, 0, 'W'},
@@ -547,7 +705,7 @@ int process_arguments(int argc, char **argv){
 		usage ("\n");
 
 	while (1) {
-		c = getopt_long (argc, argv, "Vhv46qw:c:t:H:p:o:d:C:W:", longopts, &option);
+		c = getopt_long (argc, argv, "Vhv46qw:c:t:H:p:o:d:n:C:W:", longopts, &option);
 		if (c == -1 || c == EOF || c == 1)
 			break;
 
@@ -581,7 +739,12 @@ int process_arguments(int argc, char **argv){
 		case 'H':
 			if(is_host(optarg) == FALSE)
 				usage2(_("Invalid hostname/address"), optarg);
-			server_address = strdup(optarg);
+			/* -H may be given several times to check a set of servers */
+			server_addresses = realloc(server_addresses,
+			                           (num_server_addresses+1) * sizeof(char *));
+			if(server_addresses == NULL)
+				die(STATE_UNKNOWN, _("Could not allocate memory for hostnames\n"));
+			server_addresses[num_server_addresses++] = strdup(optarg);
 			break;
 		case 'p':
 			port = strdup(optarg);
@@ -595,6 +758,11 @@ int process_arguments(int argc, char **argv){
 		case 'd':
 			delay=atoi(optarg);
 			break;
+		case 'n':
+			if(!is_intpos(optarg) || atoi(optarg) > MAX_SAMPLES)
+				usage2(_("Number of samples must be between 1 and 16"), optarg);
+			num_samples=atoi(optarg);
+			break;
 		case '4':
 			address_family = AF_INET;
 			break;
@@ -612,7 +780,7 @@ int process_arguments(int argc, char **argv){
 		}
 	}
 
-	if(server_address == NULL){
+	if(num_server_addresses == 0){
 		usage4(_("Hostname was not supplied"));
 	}
 
@@ -627,10 +795,28 @@ char *perfd_offset (double offset)
 		FALSE, 0, FALSE, 0);
 }
 
+/* label the per-server perfdata by host name, or by address if the
+ * host name resolved to more than one peer */
+const char *server_label (int i)
+{
+	if((i > 0 && servers[i-1].host == servers[i].host) ||
+	   (i < num_hosts-1 && servers[i+1].host == servers[i].host))
+		return servers[i].addr;
+	return servers[i].host;
+}
+
+int compare_doubles (const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+	return (x > y) - (x < y);
+}
+
 int main(int argc, char *argv[]){
 	int result, offset_result;
 	double offset=0;
-	char *result_line, *perfdata_line;
+	double *offsets=NULL;
+	int num_responding=0;
+	char *result_line, *perfdata_line, *label;
 
 	setlocale (LC_ALL, "");
 	setlocale (LC_NUMERIC, "C");
@@ -653,7 +839,7 @@ int main(int argc, char *argv[]){
 	/* set socket timeout */
 	alarm (timeout_interval);
 
-	offset = offset_request(server_address, &offset_result);
+	offset = offset_request(server_addresses, num_server_addresses, &offset_result);
 	if (offset_result == STATE_UNKNOWN) {
 		result = (quiet == 1 ? STATE_UNKNOWN : STATE_CRITICAL);
 	} else {
@@ -710,12 +896,53 @@ int main(int argc, char *argv[]){
 	} else {
 	  xasprintf(&result_line, "%s %s %.10g secs, stratum best:%d worst:%d", result_line, _("Offset"), offset, servers_best_stratum, servers_worst_stratum);
 	  xasprintf(&perfdata_line, "%s stratum_best=%d stratum_worst=%d num_warn_stratum=%d num_crit_stratum=%d", perfd_offset(offset), servers_best_stratum, servers_worst_stratum, servers_warn_stratum, servers_crit_stratum);
+	  /* the true offset lies within half the round trip delay of the
+	   * measured one, so report that as the measurement error */
+	  xasprintf(&perfdata_line, "%s %s %s", perfdata_line,
+	            sperfdata ("delay", servers[best_server].min_delay, "s", NULL, NULL, TRUE, 0, FALSE, 0),
+	            sperfdata ("offset_error", servers[best_server].min_delay / 2, "s", NULL, NULL, TRUE, 0, FALSE, 0));
+	}
+
+	/* with several servers, also report each one and their consensus */
+	if(num_server_addresses > 1 && offset_result != STATE_UNKNOWN){
+		offsets = (double *)malloc(sizeof(double) * num_hosts);
+		if(offsets == NULL)
+			die(STATE_UNKNOWN, _("Could not allocate memory for offsets\n"));
+		for (i=0; i<num_hosts; i++) {
+			if (servers[i].num_responses == 0)
+				continue;
+			offsets[num_responding++] = servers[i].filtered_offset;
+			xasprintf(&label, "offset_%s", server_label(i));
+			xasprintf(&perfdata_line, "%s %s", perfdata_line,
+			          sperfdata (label, servers[i].filtered_offset, "s",
+			                     offset_thresholds->warning_string,
+			                     offset_thresholds->critical_string,
+			                     FALSE, 0, FALSE, 0));
+			xasprintf(&label, "jitter_%s", server_label(i));
+			xasprintf(&perfdata_line, "%s %s", perfdata_line,
+			          sperfdata (label, servers[i].jitter, "s", NULL, NULL,
+			                     TRUE, 0, FALSE, 0));
+			xasprintf(&label, "stratum_%s", server_label(i));
+			xasprintf(&perfdata_line, "%s %s", perfdata_line,
+			          sperfdata_int (label, servers[i].stratum, "", NULL, NULL,
+			                         TRUE, 0, TRUE, 16));
+		}
+		qsort(offsets, num_responding, sizeof(double), compare_doubles);
+		xasprintf(&result_line, _("%s, %d of %d servers responding, median offset %.10g secs, spread %.10g secs"),
+		          result_line, num_responding, num_hosts,
+		          offsets[num_responding/2], offsets[num_responding-1] - offsets[0]);
+		xasprintf(&perfdata_line, "%s servers_responding=%d;;;0;%d offset_median=%.10gs offset_spread=%.10gs",
+		          perfdata_line, num_responding, num_hosts,
+		          offsets[num_responding/2], offsets[num_responding-1] - offsets[0]);
+		free(offsets);
 	}
 	printf("%s|%s\n", result_line, perfdata_line);
 
 	free(servers);
 
-	if(server_address!=NULL) free(server_address);
+	for (i=0; i<num_server_addresses; i++)
+		free(server_addresses[i]);
+	free(server_addresses);
 	return result;
 }
 
@@ -734,6 +961,7 @@ void print_help(void){
 	printf (UT_EXTRA_OPTS);
 	printf (UT_IPv46);
 	printf (UT_HOST_PORT, 'p', "123");
+	printf ("    %s\n", _("-H may be repeated to query several servers in parallel"));
 	printf (" %s\n", "-q, --quiet");
 	printf ("    %s\n", _("Returns UNKNOWN instead of CRITICAL if offset cannot be found"));
 	printf (" %s\n", "-w, --warning=THRESHOLD");
@@ -744,6 +972,8 @@ void print_help(void){
 	printf ("    %s\n", _("Expected offset of the ntp server relative to local server (seconds)"));
 	printf (" %s\n", "-d, --delay=INTEGER");
 	printf ("    %s\n", _("Delay between each packet (seconds)"));
+	printf (" %s\n", "-n, --samples=INTEGER");
+	printf ("    %s\n", _("Number of samples to take from each server (default: 4, max: 16)"));
 	printf (" %s\n", "-W, --stratum-warn=INTEGER");
 	printf ("    %s\n", _("Alert warning if stratum is worse (less) than specfied value"));
 	printf (" %s\n", "-C, --stratum-crit=INTEGER");
@@ -765,12 +995,19 @@ void print_help(void){
 	printf(" %s\n", _("and expected clock skew."));
 	printf(" %s\n", _("--delay is useful if you are triggering the anti-DOS for the"));
 	printf(" %s\n", _("NTP server and need to leave a bigger gap between queries"));
+	printf(" %s\n", _("Of the samples taken from a server, the one with the lowest round trip"));
+	printf(" %s\n", _("delay is used. Where the kernel supports it, replies are timestamped"));
+	printf(" %s\n", _("on arrival; offset_error in the perfdata is half of that delay."));
+	printf(" %s\n", _("When several servers are given, all of them are queried at once and"));
+	printf(" %s\n", _("the offset of the best one is checked against the thresholds; the"));
+	printf(" %s\n", _("offset, jitter and stratum of each server are added to the perfdata."));
 	printf("\n");
 	printf(UT_THRESHOLDS_NOTES);
 
 	printf("\n");
 	printf("%s\n", _("Examples:"));
 	printf("  %s\n", ("./check_ntp_time -H ntpserv -w 0.5 -c 1"));
+	printf("  %s\n", ("./check_ntp_time -H ntp1 -H ntp2 -H ntp3 -w 0.5 -c 1"));
 
 	printf (UT_SUPPORT);
 }
@@ -779,6 +1016,6 @@ void
 print_usage(void)
 {
 	printf ("%s\n", _("Usage:"));
-	printf(" %s -H <host> [-4|-6] [-w <warn>] [-c <crit>] [-v verbose] [-o <time offset>] [-d <delay>] [-W <stratum warn>] [-C <stratum crit>]\n", progname);
+	printf(" %s -H <host> [-H <host> ...] [-4|-6] [-w <warn>] [-c <crit>] [-v verbose] [-o <time offset>] [-d <delay>] [-n <samples>] [-W <stratum warn>] [-C <stratum crit>]\n", progname);
 }
 
@@ -110,7 +110,28 @@ int check_netware_version=FALSE;
 enum checkvar vars_to_check = NONE;
 int sap_number=-1;
 
+typedef struct nwstat_var {
+	char *arg;                   /* argument of -v */
+	unsigned long warning_value;
+	unsigned long critical_value;
+	int check_warning_value;
+	int check_critical_value;
+} nwstat_var;
+
+nwstat_var *vars=NULL;
+int num_vars=0;
+
+int sd=-1;
+np_net_reader reader;
+int requests_on_connection=0;
+int reuse_connection=TRUE;
+
 int process_arguments(int, char **);
+int parse_variable(const char *);
+void add_variable(const char *);
+void select_variable(int);
+int nwstat_request(const char *, char *, int);
+int check_variable(char **);
 void print_help(void);
 void print_usage(void);
 
@@ -119,12 +140,104 @@ void print_usage(void);
 int
 main(int argc, char **argv) {
 	int result = STATE_UNKNOWN;
-	int sd;
+	int var_result;
+	char recv_buffer[MAX_INPUT_BUFFER];
+	char *output_message=NULL;
+	char *netware_version=NULL;
+	char *var_message;
+	char *perfdata;
+	char *sep;
+	int i;
+
+	setlocale (LC_ALL, "");
+	bindtextdomain (PACKAGE, LOCALEDIR);
+	textdomain (PACKAGE);
+
+	/* Parse extra opts if any */
+	argv=np_extra_opts(&argc, argv, progname);
+
+	if (process_arguments(argc,argv) == ERROR)
+		usage4 (_("Could not parse arguments"));
+
+	/* initialize alarm signal handling */
+	signal(SIGALRM,socket_timeout_alarm_handler);
+
+	/* the agent may close a connection we are about to reuse */
+	signal(SIGPIPE,SIG_IGN);
+
+	/* set socket timeout */
+	alarm(timeout_interval);
+
+	/* get OS version string */
+	if (check_netware_version==TRUE) {
+		result=nwstat_request("S19\r\n",recv_buffer,sizeof(recv_buffer));
+		if (result!=STATE_OK)
+			return result;
+		if (!strcmp(recv_buffer,"-1\n"))
+			netware_version = strdup("");
+		else {
+			recv_buffer[strlen(recv_buffer)-1]=0;
+			xasprintf (&netware_version,_("NetWare %s: "),recv_buffer);
+		}
+	} else
+		netware_version = strdup("");
+
+	if (num_vars == 0) {
+
+		output_message = strdup (_("Nothing to check!\n"));
+		result=STATE_UNKNOWN;
+
+	} else if (num_vars == 1) {
+
+		select_variable(0);
+		result=check_variable(&output_message);
+		if (output_message==NULL)
+			return result;
+
+	} else {
+
+		/* all variables in one line, perfdata collected at the end */
+		result=STATE_OK;
+		output_message=strdup("");
+		perfdata=strdup("");
+		for (i=0; i<num_vars; i++) {
+			select_variable(i);
+			var_message=NULL;
+			var_result=check_variable(&var_message);
+			if (var_message==NULL)
+				return var_result;
+			result=max_state(result,var_result);
+			if ((sep=strchr(var_message,'|'))!=NULL)
+				*sep++=0;
+			xasprintf (&output_message,"%s%s%s",output_message,i?"; ":"",var_message);
+			if (sep!=NULL && *sep)
+				xasprintf (&perfdata,"%s%s%s",perfdata,*perfdata?" ":"",sep);
+		}
+		xasprintf (&output_message,"%s|%s",output_message,perfdata);
+
+	}
+
+	if (sd >= 0)
+		close (sd);
+
+	/* reset timeout */
+	alarm(0);
+
+	printf("%s%s\n",netware_version,output_message);
+
+	return result;
+}
+
+
+/* check the variable set up by select_variable(), returns with
+ * *output_message left NULL if the agent could not be queried */
+int
+check_variable(char **output_message_ptr) {
+	int result = STATE_UNKNOWN;
 	char *send_buffer=NULL;
 	char recv_buffer[MAX_INPUT_BUFFER];
 	char *output_message=NULL;
 	char *temp_buffer=NULL;
-	char *netware_version=NULL;
 
 	int time_sync_status=0;
 	int nrm_health_status=0;
@@ -162,40 +275,6 @@ main(int argc, char **argv) {
 	unsigned long sap_entries=0;
 	char uptime[MAX_INPUT_BUFFER];
 
-	setlocale (LC_ALL, "");
-	bindtextdomain (PACKAGE, LOCALEDIR);
-	textdomain (PACKAGE);
-
-	/* Parse extra opts if any */
-	argv=np_extra_opts(&argc, argv, progname);
-
-	if (process_arguments(argc,argv) == ERROR)
-		usage4 (_("Could not parse arguments"));
-
-	/* initialize alarm signal handling */
-	signal(SIGALRM,socket_timeout_alarm_handler);
-
-	/* set socket timeout */
-	alarm(timeout_interval);
-
-	/* open connection */
-	my_tcp_connect (server_address, server_port, &sd);
-
-	/* get OS version string */
-	if (check_netware_version==TRUE) {
-		send_buffer = strdup ("S19\r\n");
-		result=send_tcp_request(sd,send_buffer,recv_buffer,sizeof(recv_buffer));
-		if (result!=STATE_OK)
-			return result;
-		if (!strcmp(recv_buffer,"-1\n"))
-			netware_version = strdup("");
-		else {
-			recv_buffer[strlen(recv_buffer)-1]=0;
-			xasprintf (&netware_version,_("NetWare %s: "),recv_buffer);
-		}
-	} else
-		netware_version = strdup("");
-
 
 	/* check CPU load */
 	if (vars_to_check==LOAD1 || vars_to_check==LOAD5 || vars_to_check==LOAD15) {
@@ -212,20 +291,14 @@ main(int argc, char **argv) {
 			break;
 		}
 
-		close(sd);
-		my_tcp_connect (server_address, server_port, &sd);
-
 		xasprintf (&send_buffer,"UTIL%s\r\n",temp_buffer);
-		result=send_tcp_request(sd,send_buffer,recv_buffer,sizeof(recv_buffer));
+		result=nwstat_request(send_buffer,recv_buffer,sizeof(recv_buffer));
 		if (result!=STATE_OK)
 			return result;
 		utilization=strtoul(recv_buffer,NULL,10);
 
-		close(sd);
-		my_tcp_connect (server_address, server_port, &sd);
-
 		send_buffer = strdup ("UPTIME\r\n");
-		result=send_tcp_request(sd,send_buffer,recv_buffer,sizeof(recv_buffer));
+		result=nwstat_request(send_buffer,recv_buffer,sizeof(recv_buffer));
 		if (result!=STATE_OK)
 			return result;
 		recv_buffer[strlen(recv_buffer)-1]=0;
@@ -250,11 +323,8 @@ main(int argc, char **argv) {
 		/* check number of user connections */
 	} else if (vars_to_check==CONNS) {
 
-		close(sd);
-		my_tcp_connect (server_address, server_port, &sd);
-
 		send_buffer = strdup ("CONNECT\r\n");
-		result=send_tcp_request(sd,send_buffer,recv_buffer,sizeof(recv_buffer));
+		result=nwstat_request(send_buffer,recv_buffer,sizeof(recv_buffer));
 		if (result!=STATE_OK)
 			return result;
 		current_connections=strtoul(recv_buffer,NULL,10);
@@ -275,11 +345,8 @@ main(int argc, char **argv) {
 		/* check % long term cache hits */
 	} else if (vars_to_check==LTCH) {
 
-		close(sd);
-		my_tcp_connect (server_address, server_port, &sd);
-
 		send_buffer = strdup ("S1\r\n");
-		result=send_tcp_request(sd,send_buffer,recv_buffer,sizeof(recv_buffer));
+		result=nwstat_request(send_buffer,recv_buffer,sizeof(recv_buffer));
 		if (result!=STATE_OK)
 			return result;
 		cache_hits=atoi(recv_buffer);
@@ -297,11 +364,8 @@ main(int argc, char **argv) {
 		/* check cache buffers */
 	} else if (vars_to_check==CBUFF) {
 
-		close(sd);
-		my_tcp_connect (server_address, server_port, &sd);
-
 		send_buffer = strdup ("S2\r\n");
-		result=send_tcp_request(sd,send_buffer,recv_buffer,sizeof(recv_buffer));
+		result=nwstat_request(send_buffer,recv_buffer,sizeof(recv_buffer));
 		if (result!=STATE_OK)
 			return result;
 		cache_buffers=strtoul(recv_buffer,NULL,10);
@@ -322,11 +386,8 @@ main(int argc, char **argv) {
 		/* check dirty cache buffers */
 	} else if (vars_to_check==CDBUFF) {
 
-		close(sd);
-		my_tcp_connect (server_address, server_port, &sd);
-
 		send_buffer = strdup ("S3\r\n");
-		result=send_tcp_request(sd,send_buffer,recv_buffer,sizeof(recv_buffer));
+		result=nwstat_request(send_buffer,recv_buffer,sizeof(recv_buffer));
 		if (result!=STATE_OK)
 			return result;
 		cache_buffers=strtoul(recv_buffer,NULL,10);
@@ -347,11 +408,8 @@ main(int argc, char **argv) {
 		/* check LRU sitting time in minutes */
 	} else if (vars_to_check==LRUM) {
 
-		close(sd);
-		my_tcp_connect (server_address, server_port, &sd);
-
 		send_buffer = strdup ("S5\r\n");
-		result=send_tcp_request(sd,send_buffer,recv_buffer,sizeof(recv_buffer));
+		result=nwstat_request(send_buffer,recv_buffer,sizeof(recv_buffer));
 		if (result!=STATE_OK)
 			return result;
 		lru_time=strtoul(recv_buffer,NULL,10);
@@ -370,11 +428,8 @@ main(int argc, char **argv) {
 		/* check KB free space on volume */
 	} else if (vars_to_check==VKF) {
 
-		close(sd);
-		my_tcp_connect (server_address, server_port, &sd);
-
 		xasprintf (&send_buffer,"VKF%s\r\n",volume_name);
-		result=send_tcp_request(sd,send_buffer,recv_buffer,sizeof(recv_buffer));
+		result=nwstat_request(send_buffer,recv_buffer,sizeof(recv_buffer));
 		if (result!=STATE_OK)
 			return result;
 
@@ -402,7 +457,7 @@ main(int argc, char **argv) {
 	} else if (vars_to_check==VMF) {
 
 		xasprintf (&send_buffer,"VMF%s\r\n",volume_name);
-		result=send_tcp_request(sd,send_buffer,recv_buffer,sizeof(recv_buffer));
+		result=nwstat_request(send_buffer,recv_buffer,sizeof(recv_buffer));
 		if (result!=STATE_OK)
 			return result;
 
@@ -429,7 +484,7 @@ main(int argc, char **argv) {
 	} else if (vars_to_check==VMU) {
 
 		xasprintf (&send_buffer,"VMU%s\r\n",volume_name);
-		result=send_tcp_request(sd,send_buffer,recv_buffer,sizeof(recv_buffer));
+		result=nwstat_request(send_buffer,recv_buffer,sizeof(recv_buffer));
 		if (result!=STATE_OK)
 			return result;
 
@@ -457,11 +512,8 @@ main(int argc, char **argv) {
 		/* check % free space on volume */
 	} else if (vars_to_check==VPF) {
 
-		close(sd);
-		my_tcp_connect (server_address, server_port, &sd);
-
 		xasprintf (&send_buffer,"VKF%s\r\n",volume_name);
-		result=send_tcp_request(sd,send_buffer,recv_buffer,sizeof(recv_buffer));
+		result=nwstat_request(send_buffer,recv_buffer,sizeof(recv_buffer));
 		if (result!=STATE_OK)
 			return result;
 
@@ -474,11 +526,8 @@ main(int argc, char **argv) {
 
 			free_disk_space=strtoul(recv_buffer,NULL,10);
 
-			close(sd);
-			my_tcp_connect (server_address, server_port, &sd);
-
 			xasprintf (&send_buffer,"VKS%s\r\n",volume_name);
-			result=send_tcp_request(sd,send_buffer,recv_buffer,sizeof(recv_buffer));
+			result=nwstat_request(send_buffer,recv_buffer,sizeof(recv_buffer));
 			if (result!=STATE_OK)
 				return result;
 			total_disk_space=strtoul(recv_buffer,NULL,10);
@@ -506,19 +555,13 @@ main(int argc, char **argv) {
 		/* check to see if DS Database is open or closed */
 	} else if (vars_to_check==DSDB) {
 
-		close(sd);
-		my_tcp_connect (server_address, server_port, &sd);
-
 		send_buffer = strdup ("S11\r\n");
-		result=send_tcp_request(sd,send_buffer,recv_buffer,sizeof(recv_buffer));
+		result=nwstat_request(send_buffer,recv_buffer,sizeof(recv_buffer));
 		if (result!=STATE_OK)
 			return result;
 
-		close(sd);
-		my_tcp_connect (server_address, server_port, &sd);
-
 		send_buffer = strdup ("S13\r\n");
-		result=send_tcp_request(sd,send_buffer,recv_buffer,sizeof(recv_buffer));
+		result=nwstat_request(send_buffer,recv_buffer,sizeof(recv_buffer));
 		temp_buffer=strtok(recv_buffer,"\r\n");
 
 		xasprintf (&output_message,_("Directory Services Database is %s (DS version %s)"),(result==STATE_OK)?"open":"closed",temp_buffer);
@@ -526,11 +569,8 @@ main(int argc, char **argv) {
 		/* check to see if logins are enabled */
 	} else if (vars_to_check==LOGINS) {
 
-		close(sd);
-		my_tcp_connect (server_address, server_port, &sd);
-
 		send_buffer = strdup ("S12\r\n");
-		result=send_tcp_request(sd,send_buffer,recv_buffer,sizeof(recv_buffer));
+		result=nwstat_request(send_buffer,recv_buffer,sizeof(recv_buffer));
 		if (result!=STATE_OK)
 			return result;
 		if (atoi(recv_buffer)==1)
@@ -545,7 +585,7 @@ main(int argc, char **argv) {
 	} else if (vars_to_check==NRMH) {
 
 		xasprintf (&send_buffer,"NRMH\r\n");
-		result=send_tcp_request(sd,send_buffer,recv_buffer,sizeof(recv_buffer));
+		result=nwstat_request(send_buffer,recv_buffer,sizeof(recv_buffer));
 		if (result!=STATE_OK)
 			return result;
 
@@ -569,21 +609,15 @@ main(int argc, char **argv) {
 		/* check packet receive buffers */
 	} else if (vars_to_check==UPRB || vars_to_check==PUPRB) {
 
-		close(sd);
-		my_tcp_connect (server_address, server_port, &sd);
-
 		xasprintf (&send_buffer,"S15\r\n");
-		result=send_tcp_request(sd,send_buffer,recv_buffer,sizeof(recv_buffer));
+		result=nwstat_request(send_buffer,recv_buffer,sizeof(recv_buffer));
 		if (result!=STATE_OK)
 			return result;
 
 		used_packet_receive_buffers=atoi(recv_buffer);
 
-		close(sd);
-		my_tcp_connect (server_address, server_port, &sd);
-
 		xasprintf (&send_buffer,"S16\r\n");
-		result=send_tcp_request(sd,send_buffer,recv_buffer,sizeof(recv_buffer));
+		result=nwstat_request(send_buffer,recv_buffer,sizeof(recv_buffer));
 		if (result!=STATE_OK)
 			return result;
 
@@ -608,14 +642,11 @@ main(int argc, char **argv) {
 		/* check SAP table entries */
 	} else if (vars_to_check==SAPENTRIES) {
 
-		close(sd);
-		my_tcp_connect (server_address, server_port, &sd);
-
 		if (sap_number==-1)
 			xasprintf (&send_buffer,"S9\r\n");
 		else
 			xasprintf (&send_buffer,"S9.%d\r\n",sap_number);
-		result=send_tcp_request(sd,send_buffer,recv_buffer,sizeof(recv_buffer));
+		result=nwstat_request(send_buffer,recv_buffer,sizeof(recv_buffer));
 		if (result!=STATE_OK)
 			return result;
 
@@ -634,11 +665,8 @@ main(int argc, char **argv) {
 		/* check KB purgeable space on volume */
 	} else if (vars_to_check==VKP) {
 
-		close(sd);
-		my_tcp_connect (server_address, server_port, &sd);
-
 		xasprintf (&send_buffer,"VKP%s\r\n",volume_name);
-		result=send_tcp_request(sd,send_buffer,recv_buffer,sizeof(recv_buffer));
+		result=nwstat_request(send_buffer,recv_buffer,sizeof(recv_buffer));
 		if (result!=STATE_OK)
 			return result;
 
@@ -664,7 +692,7 @@ main(int argc, char **argv) {
 	} else if (vars_to_check==VMP) {
 
 		xasprintf (&send_buffer,"VMP%s\r\n",volume_name);
-		result=send_tcp_request(sd,send_buffer,recv_buffer,sizeof(recv_buffer));
+		result=nwstat_request(send_buffer,recv_buffer,sizeof(recv_buffer));
 		if (result!=STATE_OK)
 			return result;
 
@@ -690,11 +718,8 @@ main(int argc, char **argv) {
 		/* check % purgeable space on volume */
 	} else if (vars_to_check==VPP) {
 
-		close(sd);
-		my_tcp_connect (server_address, server_port, &sd);
-
 		xasprintf (&send_buffer,"VKP%s\r\n",volume_name);
-		result=send_tcp_request(sd,send_buffer,recv_buffer,sizeof(recv_buffer));
+		result=nwstat_request(send_buffer,recv_buffer,sizeof(recv_buffer));
 		if (result!=STATE_OK)
 			return result;
 
@@ -707,11 +732,8 @@ main(int argc, char **argv) {
 
 			purgeable_disk_space=strtoul(recv_buffer,NULL,10);
 
-			close(sd);
-			my_tcp_connect (server_address, server_port, &sd);
-
 			xasprintf (&send_buffer,"VKS%s\r\n",volume_name);
-			result=send_tcp_request(sd,send_buffer,recv_buffer,sizeof(recv_buffer));
+			result=nwstat_request(send_buffer,recv_buffer,sizeof(recv_buffer));
 			if (result!=STATE_OK)
 				return result;
 			total_disk_space=strtoul(recv_buffer,NULL,10);
@@ -737,11 +759,8 @@ main(int argc, char **argv) {
 		/* check KB not yet purgeable space on volume */
 	} else if (vars_to_check==VKNP) {
 
-		close(sd);
-		my_tcp_connect (server_address, server_port, &sd);
-
 		xasprintf (&send_buffer,"VKNP%s\r\n",volume_name);
-		result=send_tcp_request(sd,send_buffer,recv_buffer,sizeof(recv_buffer));
+		result=nwstat_request(send_buffer,recv_buffer,sizeof(recv_buffer));
 		if (result!=STATE_OK)
 			return result;
 
@@ -760,11 +779,8 @@ main(int argc, char **argv) {
 		/* check % not yet purgeable space on volume */
 	} else if (vars_to_check==VPNP) {
 
-		close(sd);
-		my_tcp_connect (server_address, server_port, &sd);
-
 		xasprintf (&send_buffer,"VKNP%s\r\n",volume_name);
-		result=send_tcp_request(sd,send_buffer,recv_buffer,sizeof(recv_buffer));
+		result=nwstat_request(send_buffer,recv_buffer,sizeof(recv_buffer));
 		if (result!=STATE_OK)
 			return result;
 
@@ -777,11 +793,8 @@ main(int argc, char **argv) {
 
 			non_purgeable_disk_space=strtoul(recv_buffer,NULL,10);
 
-			close(sd);
-			my_tcp_connect (server_address, server_port, &sd);
-
 			xasprintf (&send_buffer,"VKS%s\r\n",volume_name);
-			result=send_tcp_request(sd,send_buffer,recv_buffer,sizeof(recv_buffer));
+			result=nwstat_request(send_buffer,recv_buffer,sizeof(recv_buffer));
 			if (result!=STATE_OK)
 				return result;
 			total_disk_space=strtoul(recv_buffer,NULL,10);
@@ -798,11 +811,8 @@ main(int argc, char **argv) {
 		/* check # of open files */
 	} else if (vars_to_check==OFILES) {
 
-		close(sd);
-		my_tcp_connect (server_address, server_port, &sd);
-
 		xasprintf (&send_buffer,"S18\r\n");
-		result=send_tcp_request(sd,send_buffer,recv_buffer,sizeof(recv_buffer));
+		result=nwstat_request(send_buffer,recv_buffer,sizeof(recv_buffer));
 		if (result!=STATE_OK)
 			return result;
 
@@ -823,11 +833,8 @@ main(int argc, char **argv) {
 		/* check # of abended threads (Netware > 5.x only) */
 	} else if (vars_to_check==ABENDS) {
 
-		close(sd);
-		my_tcp_connect (server_address, server_port, &sd);
-
 		xasprintf (&send_buffer,"S17\r\n");
-		result=send_tcp_request(sd,send_buffer,recv_buffer,sizeof(recv_buffer));
+		result=nwstat_request(send_buffer,recv_buffer,sizeof(recv_buffer));
 		if (result!=STATE_OK)
 			return result;
 
@@ -847,21 +854,15 @@ main(int argc, char **argv) {
 		/* check # of current service processes (Netware 5.x only) */
 	} else if (vars_to_check==CSPROCS) {
 
-		close(sd);
-		my_tcp_connect (server_address, server_port, &sd);
-
 		xasprintf (&send_buffer,"S20\r\n");
-		result=send_tcp_request(sd,send_buffer,recv_buffer,sizeof(recv_buffer));
+		result=nwstat_request(send_buffer,recv_buffer,sizeof(recv_buffer));
 		if (result!=STATE_OK)
 			return result;
 
 		max_service_processes=atoi(recv_buffer);
 
-		close(sd);
-		my_tcp_connect (server_address, server_port, &sd);
-
 		xasprintf (&send_buffer,"S21\r\n");
-		result=send_tcp_request(sd,send_buffer,recv_buffer,sizeof(recv_buffer));
+		result=nwstat_request(send_buffer,recv_buffer,sizeof(recv_buffer));
 		if (result!=STATE_OK)
 			return result;
 
@@ -884,11 +885,8 @@ main(int argc, char **argv) {
 		/* check # Timesync Status */
 	} else if (vars_to_check==TSYNC) {
 
-		close(sd);
-		my_tcp_connect (server_address, server_port, &sd);
-
 		xasprintf (&send_buffer,"S22\r\n");
-		result=send_tcp_request(sd,send_buffer,recv_buffer,sizeof(recv_buffer));
+		result=nwstat_request(send_buffer,recv_buffer,sizeof(recv_buffer));
 		if (result!=STATE_OK)
 			return result;
 
@@ -909,11 +907,8 @@ main(int argc, char **argv) {
 		/* check LRU sitting time in secondss */
 	} else if (vars_to_check==LRUS) {
 
-		close(sd);
-		my_tcp_connect (server_address, server_port, &sd);
-
 		send_buffer = strdup ("S4\r\n");
-		result=send_tcp_request(sd,send_buffer,recv_buffer,sizeof(recv_buffer));
+		result=nwstat_request(send_buffer,recv_buffer,sizeof(recv_buffer));
 		if (result!=STATE_OK)
 			return result;
 		lru_time=strtoul(recv_buffer,NULL,10);
@@ -928,11 +923,8 @@ main(int argc, char **argv) {
 		/* check % dirty cacheobuffers as a percentage of the total*/
 	} else if (vars_to_check==DCB) {
 
-		close(sd);
-		my_tcp_connect (server_address, server_port, &sd);
-
 		send_buffer = strdup ("S6\r\n");
-		result=send_tcp_request(sd,send_buffer,recv_buffer,sizeof(recv_buffer));
+		result=nwstat_request(send_buffer,recv_buffer,sizeof(recv_buffer));
 		if (result!=STATE_OK)
 			return result;
 		dirty_cache_buffers=atoi(recv_buffer);
@@ -950,11 +942,8 @@ main(int argc, char **argv) {
 		/* check % total cache buffers as a percentage of the original*/
 	} else if (vars_to_check==TCB) {
 
-		close(sd);
-		my_tcp_connect (server_address, server_port, &sd);
-
 		send_buffer = strdup ("S7\r\n");
-		result=send_tcp_request(sd,send_buffer,recv_buffer,sizeof(recv_buffer));
+		result=nwstat_request(send_buffer,recv_buffer,sizeof(recv_buffer));
 		if (result!=STATE_OK)
 			return result;
 		total_cache_buffers=atoi(recv_buffer);
@@ -971,11 +960,8 @@ main(int argc, char **argv) {
 
 	} else if (vars_to_check==DSVER) {
 
-		close(sd);
-		my_tcp_connect (server_address, server_port, &sd);
-
 		xasprintf (&send_buffer,"S13\r\n");
-		result=send_tcp_request(sd,send_buffer,recv_buffer,sizeof(recv_buffer));
+		result=nwstat_request(send_buffer,recv_buffer,sizeof(recv_buffer));
 		if (result!=STATE_OK)
 			return result;
 
@@ -985,11 +971,8 @@ main(int argc, char **argv) {
 
 	} else if (vars_to_check==UPTIME) {
 
-		close(sd);
-		my_tcp_connect (server_address, server_port, &sd);
-
 		xasprintf (&send_buffer,"UPTIME\r\n");
-		result=send_tcp_request(sd,send_buffer,recv_buffer,sizeof(recv_buffer));
+		result=nwstat_request(send_buffer,recv_buffer,sizeof(recv_buffer));
 		if (result!=STATE_OK)
 	 		return result;
 
@@ -1001,11 +984,8 @@ main(int argc, char **argv) {
 
 	} else if (vars_to_check==NLM) {
 
-		close(sd);
-		my_tcp_connect (server_address, server_port, &sd);
-
 		xasprintf (&send_buffer,"S24:%s\r\n",nlm_name);
-		result=send_tcp_request(sd,send_buffer,recv_buffer,sizeof(recv_buffer));
+		result=nwstat_request(send_buffer,recv_buffer,sizeof(recv_buffer));
 		if (result!=STATE_OK)
 			return result;
 
@@ -1020,7 +1000,7 @@ main(int argc, char **argv) {
 	} else if (vars_to_check==NRMP) {
 
 		xasprintf (&send_buffer,"NRMP:%s\r\n",nrmp_name);
-		result=send_tcp_request(sd,send_buffer,recv_buffer,sizeof(recv_buffer));
+		result=nwstat_request(send_buffer,recv_buffer,sizeof(recv_buffer));
 		if (result!=STATE_OK)
 			return result;
 
@@ -1046,7 +1026,7 @@ main(int argc, char **argv) {
 	} else if (vars_to_check==NRMM) {
 
 		xasprintf (&send_buffer,"NRMM:%s\r\n",nrmm_name);
-		result=send_tcp_request(sd,send_buffer,recv_buffer,sizeof(recv_buffer));
+		result=nwstat_request(send_buffer,recv_buffer,sizeof(recv_buffer));
 		if (result!=STATE_OK)
 			return result;
 
@@ -1072,7 +1052,7 @@ main(int argc, char **argv) {
 	} else if (vars_to_check==NRMS) {
 
 		xasprintf (&send_buffer,"NRMS:%s\r\n",nrms_name);
-		result=send_tcp_request(sd,send_buffer,recv_buffer,sizeof(recv_buffer));
+		result=nwstat_request(send_buffer,recv_buffer,sizeof(recv_buffer));
 		if (result!=STATE_OK)
 			return result;
 
@@ -1098,7 +1078,7 @@ main(int argc, char **argv) {
 	} else if (vars_to_check==NSS1) {
 
 		xasprintf (&send_buffer,"NSS1:%s\r\n",nss1_name);
-		result=send_tcp_request(sd,send_buffer,recv_buffer,sizeof(recv_buffer));
+		result=nwstat_request(send_buffer,recv_buffer,sizeof(recv_buffer));
 		if (result!=STATE_OK)
 			return result;
 
@@ -1124,7 +1104,7 @@ main(int argc, char **argv) {
 	} else if (vars_to_check==NSS2) {
 
 		xasprintf (&send_buffer,"NSS2:%s\r\n",nss2_name);
-		result=send_tcp_request(sd,send_buffer,recv_buffer,sizeof(recv_buffer));
+		result=nwstat_request(send_buffer,recv_buffer,sizeof(recv_buffer));
 		if (result!=STATE_OK)
 			return result;
 
@@ -1150,7 +1130,7 @@ main(int argc, char **argv) {
 	} else if (vars_to_check==NSS3) {
 
 		xasprintf (&send_buffer,"NSS3:%s\r\n",nss3_name);
-		result=send_tcp_request(sd,send_buffer,recv_buffer,sizeof(recv_buffer));
+		result=nwstat_request(send_buffer,recv_buffer,sizeof(recv_buffer));
 		if (result!=STATE_OK)
 			return result;
 
@@ -1176,7 +1156,7 @@ main(int argc, char **argv) {
 	} else if (vars_to_check==NSS4) {
 
 		xasprintf (&send_buffer,"NSS4:%s\r\n",nss4_name);
-		result=send_tcp_request(sd,send_buffer,recv_buffer,sizeof(recv_buffer));
+		result=nwstat_request(send_buffer,recv_buffer,sizeof(recv_buffer));
 		if (result!=STATE_OK)
 			return result;
 
@@ -1202,7 +1182,7 @@ main(int argc, char **argv) {
 	} else if (vars_to_check==NSS5) {
 
 		xasprintf (&send_buffer,"NSS5:%s\r\n",nss5_name);
-		result=send_tcp_request(sd,send_buffer,recv_buffer,sizeof(recv_buffer));
+		result=nwstat_request(send_buffer,recv_buffer,sizeof(recv_buffer));
 		if (result!=STATE_OK)
 			return result;
 
@@ -1228,7 +1208,7 @@ main(int argc, char **argv) {
 	} else if (vars_to_check==NSS6) {
 
 		xasprintf (&send_buffer,"NSS6:%s\r\n",nss6_name);
-		result=send_tcp_request(sd,send_buffer,recv_buffer,sizeof(recv_buffer));
+		result=nwstat_request(send_buffer,recv_buffer,sizeof(recv_buffer));
 		if (result!=STATE_OK)
 			return result;
 
@@ -1254,7 +1234,7 @@ main(int argc, char **argv) {
 	} else if (vars_to_check==NSS7) {
 
 		xasprintf (&send_buffer,"NSS7:%s\r\n",nss7_name);
-		result=send_tcp_request(sd,send_buffer,recv_buffer,sizeof(recv_buffer));
+		result=nwstat_request(send_buffer,recv_buffer,sizeof(recv_buffer));
 		if (result!=STATE_OK)
 			return result;
 
@@ -1279,20 +1259,8 @@ main(int argc, char **argv) {
 
 
 }
-	else {
-
-		output_message = strdup (_("Nothing to check!\n"));
-		result=STATE_UNKNOWN;
-
-	}
-
-	close (sd);
-
-	/* reset timeout */
-	alarm(0);
-
-	printf("%s%s\n",netware_version,output_message);
 
+	*output_message_ptr = output_message;
 	return result;
 }
 
@@ -1366,220 +1334,302 @@ int process_arguments(int argc, char **argv) {
 					die(STATE_UNKNOWN,_("Server port an integer\n"));
 				break;
 			case 'v':
-				if (strlen(optarg)<3)
+				if (parse_variable(optarg) == ERROR)
 					return ERROR;
-				if (!strcmp(optarg,"LOAD1"))
-					vars_to_check=LOAD1;
-				else if (!strcmp(optarg,"LOAD5"))
-					vars_to_check=LOAD5;
-				else if (!strcmp(optarg,"LOAD15"))
-					vars_to_check=LOAD15;
-				else if (!strcmp(optarg,"CONNS"))
-					vars_to_check=CONNS;
-				else if (!strcmp(optarg,"LTCH"))
-					vars_to_check=LTCH;
-				else if (!strcmp(optarg,"DCB"))
-					vars_to_check=DCB;
-				else if (!strcmp(optarg,"TCB"))
-					vars_to_check=TCB;
-				else if (!strcmp(optarg,"CBUFF"))
-					vars_to_check=CBUFF;
-				else if (!strcmp(optarg,"CDBUFF"))
-					vars_to_check=CDBUFF;
-				else if (!strcmp(optarg,"LRUM"))
-					vars_to_check=LRUM;
-				else if (!strcmp(optarg,"LRUS"))
-					vars_to_check=LRUS;
-				else if (strncmp(optarg,"VPF",3)==0) {
-					vars_to_check=VPF;
-					volume_name = strdup (optarg+3);
-					if (!strcmp(volume_name,""))
-						volume_name = strdup ("SYS");
-				}
-				else if (strncmp(optarg,"VKF",3)==0) {
-					vars_to_check=VKF;
-					volume_name = strdup (optarg+3);
-					if (!strcmp(volume_name,""))
-						volume_name = strdup ("SYS");
-				}
-				else if (strncmp(optarg,"VMF",3)==0) {
-					vars_to_check=VMF;
-					volume_name = strdup (optarg+3);
-					if (!strcmp(volume_name,""))
-						volume_name = strdup ("SYS");
-				}
-				else if (!strcmp(optarg,"DSDB"))
-					vars_to_check=DSDB;
-				else if (!strcmp(optarg,"LOGINS"))
-					vars_to_check=LOGINS;
-				else if (!strcmp(optarg,"NRMH"))
-					vars_to_check=NRMH;
-				else if (!strcmp(optarg,"UPRB"))
-					vars_to_check=UPRB;
-				else if (!strcmp(optarg,"PUPRB"))
-					vars_to_check=PUPRB;
-				else if (!strncmp(optarg,"SAPENTRIES",10)) {
-					vars_to_check=SAPENTRIES;
-					if (strlen(optarg)>10)
-						sap_number=atoi(optarg+10);
-					else
-						sap_number=-1;
-				}
-				else if (!strcmp(optarg,"OFILES"))
-					vars_to_check=OFILES;
-				else if (strncmp(optarg,"VKP",3)==0) {
-					vars_to_check=VKP;
-					volume_name = strdup (optarg+3);
-					if (!strcmp(volume_name,""))
-						volume_name = strdup ("SYS");
-				}
-				else if (strncmp(optarg,"VMP",3)==0) {
-					vars_to_check=VMP;
-					volume_name = strdup (optarg+3);
-					if (!strcmp(volume_name,""))
-						volume_name = strdup ("SYS");
-				}
-				else if (strncmp(optarg,"VMU",3)==0) {
-					vars_to_check=VMU;
-					volume_name = strdup (optarg+3);
-					if (!strcmp(volume_name,""))
-						volume_name = strdup ("SYS");
-				}
-				else if (strncmp(optarg,"VPP",3)==0) {
-					vars_to_check=VPP;
-					volume_name = strdup (optarg+3);
-					if (!strcmp(volume_name,""))
-						volume_name = strdup ("SYS");
-				}
-				else if (strncmp(optarg,"VKNP",4)==0) {
-					vars_to_check=VKNP;
-					volume_name = strdup (optarg+4);
-					if (!strcmp(volume_name,""))
-						volume_name = strdup ("SYS");
-				}
-				else if (strncmp(optarg,"VPNP",4)==0) {
-					vars_to_check=VPNP;
-					volume_name = strdup (optarg+4);
-					if (!strcmp(volume_name,""))
-						volume_name = strdup("SYS");
-				}
-				else if (!strcmp(optarg,"ABENDS"))
-					vars_to_check=ABENDS;
-				else if (!strcmp(optarg,"CSPROCS"))
-					vars_to_check=CSPROCS;
-				else if (!strcmp(optarg,"TSYNC"))
-					vars_to_check=TSYNC;
-				else if (!strcmp(optarg,"DSVER"))
-					vars_to_check=DSVER;
-				else if (!strcmp(optarg,"UPTIME")) {
-					vars_to_check=UPTIME;
-				}
-				else if (strncmp(optarg,"NLM:",4)==0) {
-					vars_to_check=NLM;
-					nlm_name=strdup (optarg+4);
+				add_variable(optarg);
+				break;
+			case 'w': /* warning threshold */
+				/* applies to the last -v given, or to all if none yet */
+				if (num_vars > 0) {
+					vars[num_vars-1].warning_value=strtoul(optarg,NULL,10);
+					vars[num_vars-1].check_warning_value=TRUE;
+				} else {
+					warning_value=strtoul(optarg,NULL,10);
+					check_warning_value=TRUE;
 				}
-				else if (strncmp(optarg,"NRMP",4)==0) {
-					vars_to_check=NRMP;
-					nrmp_name = strdup (optarg+4);
-					if (!strcmp(nrmp_name,""))
-						nrmp_name = strdup ("AVAILABLE_MEMORY");
+				break;
+			case 'c': /* critical threshold */
+				if (num_vars > 0) {
+					vars[num_vars-1].critical_value=strtoul(optarg,NULL,10);
+					vars[num_vars-1].check_critical_value=TRUE;
+				} else {
+					critical_value=strtoul(optarg,NULL,10);
+					check_critical_value=TRUE;
 				}
-				else if (strncmp(optarg,"NRMM",4)==0) {
-					vars_to_check=NRMM;
-					nrmm_name = strdup (optarg+4);
-					if (!strcmp(nrmm_name,""))
-						nrmm_name = strdup ("AVAILABLE_CACHE_MEMORY");
+				break;
+			case 't': /* timeout */
+				timeout_interval = parse_timeout_string(optarg);
+			}
 
-				}
+	}
 
-				else if (strncmp(optarg,"NRMS",4)==0) {
-					vars_to_check=NRMS;
-					nrms_name = strdup (optarg+4);
-					if (!strcmp(nrms_name,""))
-						nrms_name = strdup ("USED_SWAP_SPACE");
+	return OK;
+}
 
-				}
 
-				else if (strncmp(optarg,"NSS1",4)==0) {
-					vars_to_check=NSS1;
-					nss1_name = strdup (optarg+4);
-					if (!strcmp(nss1_name,""))
-						nss1_name = strdup ("CURRENTBUFFERCACHESIZE");
+/* set vars_to_check and the name it needs from a -v argument */
+int parse_variable(const char *arg) {
+	if (strlen(arg)<3)
+		return ERROR;
+	if (!strcmp(arg,"LOAD1"))
+		vars_to_check=LOAD1;
+	else if (!strcmp(arg,"LOAD5"))
+		vars_to_check=LOAD5;
+	else if (!strcmp(arg,"LOAD15"))
+		vars_to_check=LOAD15;
+	else if (!strcmp(arg,"CONNS"))
+		vars_to_check=CONNS;
+	else if (!strcmp(arg,"LTCH"))
+		vars_to_check=LTCH;
+	else if (!strcmp(arg,"DCB"))
+		vars_to_check=DCB;
+	else if (!strcmp(arg,"TCB"))
+		vars_to_check=TCB;
+	else if (!strcmp(arg,"CBUFF"))
+		vars_to_check=CBUFF;
+	else if (!strcmp(arg,"CDBUFF"))
+		vars_to_check=CDBUFF;
+	else if (!strcmp(arg,"LRUM"))
+		vars_to_check=LRUM;
+	else if (!strcmp(arg,"LRUS"))
+		vars_to_check=LRUS;
+	else if (strncmp(arg,"VPF",3)==0) {
+		vars_to_check=VPF;
+		volume_name = strdup (arg+3);
+		if (!strcmp(volume_name,""))
+			volume_name = strdup ("SYS");
+	}
+	else if (strncmp(arg,"VKF",3)==0) {
+		vars_to_check=VKF;
+		volume_name = strdup (arg+3);
+		if (!strcmp(volume_name,""))
+			volume_name = strdup ("SYS");
+	}
+	else if (strncmp(arg,"VMF",3)==0) {
+		vars_to_check=VMF;
+		volume_name = strdup (arg+3);
+		if (!strcmp(volume_name,""))
+			volume_name = strdup ("SYS");
+	}
+	else if (!strcmp(arg,"DSDB"))
+		vars_to_check=DSDB;
+	else if (!strcmp(arg,"LOGINS"))
+		vars_to_check=LOGINS;
+	else if (!strcmp(arg,"NRMH"))
+		vars_to_check=NRMH;
+	else if (!strcmp(arg,"UPRB"))
+		vars_to_check=UPRB;
+	else if (!strcmp(arg,"PUPRB"))
+		vars_to_check=PUPRB;
+	else if (!strncmp(arg,"SAPENTRIES",10)) {
+		vars_to_check=SAPENTRIES;
+		if (strlen(arg)>10)
+			sap_number=atoi(arg+10);
+		else
+			sap_number=-1;
+	}
+	else if (!strcmp(arg,"OFILES"))
+		vars_to_check=OFILES;
+	else if (strncmp(arg,"VKP",3)==0) {
+		vars_to_check=VKP;
+		volume_name = strdup (arg+3);
+		if (!strcmp(volume_name,""))
+			volume_name = strdup ("SYS");
+	}
+	else if (strncmp(arg,"VMP",3)==0) {
+		vars_to_check=VMP;
+		volume_name = strdup (arg+3);
+		if (!strcmp(volume_name,""))
+			volume_name = strdup ("SYS");
+	}
+	else if (strncmp(arg,"VMU",3)==0) {
+		vars_to_check=VMU;
+		volume_name = strdup (arg+3);
+		if (!strcmp(volume_name,""))
+			volume_name = strdup ("SYS");
+	}
+	else if (strncmp(arg,"VPP",3)==0) {
+		vars_to_check=VPP;
+		volume_name = strdup (arg+3);
+		if (!strcmp(volume_name,""))
+			volume_name = strdup ("SYS");
+	}
+	else if (strncmp(arg,"VKNP",4)==0) {
+		vars_to_check=VKNP;
+		volume_name = strdup (arg+4);
+		if (!strcmp(volume_name,""))
+			volume_name = strdup ("SYS");
+	}
+	else if (strncmp(arg,"VPNP",4)==0) {
+		vars_to_check=VPNP;
+		volume_name = strdup (arg+4);
+		if (!strcmp(volume_name,""))
+			volume_name = strdup("SYS");
+	}
+	else if (!strcmp(arg,"ABENDS"))
+		vars_to_check=ABENDS;
+	else if (!strcmp(arg,"CSPROCS"))
+		vars_to_check=CSPROCS;
+	else if (!strcmp(arg,"TSYNC"))
+		vars_to_check=TSYNC;
+	else if (!strcmp(arg,"DSVER"))
+		vars_to_check=DSVER;
+	else if (!strcmp(arg,"UPTIME")) {
+		vars_to_check=UPTIME;
+	}
+	else if (strncmp(arg,"NLM:",4)==0) {
+		vars_to_check=NLM;
+		nlm_name=strdup (arg+4);
+	}
+	else if (strncmp(arg,"NRMP",4)==0) {
+		vars_to_check=NRMP;
+		nrmp_name = strdup (arg+4);
+		if (!strcmp(nrmp_name,""))
+			nrmp_name = strdup ("AVAILABLE_MEMORY");
+	}
+	else if (strncmp(arg,"NRMM",4)==0) {
+		vars_to_check=NRMM;
+		nrmm_name = strdup (arg+4);
+		if (!strcmp(nrmm_name,""))
+			nrmm_name = strdup ("AVAILABLE_CACHE_MEMORY");
 
-				}
+	}
 
-				else if (strncmp(optarg,"NSS2",4)==0) {
-					vars_to_check=NSS2;
-					nss2_name = strdup (optarg+4);
-					if (!strcmp(nss2_name,""))
-						nss2_name = strdup ("CACHEHITS");
+	else if (strncmp(arg,"NRMS",4)==0) {
+		vars_to_check=NRMS;
+		nrms_name = strdup (arg+4);
+		if (!strcmp(nrms_name,""))
+			nrms_name = strdup ("USED_SWAP_SPACE");
 
-				}
+	}
 
-				else if (strncmp(optarg,"NSS3",4)==0) {
-					vars_to_check=NSS3;
-					nss3_name = strdup (optarg+4);
-					if (!strcmp(nss3_name,""))
-						nss3_name = strdup ("CACHEGITPERCENT");
+	else if (strncmp(arg,"NSS1",4)==0) {
+		vars_to_check=NSS1;
+		nss1_name = strdup (arg+4);
+		if (!strcmp(nss1_name,""))
+			nss1_name = strdup ("CURRENTBUFFERCACHESIZE");
 
-				}
+	}
 
-				else if (strncmp(optarg,"NSS4",4)==0) {
-					vars_to_check=NSS4;
-					nss4_name = strdup (optarg+4);
-					if (!strcmp(nss4_name,""))
-						nss4_name = strdup ("CURRENTOPENCOUNT");
+	else if (strncmp(arg,"NSS2",4)==0) {
+		vars_to_check=NSS2;
+		nss2_name = strdup (arg+4);
+		if (!strcmp(nss2_name,""))
+			nss2_name = strdup ("CACHEHITS");
 
-				}
+	}
 
-				else if (strncmp(optarg,"NSS5",4)==0) {
-					vars_to_check=NSS5;
-					nss5_name = strdup (optarg+4);
-					if (!strcmp(nss5_name,""))
-						nss5_name = strdup ("CACHEMISSES");
+	else if (strncmp(arg,"NSS3",4)==0) {
+		vars_to_check=NSS3;
+		nss3_name = strdup (arg+4);
+		if (!strcmp(nss3_name,""))
+			nss3_name = strdup ("CACHEGITPERCENT");
 
-				}
+	}
 
+	else if (strncmp(arg,"NSS4",4)==0) {
+		vars_to_check=NSS4;
+		nss4_name = strdup (arg+4);
+		if (!strcmp(nss4_name,""))
+			nss4_name = strdup ("CURRENTOPENCOUNT");
 
-				else if (strncmp(optarg,"NSS6",4)==0) {
-					vars_to_check=NSS6;
-					nss6_name = strdup (optarg+4);
-					if (!strcmp(nss6_name,""))
-						nss6_name = strdup ("PENDINGWORKSCOUNT");
+	}
 
-				}
+	else if (strncmp(arg,"NSS5",4)==0) {
+		vars_to_check=NSS5;
+		nss5_name = strdup (arg+4);
+		if (!strcmp(nss5_name,""))
+			nss5_name = strdup ("CACHEMISSES");
 
+	}
 
-				else if (strncmp(optarg,"NSS7",4)==0) {
-					vars_to_check=NSS7;
-					nss7_name = strdup (optarg+4);
-					if (!strcmp(nss7_name,""))
-						nss7_name = strdup ("CACHESIZE");
 
-				}
+	else if (strncmp(arg,"NSS6",4)==0) {
+		vars_to_check=NSS6;
+		nss6_name = strdup (arg+4);
+		if (!strcmp(nss6_name,""))
+			nss6_name = strdup ("PENDINGWORKSCOUNT");
 
+	}
 
-				else
-					return ERROR;
-				break;
-			case 'w': /* warning threshold */
-				warning_value=strtoul(optarg,NULL,10);
-				check_warning_value=TRUE;
-				break;
-			case 'c': /* critical threshold */
-				critical_value=strtoul(optarg,NULL,10);
-				check_critical_value=TRUE;
-				break;
-			case 't': /* timeout */
-				timeout_interval = parse_timeout_string(optarg);
-			}
+
+	else if (strncmp(arg,"NSS7",4)==0) {
+		vars_to_check=NSS7;
+		nss7_name = strdup (arg+4);
+		if (!strcmp(nss7_name,""))
+			nss7_name = strdup ("CACHESIZE");
 
 	}
+	else
+		return ERROR;
 
 	return OK;
 }
 
 
+/* remember a -v argument along with the thresholds given so far */
+void add_variable(const char *arg) {
+	vars = realloc(vars, (num_vars + 1) * sizeof(nwstat_var));
+	if (vars == NULL)
+		die(STATE_UNKNOWN, _("Could not realloc() units [%d]\n"), num_vars);
+	vars[num_vars].arg = strdup(arg);
+	vars[num_vars].warning_value = warning_value;
+	vars[num_vars].critical_value = critical_value;
+	vars[num_vars].check_warning_value = check_warning_value;
+	vars[num_vars].check_critical_value = check_critical_value;
+	num_vars++;
+}
+
+
+/* make variable i the one check_variable() looks at */
+void select_variable(int i) {
+	parse_variable(vars[i].arg);
+	warning_value = vars[i].warning_value;
+	critical_value = vars[i].critical_value;
+	check_warning_value = vars[i].check_warning_value;
+	check_critical_value = vars[i].check_critical_value;
+}
+
+
+/* send one command to the agent and read the line it sends back.  The
+ * connection is kept open for the next command unless the agent turns
+ * out to close it after every reply. */
+int nwstat_request(const char *send_buffer, char *recv_buffer, int recv_size) {
+	int len = (int)strlen(send_buffer);
+	int attempt;
+
+	for (attempt = 0; attempt < 2; attempt++) {
+		if (sd < 0) {
+			if (my_tcp_connect (server_address, server_port, &sd) != STATE_OK)
+				return STATE_CRITICAL;
+			np_net_reader_init(&reader, sd);
+			requests_on_connection = 0;
+		}
+
+		if (send(sd, send_buffer, len, 0) == len &&
+		    np_net_recvline(&reader, recv_buffer, recv_size) > 0) {
+			requests_on_connection++;
+			if (!reuse_connection) {
+				close(sd);
+				sd = -1;
+			}
+			return STATE_OK;
+		}
+
+		close(sd);
+		sd = -1;
+		/* a fresh connection failed, retrying will not help */
+		if (requests_on_connection == 0)
+			break;
+		reuse_connection = FALSE;
+	}
+
+	strcpy(recv_buffer, "");
+	printf("%s\n", _("No data was received from host!"));
+	return STATE_WARNING;
+}
+
+
 
 void print_help(void)
 {
@@ -1604,7 +1654,8 @@ void print_help(void)
 	printf (UT_HOST_PORT, 'p', myport);
 
 	printf (" %s\n", "-v, --variable=STRING");
-  printf ("   %s\n", _("Variable to check.  Valid variables include:"));
+  printf ("   %s\n", _("Variable to check, may be given several times to check them all over one"));
+  printf ("   %s\n", _("connection.  Valid variables include:"));
   printf ("    %s\n", _("LOAD1     = 1 minute average CPU load"));
   printf ("    %s\n", _("LOAD5     = 5 minute average CPU load"));
   printf ("    %s\n", _("LOAD15    = 15 minute average CPU load"));
@@ -1654,6 +1705,8 @@ void print_help(void)
   printf ("    %s\n", _("Threshold which will result in a warning status"));
   printf (" %s\n", "-c, --critical=INTEGER");
   printf ("    %s\n", _("Threshold which will result in a critical status"));
+  printf ("    %s\n", _("-w and -c apply to the -v given before them, or to all variables if given"));
+  printf ("    %s\n", _("before the first -v"));
   printf (" %s\n", "-o, --osversion");
   printf ("    %s\n", _("Include server version string in results"));
 
@@ -1676,5 +1729,5 @@ void print_help(void)
 void print_usage(void)
 {
   printf ("%s\n", _("Usage:"));
-	printf ("%s -H host [-p port] [-v variable] [-w warning] [-c critical] [-t timeout]\n",progname);
+	printf ("%s -H host [-p port] [-v variable [-w warning] [-c critical]]... [-t timeout]\n",progname);
 }
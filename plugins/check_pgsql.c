@@ -71,6 +71,7 @@ void print_help (void);
 int is_pg_dbname (char *);
 int is_pg_logname (char *);
 int do_query (PGconn *, char *);
+int do_queries (PGconn *);
 
 char *pghost = NULL;						/* host name of the backend server */
 char *pgport = NULL;						/* port of the backend server */
@@ -90,6 +91,22 @@ static int print_query = 0;
 thresholds *qthresholds = NULL;
 int verbose = 0;
 
+/* one of several -q queries, each with its own name and thresholds */
+typedef struct pg_query {
+	char *name;
+	char *sql;
+	char *warning;
+	char *critical;
+	thresholds *thresholds;
+	double value;
+	int status;
+	char *error;
+} pg_query;
+
+pg_query *queries = NULL;
+int nqueries = 0;
+pg_query next_query;  /* -n/-W/-C given before the first -q */
+
 /******************************************************************************
 
 The (pseudo?)literate programming XML is contained within \@\@\- <XML> \-\@\@
@@ -253,13 +270,15 @@ main (int argc, char **argv)
 	        fperfdata("time", elapsed_time, "s",
 	                 !!(twarn > 0.0), twarn, !!(tcrit > 0.0), tcrit, TRUE, 0, FALSE,0));
 
-	if (pgquery)
+	if (nqueries > 1)
+		query_status = do_queries (conn);
+	else if (pgquery)
 		query_status = do_query (conn, pgquery);
 
 	if (verbose)
 		printf("Closing connection\n");
 	PQfinish (conn);
-	return (pgquery && query_status > status) ? query_status : status;
+	return ((pgquery || nqueries > 1) && query_status > status) ? query_status : status;
 }
 
 
@@ -288,12 +307,13 @@ process_arguments (int argc, char **argv)
 		{"query_critical", required_argument, 0, 'C'},
 		{"query_warning", required_argument, 0, 'W'},
 		{"print-query", no_argument, 0, 'r'},
+		{"query-name", required_argument, 0, 'n'},
 		{"verbose", no_argument, 0, 'v'},
 		{0, 0, 0, 0}
 	};
 
 	while (1) {
-		c = getopt_long (argc, argv, "hVt:c:w:H:P:d:l:p:a:o:q:C:W:v",
+		c = getopt_long (argc, argv, "hVt:c:w:H:P:d:l:p:a:o:q:C:W:n:rv",
 		                 longopts, &option);
 
 		if (c == EOF)
@@ -324,10 +344,22 @@ process_arguments (int argc, char **argv)
 				twarn = strtod (optarg, NULL);
 			break;
 		case 'C':     /* critical query threshold */
-			query_critical = optarg;
+			if (nqueries)
+				queries[nqueries - 1].critical = optarg;
+			else
+				next_query.critical = optarg;
 			break;
 		case 'W':     /* warning query threshold */
-			query_warning = optarg;
+			if (nqueries)
+				queries[nqueries - 1].warning = optarg;
+			else
+				next_query.warning = optarg;
+			break;
+		case 'n':     /* name of the query */
+			if (nqueries)
+				queries[nqueries - 1].name = optarg;
+			else
+				next_query.name = optarg;
 			break;
 		case 'r':
 			print_query = 1;
@@ -366,8 +398,13 @@ process_arguments (int argc, char **argv)
 			else
 				asprintf (&pgparams, "%s", optarg);
 			break;
-		case 'q':
-			pgquery = optarg;
+		case 'q':     /* may be repeated, -n/-W/-C apply to the last one */
+			queries = realloc (queries, sizeof (pg_query) * (nqueries + 1));
+			if (queries == NULL)
+				die (STATE_UNKNOWN, _("Could not allocate memory\n"));
+			queries[nqueries] = nqueries ? (pg_query) { 0 } : next_query;
+			queries[nqueries].sql = optarg;
+			nqueries++;
 			break;
 		case 'v':
 			verbose++;
@@ -375,8 +412,23 @@ process_arguments (int argc, char **argv)
 		}
 	}
 
+	if (nqueries == 0) {
+		query_warning = next_query.warning;
+		query_critical = next_query.critical;
+	}
+	else if (nqueries == 1) {
+		pgquery = queries[0].sql;
+		query_warning = queries[0].warning;
+		query_critical = queries[0].critical;
+	}
 	set_thresholds (&qthresholds, query_warning, query_critical);
 
+	for (c = 0; nqueries > 1 && c < nqueries; c++) {
+		if (queries[c].name == NULL)
+			xasprintf (&queries[c].name, "query%d", c + 1);
+		set_thresholds (&queries[c].thresholds, queries[c].warning, queries[c].critical);
+	}
+
 	return validate_arguments ();
 }
 
@@ -535,6 +587,8 @@ print_help (void)
 	printf ("    %s\n", _("SQL query value to result in warning status (double)"));
 	printf (" %s\n", "-C, --query-critical=RANGE");
 	printf ("    %s\n", _("SQL query value to result in critical status (double)"));
+	printf (" %s\n", "-n, --query-name=STRING");
+	printf ("    %s\n", _("Name of the query in output and perfdata when several are given"));
 	printf (" %s\n", "-r,  --print-query");
 	printf ("    %s\n", _("Print the output of the entire query to extended plugin output."));
 
@@ -554,6 +608,12 @@ print_help (void)
 	printf (" %s\n", _("of the last command is taken into account only. The value of the first"));
 	printf (" %s\n\n", _("column in the first row is used as the check result."));
 
+	printf (" %s\n", _("-q may be repeated to run several queries over the same connection. -n, -W"));
+	printf (" %s\n", _("and -C then belong to the -q they follow (or to the first one, if given"));
+	printf (" %s\n", _("before it). The queries are sent together in one pipeline when libpq"));
+	printf (" %s\n", _("supports it, so each one must be a single SQL command. The worst state of"));
+	printf (" %s\n\n", _("all queries is returned, and each one has its own perfdata."));
+
 	printf (" %s\n", _("See the chapter \"Monitoring Database Activity\" of the PostgreSQL manual"));
 	printf (" %s\n\n", _("for details about how to access internal statistics of the database server."));
 
@@ -583,56 +643,46 @@ print_usage (void)
 	printf ("%s\n", _("Usage:"));
 	printf ("%s [-H <host>] [-P <port>] [-c <critical time>] [-w <warning time>]\n", progname);
 	printf (" [-t <timeout>] [-d <database>] [-l <logname>] [-p <password>]\n"
-			"[-q <query>] [-C <critical query range>] [-W <warning query range>] [-r]\n");
+			"[-q <query>] [-C <critical query range>] [-W <warning query range>] [-r]\n"
+			"[-n <query name> -q <query> [-W <range>] [-C <range>] ...]\n");
 }
 
-int
-do_query (PGconn *conn, char *query)
+/* first column of the first row as a number, or a state and reason why not */
+static int
+query_value (PGconn *conn, PGresult *res, double *value, char **error)
 {
-	PGresult *res;
-
 	char *val_str;
-	double value;
-
 	char *endptr = NULL;
 
-	int my_status = STATE_UNKNOWN;
-
-	// Only used for print_query block at the end of this function
-	PQprintOpt po;
-
-	if (verbose)
-		printf ("Executing SQL query \"%s\".\n", query);
-	res = PQexec (conn, query);
-
 	if (PGRES_TUPLES_OK != PQresultStatus (res)) {
-		printf (_("QUERY %s - %s: %s.\n"), _("CRITICAL"), _("Error with query"),
-					PQerrorMessage (conn));
+		char *message = PQresultErrorMessage (res)[0] ? PQresultErrorMessage (res) : PQerrorMessage (conn);
+		xasprintf (error, "%s: %.*s.", _("Error with query"),
+		           (int) strcspn (message, "\n"), message);
 		return STATE_CRITICAL;
 	}
 
 	if (PQntuples (res) < 1) {
-		printf ("QUERY %s - %s.\n", _("WARNING"), _("No rows returned"));
+		xasprintf (error, "%s.", _("No rows returned"));
 		return STATE_WARNING;
 	}
 
 	if (PQnfields (res) < 1) {
-		printf ("QUERY %s - %s.\n", _("WARNING"), _("No columns returned"));
+		xasprintf (error, "%s.", _("No columns returned"));
 		return STATE_WARNING;
 	}
 
 	val_str = PQgetvalue (res, 0, 0);
 	if (! val_str) {
-		printf ("QUERY %s - %s.\n", _("CRITICAL"), _("No data returned"));
+		xasprintf (error, "%s.", _("No data returned"));
 		return STATE_CRITICAL;
 	}
 
-	value = strtod (val_str, &endptr);
+	*value = strtod (val_str, &endptr);
 	if (verbose)
-		printf ("Query result: %f\n", value);
+		printf ("Query result: %f\n", *value);
 
 	if (endptr == val_str) {
-		printf ("QUERY %s - %s: %s\n", _("CRITICAL"), _("Is not a numeric"), val_str);
+		xasprintf (error, "%s: %s", _("Is not a numeric"), val_str);
 		return STATE_CRITICAL;
 	}
 	else if ((endptr != NULL) && (*endptr != '\0')) {
@@ -640,15 +690,49 @@ do_query (PGconn *conn, char *query)
 			printf ("Garbage after value: %s.\n", endptr);
 	}
 
+	return STATE_OK;
+}
+
+static void
+print_result (PGresult *res)
+{
+	PQprintOpt po;
+
+	po.header = 1;
+	po.align = 1;
+	po.standard = 1;
+	po.html3 = 0;
+	po.expanded = 0;
+	po.pager = 0;
+	po.fieldSep = "|";
+	po.tableOpt = NULL;
+	po.caption = NULL;
+	po.fieldName = NULL;
+
+	PQprint(stdout, res, &po);
+}
+
+int
+do_query (PGconn *conn, char *query)
+{
+	PGresult *res;
+
+	double value = 0;
+	char *error = NULL;
+
+	int my_status = STATE_UNKNOWN;
+
+	if (verbose)
+		printf ("Executing SQL query \"%s\".\n", query);
+	res = PQexec (conn, query);
+
+	if ((my_status = query_value (conn, res, &value, &error)) != STATE_OK) {
+		printf ("QUERY %s - %s\n", state_text (my_status), error);
+		return my_status;
+	}
+
 	my_status = get_status (value, qthresholds);
-	printf ("QUERY %s - ",
-			(my_status == STATE_OK)
-				? _("OK")
-				: (my_status == STATE_WARNING)
-					? _("WARNING")
-					: (my_status == STATE_CRITICAL)
-						? _("CRITICAL")
-						: _("UNKNOWN"));
+	printf ("QUERY %s - ", state_text (my_status));
 	printf (_("'%s' returned %f"), query, value);
 	printf ("|query=%f;%s;%s;;\n", value,
 			query_warning ? query_warning : "",
@@ -656,20 +740,100 @@ do_query (PGconn *conn, char *query)
 
 	if (print_query) {
 		printf("\n");
-		po.header = 1;
-		po.align = 1;
-		po.standard = 1;
-		po.html3 = 0;
-		po.expanded = 0;
-		po.pager = 0;
-		po.fieldSep = "|";
-		po.tableOpt = NULL;
-		po.caption = NULL;
-		po.fieldName = NULL;
-
-		PQprint(stdout, res, &po);
+		print_result (res);
 	}
 
 	return my_status;
 }
 
+/* run all -q queries over the one connection, in a single pipeline when
+ * libpq supports it, so they cost one round trip instead of one each */
+int
+do_queries (PGconn *conn)
+{
+	PGresult **results;
+	PGresult *res;
+	char *perf = NULL;
+	int i, my_status = STATE_OK;
+
+	results = calloc (nqueries, sizeof (PGresult *));
+	if (results == NULL)
+		die (STATE_UNKNOWN, _("Could not allocate memory\n"));
+
+#ifdef LIBPQ_HAS_PIPELINING
+	if (verbose)
+		printf ("Sending %d queries in one pipeline\n", nqueries);
+	if (PQenterPipelineMode (conn) != 1)
+		die (STATE_CRITICAL, "QUERY %s - %s: %s", _("CRITICAL"),
+		     _("Could not enter pipeline mode"), PQerrorMessage (conn));
+	for (i = 0; i < nqueries; i++) {
+		if (verbose)
+			printf ("Executing SQL query \"%s\".\n", queries[i].sql);
+		if (PQsendQueryParams (conn, queries[i].sql, 0, NULL, NULL, NULL, NULL, 0) != 1)
+			die (STATE_CRITICAL, "QUERY %s - %s: %s", _("CRITICAL"),
+			     _("Error with query"), PQerrorMessage (conn));
+	}
+	if (PQpipelineSync (conn) != 1)
+		die (STATE_CRITICAL, "QUERY %s - %s: %s", _("CRITICAL"),
+		     _("Error with query"), PQerrorMessage (conn));
+
+	/* every query ends with a NULL result, the pipeline with a sync */
+	for (i = 0; i < nqueries; i++) {
+		results[i] = PQgetResult (conn);
+		while ((res = PQgetResult (conn)) != NULL)
+			PQclear (res);
+	}
+	while ((res = PQgetResult (conn)) != NULL) {
+		int sync = PQresultStatus (res) == PGRES_PIPELINE_SYNC;
+		PQclear (res);
+		if (sync)
+			break;
+	}
+	PQexitPipelineMode (conn);
+#else
+	for (i = 0; i < nqueries; i++) {
+		if (verbose)
+			printf ("Executing SQL query \"%s\".\n", queries[i].sql);
+		results[i] = PQexec (conn, queries[i].sql);
+	}
+#endif
+
+	for (i = 0; i < nqueries; i++) {
+		pg_query *q = &queries[i];
+
+#ifdef LIBPQ_HAS_PIPELINING
+		if (PQresultStatus (results[i]) == PGRES_PIPELINE_ABORTED) {
+			q->status = STATE_CRITICAL;
+			xasprintf (&q->error, "%s.", _("Not run after an earlier error"));
+		}
+		else
+#endif
+		if ((q->status = query_value (conn, results[i], &q->value, &q->error)) == STATE_OK) {
+			q->status = get_status (q->value, q->thresholds);
+			xasprintf (&perf, "%s%s%s", perf ? perf : "", perf ? " " : "",
+			           sperfdata (q->name, q->value, "", q->warning, q->critical,
+			                      FALSE, 0, FALSE, 0));
+		}
+		my_status = max_state (my_status, q->status);
+	}
+
+	printf ("QUERY %s - ", state_text (my_status));
+	for (i = 0; i < nqueries; i++) {
+		if (queries[i].error)
+			printf ("%s%s: %s", i ? ", " : "", queries[i].name, queries[i].error);
+		else
+			printf (_("%s%s returned %f"), i ? ", " : "", queries[i].name, queries[i].value);
+	}
+	printf ("|%s\n", perf ? perf : "");
+
+	for (i = 0; i < nqueries; i++) {
+		if (print_query && queries[i].error == NULL) {
+			printf ("\n%s:\n", queries[i].name);
+			print_result (results[i]);
+		}
+		PQclear (results[i]);
+	}
+	free (results);
+
+	return my_status;
+}
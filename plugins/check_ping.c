@@ -42,13 +42,21 @@ const char *email = "devel@nagios-plugins.org";
 
 enum {
 	UNKNOWN_PACKET_LOSS = 200,    /* 200% */
-	DEFAULT_MAX_PACKETS = 5       /* default no. of ICMP ECHO packets */
+	DEFAULT_MAX_PACKETS = 5,      /* default no. of ICMP ECHO packets */
+	PING_DATA_SIZE = 56,          /* bytes of data in ICMP ECHO packets */
+	PING_INTERVAL = 1000          /* ms between ICMP ECHO packets */
+};
+
+enum {
+	ICMP_SOCKET_OPTION = CHAR_MAX + 1
 };
 
 int process_arguments (int, char **);
 int get_threshold (char *, float *, int *);
 int validate_arguments (void);
 int run_ping (const char *cmd, const char *addr);
+int run_ping_command (const char *addr);
+int run_ping_socket (const char *addr);
 int error_scan (char buf[MAX_INPUT_BUFFER], const char *addr);
 void print_usage (void);
 void print_help (void);
@@ -64,6 +72,7 @@ int n_addresses = 0;
 int max_addr = 1;
 int max_packets = -1;
 int verbose = 0;
+int use_icmp_socket = FALSE;
 
 float rta = UNKNOWN_TRIP_TIME;
 int pl = UNKNOWN_PACKET_LOSS;
@@ -71,14 +80,13 @@ int pl = UNKNOWN_PACKET_LOSS;
 char ping_name[256];
 char ping_ip_addr[64];
 char *warn_text;
+struct timeval alarm_set;
 
 
 
 int
 main (int argc, char **argv)
 {
-	char *cmd = NULL;
-	char *rawcmd = NULL;
 	int result = STATE_UNKNOWN;
 	int this_result = STATE_UNKNOWN;
 	int i;
@@ -109,34 +117,13 @@ main (int argc, char **argv)
 #else
 	alarm (timeout_interval);
 #endif
+	gettimeofday (&alarm_set, NULL);
 
 	for (i = 0 ; i < n_addresses ; i++) {
 
-#ifdef PING6_COMMAND
-		if (address_family != AF_INET && is_inet6_addr(addresses[i]))
-			rawcmd = strdup(PING6_COMMAND);
-		else
-			rawcmd = strdup(PING_COMMAND);
-#else
-		rawcmd = strdup(PING_COMMAND);
-#endif
-
-		/* does the host address of number of packets argument come first? */
-#ifdef PING_PACKETS_FIRST
-# ifdef PING_HAS_TIMEOUT
-		xasprintf (&cmd, rawcmd, timeout_interval, max_packets, addresses[i]);
-# else
-		xasprintf (&cmd, rawcmd, max_packets, addresses[i]);
-# endif
-#else
-		xasprintf (&cmd, rawcmd, addresses[i], max_packets);
-#endif
-
-		if (verbose >= 2)
-			printf ("CMD: %s\n", cmd);
-
-		/* run the command */
-		this_result = run_ping (cmd, addresses[i]);
+		/* ping from within the plugin if we can get an ICMP socket */
+		if (!use_icmp_socket || (this_result = run_ping_socket (addresses[i])) == ERROR)
+			this_result = run_ping_command (addresses[i]);
 
 		if (pl == UNKNOWN_PACKET_LOSS || rta < 0.0) {
 			die (STATE_UNKNOWN,
@@ -184,8 +171,6 @@ main (int argc, char **argv)
 			printf ("%f:%d%% %f:%d%%\n", wrta, wpl, crta, cpl);
 
 		result = max_state (result, this_result);
-		free (rawcmd);
-		free (cmd);
 	}
 
 	return result;
@@ -209,6 +194,7 @@ process_arguments (int argc, char **argv)
 		{"link", no_argument, 0, 'L'},
 		{"use-ipv4", no_argument, 0, '4'},
 		{"use-ipv6", no_argument, 0, '6'},
+		{"icmp-socket", no_argument, 0, ICMP_SOCKET_OPTION},
 		{0, 0, 0, 0}
 	};
 
@@ -295,6 +281,9 @@ process_arguments (int argc, char **argv)
 		case 'w':
 			get_threshold (optarg, &wrta, &wpl);
 			break;
+		case ICMP_SOCKET_OPTION:
+			use_icmp_socket = TRUE;
+			break;
 		}
 	}
 
@@ -532,6 +521,116 @@ run_ping (const char *cmd, const char *addr)
 
 
 
+/* build the ping command line for addr and run it */
+int
+run_ping_command (const char *addr)
+{
+	char *cmd = NULL;
+	char *rawcmd = NULL;
+	int result;
+
+#ifdef PING6_COMMAND
+	if (address_family != AF_INET && is_inet6_addr(addr))
+		rawcmd = strdup(PING6_COMMAND);
+	else
+		rawcmd = strdup(PING_COMMAND);
+#else
+	rawcmd = strdup(PING_COMMAND);
+#endif
+
+	/* does the host address of number of packets argument come first? */
+#ifdef PING_PACKETS_FIRST
+# ifdef PING_HAS_TIMEOUT
+	xasprintf (&cmd, rawcmd, timeout_interval, max_packets, addr);
+# else
+	xasprintf (&cmd, rawcmd, max_packets, addr);
+# endif
+#else
+	xasprintf (&cmd, rawcmd, addr, max_packets);
+#endif
+
+	if (verbose >= 2)
+		printf ("CMD: %s\n", cmd);
+
+	/* run the command */
+	result = run_ping (cmd, addr);
+
+	free (rawcmd);
+	free (cmd);
+	return result;
+}
+
+
+
+/* ping addr without the ping command, returns ERROR if no ICMP socket
+ * could be opened */
+int
+run_ping_socket (const char *addr)
+{
+	np_ping_stats stats;
+	int result = STATE_OK;
+	long left;
+	int wait;
+
+	/* replies later than crta only matter for the packet loss, and none
+	 * are waited for past half a second before the alarm */
+	wait = (int) crta + PING_INTERVAL;
+	left = timeout_interval * 1000L - deltime (alarm_set) / 1000
+	       - (max_packets - 1) * (long) PING_INTERVAL - 500;
+	if (left < wait)
+		wait = left > 0 ? (int) left : 0;
+
+	switch (np_net_ping (addr, max_packets, PING_DATA_SIZE, PING_INTERVAL,
+	                     wait, &stats)) {
+	case NP_PING_NO_SOCKET:
+		if (verbose)
+			printf (_("Could not open ICMP socket (%s), using the ping command\n"),
+			        strerror (errno));
+		return ERROR;
+	case NP_PING_NO_HOST:
+		die (STATE_CRITICAL, _("CRITICAL - Host not found (%s)\n"), addr);
+	}
+
+	switch (stats.error) {
+	case 0:
+		break;
+	case ENETUNREACH:
+		die (STATE_CRITICAL, _("CRITICAL - Network Unreachable (%s)\n"), addr);
+	case EACCES:
+		die (STATE_CRITICAL, _("CRITICAL - Host Prohibited (%s)\n"), addr);
+	case ECONNREFUSED:
+		die (STATE_CRITICAL, _("CRITICAL - Bogus ICMP: Port Unreachable (%s)\n"), addr);
+	case ETIMEDOUT:
+		die (STATE_CRITICAL, _("CRITICAL - Time to live exceeded (%s)\n"), addr);
+	default:
+		die (STATE_CRITICAL, _("CRITICAL - Host Unreachable (%s)\n"), addr);
+	}
+
+	if (verbose >= 2)
+		printf ("%d packets transmitted, %d received, %d duplicates, rtt min/avg/max = %.3f/%.3f/%.3f ms\n",
+		        stats.sent, stats.received, stats.duplicates,
+		        stats.rta_min, stats.rta_avg, stats.rta_max);
+
+	snprintf (ping_name, sizeof (ping_name), "%s", addr);
+	snprintf (ping_ip_addr, sizeof (ping_ip_addr), "%s", stats.address);
+
+	pl = stats.sent ? 100 * (stats.sent - stats.received) / stats.sent : 100;
+	/* this is needed because there is no rta if all packets are lost */
+	rta = stats.received ? stats.rta_avg : crta;
+
+	if (stats.duplicates) {
+		if (warn_text == NULL)
+			warn_text = strdup (_(WARN_DUPLICATES));
+		result = STATE_WARNING;
+	}
+	if (warn_text == NULL)
+		warn_text = strdup("");
+
+	return result;
+}
+
+
+
 int
 error_scan (char buf[MAX_INPUT_BUFFER], const char *addr)
 {
@@ -604,6 +703,9 @@ print_help (void)
 	printf ("    %s\n", _("show name resolution in the plugin output (DNS & IP)"));
   printf (" %s\n", "-L, --link");
   printf ("    %s\n", _("show HTML in the plugin output (obsoleted by urlize)"));
+  printf (" %s\n", "--icmp-socket");
+  printf ("    %s\n", _("send the ICMP ECHO packets from the plugin instead of running ping. Falls"));
+  printf ("    %s\n", _("back to ping if the system does not allow the plugin an ICMP socket"));
 
 	printf (UT_CONN_TIMEOUT, DEFAULT_SOCKET_TIMEOUT);
 
@@ -626,5 +728,5 @@ print_usage (void)
 {
   printf ("%s\n", _("Usage:"));
 	printf ("%s -H <host_address> -w <wrta>,<wpl>%% -c <crta>,<cpl>%%\n", progname);
-  printf (" [-p packets] [-t timeout] [-4|-6]\n");
+  printf (" [-p packets] [-t timeout] [-4|-6] [--icmp-socket]\n");
 }
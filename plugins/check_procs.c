@@ -39,7 +39,7 @@ const char *email = "devel@nagios-plugins.org";
 #include "common.h"
 #include "utils.h"
 #include "utils_cmd.h"
-#include "regex.h"
+#include "utils_regex.h"
 
 #include <pwd.h>
 #include <errno.h>
@@ -102,7 +102,7 @@ char exclude_progs_counter = 0;
 char *cgroup_hierarchy;
 char *args;
 char *input_filename = NULL;
-regex_t re_args;
+np_regex re_args;
 char *fmt;
 char *fails;
 char tmp[MAX_INPUT_BUFFER];
@@ -313,7 +313,7 @@ main (int argc, char **argv)
 				resultsum |= STAT;
 			if ((options & ARGS) && procargs && (strstr (procargs, args) != NULL))
 				resultsum |= ARGS;
-			if ((options & EREG_ARGS) && procargs && (regexec(&re_args, procargs, (size_t) 0, NULL, 0) == 0))
+			if ((options & EREG_ARGS) && procargs && np_regex_match(&re_args, procargs))
 				resultsum |= EREG_ARGS;
 			if ((options & PROG) && procprog && (strcmp (prog, procprog) == 0))
 				resultsum |= PROG;
@@ -608,9 +608,9 @@ process_arguments (int argc, char **argv)
 			options |= ARGS;
 			break;
 		case CHAR_MAX+1:
-			err = regcomp(&re_args, optarg, cflags);
+			err = np_regex_compile(&re_args, optarg, cflags);
 			if (err != 0) {
-				regerror (err, &re_args, errbuf, MAX_INPUT_BUFFER);
+				np_regex_error (err, &re_args, errbuf, MAX_INPUT_BUFFER);
 				die (STATE_UNKNOWN, "PROCS %s: %s - %s\n", _("UNKNOWN"), _("Could not compile regular expression"), errbuf);
 			}
 			/* Strip off any | within the regex optarg */
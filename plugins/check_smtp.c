@@ -72,8 +72,9 @@ int validate_arguments (void);
 void print_help (void);
 void print_usage (void);
 void smtp_quit(void);
-int recvline(char *, size_t);
-int recvlines(char *, size_t);
+int smtp_pipeline(const char *, int, int);
+int ends_pipeline_group(const char *);
+int check_response(int);
 int my_close(void);
 
 #include "regex.h"
@@ -98,6 +99,7 @@ int nresponses=0;
 int response_size=0;
 char **commands = NULL;
 char **responses = NULL;
+double *command_time = NULL;
 char *authtype = NULL;
 char *authuser = NULL;
 char *authpass = NULL;
@@ -109,12 +111,17 @@ int verbose = 0;
 int use_ssl = FALSE;
 int use_starttls = FALSE;
 int use_sni = FALSE;
+int use_tls_resume = FALSE;
 short use_proxy_prefix = FALSE;
 short use_ehlo = FALSE;
 short use_lhlo = FALSE;
+short use_pipelining = FALSE;
+short show_command_times = FALSE;
+short quit_sent = FALSE;
 short ssl_established = 0;
 char *localhostname = NULL;
 int sd;
+np_net_reader reader;
 char buffer[MAX_INPUT_BUFFER];
 enum {
   TCP_PROTOCOL = 1,
@@ -127,6 +134,7 @@ int
 main (int argc, char **argv)
 {
 	short supports_tls=FALSE;
+	short supports_pipelining=FALSE;
 	int n = 0;
 	double elapsed_time;
 	long microsec;
@@ -134,7 +142,10 @@ main (int argc, char **argv)
 	char *cmd_str = NULL;
 	char *helocmd = NULL;
 	char *error_msg = "";
+	char *perf = NULL;
+	char *label = NULL;
 	struct timeval tv;
+	struct timeval cmd_tv;
 
 	/* Catch pipe errors in read/write - sometimes occurs when writing QUIT */
 #ifdef HAVE_SIGACTION
@@ -156,9 +167,16 @@ main (int argc, char **argv)
 	/* Parse extra opts if any */
 	argv=np_extra_opts (&argc, argv, progname);
 
+	np_init ((char *) progname, argc, argv);
+
 	if (process_arguments (argc, argv) == ERROR)
 		usage4 (_("Could not parse arguments"));
 
+#ifdef HAVE_SSL
+	if (use_tls_resume)
+		np_net_ssl_resume_sessions (server_address, server_port);
+#endif
+
 	/* If localhostname not set on command line, use gethostname to set */
 	if(! localhostname){
 		localhostname = malloc (HOST_MAX_BYTES);
@@ -200,6 +218,7 @@ main (int argc, char **argv)
 	result = my_tcp_connect (server_address, server_port, &sd);
 
 	if (result == STATE_OK) { /* we connected */
+		np_net_reader_init(&reader, sd);
 #ifdef HAVE_SSL
 		if (use_ssl) {
 			result = np_net_ssl_init_with_hostname(sd, (use_sni ? server_address : NULL));
@@ -210,6 +229,7 @@ main (int argc, char **argv)
 				return STATE_CRITICAL;
 			} else {
 				ssl_established = 1;
+				np_net_reader_use_ssl(&reader, np_net_ssl_read);
 			}
 		}
 #endif
@@ -223,7 +243,7 @@ main (int argc, char **argv)
 
 		/* watch for the SMTP connection string and */
 		/* return a WARNING status if we couldn't read any data */
-		if (recvlines(buffer, MAX_INPUT_BUFFER) <= 0) {
+		if (np_net_recvlines(&reader, buffer, MAX_INPUT_BUFFER) <= 0) {
 			printf (_("recv() failed\n"));
 			return STATE_WARNING;
 		}
@@ -247,7 +267,7 @@ main (int argc, char **argv)
 		my_send(helocmd, strlen(helocmd));
 
 		/* allow for response to helo command to reach us */
-		if (recvlines(buffer, MAX_INPUT_BUFFER) <= 0) {
+		if (np_net_recvlines(&reader, buffer, MAX_INPUT_BUFFER) <= 0) {
 			printf (_("recv() failed\n"));
 			return STATE_WARNING;
 		} else if(use_ehlo || use_lhlo){
@@ -255,6 +275,10 @@ main (int argc, char **argv)
 			   strstr(buffer, "250-STARTTLS") != NULL){
 				supports_tls=TRUE;
 			}
+			if(strstr(buffer, "250 PIPELINING") != NULL ||
+			   strstr(buffer, "250-PIPELINING") != NULL){
+				supports_pipelining=TRUE;
+			}
 		}
 
 		if(use_starttls && ! supports_tls){
@@ -268,7 +292,7 @@ main (int argc, char **argv)
 		  /* send the STARTTLS command */
 		  send(sd, SMTP_STARTTLS, strlen(SMTP_STARTTLS), 0);
 
-		  recvlines(buffer, MAX_INPUT_BUFFER); /* wait for it */
+		  np_net_recvlines(&reader, buffer, MAX_INPUT_BUFFER); /* wait for it */
 		  if (!strstr (buffer, SMTP_EXPECT)) {
 		    printf (_("Server does not support STARTTLS\n"));
 		    smtp_quit();
@@ -282,6 +306,7 @@ main (int argc, char **argv)
 		    return STATE_CRITICAL;
 		  } else {
 			ssl_established = 1;
+			np_net_reader_use_ssl(&reader, np_net_ssl_read);
 		  }
 
 		/*
@@ -302,7 +327,7 @@ main (int argc, char **argv)
 		}
 		if (verbose)
 			printf(_("sent %s"), helocmd);
-		if ((n = recvlines(buffer, MAX_INPUT_BUFFER)) <= 0) {
+		if ((n = np_net_recvlines(&reader, buffer, MAX_INPUT_BUFFER)) <= 0) {
 			printf("%s\n", _("SMTP UNKNOWN - Cannot read EHLO response via TLS."));
 			my_close();
 			return STATE_UNKNOWN;
@@ -310,6 +335,8 @@ main (int argc, char **argv)
 		if (verbose) {
 			printf("%s", buffer);
 		}
+		supports_pipelining = (strstr(buffer, "250 PIPELINING") != NULL ||
+		                       strstr(buffer, "250-PIPELINING") != NULL);
 
 		}
 #endif
@@ -323,39 +350,37 @@ main (int argc, char **argv)
 		  }
 #endif /* USE_OPENSSL */
 
-		if (send_mail_from) {
+		if (ncommands > 0 &&
+		    (command_time = calloc (ncommands, sizeof (double))) == NULL)
+			die (STATE_UNKNOWN,
+			     _("Could not calloc() command times [%d]\n"), ncommands);
+		n = 0;
+
+		if (use_pipelining && supports_pipelining) {
+			/* QUIT can only go with the commands if no AUTH follows them */
+			result = smtp_pipeline (send_mail_from ? cmd_str : NULL,
+			                        authtype == NULL, result);
+			if (result == ERROR)
+				return ERROR;
+			n = ncommands;
+		} else if (send_mail_from) {
 		  my_send(cmd_str, strlen(cmd_str));
-		  if (recvlines(buffer, MAX_INPUT_BUFFER) >= 1 && verbose)
+		  if (np_net_recvlines(&reader, buffer, MAX_INPUT_BUFFER) >= 1 && verbose)
 		    printf("%s", buffer);
 		}
 
 		while (n < ncommands) {
 			xasprintf (&cmd_str, "%s%s", commands[n], "\r\n");
+			gettimeofday (&cmd_tv, NULL);
 			my_send(cmd_str, strlen(cmd_str));
-			if (recvlines(buffer, MAX_INPUT_BUFFER) >= 1 && verbose)
+			if (np_net_recvlines(&reader, buffer, MAX_INPUT_BUFFER) >= 1 && verbose)
 				printf("%s", buffer);
+			command_time[n] = (double)deltime (cmd_tv) / 1.0e6;
 			strip (buffer);
 			if (n < nresponses) {
-				cflags |= REG_EXTENDED | REG_NOSUB | REG_NEWLINE;
-				errcode = regcomp (&preg, responses[n], cflags);
-				if (errcode != 0) {
-					regerror (errcode, &preg, errbuf, MAX_INPUT_BUFFER);
-					printf (_("Could Not Compile Regular Expression"));
+				result = check_response (n);
+				if (result == ERROR)
 					return ERROR;
-				}
-				excode = regexec (&preg, buffer, 10, pmatch, eflags);
-				if (excode == 0) {
-					result = STATE_OK;
-				}
-				else if (excode == REG_NOMATCH) {
-					result = STATE_WARNING;
-					printf (_("SMTP %s - Invalid response '%s' to command '%s'\n"), state_text (result), buffer, commands[n]);
-				}
-				else {
-					regerror (excode, &preg, errbuf, MAX_INPUT_BUFFER);
-					printf (_("Execute Error: %s\n"), errbuf);
-					result = STATE_UNKNOWN;
-				}
 			}
 			n++;
 		}
@@ -381,7 +406,7 @@ main (int argc, char **argv)
 					if (verbose)
 						printf (_("sent %s\n"), "AUTH LOGIN");
 
-					if ((ret = recvlines(buffer, MAX_INPUT_BUFFER)) <= 0) {
+					if ((ret = np_net_recvlines(&reader, buffer, MAX_INPUT_BUFFER)) <= 0) {
 						xasprintf(&error_msg, _("recv() failed after AUTH LOGIN, "));
 						result = STATE_WARNING;
 						break;
@@ -402,7 +427,7 @@ main (int argc, char **argv)
 					if (verbose)
 						printf (_("sent %s\n"), abuf);
 
-					if ((ret = recvlines(buffer, MAX_INPUT_BUFFER)) <= 0) {
+					if ((ret = np_net_recvlines(&reader, buffer, MAX_INPUT_BUFFER)) <= 0) {
 						result = STATE_CRITICAL;
 						xasprintf(&error_msg, _("recv() failed after sending authuser, "));
 						break;
@@ -422,7 +447,7 @@ main (int argc, char **argv)
 					if (verbose) {
 						printf (_("sent %s\n"), abuf);
 					}
-					if ((ret = recvlines(buffer, MAX_INPUT_BUFFER)) <= 0) {
+					if ((ret = np_net_recvlines(&reader, buffer, MAX_INPUT_BUFFER)) <= 0) {
 						result = STATE_CRITICAL;
 						xasprintf(&error_msg, _("recv() failed after sending authpass, "));
 						break;
@@ -447,7 +472,7 @@ main (int argc, char **argv)
 		smtp_quit();
 
 		/* finally close the connection */
-		close (sd);
+		my_close ();
 	}
 
 	/* reset the alarm */
@@ -463,15 +488,30 @@ main (int argc, char **argv)
 			result = STATE_WARNING;
 	}
 
+	perf = fperfdata ("time", elapsed_time, "s",
+		(int)check_warning_time, warning_time,
+		(int)check_critical_time, critical_time,
+		TRUE, 0, FALSE, 0);
+	for (n = 0; show_command_times && command_time && n < ncommands; n++) {
+		xasprintf (&label, "cmd%d", n + 1);
+		xasprintf (&perf, "%s %s", perf, fperfdata (label, command_time[n], "s",
+			FALSE, 0, FALSE, 0, TRUE, 0, FALSE, 0));
+	}
+#ifdef HAVE_SSL
+	if (use_tls_resume && ssl_established)
+		xasprintf (&perf, "%s %s %s", perf,
+			fperfdata ("time_tls", np_net_ssl_handshake_time (), "s",
+				FALSE, 0, FALSE, 0, TRUE, 0, FALSE, 0),
+			perfdata ("tls_resumed", np_net_ssl_session_resumed (), "",
+				FALSE, 0, FALSE, 0, TRUE, 0, TRUE, 1));
+#endif
+
 	printf (_("SMTP %s - %s%.3f sec. response time%s%s|%s\n"),
 			state_text (result),
 			error_msg,
 			elapsed_time,
 			verbose?", ":"", verbose?buffer:"",
-			fperfdata ("time", elapsed_time, "s",
-				(int)check_warning_time, warning_time,
-				(int)check_critical_time, critical_time,
-				TRUE, 0, FALSE, 0));
+			perf);
 
 	return result;
 }
@@ -486,7 +526,10 @@ process_arguments (int argc, char **argv)
 	char* temp;
 
 	enum {
-	  SNI_OPTION
+	  SNI_OPTION,
+	  PIPELINING_OPTION,
+	  TLS_RESUME_OPTION,
+	  COMMAND_TIMES_OPTION
 	};
 
 	int option = 0;
@@ -504,6 +547,7 @@ process_arguments (int argc, char **argv)
 		{"authpass", required_argument, 0, 'P'},
 		{"command", required_argument, 0, 'C'},
 		{"response", required_argument, 0, 'R'},
+		{"command-times", no_argument, 0, COMMAND_TIMES_OPTION},
 		{"verbose", no_argument, 0, 'v'},
 		{"version", no_argument, 0, 'V'},
 		{"use-ipv4", no_argument, 0, '4'},
@@ -513,6 +557,8 @@ process_arguments (int argc, char **argv)
 		{"ssl", no_argument, 0, 's'},
 		{"starttls",no_argument,0,'S'},
 		{"sni", no_argument, 0, SNI_OPTION},
+		{"pipelining", no_argument, 0, PIPELINING_OPTION},
+		{"tls-resume", no_argument, 0, TLS_RESUME_OPTION},
 		{"certificate",required_argument,0,'D'},
 		{"ignore-quit-failure",no_argument,0,'q'},
 		{"proxy",no_argument,0,'r'},
@@ -666,6 +712,20 @@ process_arguments (int argc, char **argv)
 			usage (_("SSL support not available - install OpenSSL and recompile"));
 #endif
       break;
+		case COMMAND_TIMES_OPTION:
+			show_command_times = TRUE;
+			break;
+		case PIPELINING_OPTION:
+			use_pipelining = TRUE;
+			use_ehlo = TRUE;
+			break;
+		case TLS_RESUME_OPTION:
+#ifdef HAVE_SSL
+			use_tls_resume = TRUE;
+#else
+			usage (_("SSL support not available - install OpenSSL and recompile"));
+#endif
+			break;
 		case 'r':
 			use_proxy_prefix = TRUE;
 			break;
@@ -741,7 +801,8 @@ smtp_quit(void)
 	int bytes;
 	int n;
 
-	n = my_send(SMTP_QUIT, strlen(SMTP_QUIT));
+	/* already sent along with the pipelined commands */
+	n = quit_sent ? 0 : my_send(SMTP_QUIT, strlen(SMTP_QUIT));
 	if(n < 0) {
 		if(ignore_send_quit_failure) {
 			if(verbose) {
@@ -753,11 +814,11 @@ smtp_quit(void)
 			_("Connection closed by server before sending QUIT command\n"));
 	}
 
-	if (verbose)
+	if (verbose && !quit_sent)
 		printf(_("sent %s\n"), "QUIT");
 
 	/* read the response but don't care about problems */
-	bytes = recvlines(buffer, MAX_INPUT_BUFFER);
+	bytes = np_net_recvlines(&reader, buffer, MAX_INPUT_BUFFER);
 	if (verbose) {
 		if (bytes < 0)
 			printf(_("recv() failed after QUIT."));
@@ -772,60 +833,112 @@ smtp_quit(void)
 
 
 /*
- * Receive one line, copy it into buf and nul-terminate it.  Returns the
- * number of bytes written to buf (excluding the '\0') or 0 on EOF or <0 on
- * error.
- *
- * TODO: Reading one byte at a time is very inefficient.  Replace this by a
- * function which buffers the data, move that to netutils.c and change
- * check_smtp and other plugins to use that.  Also, remove (\r)\n.
+ * Send the MAIL command (if mail_cmd is not NULL), the -C commands and, if
+ * send_quit is set, QUIT without waiting for each reply, and read the
+ * replies in order afterwards (RFC 2920).  A group of commands ends after
+ * one which may only be the last command in a group; the next group is
+ * only sent once all replies to the previous one are in.  Returns the new
+ * state, which is result unless a reply is checked against -R.
  */
 int
-recvline(char *buf, size_t bufsize)
+smtp_pipeline (const char *mail_cmd, int send_quit, int result)
 {
-	int result;
-	unsigned i;
+	char *batch;
+	struct timeval tv;
+	int first, last, i;
+
+	for (first = mail_cmd ? -1 : 0; first < ncommands; first = last) {
+		batch = strdup (mail_cmd && first < 0 ? mail_cmd : "");
+		for (last = first; last < ncommands; ) {
+			if (last++ < 0)
+				continue;
+			xasprintf (&batch, "%s%s\r\n", batch, commands[last - 1]);
+			if (ends_pipeline_group (commands[last - 1]))
+				break;
+		}
+		/* QUIT may not follow a command ending a group, smtp_quit sends
+		 * it once the replies are in */
+		if (last == ncommands && send_quit &&
+		    (ncommands == 0 || !ends_pipeline_group (commands[ncommands - 1]))) {
+			xasprintf (&batch, "%s%s", batch, SMTP_QUIT);
+			quit_sent = TRUE;
+		}
 
-	for (i = result = 0; i < bufsize - 1; i++) {
-		if ((result = my_recv(&buf[i], 1)) != 1)
-			break;
-		if (buf[i] == '\n') {
-			buf[++i] = '\0';
-			return i;
+		if (verbose)
+			printf (_("sent %s"), batch);
+		gettimeofday (&tv, NULL);
+		my_send (batch, strlen (batch));
+		free (batch);
+
+		for (i = first; i < last; i++) {
+			if (np_net_recvlines(&reader, buffer, MAX_INPUT_BUFFER) >= 1 && verbose)
+				printf("%s", buffer);
+			if (i < 0)
+				continue;
+			command_time[i] = (double)deltime (tv) / 1.0e6;
+			strip (buffer);
+			if (i < nresponses) {
+				result = check_response (i);
+				if (result == ERROR)
+					return ERROR;
+			}
 		}
 	}
-	return (result == 1 || i == 0) ? -2 : result;	/* -2 if out of space */
+
+	return result;
 }
 
 
-/*
- * Receive one or more lines, copy them into buf and nul-terminate it.  Returns
- * the number of bytes written to buf (excluding the '\0') or 0 on EOF or <0 on
- * error.  Works for all protocols which format multiline replies as follows:
- *
- * ``The format for multiline replies requires that every line, except the last,
- * begin with the reply code, followed immediately by a hyphen, `-' (also known
- * as minus), followed by text.  The last line will begin with the reply code,
- * followed immediately by <SP>, optionally some text, and <CRLF>.  As noted
- * above, servers SHOULD send the <SP> if subsequent text is not sent, but
- * clients MUST be prepared for it to be omitted.'' (RFC 2821, 4.2.1)
- *
- * TODO: Move this to netutils.c.  Also, remove \r and possibly the final \n.
- */
+/* RFC 2920 (3.1) and the RFCs defining AUTH and STARTTLS: these commands
+ * may only appear as the last command in a group */
 int
-recvlines(char *buf, size_t bufsize)
+ends_pipeline_group (const char *cmd)
 {
-	int result, i;
-
-	for (i = 0; /* forever */; i += result)
-		if (!((result = recvline(buf + i, bufsize - i)) > 3 &&
-		    isdigit((int)buf[i]) &&
-		    isdigit((int)buf[i + 1]) &&
-		    isdigit((int)buf[i + 2]) &&
-		    buf[i + 3] == '-'))
-			break;
+	static const char *verbs[] = {
+		"EHLO", "HELO", "LHLO", "DATA", "VRFY", "EXPN", "TURN", "ATRN",
+		"ETRN", "NOOP", "QUIT", "AUTH", "STARTTLS", NULL
+	};
+	size_t len;
+	int i;
+
+	for (i = 0; verbs[i]; i++) {
+		len = strlen (verbs[i]);
+		if (strncasecmp (cmd, verbs[i], len) == 0 &&
+		    (cmd[len] == '\0' || cmd[len] == ' '))
+			return TRUE;
+	}
+	return FALSE;
+}
+
+
+/* match the reply in buffer against the expected response to command n */
+int
+check_response (int n)
+{
+	int result;
 
-	return (result <= 0) ? result : result + i;
+	cflags |= REG_EXTENDED | REG_NOSUB | REG_NEWLINE;
+	errcode = regcomp (&preg, responses[n], cflags);
+	if (errcode != 0) {
+		regerror (errcode, &preg, errbuf, MAX_INPUT_BUFFER);
+		printf (_("Could Not Compile Regular Expression"));
+		return ERROR;
+	}
+	excode = regexec (&preg, buffer, 10, pmatch, eflags);
+	if (excode == 0) {
+		result = STATE_OK;
+	}
+	else if (excode == REG_NOMATCH) {
+		result = STATE_WARNING;
+		printf (_("SMTP %s - Invalid response '%s' to command '%s'\n"), state_text (result), buffer, commands[n]);
+	}
+	else {
+		regerror (excode, &preg, errbuf, MAX_INPUT_BUFFER);
+		printf (_("Execute Error: %s\n"), errbuf);
+		result = STATE_UNKNOWN;
+	}
+	regfree (&preg);
+	return result;
 }
 
 
@@ -871,10 +984,16 @@ print_help (void)
   printf ("    %s\n", _("SMTP command (may be used repeatedly)"));
   printf (" %s\n", "-R, --response=STRING");
   printf ("    %s\n", _("Expected response to command (may be used repeatedly)"));
+  printf (" %s\n", "--command-times");
+  printf ("    %s\n", _("Add the response time of each command to the performance data, as cmd1,"));
+  printf ("    %s\n", _("cmd2 and so on"));
   printf (" %s\n", "-f, --from=STRING");
   printf ("    %s\n", _("FROM-address to include in MAIL command, required by Exchange 2000")),
   printf (" %s\n", "-F, --fqdn=STRING");
   printf ("    %s\n", _("FQDN used for HELO"));
+  printf (" %s\n", "--pipelining");
+  printf ("    %s\n", _("Send EHLO and, if the server supports PIPELINING, send the commands and"));
+  printf ("    %s\n", _("QUIT in one go instead of waiting for each response (RFC 2920)"));
   printf (" %s\n", "-r, --proxy");
   printf ("    %s\n", _("Use PROXY protocol prefix for the connection."));
 #ifdef HAVE_SSL
@@ -886,6 +1005,9 @@ print_help (void)
   printf ("    %s\n", _("Use STARTTLS for the connection."));
   printf (" %s\n", "--sni");
   printf ("    %s\n", _("Enable SSL/TLS hostname extension support (SNI)"));
+  printf (" %s\n", "--tls-resume");
+  printf ("    %s\n", _("Keep the SSL/TLS session in the state directory and resume it on the next"));
+  printf ("    %s\n", _("check"));
 #endif
 
 	printf (" %s\n", "-A, --authtype=STRING");
@@ -922,6 +1044,7 @@ print_usage (void)
   printf ("%s\n", _("Usage:"));
   printf ("%s -H host [-p port] [-4|-6] [-e expect] [-C command] [-R response] [-f from addr]\n", progname);
   printf ("[-A authtype -U authuser -P authpass] [-w warn] [-c crit] [-t timeout] [-q]\n");
-  printf ("[-F fqdn] [-S] [-L] [-D warn days cert expire[,crit days cert expire]] [--sni] [-v] \n");
+  printf ("[-F fqdn] [-S] [-L] [-D warn days cert expire[,crit days cert expire]] [--sni]\n");
+  printf ("[--pipelining] [--tls-resume] [--command-times] [-v]\n");
 }
 
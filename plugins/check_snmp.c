@@ -98,7 +98,7 @@ char regex_expect[MAX_INPUT_BUFFER] = "";
 regex_t preg;
 regmatch_t pmatch[10];
 char errbuf[MAX_INPUT_BUFFER] = "";
-char perfstr[MAX_INPUT_BUFFER] = "| ";
+np_str perfstr = NP_STR_INIT;
 int cflags = REG_EXTENDED | REG_NOSUB | REG_NEWLINE;
 int eflags = 0;
 int errcode, excode;
@@ -137,6 +137,7 @@ int usesnmpgetnext = FALSE;
 char *warning_thresholds = NULL;
 char *critical_thresholds = NULL;
 thresholds **thlds;
+compiled_thresholds *cthlds;
 size_t thlds_size = OID_COUNT_STEP;
 double *response_value;
 size_t response_size = OID_COUNT_STEP;
@@ -182,7 +183,7 @@ static char *fix_snmp_range(char *th)
 int
 main (int argc, char **argv)
 {
-	int i, len, line, total_oids;
+	int i, line, total_oids;
 	unsigned int bk_count = 0, dq_count = 0;
 	int iresult = STATE_UNKNOWN;
 	int result = STATE_UNKNOWN;
@@ -192,8 +193,8 @@ main (int argc, char **argv)
 	char *cl_hidden_auth = NULL;
 	char *oidname = NULL;
 	char *response = NULL;
-	char *mult_resp = NULL;
-	char *outbuff;
+	np_str mult_resp = NP_STR_INIT;
+	np_str outbuff = NP_STR_INIT;
 	char *ptr = NULL;
 	char *show = NULL;
 	char *th_warn=NULL;
@@ -221,6 +222,7 @@ main (int argc, char **argv)
 	labels = malloc (labels_size * sizeof(*labels));
 	unitv = malloc (unitv_size * sizeof(*unitv));
 	thlds = malloc (thlds_size * sizeof(*thlds));
+	cthlds = malloc (thlds_size * sizeof(*cthlds));
 	response_value = malloc (response_size * sizeof(*response_value));
 	previous_value = malloc (previous_size * sizeof(*previous_value));
 	eval_method = calloc (eval_size, sizeof(*eval_method));
@@ -229,7 +231,7 @@ main (int argc, char **argv)
 	label = strdup ("SNMP");
 	units = strdup ("");
 	port = strdup (DEFAULT_PORT);
-	outbuff = strdup ("");
+	np_str_add (&perfstr, "| ");
 	delimiter = strdup (" = ");
 	output_delim = strdup (DEFAULT_OUTPUT_DELIMITER);
 	retries = DEFAULT_RETRIES;
@@ -286,12 +288,15 @@ main (int argc, char **argv)
 		while (i >= thlds_size) {
 			thlds_size += OID_COUNT_STEP;
 			thlds = realloc(thlds, thlds_size * sizeof(*thlds));
+			cthlds = realloc(cthlds, thlds_size * sizeof(*cthlds));
 		}
 
 		/* Skip empty thresholds, while avoiding segfault */
 		set_thresholds(&thlds[i],
 		               w ? strpbrk(w, NP_THRESHOLDS_CHARS) : NULL,
 		               c ? strpbrk(c, NP_THRESHOLDS_CHARS) : NULL);
+		/* flattened once here, evaluated for every response */
+		compile_thresholds(&cthlds[i], thlds[i]);
 
 		if (w) {
 			th_warn=strchr(th_warn, ',');
@@ -461,15 +466,14 @@ main (int argc, char **argv)
 
 			if (dq_count) { /* unfinished line */
 				/* copy show verbatim first */
-				if (!mult_resp) mult_resp = strdup("");
-				xasprintf (&mult_resp, "%s%s:\n%s\n", mult_resp, oids[i], show);
+				np_str_addf (&mult_resp, "%s:\n%s\n", oids[i], show);
 				/* then strip out unmatched double-quote from single-line output */
 				if (show[0] == '"') show++;
 
 				/* Keep reading until we match end of double-quoted string */
 				for (line++; line < chld_out.lines; line++) {
 					ptr = chld_out.line[line];
-					xasprintf (&mult_resp, "%s%s\n", mult_resp, ptr);
+					np_str_addf (&mult_resp, "%s\n", ptr);
 
 					COUNT_SEQ(ptr, bk_count, dq_count)
 					while (dq_count && ptr[0] != '\n' && ptr[0] != '\0') {
@@ -523,11 +527,11 @@ main (int argc, char **argv)
 					}
 					/* Convert to per second, then use multiplier */
 					temp_double = temp_double/duration*rate_multiplier;
-					iresult = get_status(temp_double, thlds[i]);
+					iresult = get_status_compiled(temp_double, &cthlds[i]);
 					xasprintf (&show, conv, temp_double);
 				}
 			} else {
-				iresult = get_status(response_value[i], thlds[i]);
+				iresult = get_status_compiled(response_value[i], &cthlds[i]);
 				if(is_ticks) {
 					xasprintf (&show, "%s", response);
 				}
@@ -577,16 +581,16 @@ main (int argc, char **argv)
 		
 		/* Prepend a label for this OID if there is one */
 		if (nlabels >= (size_t)1 && (size_t)i < nlabels && labels[i] != NULL)
-			xasprintf (&outbuff, "%s%s%s %s%s%s", outbuff,
+			np_str_addf (&outbuff, "%s%s %s%s%s",
 				(i == 0) ? " " : output_delim,
 				labels[i], mark (iresult), show, mark (iresult));
 		else
-			xasprintf (&outbuff, "%s%s%s%s%s", outbuff, (i == 0) ? " " : output_delim,
+			np_str_addf (&outbuff, "%s%s%s%s", (i == 0) ? " " : output_delim,
 				mark (iresult), show, mark (iresult));
 
 		/* Append a unit string for this OID if there is one */
 		if (nunits > (size_t)0 && (size_t)i < nunits && unitv[i] != NULL)
-			xasprintf (&outbuff, "%s %s", outbuff, unitv[i]);
+			np_str_addf (&outbuff, " %s", unitv[i]);
 		
 		/* Write perfdata with whatever can be parsed by strtod, if possible */
 		ptr = NULL;
@@ -613,7 +617,7 @@ main (int argc, char **argv)
 			if (strpbrk(temp_string, " ='\"") == NULL) {
 
 				/* if it doesn't have any - we can just use it as the label */
-				strncat(perfstr, temp_string, sizeof(perfstr) - strlen(perfstr) - 1);
+				np_str_add (&perfstr, temp_string);
 
 			} else {
 
@@ -625,63 +629,51 @@ main (int argc, char **argv)
 					quote_string="\"";
 				}
 
-				strncat(perfstr, quote_string, sizeof(perfstr) - strlen(perfstr) - 1);
-				strncat(perfstr, temp_string, sizeof(perfstr) - strlen(perfstr) - 1);
-				strncat(perfstr, quote_string, sizeof(perfstr) - strlen(perfstr) - 1);
+				np_str_addf (&perfstr, "%s%s%s", quote_string, temp_string, quote_string);
 			}
 
 			/* append the equal */
-			strncat(perfstr, "=", sizeof(perfstr) - strlen(perfstr) - 1);
-			len = sizeof(perfstr) - strlen(perfstr) - 1;
+			np_str_add (&perfstr, "=");
 
 			/* and then the data itself from the response */
-			strncat(perfstr, show, (len > ptr - show) ? ptr - show : len);
+			np_str_addn (&perfstr, show, ptr - show);
 
 			/* now append the unit of measurement */
 			if ((nunits > (size_t)0) 
 				&& ((size_t)i < nunits) 
 				&& (unitv[i] != NULL)) {
 
-					xasprintf(&temp_string, "%s", unitv[i]);
-					strncat(perfstr, temp_string, sizeof(perfstr) - strlen(perfstr) - 1);
+					np_str_add (&perfstr, unitv[i]);
 			}
 
 			/* and the type, if any */
 			if (type) {
-				strncat(perfstr, type, sizeof(perfstr) - strlen(perfstr) - 1);
+				np_str_add (&perfstr, type);
 			}
 
 			/* add warn/crit to perfdata */
 			if (thlds[i]->warning || thlds[i]->critical) {
 
-				strncat(perfstr, ";", sizeof(perfstr) - strlen(perfstr) - 1);
+				np_str_add (&perfstr, ";");
 
 				/* print the warning string if it exists */
-				if (thlds[i]->warning_string) {
-
-					xasprintf(&temp_string, "%s", thlds[i]->warning_string);
-					strncat(perfstr, temp_string, sizeof(perfstr) - strlen(perfstr) - 1);
-				}
-				strncat(perfstr, ";", sizeof(perfstr)-strlen(perfstr)-1);
+				if (thlds[i]->warning_string)
+					np_str_add (&perfstr, thlds[i]->warning_string);
+				np_str_add (&perfstr, ";");
 
 				/* print the critical string if it exists */
-				if (thlds[i]->critical_string) {
-
-					xasprintf(&temp_string, "%s", thlds[i]->critical_string);
-					strncat(perfstr, temp_string, sizeof(perfstr) - strlen(perfstr) - 1);
-				}
-				strncat(perfstr, ";", sizeof(perfstr) - strlen(perfstr) - 1);
+				if (thlds[i]->critical_string)
+					np_str_add (&perfstr, thlds[i]->critical_string);
+				np_str_add (&perfstr, ";");
 			}
 
 			/* remove trailing semi-colons for guideline adherence */
-			len = strlen(perfstr) - 1;
-			if (perfstr[len] == ';') {
-				perfstr[len] = '\0';
-			}
+			if (perfstr.data[perfstr.len - 1] == ';')
+				perfstr.data[--perfstr.len] = '\0';
 
 			/* we do not add any min/max value */
 
-			strncat(perfstr, " ", sizeof(perfstr) - strlen(perfstr) - 1);
+			np_str_add (&perfstr, " ");
 		}
 
 	} /* for (line=0, i=0; line < chld_out.lines; line++, i++) */
@@ -725,8 +717,9 @@ main (int argc, char **argv)
 		}
 	}
 	
-	printf ("%s %s -%s %s\n", label, state_text (result), outbuff, perfstr);
-	if (mult_resp) printf ("%s", mult_resp);
+	printf ("%s %s -%s %s\n", label, state_text (result), np_str_get (&outbuff),
+	        np_str_get (&perfstr));
+	printf ("%s", np_str_get (&mult_resp));
 
 	return result;
 }
@@ -42,6 +42,8 @@ const char *email = "devel@nagios-plugins.org";
 
 #define SSH_DFL_PORT    22
 #define BUFF_SZ         256
+#define PREBANNER_LINES 20		/* lines taken before the version string */
+#define PREBANNER_WAIT  1000	/* ms to wait for another such line */
 
 int port = -1;
 char *server_name = NULL;
@@ -212,13 +214,17 @@ ssh_connect (char *haddr, int hport, char *remote_version, char *remote_protocol
 {
 	int sd;
 	int result;
+	np_net_reader reader;
 	char *output = NULL;
+	char *first_line = NULL;
 	char *buffer = NULL;
 	char *ssh_proto = NULL;
 	char *ssh_server = NULL;
 	static char *rev_no = VERSION;
 	struct timeval tv;
+	struct pollfd pfd;
 	double elapsed_time;
+	int lines = 0;
 
 	gettimeofday(&tv, NULL);
 
@@ -229,9 +235,22 @@ ssh_connect (char *haddr, int hport, char *remote_version, char *remote_protocol
 
 	output = (char *) malloc (BUFF_SZ + 1);
 	memset (output, 0, BUFF_SZ + 1);
-	recv (sd, output, BUFF_SZ, 0);
+	/* RFC 4253 (4.2) allows the server to send other lines of data
+	 * before the version string, so skip a few of those. Other services
+	 * greet once and wait for us, so stop when no more lines follow */
+	np_net_reader_init (&reader, sd);
+	pfd.fd = sd;
+	pfd.events = POLLIN;
+	while (np_net_recvline (&reader, output, BUFF_SZ + 1) > 0 &&
+	       strncmp (output, "SSH-", 4)) {
+		if (first_line == NULL)
+			first_line = strdup (output);
+		if (++lines >= PREBANNER_LINES ||
+		    (reader.pos == reader.len && poll (&pfd, 1, PREBANNER_WAIT) <= 0))
+			break;
+	}
 	if (strncmp (output, "SSH", 3)) {
-		printf (_("Server answer: %s"), output);
+		printf (_("Server answer: %s"), first_line ? first_line : output);
 		close(sd);
 		exit (STATE_CRITICAL);
 	}
@@ -34,6 +34,7 @@ const char *email = "devel@nagios-plugins.org";
 #include "common.h"
 #include "popen.h"
 #include "utils.h"
+#include "utils_proc.h"
 
 #ifdef HAVE_DECL_SWAPCTL
 # ifdef HAVE_SYS_PARAM_H
@@ -52,6 +53,8 @@ const char *email = "devel@nagios-plugins.org";
 #endif
 
 int check_swap (int usp, double free_swap_mb);
+int check_swap_rates (char **extra, char **perf);
+int check_pressure (char **extra, char **perf);
 int process_arguments (int argc, char **argv);
 int validate_arguments (void);
 void print_usage (void);
@@ -66,20 +69,29 @@ double crit_size_bytes= 0;
 int verbose;
 int allswaps;
 int no_swap_state = STATE_CRITICAL;
+int rates = FALSE;
+char *rate_warning = NULL;
+char *rate_critical = NULL;
+thresholds *rate_thresholds = NULL;
+int pressure = FALSE;
+char *pressure_warning = NULL;
+char *pressure_critical = NULL;
+thresholds *pressure_thresholds = NULL;
 
 int
 main (int argc, char **argv)
 {
 	int percent_used, percent;
 	double total_swap_mb = 0, used_swap_mb = 0, free_swap_mb = 0;
-	double dsktotal_mb = 0, dskused_mb = 0, dskfree_mb = 0, tmp_mb = 0;
+	double dsktotal_mb = 0, dskused_mb = 0, dskfree_mb = 0;
 	int result = STATE_UNKNOWN;
-	char input_buffer[MAX_INPUT_BUFFER];
 #ifdef HAVE_PROC_MEMINFO
-	FILE *fp;
+	np_swap_device *devices = NULL, *dev;
 #else
 	int conv_factor = SWAP_CONVERSION;
 # ifdef HAVE_SWAP
+	char input_buffer[MAX_INPUT_BUFFER];
+	char str[32];
 	char *temp_buffer;
 	char *swap_command;
 	char *swap_format;
@@ -97,18 +109,22 @@ main (int argc, char **argv)
 #  endif /* HAVE_DECL_SWAPCTL */
 # endif
 #endif
-	char str[32];
 	char *status;
+	char *extra, *perf;
 
 	setlocale (LC_ALL, "");
 	bindtextdomain (PACKAGE, LOCALEDIR);
 	textdomain (PACKAGE);
 
 	status = strdup ("");
+	extra = strdup ("");
+	perf = strdup ("");
 
 	/* Parse extra opts if any */
 	argv=np_extra_opts (&argc, argv, progname);
 
+	np_init ((char *) progname, argc, argv);
+
 	if (process_arguments (argc, argv) == ERROR)
 		usage4 (_("Could not parse arguments"));
 
@@ -116,43 +132,32 @@ main (int argc, char **argv)
 	if (verbose >= 3) {
 		printf("Reading PROC_MEMINFO at %s\n", PROC_MEMINFO);
 	}
-	fp = fopen (PROC_MEMINFO, "r");
-	while (fgets (input_buffer, MAX_INPUT_BUFFER - 1, fp)) {
-		if (sscanf (input_buffer, "%*[S]%*[w]%*[a]%*[p]%*[:] %lf %lf %lf", &dsktotal_mb, &dskused_mb, &dskfree_mb) == 3) {
-			dsktotal_mb = dsktotal_mb / 1048576;	/* Apply conversion */
-			dskused_mb = dskused_mb / 1048576;
-			dskfree_mb = dskfree_mb / 1048576;
-			total_swap_mb += dsktotal_mb;
-			used_swap_mb += dskused_mb;
-			free_swap_mb += dskfree_mb;
-			if (allswaps) {
-				if (dsktotal_mb == 0)
-					percent=0.0;
-				else
-					percent = 100 * (((double) dskused_mb) / ((double) dsktotal_mb));
-				result = max_state (result, check_swap (percent, dskfree_mb));
-				if (verbose)
-					xasprintf (&status, "%s [%.0f (%d%%)]", status, dskfree_mb, 100 - percent);
-			}
-		}
-		else if (sscanf (input_buffer, "%*[S]%*[w]%*[a]%*[p]%[TotalFre]%*[:] %lf %*[k]%*[B]", str, &tmp_mb)) {
-			if (verbose >= 3) {
-				printf("Got %s with %lf\n", str, tmp_mb);
-			}
-			/* I think this part is always in Kb, so convert to mb */
-			if (strcmp ("Total", str) == 0) {
-				dsktotal_mb = tmp_mb / 1024;
-			}
-			else if (strcmp ("Free", str) == 0) {
-				dskfree_mb = tmp_mb / 1024;
-			}
+	/* SwapTotal and SwapFree from one read of the file, or sysinfo(2) */
+	if (np_swap_summary (&total_swap_mb, &free_swap_mb) != OK)
+		die (STATE_UNKNOWN, _("Could not read %s\n"), PROC_MEMINFO);
+	used_swap_mb = total_swap_mb - free_swap_mb;
+
+	if (allswaps) {
+		devices = np_swap_devices ();
+		for (dev = devices; dev; dev = dev->next) {
+			dsktotal_mb = dev->total_mb;
+			dskused_mb = dev->used_mb;
+			dskfree_mb = dsktotal_mb - dskused_mb;
+			if (verbose >= 3)
+				printf (_("%s total=%.0f, free=%.0f\n"), dev->name, dsktotal_mb, dskfree_mb);
+			if (dsktotal_mb == 0)
+				percent=0.0;
+			else
+				percent = 100 * (((double) dskused_mb) / ((double) dsktotal_mb));
+			result = max_state (result, check_swap (percent, dskfree_mb));
+			if (verbose)
+				xasprintf (&status, "%s [%.0f (%d%%)]", status, dskfree_mb, 100 - percent);
+			xasprintf (&perf, "%s %s", perf,
+			           perfdata (dev->name, (long) dskfree_mb, "MB", FALSE, 0, FALSE, 0,
+			                     TRUE, 0, TRUE, (long) dsktotal_mb));
 		}
+		np_swap_devices_free (devices);
 	}
-	fclose(fp);
-	dskused_mb = dsktotal_mb - dskfree_mb;
-	total_swap_mb = dsktotal_mb;
-	used_swap_mb = dskused_mb;
-	free_swap_mb = dskfree_mb;
 #else
 # ifdef HAVE_SWAP
 	xasprintf(&swap_command, "%s", SWAP_COMMAND);
@@ -361,15 +366,19 @@ main (int argc, char **argv)
 	}
 
 	result = max_state (result, check_swap (percent_used, free_swap_mb));
-	printf (_("SWAP %s - %d%% free (%d MB out of %d MB) %s|"),
+	if (rates)
+		result = max_state (result, check_swap_rates (&extra, &perf));
+	if (pressure)
+		result = max_state (result, check_pressure (&extra, &perf));
+	printf (_("SWAP %s - %d%% free (%d MB out of %d MB) %s%s|"),
 			state_text (result),
-			(100 - percent_used), (int) free_swap_mb, (int) total_swap_mb, status);
+			(100 - percent_used), (int) free_swap_mb, (int) total_swap_mb, status, extra);
 
-	puts (perfdata ("swap", (long) free_swap_mb, "MB",
+	printf ("%s%s\n", perfdata ("swap", (long) free_swap_mb, "MB",
 	                TRUE, (long) max (warn_size_bytes/(1024 * 1024), warn_percent/100.0*total_swap_mb),
 	                TRUE, (long) max (crit_size_bytes/(1024 * 1024), crit_percent/100.0*total_swap_mb),
 	                TRUE, 0,
-	                TRUE, (long) total_swap_mb));
+	                TRUE, (long) total_swap_mb), perf);
 
 	return result;
 }
@@ -398,6 +407,70 @@ check_swap (int usp, double free_swap_mb)
 
 
 
+/* pages swapped in and out per second, from the PROC_VMSTAT counters
+ * against the ones saved by the last run */
+int
+check_swap_rates (char **extra, char **perf)
+{
+	state_data *previous;
+	unsigned long long in, out, prev_in, prev_out;
+	char *buf, *data;
+	time_t now = time (NULL);
+	double interval, in_rate, out_rate;
+	int found;
+
+	if ((buf = np_proc_load (PROC_VMSTAT, NULL)) == NULL)
+		die (STATE_UNKNOWN, _("Could not read %s\n"), PROC_VMSTAT);
+	found = np_proc_value (buf, "pswpin", &in) && np_proc_value (buf, "pswpout", &out);
+	free (buf);
+	if (!found)
+		die (STATE_UNKNOWN, _("No swap counters in %s\n"), PROC_VMSTAT);
+
+	np_enable_state (NULL, 1);
+	previous = np_state_read ();
+	xasprintf (&data, "%llu %llu", in, out);
+	np_state_write_string (now, data);
+	free (data);
+
+	/* nothing to compare with on the first run or after a reboot */
+	if (previous == NULL || (interval = difftime (now, previous->time)) <= 0 ||
+	    sscanf ((char *) previous->data, "%llu %llu", &prev_in, &prev_out) != 2 ||
+	    in < prev_in || out < prev_out)
+		return STATE_OK;
+
+	in_rate = (in - prev_in) / interval;
+	out_rate = (out - prev_out) / interval;
+	if (verbose >= 3)
+		printf (_("pswpin=%llu pswpout=%llu over %.0fs\n"), in - prev_in, out - prev_out, interval);
+
+	xasprintf (extra, _("%sswap in %.1f/s, out %.1f/s "), *extra, in_rate, out_rate);
+	xasprintf (perf, "%s %s %s", *perf,
+	           sperfdata ("swap_in", in_rate, "", rate_warning, rate_critical, TRUE, 0, FALSE, 0),
+	           sperfdata ("swap_out", out_rate, "", rate_warning, rate_critical, TRUE, 0, FALSE, 0));
+	return max_state (get_status (in_rate, rate_thresholds), get_status (out_rate, rate_thresholds));
+}
+
+
+
+/* memory pressure stall information, the thresholds apply to the share
+ * of the last 10 seconds in which some task waited for memory */
+int
+check_pressure (char **extra, char **perf)
+{
+	np_pressure some, full;
+
+	if (!np_pressure_read (PROC_PRESSURE_MEMORY, &some, &full))
+		die (STATE_UNKNOWN, _("Could not read %s\n"), PROC_PRESSURE_MEMORY);
+
+	xasprintf (extra, _("%smemory pressure %.2f%% "), *extra, some.avg10);
+	xasprintf (perf, "%s %s %s", *perf,
+	           sperfdata ("pressure_some", some.avg10, "%", pressure_warning, pressure_critical, TRUE, 0, TRUE, 100),
+	           sperfdata ("pressure_full", full.avg10, "%", NULL, NULL, TRUE, 0, TRUE, 100));
+	return get_status (some.avg10, pressure_thresholds);
+}
+
+
+
 /* process command-line arguments */
 int
 process_arguments (int argc, char **argv)
@@ -405,11 +478,23 @@ process_arguments (int argc, char **argv)
 	int c = 0;  /* option character */
 
 	int option = 0;
+	enum {
+		RATE_WARNING = CHAR_MAX + 1,
+		RATE_CRITICAL,
+		PRESSURE_WARNING,
+		PRESSURE_CRITICAL
+	};
 	static struct option longopts[] = {
 		{"warning", required_argument, 0, 'w'},
 		{"critical", required_argument, 0, 'c'},
 		{"allswaps", no_argument, 0, 'a'},
 		{"no-swap", required_argument, 0, 'n'},
+		{"rates", no_argument, 0, 'r'},
+		{"rate-warning", required_argument, 0, RATE_WARNING},
+		{"rate-critical", required_argument, 0, RATE_CRITICAL},
+		{"pressure", no_argument, 0, 'P'},
+		{"pressure-warning", required_argument, 0, PRESSURE_WARNING},
+		{"pressure-critical", required_argument, 0, PRESSURE_CRITICAL},
 		{"verbose", no_argument, 0, 'v'},
 		{"version", no_argument, 0, 'V'},
 		{"help", no_argument, 0, 'h'},
@@ -420,7 +505,7 @@ process_arguments (int argc, char **argv)
 		return ERROR;
 
 	while (1) {
-		c = getopt_long (argc, argv, "+?Vvhac:w:n:", longopts, &option);
+		c = getopt_long (argc, argv, "+?VvhaPrc:w:n:", longopts, &option);
 
 		if (c == -1 || c == EOF)
 			break;
@@ -471,6 +556,28 @@ process_arguments (int argc, char **argv)
 		case 'a':									/* all swap */
 			allswaps = TRUE;
 			break;
+		case 'r':									/* swap in/out rates */
+			rates = TRUE;
+			break;
+		case RATE_WARNING:
+			rate_warning = optarg;
+			rates = TRUE;
+			break;
+		case RATE_CRITICAL:
+			rate_critical = optarg;
+			rates = TRUE;
+			break;
+		case 'P':									/* memory pressure */
+			pressure = TRUE;
+			break;
+		case PRESSURE_WARNING:
+			pressure_warning = optarg;
+			pressure = TRUE;
+			break;
+		case PRESSURE_CRITICAL:
+			pressure_critical = optarg;
+			pressure = TRUE;
+			break;
 		case 'n':									/* no-swap */
 			if ((no_swap_state = translate_state(optarg)) == ERROR) {
 				usage4 (_("no-swap result must be a valid state name (OK, WARNING, CRITICAL, UNKNOWN) or integer (0-3)."));
@@ -518,6 +625,9 @@ process_arguments (int argc, char **argv)
 int
 validate_arguments (void)
 {
+	set_thresholds (&rate_thresholds, rate_warning, rate_critical);
+	set_thresholds (&pressure_thresholds, pressure_warning, pressure_critical);
+
 	if (have_crit == FALSE && have_warn == FALSE)
 		return ERROR;
 	else if (warn_percent < 0 || crit_percent < 0 || warn_size_bytes < 0
@@ -565,6 +675,14 @@ print_help (void)
   printf ("    %s\n", _("Conduct comparisons for all swap partitions, one by one"));
   printf (" %s\n", "-n, --no-swap=<ok|warning|critical|unknown>");
   printf ("    %s %s\n", _("Resulting state when there is no swap regardless of thresholds. Default:"), state_text(no_swap_state));
+  printf (" %s\n", "-r, --rates");
+  printf ("    %s\n", _("Report pages swapped in and out per second since the last run"));
+  printf (" %s\n", "--rate-warning=THRESHOLD, --rate-critical=THRESHOLD");
+  printf ("    %s\n", _("Thresholds for either rate, implies --rates"));
+  printf (" %s\n", "-P, --pressure");
+  printf ("    %s\n", _("Report memory pressure stall information (Linux 4.20 and later)"));
+  printf (" %s\n", "--pressure-warning=THRESHOLD, --pressure-critical=THRESHOLD");
+  printf ("    %s\n", _("Thresholds for the percentage of time some task waited for memory, implies --pressure"));
 
   printf (UT_VERBOSE);
 
@@ -572,6 +690,8 @@ print_help (void)
   printf ("%s\n", _("Notes:"));
   printf (" %s\n", _("Both INTEGER and PERCENT thresholds can be specified, they are all checked."));
   printf (" %s\n", _("On AIX, if -a is specified, uses lsps -a, otherwise uses lsps -s."));
+  printf (" %s\n", _("On Linux, -a reads the devices from /proc/swaps and adds perfdata for each."));
+  printf (" %s\n", _("Rates are read from /proc/vmstat and keep their counters in the state directory."));
 
   printf (UT_SUPPORT);
 }
@@ -583,4 +703,6 @@ print_usage (void)
   printf ("%s\n", _("Usage:"));
   printf (" %s [-av] -w <percent_free>%% -c <percent_free>%%\n",progname);
   printf ("  -w <bytes_free> -c <bytes_free> [-n <state>]\n");
+  printf ("  [-r] [--rate-warning=<range>] [--rate-critical=<range>]\n");
+  printf ("  [-P] [--pressure-warning=<range>] [--pressure-critical=<range>]\n");
 }
@@ -43,6 +43,10 @@ const char *email = "devel@nagios-plugins.org";
 #ifdef HAVE_SSL
 static int check_cert = FALSE;
 static int days_till_exp_warn, days_till_exp_crit;
+static char *cert_list = NULL;
+static int cert_parallel = 32;
+static int cert_cache_days = 0;
+static int check_cert_list (void);
 # define my_recv(buf, len) ((flags & FLAG_SSL) ? np_net_ssl_read(buf, len) : read(sd, buf, len))
 # define my_send(buf, len) ((flags & FLAG_SSL) ? np_net_ssl_write(buf, len) : send(sd, buf, len, 0))
 #else
@@ -92,6 +96,7 @@ static int match_flags = NP_MATCH_EXACT;
 #define FLAG_TIME_WARN 0x04
 #define FLAG_TIME_CRIT 0x08
 #define FLAG_HIDE_OUTPUT 0x10
+#define FLAG_TLS_RESUME 0x20
 static size_t flags;
 
 int
@@ -214,9 +219,16 @@ main (int argc, char **argv)
 	/* Parse extra opts if any */
 	argv=np_extra_opts (&argc, argv, progname);
 
+	np_init ((char *) progname, argc, argv);
+
 	if (process_arguments (argc, argv) == ERROR)
 		usage4 (_("Could not parse arguments"));
 
+#ifdef HAVE_SSL
+	if (cert_list)
+		return check_cert_list ();
+#endif
+
 	if(flags & FLAG_VERBOSE) {
 		printf("Using service %s\n", SERVICE);
 		printf("Port: %d\n", server_port);
@@ -242,6 +254,8 @@ main (int argc, char **argv)
 
 #ifdef HAVE_SSL
 	if (flags & FLAG_SSL){
+		if (flags & FLAG_TLS_RESUME)
+			np_net_ssl_resume_sessions(server_address, server_port);
 		result = np_net_ssl_init_with_hostname(sd, server_name);
 		if (result == STATE_OK && check_cert == TRUE) {
 			result = np_net_ssl_check_cert(days_till_exp_warn, days_till_exp_crit);
@@ -388,12 +402,269 @@ main (int argc, char **argv)
 				TRUE, timeout_interval)
 			);
 
+#ifdef HAVE_SSL
+	if ((flags & FLAG_SSL) && (flags & FLAG_TLS_RESUME))
+		printf (" %s %s",
+		        fperfdata ("time_tls", np_net_ssl_handshake_time(), "s",
+		                   FALSE, 0, FALSE, 0, TRUE, 0, FALSE, 0),
+		        perfdata ("tls_resumed", np_net_ssl_session_resumed(), "",
+		                  FALSE, 0, FALSE, 0, TRUE, 0, TRUE, 1));
+#endif
+
 	putchar('\n');
 	return result;
 }
 
 
 
+#ifdef HAVE_SSL
+/* cached expiry of a certificate from an earlier --cert-list run */
+typedef struct cert_cache_entry {
+	char *key;
+	time_t expiry;
+	time_t checked;
+} cert_cache_entry;
+
+static int
+cert_cache_compare (const void *a, const void *b)
+{
+	return strcmp (((const cert_cache_entry *)a)->key, ((const cert_cache_entry *)b)->key);
+}
+
+static char *
+cert_target_key (np_cert_target *t)
+{
+	char *key;
+	xasprintf (&key, "%s:%d:%s", t->host, t->port, t->sni ? t->sni : "");
+	return key;
+}
+
+/* read host:port[:sni] lines, [address]:port for IPv6 literals */
+static np_cert_target *
+read_cert_list (const char *file, int *count)
+{
+	FILE *fp;
+	char line[MAX_INPUT_BUFFER], *host, *port, *sni, *p;
+	np_cert_target *targets = NULL;
+	int n = 0, size = 0, lineno = 0;
+
+	if (!strcmp (file, "-"))
+		fp = stdin;
+	else if ((fp = fopen (file, "r")) == NULL)
+		die (STATE_UNKNOWN, _("Cannot open certificate list %s: %s\n"), file, strerror (errno));
+
+	while (fgets (line, sizeof (line), fp)) {
+		lineno++;
+		line[strcspn (line, "#\r\n")] = '\0';
+		host = line + strspn (line, " \t");
+		for (p = host + strlen (host); p > host && isspace (p[-1]); p--)
+			p[-1] = '\0';
+		if (!*host)
+			continue;
+
+		if (*host == '[') {
+			host++;
+			if ((p = strchr (host, ']')) == NULL || p[1] != ':')
+				die (STATE_UNKNOWN, _("Invalid line %d in %s\n"), lineno, file);
+			*p = '\0';
+			port = p + 2;
+		} else {
+			if ((port = strchr (host, ':')) == NULL)
+				die (STATE_UNKNOWN, _("Invalid line %d in %s\n"), lineno, file);
+			*port++ = '\0';
+		}
+		if ((sni = strchr (port, ':')) != NULL)
+			*sni++ = '\0';
+		if (!is_intpos (port) || atoi (port) > 65535)
+			die (STATE_UNKNOWN, _("Invalid port on line %d in %s\n"), lineno, file);
+
+		if (n == size) {
+			size = size ? size * 2 : 64;
+			targets = realloc (targets, sizeof (np_cert_target) * size);
+			if (targets == NULL)
+				die (STATE_UNKNOWN, _("Could not allocate memory\n"));
+		}
+		memset (&targets[n], 0, sizeof (np_cert_target));
+		targets[n].host = strdup (host);
+		targets[n].port = atoi (port);
+		targets[n].sni = (sni && *sni) ? strdup (sni) : NULL;
+		n++;
+	}
+	if (fp != stdin)
+		fclose (fp);
+
+	*count = n;
+	return targets;
+}
+
+/* "key=expiry,checked" words of the state file, sorted by key */
+static cert_cache_entry *
+read_cert_cache (int *count)
+{
+	state_data *previous;
+	cert_cache_entry *cache = NULL;
+	char *data, *word, *value;
+	int n = 0, size = 0;
+	long long expiry, checked;
+
+	*count = 0;
+	if ((previous = np_state_read ()) == NULL)
+		return NULL;
+
+	data = strdup ((char *) previous->data);
+	for (word = strtok (data, " "); word; word = strtok (NULL, " ")) {
+		if ((value = strrchr (word, '=')) == NULL ||
+		    sscanf (value + 1, "%lld,%lld", &expiry, &checked) != 2)
+			continue;
+		*value = '\0';
+		if (n == size) {
+			size = size ? size * 2 : 64;
+			if ((cache = realloc (cache, sizeof (cert_cache_entry) * size)) == NULL)
+				die (STATE_UNKNOWN, _("Could not allocate memory\n"));
+		}
+		cache[n].key = word;
+		cache[n].expiry = expiry;
+		cache[n].checked = checked;
+		n++;
+	}
+	qsort (cache, n, sizeof (cert_cache_entry), cert_cache_compare);
+
+	*count = n;
+	return cache;
+}
+
+static void
+print_cert_target (np_cert_target *t)
+{
+	char timestamp[50] = "";
+	int days_left;
+
+	printf ("%s:%d", t->host, t->port);
+	if (t->sni)
+		printf (" (%s)", t->sni);
+	printf (" %s - ", state_text (t->status));
+	if (t->message[0]) {
+		printf ("%s\n", t->message);
+		return;
+	}
+	days_left = difftime (t->expiry, time (NULL)) / 86400;
+	strftime (timestamp, sizeof (timestamp), "%F %R %z/%Z", localtime (&t->expiry));
+	if (t->expiry < time (NULL))
+		printf (_("Certificate '%s' expired on %s\n"), t->cn, timestamp);
+	else
+		printf (_("Certificate '%s' expires in %d day(s) (%s)\n"), t->cn, days_left, timestamp);
+}
+
+/* --cert-list: scan all certificates of the list and summarise */
+static int
+check_cert_list (void)
+{
+	np_cert_target *targets;
+	cert_cache_entry *cache, lookup, *hit;
+	char *data = NULL;
+	time_t now = time (NULL);
+	int count, ncache, i;
+	int result = STATE_OK, warning = 0, critical = 0, errors = 0, cached = 0;
+	int days_left, min_days = -1;
+	struct timeval tv;
+
+	targets = read_cert_list (cert_list, &count);
+	if (count == 0)
+		die (STATE_UNKNOWN, _("No targets in certificate list %s\n"), cert_list);
+
+	/* each set of arguments, and so each list, keeps its own cache */
+	if (cert_cache_days > 0) {
+		np_enable_state (NULL, 1);
+		cache = read_cert_cache (&ncache);
+	} else {
+		cache = NULL;
+		ncache = 0;
+	}
+
+	/* certificates far from expiry need no handshake on every run */
+	for (i = 0; cert_cache_days > 0 && i < count; i++) {
+		lookup.key = cert_target_key (&targets[i]);
+		hit = bsearch (&lookup, cache, ncache, sizeof (cert_cache_entry), cert_cache_compare);
+		free (lookup.key);
+		if (hit && now - hit->checked < cert_cache_days * 86400 &&
+		    hit->expiry - now > (time_t) (days_till_exp_warn + cert_cache_days) * 86400) {
+			targets[i].skip = TRUE;
+			cached++;
+		}
+	}
+
+	if (flags & FLAG_VERBOSE)
+		printf (_("Checking %d certificates, %d from cache, %d at once\n"),
+		        count, cached, cert_parallel);
+
+	gettimeofday (&tv, NULL);
+	if (np_net_ssl_scan_certs (targets, count, cert_parallel, timeout_interval,
+	                           days_till_exp_warn, days_till_exp_crit) != OK)
+		die (STATE_UNKNOWN, _("SSL UNKNOWN - Could not set up certificate checks\n"));
+	elapsed_time = (double) deltime (tv) / 1.0e6;
+
+	for (i = 0; i < count; i++) {
+		np_cert_target *t = &targets[i];
+		char *key;
+
+		if (t->skip) {
+			/* entry came from the cache, keep it as it is */
+			lookup.key = key = cert_target_key (t);
+			hit = bsearch (&lookup, cache, ncache, sizeof (cert_cache_entry), cert_cache_compare);
+			t->expiry = hit->expiry;
+			t->status = STATE_OK;
+			xasprintf (&data, "%s%s%s=%lld,%lld", data ? data : "", data ? " " : "",
+			           key, (long long) hit->expiry, (long long) hit->checked);
+			free (key);
+		} else if (cert_cache_days > 0 && t->expiry && !t->message[0]) {
+			key = cert_target_key (t);
+			xasprintf (&data, "%s%s%s=%lld,%lld", data ? data : "", data ? " " : "",
+			           key, (long long) t->expiry, (long long) now);
+			free (key);
+		}
+
+		if (t->expiry) {
+			days_left = difftime (t->expiry, now) / 86400;
+			if (min_days < 0 || days_left < min_days)
+				min_days = days_left;
+		} else
+			errors++;
+		if (t->status == STATE_WARNING)
+			warning++;
+		else if (t->status == STATE_CRITICAL)
+			critical++;
+		result = max_state (result, t->status);
+	}
+	if (cert_cache_days > 0)
+		np_state_write_string (0, data ? data : "");
+
+	printf ("SSL %s - ", state_text (result));
+	printf (_("%d certificates, %d warning, %d critical, %d errors, %d cached"),
+	        count, warning, critical, errors, cached);
+	if (min_days >= 0)
+		printf (_(", %d days minimum"), min_days);
+	printf ("|%s %s %s %s %s %s",
+	        perfdata ("total", count, "", FALSE, 0, FALSE, 0, TRUE, 0, FALSE, 0),
+	        perfdata ("warning", warning, "", FALSE, 0, FALSE, 0, TRUE, 0, FALSE, 0),
+	        perfdata ("critical", critical, "", FALSE, 0, FALSE, 0, TRUE, 0, FALSE, 0),
+	        perfdata ("errors", errors, "", FALSE, 0, FALSE, 0, TRUE, 0, FALSE, 0),
+	        perfdata ("cached", cached, "", FALSE, 0, FALSE, 0, TRUE, 0, FALSE, 0),
+	        fperfdata ("time", elapsed_time, "s", FALSE, 0, FALSE, 0, TRUE, 0, FALSE, 0));
+	if (min_days >= 0)
+		printf (" %s", perfdata ("days_left_min", min_days, "",
+		                         TRUE, days_till_exp_warn, TRUE, days_till_exp_crit,
+		                         FALSE, 0, FALSE, 0));
+	putchar ('\n');
+
+	for (i = 0; i < count; i++)
+		if (targets[i].status != STATE_OK || ((flags & FLAG_VERBOSE) && !targets[i].skip))
+			print_cert_target (&targets[i]);
+
+	return result;
+}
+#endif /* HAVE_SSL */
+
+
 /* process command-line arguments */
 static int
 process_arguments (int argc, char **argv)
@@ -402,6 +673,13 @@ process_arguments (int argc, char **argv)
 	int escape = 0;
 	char *temp;
 
+	enum {
+		TLS_RESUME_OPTION = CHAR_MAX + 1,
+		CERT_LIST_OPTION,
+		PARALLEL_OPTION,
+		CERT_CACHE_OPTION
+	};
+
 	int option = 0;
 	static struct option longopts[] = {
 		{"hostname", required_argument, 0, 'H'},
@@ -429,6 +707,10 @@ process_arguments (int argc, char **argv)
 		{"help", no_argument, 0, 'h'},
 		{"ssl", no_argument, 0, 'S'},
 		{"certificate", required_argument, 0, 'D'},
+		{"tls-resume", no_argument, 0, TLS_RESUME_OPTION},
+		{"cert-list", required_argument, 0, CERT_LIST_OPTION},
+		{"parallel", required_argument, 0, PARALLEL_OPTION},
+		{"cert-cache", required_argument, 0, CERT_CACHE_OPTION},
 		{0, 0, 0, 0}
 	};
 
@@ -601,6 +883,24 @@ process_arguments (int argc, char **argv)
 			die (STATE_UNKNOWN, _("Invalid option - SSL is not available"));
 #endif
 			break;
+		case TLS_RESUME_OPTION:
+			flags |= FLAG_TLS_RESUME;
+			break;
+#ifdef HAVE_SSL
+		case CERT_LIST_OPTION:
+			cert_list = optarg;
+			break;
+		case PARALLEL_OPTION:
+			if (!is_intpos (optarg))
+				usage4 (_("Parallel must be a positive integer"));
+			cert_parallel = atoi (optarg);
+			break;
+		case CERT_CACHE_OPTION:
+			if (!is_intnonneg (optarg))
+				usage4 (_("Certificate cache must be a number of days"));
+			cert_cache_days = atoi (optarg);
+			break;
+#endif
 		case 'A':
 			match_flags |= NP_MATCH_ALL;
 			break;
@@ -614,6 +914,14 @@ process_arguments (int argc, char **argv)
 	if(host_specified == FALSE && c < argc)
 		server_address = strdup (argv[c++]);
 
+#ifdef HAVE_SSL
+	if (cert_list) {
+		if (check_cert == FALSE)
+			usage4 (_("--cert-list requires -D to set the expiry limits"));
+		return TRUE;
+	}
+#endif
+
 	if (server_address == NULL)
 		usage4 (_("You must provide a server address"));
 	else if (server_address[0] != '/' && is_host (server_address) == FALSE)
@@ -671,6 +979,16 @@ print_help (void)
   printf ("    %s\n", _("1st is #days for warning, 2nd is critical (if not specified - 0)."));
   printf (" %s\n", "-S, --ssl");
   printf ("    %s\n", _("Use SSL for the connection."));
+  printf (" %s\n", "--tls-resume");
+  printf ("    %s\n", _("Keep the SSL session in the state directory and resume it on the next check."));
+  printf (" %s\n", "--cert-list=FILE");
+  printf ("    %s\n", _("Check the certificates of all host:port[:sni] lines in FILE instead of one"));
+  printf ("    %s\n", _("connection. Needs -D, -t applies to each handshake."));
+  printf (" %s\n", "--parallel=INTEGER");
+  printf ("    %s\n", _("Number of handshakes of --cert-list to run at once (default: 32)"));
+  printf (" %s\n", "--cert-cache=DAYS");
+  printf ("    %s\n", _("Skip certificates checked less than DAYS ago which stay valid for more"));
+  printf ("    %s\n", _("than the warning days plus DAYS (default: 0, no cache)"));
 #endif
 
 	printf (UT_WARN_CRIT);
@@ -691,5 +1009,7 @@ print_usage (void)
   printf ("[-e <expect string>] [-q <quit string>][-m <maximum bytes>] [-d <delay>]\n");
   printf ("[-t <timeout seconds>] [-r <refuse state>] [-M <mismatch state>] [-v] [-4|-6] [-j]\n");
   printf ("[-D <warn days cert expire>[,<crit days cert expire>]] [-S <use SSL>] [-E]\n");
-  printf ("[-N <server name indication>]\n");
+  printf ("[-N <server name indication>] [--tls-resume]\n");
+  printf ("%s -D <warn days>[,<crit days>] --cert-list=FILE [--parallel=<n>]\n", progname);
+  printf ("[--cert-cache=<days>] [-t <timeout seconds>] [-4|-6] [-v]\n");
 }
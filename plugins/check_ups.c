@@ -71,9 +71,26 @@ enum {
 
 enum { NOSUCHVAR = ERROR-1 };
 
+/* variables fetched for every UPS, all sent in a single request */
+#define UPS_NVARS 6
+const char *ups_variables[UPS_NVARS] = {
+	"ups.status", "input.voltage", "battery.charge", "ups.load",
+	"ups.temperature", "battery.runtime"
+};
+
+typedef struct ups_info {
+	char *name;
+	char *reply[UPS_NVARS];	/* reply to GET VAR, NULL if none came back */
+} ups_info;
+
 int server_port = PORT;
 char *server_address;
 char *ups_name = NULL;
+int check_all_ups = FALSE;
+ups_info *upses = NULL;
+int num_upses = 0;
+char *ups_error = NULL;
+char *perf_prefix = "";
 double warning_value = 0.0;
 double critical_value = 0.0;
 int check_warn = FALSE;
@@ -91,8 +108,12 @@ double ups_battery_left = 0.0;
 char *ups_status;
 int temp_output_c = 0;
 
+int fetch_ups_variables (void);
+int list_ups (int, np_net_reader *);
+int check_ups (char **, char **);
 int determine_status (void);
 int get_ups_variable (const char *, char *, size_t);
+char *perf_label (const char *);
 
 int process_arguments (int, char **);
 int validate_arguments (void);
@@ -103,21 +124,17 @@ int
 main (int argc, char **argv)
 {
 	int result = STATE_UNKNOWN;
+	int ups_result;
 	char *message;
 	char *data;
-	char *tunits;
-	char temp_buffer[MAX_INPUT_BUFFER];
-	double ups_utility_deviation = 0.0;
-	int res;
+	char *output;
+	char *perf;
+	int i;
 
 	setlocale (LC_ALL, "");
 	bindtextdomain (PACKAGE, LOCALEDIR);
 	textdomain (PACKAGE);
 
-	ups_status = strdup ("N/A");
-	data = strdup ("");
-	message = strdup ("");
-
 	/* Parse extra opts if any */
 	argv=np_extra_opts (&argc, argv, progname);
 
@@ -130,9 +147,175 @@ main (int argc, char **argv)
 	/* set socket timeout */
 	alarm (timeout_interval);
 
+	/* get all variables of all UPS we are interested in in one go */
+	if (fetch_ups_variables () != OK)
+		return STATE_CRITICAL;
+
+	if (!check_all_ups) {
+		result = check_ups (&message, &data);
+		if (result == ERROR) {
+			printf ("%s\n", ups_error);
+			return STATE_CRITICAL;
+		}
+
+		/* reset timeout */
+		alarm (0);
+
+		printf ("UPS %s - %s|%s\n", state_text(result), message, data);
+		return result;
+	}
+
+	if (num_upses == 0) {
+		printf (_("UPS UNKNOWN - no UPS found on %s\n"), server_address);
+		return STATE_UNKNOWN;
+	}
+
+	result = STATE_OK;
+	output = strdup ("");
+	perf = strdup ("");
+	for (i = 0; i < num_upses; i++) {
+		ups_name = upses[i].name;
+		xasprintf (&perf_prefix, "%s_", ups_name);
+		ups_result = check_ups (&message, &data);
+		if (ups_result == ERROR) {
+			ups_result = STATE_CRITICAL;
+			message = ups_error;
+			data = "";
+		}
+		result = max_state (result, ups_result);
+		xasprintf (&output, "%s%s%s: %s", output, i ? "; " : "", ups_name, message);
+		xasprintf (&perf, "%s%s%s", perf, (i && *data) ? " " : "", data);
+	}
+
+	/* reset timeout */
+	alarm (0);
+
+	printf ("UPS %s - %d UPS: %s|%s\n", state_text(result), num_upses, output, perf);
+	return result;
+}
+
+
+
+/*
+ * Connect to upsd once and send GET VAR for every variable (and every UPS
+ * with -a) followed by LOGOUT in a single write, then read the replies,
+ * which upsd sends in the order of the commands.
+ */
+int
+fetch_ups_variables (void)
+{
+	np_net_reader reader;
+	char line[MAX_INPUT_BUFFER];
+	char *request;
+	int sd, i, len, replies;
+
+	if (my_tcp_connect (server_address, server_port, &sd) != STATE_OK) {
+		printf ("%s\n", _("Invalid response received from host"));
+		return ERROR;
+	}
+	np_net_reader_init (&reader, sd);
+
+	if (check_all_ups) {
+		if (list_ups (sd, &reader) != OK) {
+			close (sd);
+			return ERROR;
+		}
+	} else {
+		upses = calloc (1, sizeof (ups_info));
+		upses[0].name = ups_name;
+		num_upses = 1;
+	}
+
+	request = strdup ("");
+	for (i = 0; i < num_upses * UPS_NVARS; i++)
+		xasprintf (&request, "%sGET VAR %s %s\n", request,
+		           upses[i / UPS_NVARS].name, ups_variables[i % UPS_NVARS]);
+	/* Add LOGOUT to avoid read failure logs */
+	xasprintf (&request, "%sLOGOUT\n", request);
+
+	if (send (sd, request, strlen (request), 0) != (ssize_t)strlen (request)) {
+		printf ("%s\n", _("Invalid response received from host"));
+		close (sd);
+		return ERROR;
+	}
+
+	for (replies = 0; replies < num_upses * UPS_NVARS; replies++) {
+		if ((len = np_net_recvline (&reader, line, sizeof (line))) <= 0)
+			break;
+		if (line[len - 1] == '\n')
+			line[--len] = 0;
+		upses[replies / UPS_NVARS].reply[replies % UPS_NVARS] = strdup (line);
+	}
+	close (sd);
+
+	if (replies == 0) {
+		printf ("%s\n", _("Invalid response received from host"));
+		return ERROR;
+	}
+
+	return OK;
+}
+
+
+/* fill upses with the UPS known to upsd */
+int
+list_ups (int sd, np_net_reader *reader)
+{
+	char line[MAX_INPUT_BUFFER];
+	char *name;
+	const char *list = "LIST UPS\n";
+	int len;
+
+	if (send (sd, list, strlen (list), 0) != (ssize_t)strlen (list)) {
+		printf ("%s\n", _("Invalid response received from host"));
+		return ERROR;
+	}
+
+	while ((len = np_net_recvline (reader, line, sizeof (line))) > 0) {
+		strip (line);
+		if (strncmp (line, "ERR", 3) == 0) {
+			printf (_("Unknown error: %s\n"), line);
+			return ERROR;
+		}
+		if (strcmp (line, "END LIST UPS") == 0)
+			return OK;
+		if (strncmp (line, "UPS ", 4) != 0)
+			continue;
+		name = strndup (line + 4, strcspn (line + 4, " "));
+		upses = realloc (upses, (num_upses + 1) * sizeof (ups_info));
+		if (upses == NULL)
+			die (STATE_UNKNOWN, _("Could not realloc() units [%d]\n"), num_upses);
+		memset (&upses[num_upses], 0, sizeof (ups_info));
+		upses[num_upses++].name = name;
+	}
+
+	printf ("%s\n", _("Invalid response received from host"));
+	return ERROR;
+}
+
+
+/* evaluate the variables of ups_name, returns ERROR with ups_error set if
+ * they could not be read */
+int
+check_ups (char **message_ptr, char **data_ptr)
+{
+	int result = STATE_UNKNOWN;
+	char *message;
+	char *data;
+	char *tunits;
+	char temp_buffer[MAX_INPUT_BUFFER];
+	double ups_utility_deviation = 0.0;
+	int res;
+
+	ups_status = strdup ("N/A");
+	data = strdup ("");
+	message = strdup ("");
+	supported_options = UPS_NONE;
+	status = UPSSTATUS_NONE;
+
 	/* get the ups status if possible */
 	if (determine_status () != OK)
-		return STATE_CRITICAL;
+		return ERROR;
 	if (supported_options & UPS_STATUS) {
 
 		ups_status = strdup ("");
@@ -195,7 +378,7 @@ main (int argc, char **argv)
 	res=get_ups_variable ("input.voltage", temp_buffer, sizeof (temp_buffer));
 	if (res == NOSUCHVAR) supported_options &= ~UPS_UTILITY;
 	else if (res != OK)
-		return STATE_CRITICAL;
+		return ERROR;
 	else {
 		supported_options |= UPS_UTILITY;
 
@@ -215,13 +398,13 @@ main (int argc, char **argv)
 				result = max_state (result, STATE_WARNING);
 			}
 			xasprintf (&data, "%s",
-			          fperfdata ("voltage", ups_utility_voltage, (extended_units ? "V" : ""),
+			          fperfdata (perf_label ("voltage"), ups_utility_voltage, (extended_units ? "V" : ""),
 			                    check_warn, warning_value,
 			                    check_crit, critical_value,
 			                    TRUE, 0, FALSE, 0));
 		} else {
 			xasprintf (&data, "%s",
-			          fperfdata ("voltage", ups_utility_voltage, (extended_units ? "V" : ""),
+			          fperfdata (perf_label ("voltage"), ups_utility_voltage, (extended_units ? "V" : ""),
 			                    FALSE, 0, FALSE, 0, TRUE, 0, FALSE, 0));
 		}
 	}
@@ -230,7 +413,7 @@ main (int argc, char **argv)
 	res=get_ups_variable ("battery.charge", temp_buffer, sizeof (temp_buffer));
 	if (res == NOSUCHVAR) supported_options &= ~UPS_BATTPCT;
 	else if ( res != OK)
-		return STATE_CRITICAL;
+		return ERROR;
 	else {
 		supported_options |= UPS_BATTPCT;
 		ups_battery_percent = atof (temp_buffer);
@@ -244,13 +427,13 @@ main (int argc, char **argv)
 				result = max_state (result, STATE_WARNING);
 			}
 			xasprintf (&data, "%s %s", data,
-			          fperfdata ("battery", ups_battery_percent, "%",
+			          fperfdata (perf_label ("battery"), ups_battery_percent, "%",
 			                    check_warn, warning_value,
 			                    check_crit, critical_value,
 			                    TRUE, 0, TRUE, 100));
 		} else {
 			xasprintf (&data, "%s %s", data,
-			          fperfdata ("battery", ups_battery_percent, "%",
+			          fperfdata (perf_label ("battery"), ups_battery_percent, "%",
 			                    FALSE, 0, FALSE, 0, TRUE, 0, TRUE, 100));
 		}
 	}
@@ -259,7 +442,7 @@ main (int argc, char **argv)
 	res=get_ups_variable ("ups.load", temp_buffer, sizeof (temp_buffer));
 	if ( res == NOSUCHVAR ) supported_options &= ~UPS_LOADPCT;
 	else if ( res != OK)
-		return STATE_CRITICAL;
+		return ERROR;
 	else {
 		supported_options |= UPS_LOADPCT;
 		ups_load_percent = atof (temp_buffer);
@@ -273,13 +456,13 @@ main (int argc, char **argv)
 				result = max_state (result, STATE_WARNING);
 			}
 			xasprintf (&data, "%s %s", data,
-			          fperfdata ("load", ups_load_percent, "%",
+			          fperfdata (perf_label ("load"), ups_load_percent, "%",
 			                    check_warn, warning_value,
 			                    check_crit, critical_value,
 			                    TRUE, 0, TRUE, 100));
 		} else {
 			xasprintf (&data, "%s %s", data,
-			          fperfdata ("load", ups_load_percent, "%",
+			          fperfdata (perf_label ("load"), ups_load_percent, "%",
 			                    FALSE, 0, FALSE, 0, TRUE, 0, TRUE, 100));
 		}
 	}
@@ -288,7 +471,7 @@ main (int argc, char **argv)
 	res=get_ups_variable ("ups.temperature", temp_buffer, sizeof (temp_buffer));
 	if ( res == NOSUCHVAR ) supported_options &= ~UPS_TEMP;
 	else if ( res != OK)
-		return STATE_CRITICAL;
+		return ERROR;
 	else {
  		supported_options |= UPS_TEMP;
 		if (temp_output_c) {
@@ -310,13 +493,13 @@ main (int argc, char **argv)
 				result = max_state (result, STATE_WARNING);
 			}
 			xasprintf (&data, "%s %s", data,
-			          fperfdata ("temp", ups_temperature, (extended_units ? tunits : ""),
+			          fperfdata (perf_label ("temp"), ups_temperature, (extended_units ? tunits : ""),
 			                    check_warn, warning_value,
 			                    check_crit, critical_value,
 			                    TRUE, 0, FALSE, 0));
 		} else {
 			xasprintf (&data, "%s %s", data,
-			          fperfdata ("temp", ups_temperature, (extended_units ? tunits : ""),
+			          fperfdata (perf_label ("temp"), ups_temperature, (extended_units ? tunits : ""),
 			                    FALSE, 0, FALSE, 0, TRUE, 0, FALSE, 0));
 		}
 	}
@@ -325,7 +508,7 @@ main (int argc, char **argv)
 	res=get_ups_variable ("battery.runtime", temp_buffer, sizeof (temp_buffer));
 	if (res == NOSUCHVAR) supported_options &= ~UPS_BATTLEFT;
 	else if ( res != OK)
-		return STATE_CRITICAL;
+		return ERROR;
 	else {
 		supported_options |= UPS_BATTLEFT;
 		ups_battery_left = atof (temp_buffer) / 60;
@@ -339,13 +522,13 @@ main (int argc, char **argv)
 				result = max_state (result, STATE_WARNING);
 			}
 			xasprintf (&data, "%s %s", data,
-			          fperfdata ("left", ups_battery_left, "",
+			          fperfdata (perf_label ("left"), ups_battery_left, "",
 			                    check_warn, warning_value,
 			                    check_crit, critical_value,
 			                    TRUE, 0, FALSE, 0));
 		} else {
 			xasprintf (&data, "%s %s", data,
-			          fperfdata ("left", ups_battery_left, "",
+			          fperfdata (perf_label ("left"), ups_battery_left, "",
 			                    FALSE, 0, FALSE, 0, TRUE, 0, FALSE, 0));
 		}
 	}
@@ -353,13 +536,22 @@ main (int argc, char **argv)
 	/* if the UPS does not support any options we are looking for, report an error */
 	if (supported_options == UPS_NONE) {
 		result = STATE_CRITICAL;
-		xasprintf (&message, _("UPS does not support any available options\n"));
+		xasprintf (&message, _("UPS does not support any available options"));
 	}
 
-	/* reset timeout */
-	alarm (0);
+	*message_ptr = message;
+	*data_ptr = data;
+	return result;
+}
+
 
-	printf ("UPS %s - %s|%s\n", state_text(result), message, data);
+/* prefix a perfdata label with the UPS name when checking all UPS */
+char *
+perf_label (const char *label)
+{
+	char *result;
+
+	xasprintf (&result, "%s%s", perf_prefix, label);
 	return result;
 }
 
@@ -376,10 +568,8 @@ determine_status (void)
 
 	res=get_ups_variable ("ups.status", recv_buffer, sizeof (recv_buffer));
 	if (res == NOSUCHVAR) return OK;
-	if (res != STATE_OK) {
-		printf ("%s\n", _("Invalid response received from host"));
+	if (res != STATE_OK)
 		return ERROR;
-	}
 
 	supported_options |= UPS_STATUS;
 
@@ -418,38 +608,31 @@ determine_status (void)
 }
 
 
-/* gets a variable value for a specific UPS  */
+/* gets a variable value for a specific UPS from the replies fetched by
+ * fetch_ups_variables(), sets ups_error if it returns ERROR */
 int
 get_ups_variable (const char *varname, char *buf, size_t buflen)
 {
-	/*  char command[MAX_INPUT_BUFFER]; */
-	char temp_buffer[MAX_INPUT_BUFFER];
-	char send_buffer[MAX_INPUT_BUFFER];
-	char *ptr;
-	char *logout = "OK Goodbye\n";
-	int logout_len = strlen(logout);
-	int len;
+	ups_info *ups;
+	char *ptr = NULL;
+	int i, len;
 
 	*buf=0;
 
-	/* create the command string to send to the UPS daemon */
-	/* Add LOGOUT to avoid read failure logs */
-	sprintf (send_buffer, "GET VAR %s %s\nLOGOUT\n", ups_name, varname);
+	for (ups = upses; ups < upses + num_upses; ups++)
+		if (!strcmp (ups->name, ups_name))
+			break;
+	for (i = 0; ups < upses + num_upses && i < UPS_NVARS; i++)
+		if (!strcmp (ups_variables[i], varname))
+			ptr = ups->reply[i];
 
-	/* send the command to the daemon and get a response back */
-	if (process_tcp_request
-			(server_address, server_port, send_buffer, temp_buffer,
-			 sizeof (temp_buffer)) != STATE_OK) {
-		printf ("%s\n", _("Invalid response received from host"));
+	if (ptr == NULL) {
+		xasprintf (&ups_error, "%s", _("Invalid response received from host"));
 		return ERROR;
 	}
 
-	ptr = temp_buffer;
-	len = strlen(ptr);
-	if (len > logout_len && strcmp (ptr + len - logout_len, logout) == 0) len -= logout_len;
-	if (len > 0 && ptr[len-1] == '\n') ptr[len-1]=0;
 	if (strcmp (ptr, "ERR UNKNOWN-UPS") == 0) {
-		printf (_("CRITICAL - no such UPS '%s' on that host\n"), ups_name);
+		xasprintf (&ups_error, _("CRITICAL - no such UPS '%s' on that host"), ups_name);
 		return ERROR;
 	}
 
@@ -459,19 +642,25 @@ get_ups_variable (const char *varname, char *buf, size_t buflen)
 	}
 
 	if (strcmp (ptr, "ERR DATA-STALE") == 0) {
-		printf ("%s\n", _("CRITICAL - UPS data is stale"));
+		xasprintf (&ups_error, "%s", _("CRITICAL - UPS data is stale"));
 		return ERROR;
 	}
 
 	if (strncmp (ptr, "ERR", 3) == 0) {
-		printf (_("Unknown error: %s\n"), ptr);
+		xasprintf (&ups_error, _("Unknown error: %s"), ptr);
 		return ERROR;
 	}
 
-	ptr = temp_buffer + strlen (varname) + strlen (ups_name) + 6;
+	/* VAR <ups> <varname> "<value>" */
+	len = strlen (ptr);
+	if (len < (int)(strlen (varname) + strlen (ups_name) + 6)) {
+		xasprintf (&ups_error, "%s", _("Error: unable to parse variable"));
+		return ERROR;
+	}
+	ptr += strlen (varname) + strlen (ups_name) + 6;
 	len = strlen(ptr);
-	if (len < 2 || ptr[0] != '"' || ptr[len-1] != '"') {
-		printf ("%s\n", _("Error: unable to parse variable"));
+	if (len < 2 || ptr[0] != '"' || ptr[len-1] != '"' || (size_t)len - 1 > buflen) {
+		xasprintf (&ups_error, "%s", _("Error: unable to parse variable"));
 		return ERROR;
 	}
 	strncpy (buf, ptr+1, len - 2);
@@ -495,6 +684,7 @@ process_arguments (int argc, char **argv)
 	static struct option longopts[] = {
 		{"hostname", required_argument, 0, 'H'},
 		{"ups", required_argument, 0, 'u'},
+		{"all", no_argument, 0, 'a'},
 		{"port", required_argument, 0, 'p'},
 		{"critical", required_argument, 0, 'c'},
 		{"warning", required_argument, 0, 'w'},
@@ -520,7 +710,7 @@ process_arguments (int argc, char **argv)
 	}
 
 	while (1) {
-		c = getopt_long (argc, argv, "hVTH:u:p:v:c:w:t:", longopts,
+		c = getopt_long (argc, argv, "hVTaH:u:p:v:c:w:t:", longopts,
 									 &option);
 
 		if (c == -1 || c == EOF)
@@ -543,6 +733,9 @@ process_arguments (int argc, char **argv)
 		case 'u':									/* ups name */
 			ups_name = optarg;
 			break;
+		case 'a':									/* all ups on the server */
+			check_all_ups = TRUE;
+			break;
 		case 'p':									/* port */
 			if (is_intpos (optarg)) {
 				server_port = atoi (optarg);
@@ -616,7 +809,7 @@ process_arguments (int argc, char **argv)
 int
 validate_arguments (void)
 {
-	if (! ups_name) {
+	if (! ups_name && ! check_all_ups) {
 		printf ("%s\n", _("Error : no UPS indicated"));
 		return ERROR;
 	}
@@ -651,6 +844,8 @@ print_help (void)
 
 	printf (" %s\n", "-u, --ups=STRING");
   printf ("    %s\n", _("Name of UPS"));
+  printf (" %s\n", "-a, --all");
+  printf ("    %s\n", _("Check every UPS known to the server instead of a single one"));
   printf (" %s\n", "-T, --temperature");
   printf ("    %s\n", _("Output of temperatures in Celsius"));
   printf (" %s\n", "-e, --extended-units");
@@ -678,7 +873,8 @@ print_help (void)
   printf (" %s\n", _("You may also specify a variable to check (such as temperature, utility voltage,"));
   printf (" %s\n", _("battery load, etc.) as well as warning and critical thresholds for the value"));
   printf (" %s\n", _("of that variable.  If the remote host has multiple UPS that are being monitored"));
-  printf (" %s\n", _("you will have to use the --ups option to specify which UPS to check."));
+  printf (" %s\n", _("you will have to use the --ups option to specify which UPS to check, or"));
+  printf (" %s\n", _("--all to check all of them in one run."));
   printf ("\n");
   printf (" %s\n", _("This plugin requires that the UPSD daemon distributed with Russell Kroll's"));
   printf (" %s\n", _("Network UPS Tools be installed on the remote host. If you do not have the"));
@@ -693,5 +889,5 @@ void
 print_usage (void)
 {
   printf ("%s\n", _("Usage:"));
-	printf ("%s -H host -u ups [-p port] [-v variable] [-w warn_value] [-c crit_value] [-e] [-to to_sec] [-T]\n", progname);
+	printf ("%s -H host {-u ups|-a} [-p port] [-v variable] [-w warn_value] [-c crit_value] [-e] [-to to_sec] [-T]\n", progname);
 }
@@ -11,7 +11,9 @@
 * 
 * This plugin checks the number of users currently logged in on the local
 * system and generates an error if the number exceeds the thresholds
-* specified.
+* specified. Where utmpx is available the sessions can also be checked per
+* user, per remote host and per session type, and the login rate is read
+* from the records added to wtmp since the last run.
 * 
 * 
 * This program is free software: you can redistribute it and/or modify
@@ -43,7 +45,9 @@ const char *email = "devel@nagios-plugins.org";
 # undef ERROR
 # define ERROR -1
 #elif HAVE_UTMPX_H
-# include <utmpx.h>
+# include <sys/stat.h>
+# include "utils_utmp.h"
+# define HAVE_SESSION_DETAIL 1
 #else
 # include "popen.h"
 #endif
@@ -57,6 +61,35 @@ void print_usage (void);
 char *warning_range = NULL;
 char *critical_range = NULL;
 thresholds *thlds = NULL;
+int verbose = 0;
+
+#ifdef HAVE_SESSION_DETAIL
+/* sessions of one user or from one host */
+typedef struct session_count {
+	char *name;
+	int count;
+	struct session_count *next;
+} session_count;
+
+static const char *type_names[] = { "ssh", "console" };
+
+void count_session (const struct utmpx *);
+int check_groups (session_count *, thresholds *, const char *, char **);
+int check_login_rate (char **, char **);
+
+char *utmp_file = UTMPX_FILE;
+char *wtmp_file = WTMPX_FILE;
+char *user_warning = NULL, *user_critical = NULL;
+char *host_warning = NULL, *host_critical = NULL;
+char *type_warning[2] = { NULL, NULL }, *type_critical[2] = { NULL, NULL };
+char *rate_warning = NULL, *rate_critical = NULL;
+thresholds *user_thlds = NULL, *host_thlds = NULL, *type_thlds[2] = { NULL, NULL };
+thresholds *rate_thlds = NULL;
+int breakdown = FALSE;
+int check_rate = FALSE;
+int sessions[2] = { 0, 0 };
+session_count *by_user = NULL, *by_host = NULL;
+#endif
 
 int
 main (int argc, char **argv)
@@ -69,6 +102,11 @@ main (int argc, char **argv)
 	DWORD index;
 #elif HAVE_UTMPX_H
 	struct utmpx *putmpx;
+	np_utmp utmp;
+	session_count *group;
+	char *text = "", *perf = "", *label;
+	size_t i;
+	int type;
 #else
 	char input_buffer[MAX_INPUT_BUFFER];
 #endif
@@ -83,6 +121,11 @@ main (int argc, char **argv)
 	if (process_arguments (argc, argv) == ERROR)
 		usage4 (_("Could not parse arguments"));
 
+#ifdef HAVE_SESSION_DETAIL
+	/* the state store for the wtmp offset needs this */
+	np_init ((char *) progname, argc, argv);
+#endif
+
 	users = 0;
 
 #if HAVE_WTSAPI32_H
@@ -115,14 +158,22 @@ main (int argc, char **argv)
 
 	WTSFreeMemory(wtsinfo);
 #elif HAVE_UTMPX_H
-	/* get currently logged users from utmpx */
-	setutxent ();
-
-	while ((putmpx = getutxent ()) != NULL)
-		if (putmpx->ut_type == USER_PROCESS)
-			users++;
-
-	endutxent ();
+	/* get currently logged users from utmpx, mapped rather than copied
+	 * record by record */
+	if (np_utmp_open (&utmp, utmp_file, 0, 0) == OK) {
+		for (i = 0; i < utmp.count; i++)
+			count_session (&utmp.records[i]);
+		np_utmp_close (&utmp);
+	} else if (strcmp (utmp_file, UTMPX_FILE) == 0) {
+		/* the C library may still have another source */
+		setutxent ();
+		while ((putmpx = getutxent ()) != NULL)
+			count_session (putmpx);
+		endutxent ();
+	} else {
+		die (STATE_UNKNOWN, _("Could not read %s\n"), utmp_file);
+	}
+	users = sessions[NP_UTMP_SSH] + sessions[NP_UTMP_CONSOLE];
 #else
 	/* run the command */
 	child_process = spopen (WHO_COMMAND);
@@ -160,6 +211,47 @@ main (int argc, char **argv)
 	/* check the user count against warning and critical thresholds */
 	result = get_status((double)users, thlds);
 
+#ifdef HAVE_SESSION_DETAIL
+	for (type = 0; type < 2; type++) {
+		if (type_thlds[type] != NULL) {
+			if (get_status (sessions[type], type_thlds[type]) != STATE_OK)
+				xasprintf (&text, _("%s, %d %s sessions"), text, sessions[type], type_names[type]);
+			result = max_state (result, get_status (sessions[type], type_thlds[type]));
+		}
+		if (breakdown || type_thlds[type] != NULL)
+			xasprintf (&perf, "%s %s", perf, sperfdata_int (type_names[type], sessions[type], "",
+			           type_warning[type], type_critical[type], TRUE, 0, FALSE, 0));
+	}
+	if (user_thlds != NULL)
+		result = max_state (result, check_groups (by_user, user_thlds, _("user"), &text));
+	if (host_thlds != NULL)
+		result = max_state (result, check_groups (by_host, host_thlds, _("host"), &text));
+	if (breakdown) {
+		for (group = by_user; group; group = group->next) {
+			xasprintf (&label, "user_%s", group->name);
+			xasprintf (&perf, "%s %s", perf, sperfdata_int (label, group->count, "",
+			           user_warning, user_critical, TRUE, 0, FALSE, 0));
+		}
+		for (group = by_host; group; group = group->next) {
+			xasprintf (&label, "host_%s", group->name);
+			xasprintf (&perf, "%s %s", perf, sperfdata_int (label, group->count, "",
+			           host_warning, host_critical, TRUE, 0, FALSE, 0));
+		}
+	}
+	if (check_rate)
+		result = max_state (result, check_login_rate (&text, &perf));
+	if (verbose) {
+		for (group = by_user; group; group = group->next)
+			printf (_("user %s: %d sessions\n"), group->name, group->count);
+		for (group = by_host; group; group = group->next)
+			printf (_("host %s: %d sessions\n"), group->name, group->count);
+	}
+
+	printf (_("USERS %s - %d users currently logged in%s |%s%s\n"),
+			state_text(result), users, text,
+			sperfdata_int("users", users, "", warning_range,
+						critical_range, TRUE, 0, FALSE, 0), perf);
+#else
 	if (result == STATE_UNKNOWN)
 		printf ("%s\n", _("Unable to read output"));
 	else {
@@ -168,19 +260,148 @@ main (int argc, char **argv)
 				sperfdata_int("users", users, "", warning_range,
 							critical_range, TRUE, 0, FALSE, 0));
 	}
+#endif
+
+	return result;
+}
+
+#ifdef HAVE_SESSION_DETAIL
+static void
+count_group (session_count **list, const char *name)
+{
+	session_count *group;
+
+	for (; *list; list = &(*list)->next)
+		if (strcmp ((*list)->name, name) == 0) {
+			(*list)->count++;
+			return;
+		}
+	if ((group = malloc (sizeof (session_count))) == NULL || (group->name = strdup (name)) == NULL)
+		die (STATE_UNKNOWN, _("Insufficient memory\n"));
+	group->count = 1;
+	group->next = NULL;
+	*list = group;
+}
+
+void
+count_session (const struct utmpx *ut)
+{
+	char buf[sizeof (ut->ut_host) + 1];
+	int type;
+
+	if (ut->ut_type != USER_PROCESS)
+		return;
+	type = np_utmp_session_type (ut);
+	sessions[type]++;
+	if (breakdown || user_thlds != NULL || verbose)
+		count_group (&by_user, np_utmp_field (buf, ut->ut_user));
+	if (type == NP_UTMP_SSH && (breakdown || host_thlds != NULL || verbose))
+		count_group (&by_host, np_utmp_field (buf, ut->ut_host));
+}
+
+/* every user or host is held against the same thresholds */
+int
+check_groups (session_count *list, thresholds *t, const char *what, char **text)
+{
+	int result = STATE_OK, state;
 
+	for (; list; list = list->next) {
+		state = get_status (list->count, t);
+		if (state != STATE_OK)
+			xasprintf (text, _("%s, %s %s has %d sessions"), *text, what, list->name, list->count);
+		result = max_state (result, state);
+	}
 	return result;
 }
 
+/* logins per minute, from the wtmp records written since the offset saved
+ * by the last run */
+int
+check_login_rate (char **text, char **perf)
+{
+	state_data *previous;
+	unsigned long long inode, offset;
+	np_utmp wtmp;
+	struct stat st;
+	time_t now = time (NULL);
+	double interval, rate;
+	char *data;
+	size_t i;
+	int logins = 0;
+
+	np_enable_state (NULL, 1);
+	previous = np_state_read ();
+
+	/* the first run only remembers where wtmp ends */
+	if (previous == NULL || sscanf ((char *) previous->data, "%llu %llu", &inode, &offset) != 2) {
+		if (stat (wtmp_file, &st) != 0)
+			die (STATE_UNKNOWN, _("Could not read %s\n"), wtmp_file);
+		xasprintf (&data, "%llu %llu", (unsigned long long) st.st_ino,
+		           (unsigned long long) (st.st_size - st.st_size % sizeof (struct utmpx)));
+		np_state_write_string (now, data);
+		return STATE_OK;
+	}
+
+	if (np_utmp_open (&wtmp, wtmp_file, (ino_t) inode, (off_t) offset) != OK)
+		die (STATE_UNKNOWN, _("Could not read %s\n"), wtmp_file);
+	for (i = 0; i < wtmp.count; i++)
+		if (wtmp.records[i].ut_type == USER_PROCESS)
+			logins++;
+	xasprintf (&data, "%llu %llu", (unsigned long long) wtmp.inode, (unsigned long long) wtmp.end);
+	np_state_write_string (now, data);
+	if (verbose >= 3)
+		printf (_("%lu new wtmp records%s\n"), (unsigned long) wtmp.count,
+		        wtmp.restarted ? _(", file was rotated") : "");
+	np_utmp_close (&wtmp);
+
+	if ((interval = difftime (now, previous->time)) <= 0)
+		return STATE_OK;
+	rate = logins * 60.0 / interval;
+	xasprintf (text, _("%s, %d logins in %.0fs (%.2f/min)"), *text, logins, interval, rate);
+	xasprintf (perf, "%s %s", *perf,
+	           sperfdata ("logins", rate, "", rate_warning, rate_critical, TRUE, 0, FALSE, 0));
+	return get_status (rate, rate_thlds);
+}
+#endif
+
 /* process command-line arguments */
 int
 process_arguments (int argc, char **argv)
 {
 	int c;
 	int option = 0;
+	enum {
+		USER_WARNING = CHAR_MAX + 1,
+		USER_CRITICAL,
+		HOST_WARNING,
+		HOST_CRITICAL,
+		SSH_WARNING,
+		SSH_CRITICAL,
+		CONSOLE_WARNING,
+		CONSOLE_CRITICAL,
+		RATE_WARNING,
+		RATE_CRITICAL,
+		UTMP_FILE,
+		WTMP_FILE
+	};
 	static struct option longopts[] = {
 		{"critical", required_argument, 0, 'c'},
 		{"warning", required_argument, 0, 'w'},
+		{"breakdown", no_argument, 0, 'b'},
+		{"rate", no_argument, 0, 'r'},
+		{"user-warning", required_argument, 0, USER_WARNING},
+		{"user-critical", required_argument, 0, USER_CRITICAL},
+		{"host-warning", required_argument, 0, HOST_WARNING},
+		{"host-critical", required_argument, 0, HOST_CRITICAL},
+		{"ssh-warning", required_argument, 0, SSH_WARNING},
+		{"ssh-critical", required_argument, 0, SSH_CRITICAL},
+		{"console-warning", required_argument, 0, CONSOLE_WARNING},
+		{"console-critical", required_argument, 0, CONSOLE_CRITICAL},
+		{"rate-warning", required_argument, 0, RATE_WARNING},
+		{"rate-critical", required_argument, 0, RATE_CRITICAL},
+		{"utmp-file", required_argument, 0, UTMP_FILE},
+		{"wtmp-file", required_argument, 0, WTMP_FILE},
+		{"verbose", no_argument, 0, 'v'},
 		{"version", no_argument, 0, 'V'},
 		{"help", no_argument, 0, 'h'},
 		{0, 0, 0, 0}
@@ -190,7 +411,7 @@ process_arguments (int argc, char **argv)
 		usage ("\n");
 
 	while (1) {
-		c = getopt_long (argc, argv, "+hVvc:w:", longopts, &option);
+		c = getopt_long (argc, argv, "+hVvbrc:w:", longopts, &option);
 
 		if (c == -1 || c == EOF || c == 1)
 			break;
@@ -210,6 +431,71 @@ process_arguments (int argc, char **argv)
 		case 'w':									/* warning */
 			warning_range = optarg;
 			break;
+		case 'v':									/* verbose */
+			verbose++;
+			break;
+#ifdef HAVE_SESSION_DETAIL
+		case 'b':
+			breakdown = TRUE;
+			break;
+		case 'r':
+			check_rate = TRUE;
+			break;
+		case USER_WARNING:
+			user_warning = optarg;
+			break;
+		case USER_CRITICAL:
+			user_critical = optarg;
+			break;
+		case HOST_WARNING:
+			host_warning = optarg;
+			break;
+		case HOST_CRITICAL:
+			host_critical = optarg;
+			break;
+		case SSH_WARNING:
+			type_warning[NP_UTMP_SSH] = optarg;
+			break;
+		case SSH_CRITICAL:
+			type_critical[NP_UTMP_SSH] = optarg;
+			break;
+		case CONSOLE_WARNING:
+			type_warning[NP_UTMP_CONSOLE] = optarg;
+			break;
+		case CONSOLE_CRITICAL:
+			type_critical[NP_UTMP_CONSOLE] = optarg;
+			break;
+		case RATE_WARNING:
+			rate_warning = optarg;
+			check_rate = TRUE;
+			break;
+		case RATE_CRITICAL:
+			rate_critical = optarg;
+			check_rate = TRUE;
+			break;
+		case UTMP_FILE:
+			utmp_file = optarg;
+			break;
+		case WTMP_FILE:
+			wtmp_file = optarg;
+			break;
+#else
+		case 'b':
+		case 'r':
+		case USER_WARNING:
+		case USER_CRITICAL:
+		case HOST_WARNING:
+		case HOST_CRITICAL:
+		case SSH_WARNING:
+		case SSH_CRITICAL:
+		case CONSOLE_WARNING:
+		case CONSOLE_CRITICAL:
+		case RATE_WARNING:
+		case RATE_CRITICAL:
+		case UTMP_FILE:
+		case WTMP_FILE:
+			usage4 (_("Per session checks need utmpx support"));
+#endif
 		}
 	}
 
@@ -227,6 +513,18 @@ process_arguments (int argc, char **argv)
 	if (!thlds->critical || thlds->critical->end < 0)
 		usage4 (_("Critical threshold must be zero or greater"));
 
+#ifdef HAVE_SESSION_DETAIL
+	if (user_warning || user_critical)
+		set_thresholds (&user_thlds, user_warning, user_critical);
+	if (host_warning || host_critical)
+		set_thresholds (&host_thlds, host_warning, host_critical);
+	for (c = 0; c < 2; c++)
+		if (type_warning[c] || type_critical[c])
+			set_thresholds (&type_thlds[c], type_warning[c], type_critical[c]);
+	if (check_rate)
+		set_thresholds (&rate_thlds, rate_warning, rate_critical);
+#endif
+
 	return OK;
 }
 
@@ -252,6 +550,31 @@ print_help (void)
 	printf ("    %s\n", _("Set WARNING status if more than INTEGER users are logged in"));
 	printf (" %s\n", "-c, --critical=INTEGER");
 	printf ("    %s\n", _("Set CRITICAL status if more than INTEGER users are logged in"));
+#ifdef HAVE_SESSION_DETAIL
+	printf (" %s\n", "-b, --breakdown");
+	printf ("    %s\n", _("Add performance data for each session type, user and remote host"));
+	printf (" %s\n", "--user-warning=RANGE, --user-critical=RANGE");
+	printf ("    %s\n", _("Thresholds on the number of sessions of each user"));
+	printf (" %s\n", "--host-warning=RANGE, --host-critical=RANGE");
+	printf ("    %s\n", _("Thresholds on the number of sessions from each remote host"));
+	printf (" %s\n", "--ssh-warning=RANGE, --ssh-critical=RANGE");
+	printf ("    %s\n", _("Thresholds on the number of sessions from remote hosts"));
+	printf (" %s\n", "--console-warning=RANGE, --console-critical=RANGE");
+	printf ("    %s\n", _("Thresholds on the number of local terminal and X display sessions"));
+	printf (" %s\n", "-r, --rate");
+	printf ("    %s\n", _("Report the logins per minute since the last run, read from wtmp"));
+	printf (" %s\n", "--rate-warning=RANGE, --rate-critical=RANGE");
+	printf ("    %s\n", _("Thresholds on the logins per minute, these imply --rate"));
+	printf (" %s\n", "--utmp-file=PATH, --wtmp-file=PATH");
+	printf ("    %s\n", _("Read sessions and logins from other files, the defaults are"));
+	printf ("    %s, %s\n", UTMPX_FILE, WTMPX_FILE);
+	printf (UT_VERBOSE);
+
+	printf ("\n");
+	printf ("%s\n", _("Notes:"));
+	printf (" %s\n", _("Only the part of wtmp written since the last run is read, its offset is kept"));
+	printf (" %s\n", _("in the state directory. The first run only records it."));
+#endif
 
 	printf (UT_SUPPORT);
 }
@@ -260,5 +583,7 @@ void
 print_usage (void)
 {
 	printf ("%s\n", _("Usage:"));
-	printf ("%s -w <users> -c <users>\n", progname);
+	printf ("%s -w <users> -c <users> [-b] [-r] [--user-warning=<range>] [--user-critical=<range>]\n", progname);
+	printf ("  [--host-warning=<range>] [--host-critical=<range>] [--ssh-warning=<range>] [--ssh-critical=<range>]\n");
+	printf ("  [--console-warning=<range>] [--console-critical=<range>] [--rate-warning=<range>] [--rate-critical=<range>]\n");
 }
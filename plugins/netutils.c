@@ -29,6 +29,14 @@
 
 #include "common.h"
 #include "netutils.h"
+#include "utils_icmp.h"
+#include <ctype.h>
+#include <netinet/in_systm.h>
+#include <netinet/ip.h>
+#include <netinet/ip_icmp.h>
+#ifdef USE_IPV6
+# include <netinet/icmp6.h>
+#endif
 
 int econn_refuse_state = STATE_CRITICAL;
 int was_refused = FALSE;
@@ -342,6 +350,283 @@ send_request (int sd, int proto, const char *send_buffer, char *recv_buffer, int
 }
 
 
+/* prepare a reader for the connected socket sd */
+void
+np_net_reader_init (np_net_reader *reader, int sd)
+{
+	reader->sd = sd;
+	reader->ssl_read = NULL;
+	reader->pos = reader->len = 0;
+}
+
+/* switch the reader to TLS once the handshake is done. Anything still
+ * buffered was sent in the clear before the handshake and is dropped, as
+ * RFC 3207 requires for STARTTLS */
+void
+np_net_reader_use_ssl (np_net_reader *reader, int (*ssl_read)(void *, int))
+{
+	reader->ssl_read = ssl_read;
+	reader->pos = reader->len = 0;
+}
+
+/*
+ * Receive one line, copy it into buf and nul-terminate it.  Returns the
+ * number of bytes written to buf (excluding the '\0'), 0 on EOF, <0 on
+ * error or -2 if the line does not fit into buf.  Data is read from the
+ * socket in large chunks and kept in the reader for the following calls,
+ * so a multi-line reply costs one read() rather than one per byte.  A
+ * last line without a newline is returned as it is when the peer closes
+ * the connection.
+ */
+int
+np_net_recvline (np_net_reader *reader, char *buf, size_t bufsize)
+{
+	size_t n = 0, chunk;
+	char *nl;
+	int result;
+
+	if (bufsize == 0)
+		return -2;
+
+	while (n < bufsize - 1) {
+		if (reader->pos == reader->len) {
+			if (reader->ssl_read)
+				result = reader->ssl_read (reader->data, sizeof (reader->data));
+			else
+				result = read (reader->sd, reader->data, sizeof (reader->data));
+			if (result <= 0) {
+				buf[n] = '\0';
+				return n ? (int)n : result;
+			}
+			reader->pos = 0;
+			reader->len = result;
+		}
+
+		chunk = min (reader->len - reader->pos, bufsize - 1 - n);
+		nl = memchr (reader->data + reader->pos, '\n', chunk);
+		if (nl)
+			chunk = nl - (reader->data + reader->pos) + 1;
+		memcpy (buf + n, reader->data + reader->pos, chunk);
+		reader->pos += chunk;
+		n += chunk;
+		if (nl) {
+			buf[n] = '\0';
+			return n;
+		}
+	}
+
+	buf[n] = '\0';
+	return -2;
+}
+
+/*
+ * Receive one or more lines, copy them into buf and nul-terminate it.  Returns
+ * the number of bytes written to buf (excluding the '\0') or 0 on EOF or <0 on
+ * error.  Works for all protocols which format multiline replies as follows:
+ *
+ * ``The format for multiline replies requires that every line, except the last,
+ * begin with the reply code, followed immediately by a hyphen, `-' (also known
+ * as minus), followed by text.  The last line will begin with the reply code,
+ * followed immediately by <SP>, optionally some text, and <CRLF>.  As noted
+ * above, servers SHOULD send the <SP> if subsequent text is not sent, but
+ * clients MUST be prepared for it to be omitted.'' (RFC 2821, 4.2.1)
+ */
+int
+np_net_recvlines (np_net_reader *reader, char *buf, size_t bufsize)
+{
+	int result, i;
+
+	for (i = 0; /* forever */; i += result)
+		if (!((result = np_net_recvline (reader, buf + i, bufsize - i)) > 3 &&
+		    isdigit((int)buf[i]) &&
+		    isdigit((int)buf[i + 1]) &&
+		    isdigit((int)buf[i + 2]) &&
+		    buf[i + 3] == '-'))
+			break;
+
+	return (result <= 0) ? result : result + i;
+}
+
+static unsigned short
+np_icmp_checksum (const unsigned char *p, int len)
+{
+	unsigned long sum = 0;
+
+	for (; len > 1; len -= 2, p += 2)
+		sum += (p[0] << 8) | p[1];
+	if (len == 1)
+		sum += p[0] << 8;
+	sum = (sum >> 16) + (sum & 0xffff);
+	sum += sum >> 16;
+
+	return htons ((unsigned short) ~sum);
+}
+
+static double
+np_ms_between (struct timeval *from, struct timeval *to)
+{
+	return (to->tv_sec - from->tv_sec) * 1000.0 + (to->tv_usec - from->tv_usec) / 1000.0;
+}
+
+/*
+ * Send count ICMP echo requests of size bytes of data to host, interval
+ * milliseconds apart, and wait up to timeout milliseconds after the last
+ * one for the replies.  An unprivileged ICMP datagram socket is used where
+ * the kernel allows it (net.ipv4.ping_group_range on Linux), a raw socket
+ * otherwise.
+ */
+int
+np_net_ping (const char *host, int count, int size, int interval, int timeout,
+             np_ping_stats *stats)
+{
+	struct addrinfo hints, *res;
+	struct pollfd pfd;
+	struct timeval *sent_at, now, next_send;
+	unsigned char *packet, *seen;
+	unsigned char reply[65536];
+	unsigned short ident, seq;
+	int sd, raw = FALSE, family, echo, wait, len, err;
+	double rtt, total = 0.0;
+
+	memset (stats, 0, sizeof (*stats));
+	if (count <= 0)
+		return OK;
+
+	memset (&hints, 0, sizeof (hints));
+	hints.ai_family = address_family;
+	hints.ai_socktype = SOCK_DGRAM;
+	if (getaddrinfo (host, NULL, &hints, &res) != 0)
+		return NP_PING_NO_HOST;
+
+	family = res->ai_family;
+#ifdef USE_IPV6
+	if (family == AF_INET6) {
+		sd = socket (family, SOCK_DGRAM, IPPROTO_ICMPV6);
+		if (sd < 0 && (sd = socket (family, SOCK_RAW, IPPROTO_ICMPV6)) >= 0)
+			raw = TRUE;
+		echo = ICMP6_ECHO_REQUEST;
+	} else
+#endif
+	{
+		sd = socket (family, SOCK_DGRAM, IPPROTO_ICMP);
+		if (sd < 0 && (sd = socket (family, SOCK_RAW, IPPROTO_ICMP)) >= 0)
+			raw = TRUE;
+		echo = ICMP_ECHO;
+	}
+	if (sd < 0) {
+		freeaddrinfo (res);
+		return NP_PING_NO_SOCKET;
+	}
+
+	getnameinfo (res->ai_addr, res->ai_addrlen, stats->address,
+	             sizeof (stats->address), NULL, 0, NI_NUMERICHOST);
+
+	/* a connected datagram socket gets ICMP errors reported by recv() */
+	if (!raw && connect (sd, res->ai_addr, res->ai_addrlen) < 0) {
+		stats->error = errno;
+		freeaddrinfo (res);
+		close (sd);
+		return OK;
+	}
+
+	packet = calloc (1, 8 + size);
+	sent_at = calloc (count, sizeof (struct timeval));
+	seen = calloc (count, 1);
+	if (packet == NULL || sent_at == NULL || seen == NULL)
+		die (STATE_UNKNOWN, _("Could not allocate ICMP buffers\n"));
+
+	/* the kernel replaces the identifier of datagram sockets with its own */
+	ident = htons (getpid () & 0xffff);
+	for (len = 0; len < size; len++)
+		packet[8 + len] = (unsigned char) len;
+
+	pfd.fd = sd;
+	pfd.events = POLLIN;
+	gettimeofday (&next_send, NULL);
+
+	while (stats->received < count && stats->error == 0) {
+		gettimeofday (&now, NULL);
+
+		if (stats->sent < count && np_ms_between (&next_send, &now) >= 0) {
+			seq = htons (stats->sent);
+			packet[0] = echo;
+			packet[1] = 0;
+			packet[2] = packet[3] = 0;
+			memcpy (&packet[4], &ident, 2);
+			memcpy (&packet[6], &seq, 2);
+			/* the kernel fills in the ICMPv6 checksum */
+			if (family == AF_INET) {
+				seq = np_icmp_checksum (packet, 8 + size);
+				memcpy (&packet[2], &seq, 2);
+			}
+			sent_at[stats->sent] = now;
+			if (sendto (sd, packet, 8 + size, 0, res->ai_addr, res->ai_addrlen) < 0) {
+				if (errno == ENETUNREACH || errno == EHOSTUNREACH || errno == EACCES)
+					stats->error = errno;
+			}
+			stats->sent++;
+			next_send.tv_sec += interval / 1000;
+			next_send.tv_usec += (interval % 1000) * 1000;
+			if (next_send.tv_usec >= 1000000) {
+				next_send.tv_sec++;
+				next_send.tv_usec -= 1000000;
+			}
+			continue;
+		}
+
+		if (stats->sent < count)
+			wait = (int) np_ms_between (&now, &next_send) + 1;
+		else if ((wait = timeout - (int) np_ms_between (&sent_at[count - 1], &now)) <= 0)
+			break;
+
+		if (poll (&pfd, 1, wait) <= 0)
+			continue;
+
+		if ((len = recv (sd, reply, sizeof (reply), 0)) < 0) {
+			if (errno != EINTR && errno != EAGAIN)
+				stats->error = errno;
+			continue;
+		}
+		gettimeofday (&now, NULL);
+
+		switch (np_icmp_parse (reply, len, family, raw, ident, &seq, &err)) {
+		case NP_ICMP_ECHO_REPLY:
+			break;
+		case NP_ICMP_ERROR:
+			stats->error = err;
+			continue;
+		case NP_ICMP_OTHER:
+			continue;
+		}
+
+		if (seq >= stats->sent)
+			continue;
+		if (seen[seq]++) {
+			stats->duplicates++;
+			continue;
+		}
+
+		rtt = np_ms_between (&sent_at[seq], &now);
+		if (stats->received == 0 || rtt < stats->rta_min)
+			stats->rta_min = rtt;
+		if (rtt > stats->rta_max)
+			stats->rta_max = rtt;
+		total += rtt;
+		stats->received++;
+	}
+
+	if (stats->received > 0)
+		stats->rta_avg = total / stats->received;
+
+	free (packet);
+	free (sent_at);
+	free (seen);
+	freeaddrinfo (res);
+	close (sd);
+
+	return OK;
+}
+
 int
 is_host (const char *address)
 {
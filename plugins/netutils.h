@@ -67,6 +67,39 @@ int np_net_connect(const char *address, int port, int *sd, int proto);
 	send_request(s, IPPROTO_UDP, sbuf, rbuf, rsize)
 int send_request (int sd, int proto, const char *send_buffer, char *recv_buffer, int recv_size);
 
+/* buffered line reader for line based protocols */
+typedef struct np_net_reader {
+	int sd;
+	int (*ssl_read)(void *, int); /* reads through TLS when not NULL */
+	size_t pos;                   /* first byte of data not yet returned */
+	size_t len;                   /* number of bytes in data */
+	char data[MAX_INPUT_BUFFER];
+} np_net_reader;
+
+void np_net_reader_init (np_net_reader *reader, int sd);
+void np_net_reader_use_ssl (np_net_reader *reader, int (*ssl_read)(void *, int));
+int np_net_recvline (np_net_reader *reader, char *buf, size_t bufsize);
+int np_net_recvlines (np_net_reader *reader, char *buf, size_t bufsize);
+
+/* ICMP echo statistics from np_net_ping, times in milliseconds */
+typedef struct np_ping_stats {
+	int sent;
+	int received;
+	int duplicates;
+	double rta_min;
+	double rta_avg;
+	double rta_max;
+	int error;                    /* errno for an ICMP error about the host */
+	char address[INET6_ADDRSTRLEN];
+} np_ping_stats;
+
+/* np_net_ping return values besides OK */
+#define NP_PING_NO_SOCKET -1	/* no ICMP socket could be opened, errno is set */
+#define NP_PING_NO_HOST -2	/* host could not be resolved */
+
+int np_net_ping (const char *host, int count, int size, int interval, int timeout,
+                 np_ping_stats *stats);
+
 
 /* "is_*" wrapper macros and functions */
 int is_host (const char *);
@@ -113,6 +146,34 @@ int np_net_ssl_write(const void *buf, int num);
 int np_net_ssl_read(void *buf, int num);
 int np_net_ssl_check_cert(int days_till_exp_warn, int days_till_exp_crit);
 int np_net_ssl_check_cert_real(SSL *ssl, int days_till_exp_warn, int days_till_exp_crit);
+void np_net_ssl_resume_sessions(const char *host_name, int port);
+int np_net_ssl_session_resumed(void);
+double np_net_ssl_handshake_time(void);
+
+/* one certificate to fetch with np_net_ssl_scan_certs */
+typedef struct np_cert_target {
+	char *host;
+	int port;
+	char *sni;                    /* name to send and verify, host if NULL */
+	int skip;                     /* set by the caller to leave the target out */
+	int status;                   /* STATE_* of handshake, chain, name and expiry */
+	time_t expiry;                /* notAfter of the server certificate, 0 if unknown */
+	char cn[256];
+	char message[256];            /* reason for a non-OK status */
+	/* used while the scan runs */
+	int sd;
+	SSL *ssl;
+	int phase;
+	short events;
+	time_t deadline;
+} np_cert_target;
+
+#  ifdef USE_OPENSSL
+int np_net_ssl_cert_expiry(X509 *certificate, time_t *expiry);
+#  endif
+int np_net_ssl_expiry_status(time_t expiry, int days_till_exp_warn, int days_till_exp_crit);
+int np_net_ssl_scan_certs(np_cert_target *targets, int count, int parallel,
+                          int timeout, int days_till_exp_warn, int days_till_exp_crit);
 #endif /* HAVE_SSL */
 
 #endif /* NAGIOS_NETUGILS_H_INCLUDED_ */
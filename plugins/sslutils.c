@@ -29,12 +29,106 @@
 #define MAX_CN_LENGTH 256
 #include "common.h"
 #include "netutils.h"
+#include <ctype.h>
+#include <fcntl.h>
 
 int check_hostname = 0;
 #ifdef HAVE_SSL
 static SSL_CTX *c=NULL;
 static SSL *s=NULL;
 static int initialized=0;
+static int resume_sessions=0;
+static int session_resumed=0;
+static double handshake_time=0.0;
+
+#ifdef USE_OPENSSL
+/* session saved by the previous check of this host and port */
+static SSL_SESSION *np_net_ssl_load_session(void) {
+	state_data *previous;
+	unsigned char *der;
+	const unsigned char *p;
+	char *hex;
+	SSL_SESSION *session;
+	size_t i, len;
+
+	if ((previous = np_state_read()) == NULL)
+		return NULL;
+	hex = (char *) previous->data;
+	len = strlen(hex) / 2;
+	if (len == 0 || (der = malloc(len)) == NULL)
+		return NULL;
+	for (i = 0; i < len; i++) {
+		if (sscanf(&hex[2 * i], "%2hhx", &der[i]) != 1) {
+			free(der);
+			return NULL;
+		}
+	}
+	p = der;
+	session = d2i_SSL_SESSION(NULL, &p, len);
+	free(der);
+	return session;
+}
+
+/* keep the current session for the next check */
+static void np_net_ssl_save_session(void) {
+	SSL_SESSION *session;
+	unsigned char *der, *p;
+	char *hex;
+	int i, len;
+
+	if ((session = SSL_get1_session(s)) == NULL)
+		return;
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+	if (!SSL_SESSION_is_resumable(session)) {
+		SSL_SESSION_free(session);
+		return;
+	}
+#endif
+	len = i2d_SSL_SESSION(session, NULL);
+	if (len > 0 && (der = malloc(len)) != NULL) {
+		p = der;
+		i2d_SSL_SESSION(session, &p);
+		if ((hex = malloc(2 * len + 1)) != NULL) {
+			for (i = 0; i < len; i++)
+				sprintf(&hex[2 * i], "%02x", der[i]);
+			np_state_write_string(0, hex);
+			free(hex);
+		}
+		free(der);
+	}
+	SSL_SESSION_free(session);
+}
+#endif /* USE_OPENSSL */
+
+/*
+ * Resume TLS sessions across plugin runs: the session of each check is kept
+ * in the state directory under a key for host_name and port and offered to
+ * the server on the next check.  Requires np_init() and must be called
+ * before np_net_ssl_init*().
+ */
+void np_net_ssl_resume_sessions(const char *host_name, int port) {
+	char *key, *p;
+
+	xasprintf(&key, "tls_%s_%d", host_name, port);
+	for (p = key; *p; p++)
+		if (!isalnum((unsigned char) *p))
+			*p = '_';
+	np_enable_state(key, 1);
+	/* the session holds its master secret */
+	np_state_set_secret();
+	free(key);
+	resume_sessions = 1;
+}
+
+/* whether the last handshake resumed a session */
+int np_net_ssl_session_resumed(void) {
+	return session_resumed;
+}
+
+/* duration of the last handshake in seconds */
+double np_net_ssl_handshake_time(void) {
+	return handshake_time;
+}
 
 
 int np_net_ssl_init(int sd) {
@@ -52,6 +146,7 @@ int np_net_ssl_init_with_hostname_and_version(int sd, char *host_name, int versi
 int np_net_ssl_init_with_hostname_version_and_cert(int sd, char *host_name, int version, char *cert, char *privkey) {
 	const SSL_METHOD *method = NULL;
 	long options = 0;	/*SSL_OP_ALL | SSL_OP_SINGLE_DH_USE;*/
+	struct timeval tv;
 
 	switch (version) {
 	case MP_SSLv2: /* SSLv2 protocol */
@@ -171,7 +266,9 @@ int np_net_ssl_init_with_hostname_version_and_cert(int sd, char *host_name, int
 #endif
 	}
 #ifdef SSL_OP_NO_TICKET
-	options |= SSL_OP_NO_TICKET;
+	/* resumption in TLS 1.3 only works with tickets */
+	if (!resume_sessions)
+		options |= SSL_OP_NO_TICKET;
 #endif
 	SSL_CTX_set_options(c, options);
 #ifdef SSL_CTX_set_post_handshake_auth
@@ -184,7 +281,20 @@ int np_net_ssl_init_with_hostname_version_and_cert(int sd, char *host_name, int
 			SSL_set_tlsext_host_name(s, host_name);
 #endif
 		SSL_set_fd(s, sd);
+#ifdef USE_OPENSSL
+		if (resume_sessions) {
+			SSL_SESSION *session = np_net_ssl_load_session();
+			if (session) {
+				SSL_set_session(s, session);
+				SSL_SESSION_free(session);
+			}
+		}
+#endif
+		gettimeofday(&tv, NULL);
+		session_resumed = 0;
 		if (SSL_connect(s) == 1) {
+			handshake_time = (double)deltime(tv) / 1.0e6;
+			session_resumed = SSL_session_reused(s);
 #if OPENSSL_VERSION_NUMBER >= 0x10002000L
 			if (check_hostname && host_name && *host_name) {
 				X509 *certificate=SSL_get_peer_certificate(s);
@@ -210,6 +320,11 @@ int np_net_ssl_init_with_hostname_version_and_cert(int sd, char *host_name, int
 
 void np_net_ssl_cleanup() {
 	if (s) {
+#ifdef USE_OPENSSL
+		/* TLS 1.3 tickets arrive after the handshake, so save the session last */
+		if (resume_sessions)
+			np_net_ssl_save_session();
+#endif
 #ifdef SSL_set_tlsext_host_name
 		SSL_set_tlsext_host_name(s, NULL);
 #endif
@@ -240,6 +355,56 @@ int np_net_ssl_check_cert(int days_till_exp_warn, int days_till_exp_crit){
 #  endif /* USE_OPENSSL */
 }
 
+#  ifdef USE_OPENSSL
+/* notAfter of a certificate, returns ERROR if it can not be parsed */
+int np_net_ssl_cert_expiry(X509 *certificate, time_t *expiry) {
+	ASN1_STRING *tm;
+	struct tm stamp;
+#if OPENSSL_VERSION_NUMBER < 0x10101000L
+	int offset;
+#endif
+
+	tm = X509_get_notAfter(certificate);
+	memset(&stamp, 0, sizeof(stamp));
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+	if (ASN1_TIME_to_tm(tm, &stamp) != 1)
+		return ERROR;
+#else
+	/* Generate tm structure to process timestamp */
+	if (tm->type == V_ASN1_UTCTIME) {
+		if (tm->length < 10)
+			return ERROR;
+		stamp.tm_year = (tm->data[0] - '0') * 10 + (tm->data[1] - '0');
+		if (stamp.tm_year < 50)
+			stamp.tm_year += 100;
+		offset = 0;
+	} else {
+		if (tm->length < 12)
+			return ERROR;
+		stamp.tm_year =
+			(tm->data[0] - '0') * 1000 + (tm->data[1] - '0') * 100 +
+			(tm->data[2] - '0') * 10 + (tm->data[3] - '0');
+		stamp.tm_year -= 1900;
+		offset = 2;
+	}
+	stamp.tm_mon =
+		(tm->data[2 + offset] - '0') * 10 + (tm->data[3 + offset] - '0') - 1;
+	stamp.tm_mday =
+		(tm->data[4 + offset] - '0') * 10 + (tm->data[5 + offset] - '0');
+	stamp.tm_hour =
+		(tm->data[6 + offset] - '0') * 10 + (tm->data[7 + offset] - '0');
+	stamp.tm_min =
+		(tm->data[8 + offset] - '0') * 10 + (tm->data[9 + offset] - '0');
+	stamp.tm_sec =
+		(tm->data[10 + offset] - '0') * 10 + (tm->data[11 + offset] - '0');
+#endif
+	stamp.tm_isdst = -1;
+
+	*expiry = timegm(&stamp);
+	return OK;
+}
+#  endif /* USE_OPENSSL */
+
 int np_net_ssl_check_cert_real(SSL *ssl, int days_till_exp_warn, int days_till_exp_crit){
 #  ifdef USE_OPENSSL
 	X509 *certificate=NULL;
@@ -250,9 +415,6 @@ int np_net_ssl_check_cert_real(SSL *ssl, int days_till_exp_warn, int days_till_e
 	int cnlen =-1;
 	int status=STATE_UNKNOWN;
 
-	ASN1_STRING *tm;
-	int offset;
-	struct tm stamp;
 	float time_left;
 	int days_left;
 	int time_remaining;
@@ -279,44 +441,10 @@ int np_net_ssl_check_cert_real(SSL *ssl, int days_till_exp_warn, int days_till_e
 		strncpy(cn, _("Unknown CN\0"), 12);
 
 	/* Retrieve timestamp of certificate */
-	tm = X509_get_notAfter(certificate);
-
-	/* Generate tm structure to process timestamp */
-	if (tm->type == V_ASN1_UTCTIME) {
-		if (tm->length < 10) {
-			printf("%s\n", _("CRITICAL - Wrong time format in certificate."));
-			return STATE_CRITICAL;
-		} else {
-			stamp.tm_year = (tm->data[0] - '0') * 10 + (tm->data[1] - '0');
-			if (stamp.tm_year < 50)
-				stamp.tm_year += 100;
-			offset = 0;
-		}
-	} else {
-		if (tm->length < 12) {
-			printf("%s\n", _("CRITICAL - Wrong time format in certificate."));
-			return STATE_CRITICAL;
-		} else {
-			stamp.tm_year =
-				(tm->data[0] - '0') * 1000 + (tm->data[1] - '0') * 100 +
-				(tm->data[2] - '0') * 10 + (tm->data[3] - '0');
-			stamp.tm_year -= 1900;
-			offset = 2;
-		}
+	if (np_net_ssl_cert_expiry(certificate, &tm_t) != OK) {
+		printf("%s\n", _("CRITICAL - Wrong time format in certificate."));
+		return STATE_CRITICAL;
 	}
-	stamp.tm_mon =
-		(tm->data[2 + offset] - '0') * 10 + (tm->data[3 + offset] - '0') - 1;
-	stamp.tm_mday =
-		(tm->data[4 + offset] - '0') * 10 + (tm->data[5 + offset] - '0');
-	stamp.tm_hour =
-		(tm->data[6 + offset] - '0') * 10 + (tm->data[7 + offset] - '0');
-	stamp.tm_min =
-		(tm->data[8 + offset] - '0') * 10 + (tm->data[9 + offset] - '0');
-	stamp.tm_sec =
-		(tm->data[10 + offset] - '0') * 10 + (tm->data[11 + offset] - '0');
-	stamp.tm_isdst = -1;
-
-	tm_t = timegm(&stamp);
 	time_left = difftime(tm_t, time(NULL));
 	days_left = time_left / 86400;
 	strftime(timestamp, 50, "%F %R %z/%Z", localtime(&tm_t));
@@ -362,4 +490,275 @@ int np_net_ssl_check_cert_real(SSL *ssl, int days_till_exp_warn, int days_till_e
 #  endif /* USE_OPENSSL */
 }
 
+/* state of an expiry date against the -D style day limits */
+int np_net_ssl_expiry_status(time_t expiry, int days_till_exp_warn, int days_till_exp_crit) {
+	double time_left = difftime(expiry, time(NULL));
+	int days_left = time_left / 86400;
+
+	if (time_left <= 0 || days_left <= days_till_exp_crit)
+		return STATE_CRITICAL;
+	if (days_left <= days_till_exp_warn)
+		return STATE_WARNING;
+	return STATE_OK;
+}
+
+#  ifdef USE_OPENSSL
+#define NP_CERT_IDLE 0
+#define NP_CERT_CONNECTING 1
+#define NP_CERT_HANDSHAKE 2
+#define NP_CERT_DONE 3
+
+static void np_cert_finish(np_cert_target *t, int status, const char *message) {
+	if (t->ssl) {
+		SSL_free(t->ssl);
+		t->ssl = NULL;
+	}
+	if (t->sd >= 0) {
+		close(t->sd);
+		t->sd = -1;
+	}
+	t->status = max_state(t->status, status);
+	if (message && !t->message[0])
+		snprintf(t->message, sizeof(t->message), "%s", message);
+	t->phase = NP_CERT_DONE;
+}
+
+static void np_cert_start(np_cert_target *t, int timeout) {
+	struct addrinfo hints, *res = NULL;
+	char port_str[8];
+	int flags;
+
+	t->phase = NP_CERT_CONNECTING;
+	t->deadline = time(NULL) + timeout;
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = address_family;
+	hints.ai_socktype = SOCK_STREAM;
+	snprintf(port_str, sizeof(port_str), "%d", t->port);
+	if (getaddrinfo(t->host, port_str, &hints, &res) != 0 || res == NULL) {
+		np_cert_finish(t, STATE_CRITICAL, _("Could not resolve host"));
+		return;
+	}
+
+	t->sd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+	if (t->sd < 0) {
+		freeaddrinfo(res);
+		np_cert_finish(t, STATE_UNKNOWN, strerror(errno));
+		return;
+	}
+	flags = fcntl(t->sd, F_GETFL, 0);
+	fcntl(t->sd, F_SETFL, flags | O_NONBLOCK);
+	if (connect(t->sd, res->ai_addr, res->ai_addrlen) < 0 && errno != EINPROGRESS)
+		np_cert_finish(t, STATE_CRITICAL, strerror(errno));
+	freeaddrinfo(res);
+}
+
+/* whether name is an IPv4 or IPv6 address rather than a host name */
+static int np_cert_literal(const char *name) {
+	struct in6_addr addr;
+
+	return inet_pton(AF_INET, name, &addr) == 1 || inet_pton(AF_INET6, name, &addr) == 1;
+}
+
+/* chain, hostname and expiry of the certificate of a finished handshake */
+static void np_cert_validate(np_cert_target *t) {
+	X509 *certificate;
+	X509_NAME *subj;
+	long verify;
+	const char *name = t->sni ? t->sni : t->host;
+	char message[sizeof(t->message)];
+
+	certificate = SSL_get_peer_certificate(t->ssl);
+	if (!certificate) {
+		np_cert_finish(t, STATE_CRITICAL, _("Cannot retrieve server certificate"));
+		return;
+	}
+
+	subj = X509_get_subject_name(certificate);
+	if (!subj || X509_NAME_get_text_by_NID(subj, NID_commonName, t->cn, sizeof(t->cn)) == -1)
+		snprintf(t->cn, sizeof(t->cn), "%s", _("Unknown CN"));
+
+	if (np_net_ssl_cert_expiry(certificate, &t->expiry) != OK) {
+		X509_free(certificate);
+		np_cert_finish(t, STATE_CRITICAL, _("Wrong time format in certificate"));
+		return;
+	}
+
+	verify = SSL_get_verify_result(t->ssl);
+	if (verify != X509_V_OK) {
+		snprintf(message, sizeof(message), _("Certificate chain: %s"),
+		         X509_verify_cert_error_string(verify));
+		t->status = STATE_CRITICAL;
+		snprintf(t->message, sizeof(t->message), "%s", message);
+	}
+#if OPENSSL_VERSION_NUMBER >= 0x10002000L
+	else if (np_cert_literal(name) ? X509_check_ip_asc(certificate, name, 0) != 1 :
+	         X509_check_host(certificate, name, 0, 0, NULL) != 1) {
+		t->status = STATE_CRITICAL;
+		snprintf(t->message, sizeof(t->message), _("Hostname mismatch for %s"), name);
+	}
+#endif
+	X509_free(certificate);
+
+	/* be polite, the connection was only opened for the certificate */
+	SSL_shutdown(t->ssl);
+	np_cert_finish(t, STATE_OK, NULL);
+}
+
+static void np_cert_handshake(np_cert_target *t) {
+	int rc = SSL_do_handshake(t->ssl);
+	unsigned long err;
+
+	if (rc == 1) {
+		np_cert_validate(t);
+		return;
+	}
+	switch (SSL_get_error(t->ssl, rc)) {
+	case SSL_ERROR_WANT_READ:
+		t->events = POLLIN;
+		break;
+	case SSL_ERROR_WANT_WRITE:
+		t->events = POLLOUT;
+		break;
+	default:
+		err = ERR_get_error();
+		np_cert_finish(t, STATE_CRITICAL,
+		               err ? ERR_reason_error_string(err) : _("TLS handshake failed"));
+		ERR_clear_error();
+	}
+}
+
+static void np_cert_connected(np_cert_target *t, SSL_CTX *ctx) {
+	int error = 0;
+	socklen_t len = sizeof(error);
+	const char *name = t->sni ? t->sni : t->host;
+
+	if (getsockopt(t->sd, SOL_SOCKET, SO_ERROR, &error, &len) < 0)
+		error = errno;
+	if (error) {
+		np_cert_finish(t, STATE_CRITICAL, strerror(error));
+		return;
+	}
+
+	if ((t->ssl = SSL_new(ctx)) == NULL) {
+		np_cert_finish(t, STATE_UNKNOWN, _("Cannot create SSL context"));
+		return;
+	}
+#ifdef SSL_set_tlsext_host_name
+	/* literal addresses are not allowed as server names */
+	if (!np_cert_literal(name))
+		SSL_set_tlsext_host_name(t->ssl, name);
+#endif
+	SSL_set_fd(t->ssl, t->sd);
+	SSL_set_connect_state(t->ssl);
+	t->phase = NP_CERT_HANDSHAKE;
+	np_cert_handshake(t);
+}
+#  endif /* USE_OPENSSL */
+
+/*
+ * fetch and validate the certificates of all targets not marked skip,
+ * with up to parallel handshakes in flight and timeout seconds each
+ */
+int np_net_ssl_scan_certs(np_cert_target *targets, int count, int parallel,
+                          int timeout, int days_till_exp_warn, int days_till_exp_crit) {
+#  ifdef USE_OPENSSL
+	SSL_CTX *ctx;
+	struct pollfd *pfd;
+	np_cert_target **active;
+	int next = 0, nactive, i, wait;
+	time_t now;
+
+	if (parallel < 1)
+		parallel = 1;
+
+	SSL_library_init();
+	SSL_load_error_strings();
+	if ((ctx = SSL_CTX_new(SSLv23_client_method())) == NULL)
+		return ERROR;
+	SSL_CTX_set_default_verify_paths(ctx);
+	SSL_CTX_set_verify(ctx, SSL_VERIFY_NONE, NULL);
+	SSL_CTX_set_options(ctx, SSL_OP_NO_SSLv2 | SSL_OP_NO_SSLv3);
+
+	pfd = malloc(sizeof(struct pollfd) * parallel);
+	active = malloc(sizeof(np_cert_target *) * parallel);
+	if (!pfd || !active)
+		die(STATE_UNKNOWN, _("Could not allocate memory\n"));
+
+	for (i = 0; i < count; i++) {
+		targets[i].sd = -1;
+		targets[i].ssl = NULL;
+		targets[i].phase = NP_CERT_IDLE;
+		targets[i].status = STATE_OK;
+		targets[i].expiry = 0;
+		targets[i].cn[0] = '\0';
+		targets[i].message[0] = '\0';
+	}
+
+	nactive = 0;
+	while (1) {
+		/* keep the pipeline full */
+		while (nactive < parallel && next < count) {
+			np_cert_target *t = &targets[next++];
+			if (t->skip)
+				continue;
+			np_cert_start(t, timeout);
+			if (t->phase == NP_CERT_CONNECTING) {
+				t->events = POLLOUT;
+				active[nactive++] = t;
+			}
+		}
+		if (nactive == 0)
+			break;
+
+		now = time(NULL);
+		wait = timeout;
+		for (i = 0; i < nactive; i++) {
+			pfd[i].fd = active[i]->sd;
+			pfd[i].events = active[i]->events;
+			pfd[i].revents = 0;
+			if (active[i]->deadline - now < wait)
+				wait = active[i]->deadline - now;
+		}
+		if (wait < 0)
+			wait = 0;
+		if (poll(pfd, nactive, wait * 1000 + 100) < 0 && errno != EINTR)
+			die(STATE_UNKNOWN, "poll: %s\n", strerror(errno));
+
+		now = time(NULL);
+		for (i = 0; i < nactive; i++) {
+			np_cert_target *t = active[i];
+			if (pfd[i].revents) {
+				if (t->phase == NP_CERT_CONNECTING)
+					np_cert_connected(t, ctx);
+				else
+					np_cert_handshake(t);
+			}
+			if (t->phase != NP_CERT_DONE && now >= t->deadline)
+				np_cert_finish(t, STATE_CRITICAL, t->phase == NP_CERT_CONNECTING ?
+				               _("Timeout while connecting") : _("Timeout during TLS handshake"));
+		}
+
+		/* drop the finished targets */
+		for (i = 0; i < nactive; ) {
+			np_cert_target *t = active[i];
+			if (t->phase == NP_CERT_DONE) {
+				if (t->status == STATE_OK && t->expiry)
+					t->status = np_net_ssl_expiry_status(t->expiry, days_till_exp_warn, days_till_exp_crit);
+				active[i] = active[--nactive];
+			}
+			else
+				i++;
+		}
+	}
+
+	free(pfd);
+	free(active);
+	SSL_CTX_free(ctx);
+	return OK;
+#  else /* ifndef USE_OPENSSL */
+	return ERROR;
+#  endif /* USE_OPENSSL */
+}
+
 #endif /* HAVE_SSL */
@@ -7,6 +7,8 @@
 use strict;
 use Test::More;
 use NPTest;
+use IO::Socket::INET;
+use File::Temp qw(tempdir);
 
 # Required parameters
 my $ssh_service = getTestParameter( "NP_SSH_HOST",
@@ -24,7 +26,7 @@ my $ssh_conf = getTestParameter( "NP_SSH_CONFIGFILE",
 
 plan skip_all => "SSH_HOST and SSH_IDENTITY must be defined" unless ($ssh_service && $ssh_key);
 
-plan tests => 42;
+plan tests => 47;
 
 # Some random check strings/response
 my @response = ('OK: Everything is fine',
@@ -159,3 +161,24 @@ for (0, 1, 2, 3, 4) {
 }
 unlink("/tmp/check_by_ssh.$$") or die("Unable to unlink '/tmp/check_by_ssh.$$': $!");
 
+
+# Master connection, kept for two seconds so it goes away by itself
+SKIP: {
+	skip "No sshd on $ssh_service", 5
+		unless IO::Socket::INET->new( PeerAddr => $ssh_service, PeerPort => 22, Timeout => 5 );
+
+	local $ENV{NAGIOS_PLUGIN_STATE_DIRECTORY} = tempdir( CLEANUP => 1 );
+
+	$result = NPTest->testCmd(
+		"./check_by_ssh -i $ssh_key -H $ssh_service -M 2 -C '$check[0]; exit 0'"
+		);
+	cmp_ok($result->return_code, '==', 0, "First check through a master connection");
+	is($result->output, "$response[0] | ssh_master_reused=0 ssh_master_reuse=0%;;;0;100", "Master connection started");
+
+	$result = NPTest->testCmd(
+		"./check_by_ssh -i $ssh_key -H $ssh_service -M 2 -v -C '$check[1]; exit 1'"
+		);
+	cmp_ok($result->return_code, '==', 1, "Second check through the master connection");
+	like($result->output, '/^Reusing master connection /m', "Master connection reused");
+	like($result->output, '/^' . $responce_re[1] . ' \| ssh_master_reused=1 ssh_master_reuse=50%;;;0;100$/m', "Reuse in perfdata");
+}
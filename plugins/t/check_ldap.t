@@ -0,0 +1,44 @@
+#! /usr/bin/perl -w -I ..
+#
+# Lightweight Directory Access Protocol (LDAP) Tests via check_ldap
+#
+#
+
+use strict;
+use Test::More;
+use NPTest;
+
+plan skip_all => "check_ldap not compiled" unless (-x "check_ldap");
+
+my $ldap_uris = getTestParameter("NP_LDAP_URIS",
+                                 "Space separated URIs of two or more replicas of one LDAP directory",
+                                 "");
+
+my $ldap_base = getTestParameter("NP_LDAP_BASE",
+                                 "The base DN of the LDAP directory",
+                                 "dc=example,dc=com");
+
+plan tests => 8;
+
+my $res;
+
+# servers nobody listens on fail without a time and without entry counts
+$res = NPTest->testCmd( "./check_ldap -U ldap://127.0.0.1:1 -U ldap://127.0.0.1:2 -b $ldap_base --compare -t 5" );
+cmp_ok( $res->return_code, '==', 2, "No server answered" );
+like( $res->output, '/^LDAP CRITICAL - 0 of 2 servers OK/', "Output for no server OK" );
+unlike( $res->output, '/time_127/', "No time for servers that failed" );
+unlike( $res->output, '/entries|-1/', "No entry counts without an answer" );
+
+SKIP: {
+	skip "NP_LDAP_URIS not defined", 4 unless $ldap_uris;
+
+	my $uris = join( " ", map { "-U $_" } split( / /, $ldap_uris ) );
+
+	$res = NPTest->testCmd( "./check_ldap $uris -b $ldap_base -t 5" );
+	cmp_ok( $res->return_code, '==', 0, "All replicas answered" );
+	like( $res->output, '/^LDAP OK - ([0-9]+) of \1 servers OK/', "Output for all servers OK" );
+
+	$res = NPTest->testCmd( "./check_ldap $uris -b $ldap_base --compare -t 5" );
+	like( $res->output, '/contextCSN lag [0-9]+ seconds, [0-9]+ to [0-9]+ entries/', "Replicas compared" );
+	like( $res->output, '/entries_diff=[0-9]+;;;0/', "Entry difference in perfdata" );
+}
@@ -0,0 +1,42 @@
+#! /usr/bin/perl -w -I ..
+#
+# Batched Local Checks via check_local
+#
+#
+
+use strict;
+use Test::More;
+use NPTest;
+
+my $res;
+my $ini = "t/check_local.ini";
+
+plan tests => 16;
+
+$res = NPTest->testCmd( "./check_local -f $ini" );
+cmp_ok( $res->return_code, 'eq', 0, "All default definitions are OK");
+like( $res->output, '/^load LOAD OK - load average: .*\|load1=[0-9.;]+ load5=[0-9.;]+ load15=[0-9.]+;[0-9.]+;[0-9.]+;0;$/m', "Load line");
+like( $res->output, '/^swap SWAP OK - [0-9]+% free/m', "Swap line");
+like( $res->output, '/^uptime UPTIME OK - [0-9]+ day\(s\)/m', "Uptime line");
+like( $res->output, '/^procs PROCS OK - [0-9]+ processes\|procs=[0-9]+;1:;1:;0;$/m', "Procs line");
+like( $res->output, '/^root DISK OK - free space: \/ [0-9]+ MiB/m', "Disk line");
+
+$res = NPTest->testCmd( "./check_local -f $ini -C load -C uptime" );
+cmp_ok( $res->return_code, 'eq', 0, "Selected definitions");
+is( scalar(split /\n/, $res->output), 2, "One line per selected definition");
+
+$res = NPTest->testCmd( "./check_local -f $ini -C missing_command" );
+cmp_ok( $res->return_code, 'eq', 2, "No matching process is critical");
+like( $res->output, "/^missing_command PROCS CRITICAL - 0 processes with command name 'no_such_command_here'/", "Output OK");
+
+$res = NPTest->testCmd( "./check_local -f $ini -C no_plugin" );
+cmp_ok( $res->return_code, 'eq', 3, "Definition without a plugin is unknown");
+like( $res->output, "/^no_plugin LOCAL UNKNOWN - Unknown or missing plugin ''\$/", "No separator without perfdata");
+
+$res = NPTest->testCmd( "./check_local -f $ini -C below_root" );
+cmp_ok( $res->return_code, 'eq', 0, "A path selects the file system it is on");
+like( $res->output, '/^below_root DISK OK - free space: \/ [0-9]+ MiB/', "Best match is /");
+
+$res = NPTest->testCmd( "./check_local -f $ini -C load_no_thresholds" );
+cmp_ok( $res->return_code, 'eq', 3, "Load without thresholds is unknown");
+like( $res->output, '/^load_no_thresholds LOAD UNKNOWN - Warning and critical thresholds are required/', "Output OK");
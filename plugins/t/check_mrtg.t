@@ -0,0 +1,45 @@
+#! /usr/bin/perl -w -I ..
+#
+# MRTG Log Tests via check_mrtg
+#
+#
+
+use strict;
+use Test::More;
+use NPTest;
+
+plan tests => 7;
+
+my $res;
+my $dir = "/tmp/check_mrtg.$$";
+my $then = time() - 300;
+
+sub write_log {
+	my ($file, @lines) = @_;
+	open(my $fh, '>', "$dir/$file") or die "$dir/$file: $!";
+	print $fh map { "$_\n" } @lines;
+	close($fh);
+}
+
+mkdir $dir or die "$dir: $!";
+write_log("cpu.log", "$then 100 200", "$then 40 60 80 95", "$then 30 50 70 90");
+write_log("conns.log", "$then 100 200", "$then 400 10 900 20");
+
+$res = NPTest->testCmd( "./check_mrtg -F $dir/cpu.log -a AVG -v 1 -w 50 -c 90 -l Load -u %" );
+cmp_ok( $res->return_code, '==', 0, "Average under the thresholds" );
+is( $res->output, "OK - Avg. Load = 40 %|Load=40%;50;90;", "Output OK" );
+
+$res = NPTest->testCmd( "./check_mrtg -F $dir/cpu.log -a MAX -v 2 -w 50 -c 90 -l Load -u %" );
+cmp_ok( $res->return_code, '==', 2, "Maximum of the second variable" );
+
+$res = NPTest->testCmd( "./check_mrtg -F $dir/missing.log -v 1 -w 50 -c 90" );
+is( $res->output, "Unable to open MRTG log file", "Missing log" );
+
+$res = NPTest->testCmd( "./check_mrtg -F $dir/cpu.log -e 1 -v 1 -w 50 -c 90" );
+like( $res->output, '/^MRTG data has expired \(5 minutes old\)$/', "Old data" );
+
+$res = NPTest->testCmd( "./check_mrtg -F '$dir/*.log' -v 1 -w 50 -c 500 -l Value" );
+cmp_ok( $res->return_code, '==', 1, "Worst state of all logs" );
+is( $res->output, "WARNING - 2 logs, 0 critical, 1 warning, 0 unknown|conns_Value=400;50;500; cpu_Value=40;50;500;\nconns: WARNING Avg. Value = 400 \ncpu: OK Avg. Value = 40 ", "One line per log" );
+
+system("rm -rf $dir");
@@ -0,0 +1,58 @@
+#! /usr/bin/perl -w -I ..
+#
+# MRTG Traffic Log Tests via check_mrtgtraf
+#
+#
+
+use strict;
+use Test::More;
+use NPTest;
+
+plan tests => 10;
+
+my $res;
+my $dir = "/tmp/check_mrtgtraf.$$";
+my $now = time();
+my $then = $now - 300;
+
+sub write_log {
+	my ($file, @lines) = @_;
+	open(my $fh, '>', "$dir/$file") or die "$dir/$file: $!";
+	print $fh map { "$_\n" } @lines;
+	close($fh);
+}
+
+mkdir $dir or die "$dir: $!";
+$ENV{NAGIOS_PLUGIN_STATE_DIRECTORY} = "$dir/state";
+write_log("eth0.log", "$then 5000000 7000000", "$then 1200 3400 5600 7800", "$then 1100 3300 5500 7700");
+write_log("eth1.log", "$then 100 200", "$then 12 34 56 78");
+
+$res = NPTest->testCmd( "./check_mrtgtraf -F $dir/eth0.log -a AVG -w 2000,4000 -c 3000,5000" );
+cmp_ok( $res->return_code, '==', 0, "Averages under the thresholds" );
+is( $res->output, "Traffic OK - Avg. In = 1.2 KB/s, Avg. Out = 3.3 KB/s|in=1.171875KB;2000.000000;3000.000000;0.000000 out=3.320312KB;4000.000000;5000.000000;0.000000", "Output OK" );
+
+$res = NPTest->testCmd( "./check_mrtgtraf -F $dir/eth0.log -a MAX -w 2000,4000 -c 3000,5000" );
+cmp_ok( $res->return_code, '==', 2, "Maxima over the critical thresholds" );
+
+$res = NPTest->testCmd( "./check_mrtgtraf -F '$dir/*.log' -a AVG -w 1000,4000 -c 3000,5000" );
+cmp_ok( $res->return_code, '==', 1, "Worst state of all logs" );
+like( $res->output, '/^Traffic WARNING - 2 logs, 0 critical, 1 warning, 0 unknown\|eth0_in=[^ ]+ eth0_out=[^ ]+ eth1_in=[^ ]+ eth1_out=[^ ]+\neth0: WARNING Avg. In = 1.2 KB\/s.*\neth1: OK Avg. In = 12.0 B\/s/', "One line per log" );
+
+$res = NPTest->testCmd( "./check_mrtgtraf -F '$dir/none*.log' -w 1,1 -c 2,2" );
+cmp_ok( $res->return_code, '==', 3, "No matching logs" );
+
+# the first run keeps the counters, the next one after MRTG has run uses them
+$res = NPTest->testCmd( "./check_mrtgtraf -F $dir/eth0.log -r -w 20000,20000 -c 30000,30000" );
+like( $res->output, '/^Traffic OK - Avg. In/', "First run falls back to the log" );
+write_log("eth0.log", "$now 8000000 7300000", "$now 1200 3400 5600 7800");
+$res = NPTest->testCmd( "./check_mrtgtraf -F $dir/eth0.log -r -w 20000,20000 -c 30000,30000" );
+like( $res->output, '/^Traffic OK - Rate. In = 9.8 KB\/s, Rate. Out = 1000.0 B\/s\|/', "Rates from the counters" );
+$res = NPTest->testCmd( "./check_mrtgtraf -F $dir/eth0.log -r -w 20000,20000 -c 30000,30000" );
+like( $res->output, '/^Traffic OK - Rate. In = 9.8 KB\/s/', "Rates are kept until MRTG runs again" );
+
+unlink("$dir/eth1.log");
+write_log("eth1.log", "$now 100 200");
+$res = NPTest->testCmd( "./check_mrtgtraf -F '$dir/*.log' -w 1000,4000 -c 3000,5000" );
+like( $res->output, '/\neth1: UNKNOWN Unable to process MRTG log file/', "Broken log is unknown" );
+
+system("rm -rf $dir");
@@ -13,12 +13,13 @@
 use strict;
 use Test::More;
 use NPTest;
+use File::Temp qw(tempdir);
 
 use vars qw($tests);
 
 plan skip_all => "check_mysql not compiled" unless (-x "check_mysql");
 
-plan tests => 15;
+plan tests => 23;
 
 my $bad_login_output = '/Access denied for user /';
 my $mysqlserver = getTestParameter(
@@ -91,3 +92,29 @@ SKIP: {
 	cmp_ok( $result->return_code, '==', 1, 'Alert warning if < 60 seconds behind');
 	like( $result->output, "/^SLOW_SLAVE WARNING:/", "Output okay");
 }
+
+SKIP: {
+	skip "No mysql server defined", 6 unless $mysqlserver;
+	$result = NPTest->testCmd("./check_mysql -H $mysqlserver $mysql_login_details -m Uptime,1:");
+	cmp_ok( $result->return_code, '==', 0, "Selected metric okay");
+	like( $result->output, '/\|Uptime=[0-9.]+;1:;/', "Only the selected metric in perfdata");
+
+	$result = NPTest->testCmd("./check_mysql -H $mysqlserver $mysql_login_details -m Uptime,0:1,0:1");
+	cmp_ok( $result->return_code, '==', 2, "Metric outside its critical range");
+	like( $result->output, '/ Uptime CRITICAL \(/', "Metric listed in the output");
+
+	# rates need the previous run, kept in the state directory
+	$ENV{NAGIOS_PLUGIN_STATE_DIRECTORY} = tempdir( CLEANUP => 1 );
+	$result = NPTest->testCmd("./check_mysql -H $mysqlserver $mysql_login_details -m Questions/s");
+	unlike( $result->output, '/Questions_rate=/', "No rate on the first run");
+	sleep 1;
+	$result = NPTest->testCmd("./check_mysql -H $mysqlserver $mysql_login_details -m Questions/s");
+	like( $result->output, '/\|Questions_rate=[0-9.]+;;;0/', "Rate on the next run");
+}
+
+SKIP: {
+	skip "No mysql server with slaves defined", 2 unless $with_slave;
+	$result = NPTest->testCmd("./check_mysql -S -H $with_slave $with_slave_login -w 60: -m Uptime,0:1,0:1");
+	cmp_ok( $result->return_code, '==', 2, 'Critical metric is not hidden by a slow slave');
+	like( $result->output, "/^SLOW_SLAVE WARNING:.* Uptime CRITICAL/", "Both reported");
+}
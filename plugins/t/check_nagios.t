@@ -7,11 +7,12 @@
 use strict;
 use Test::More;
 use NPTest;
+use POSIX;
 
 if (`uname -s` eq "SunOS\n") {
         plan skip_all => "Ignoring tests on solaris because of pst3";
 } else {
-        plan tests => 13;
+        plan tests => 21;
 }
 
 my $successOutput = '/^NAGIOS OK: /';
@@ -90,3 +91,51 @@ $result = NPTest->testCmd(
 cmp_ok( $result->return_code, "==", 2, "Invalid log file" );
 
 
+
+# the daemon named by the status log or a lock file, this test stands in for it
+$now = time;
+system( "perl -pe 's/1133537302/$now/; s/nagios_pid=2750/nagios_pid=$$/' $nagios2 > $nagios2.tmp" ) == 0 or die "Problem with munging $nagios2";
+
+$result = NPTest->testCmd(
+	"./check_nagios -F $nagios2.tmp -e 1 -C check_nagios.t"
+	);
+cmp_ok( $result->return_code, "==", 0, "Daemon found from nagios_pid" );
+like  ( $result->output, '/^NAGIOS OK: 1 process, status log updated/', "Output for daemon from nagios_pid correct" );
+
+system( "echo 999999 > $nagios2.lock" );
+$result = NPTest->testCmd(
+	"./check_nagios -F $nagios2.tmp -e 1 -C check_nagios.t -L $nagios2.lock"
+	);
+cmp_ok( $result->return_code, "==", 2, "Lock file of a stopped daemon" );
+
+system( "echo $$ > $nagios2.lock" );
+$result = NPTest->testCmd(
+	"./check_nagios -F $nagios1.tmp -e 5 -C check_nagios.t -L $nagios2.lock"
+	);
+cmp_ok( $result->return_code, "==", 0, "Daemon found from lock file" );
+
+$result = NPTest->testCmd(
+	"./check_nagios -F $nagios2.tmp -e 1 -C check_nagios.t -s"
+	);
+like  ( $result->output, '/, check latency 0.000s average over 2 checks\|size=[0-9]+B;;;0 parse_time=[0-9.]+s;;;0.000000 latency_min=0.000000s;;;0.000000 latency_avg=0.000000s;;;0.000000 latency_max=/', "Statistics" );
+
+$result = NPTest->testCmd(
+	"./check_nagios -F $nagios2.tmp -e 1 -C check_nagios.t --latency-critical=\@0"
+	);
+cmp_ok( $result->return_code, "==", 2, "Latency over its threshold" );
+
+# a log filling whole pages, ending in a newline, is scanned without
+# reading past the end of the mapping
+my $page = POSIX::sysconf( &POSIX::_SC_PAGESIZE ) || 4096;
+my $entry = "[$now] PROGRAM;$now;$$;1\n";
+open( my $fh, ">", "$nagios1.page" ) or die "Cannot write $nagios1.page: $!";
+print $fh "# Nagios 1.2 Status File\n", "#" x ($page - 25 - length($entry) - 1), "\n", $entry;
+close( $fh );
+$result = NPTest->testCmd(
+	"./check_nagios -F $nagios1.page -e 1 -C $procname"
+	);
+cmp_ok( -s "$nagios1.page", "==", $page, "Log is exactly one page" );
+cmp_ok( $result->return_code, "==", 0, "Page sized log read" );
+unlink( "$nagios1.page" );
+
+unlink( "$nagios2.lock" );
@@ -7,11 +7,14 @@
 use strict;
 use Test::More;
 use NPTest;
+use IO::Select;
+use IO::Socket::INET;
+use Time::HiRes qw(time);
 
 my @PLUGINS1 = ('check_ntp', 'check_ntp_peer', 'check_ntp_time');
 my @PLUGINS2 = ('check_ntp_peer');
 
-plan tests => (12 * scalar(@PLUGINS1)) + (6 * scalar(@PLUGINS2));
+plan tests => (12 * scalar(@PLUGINS1)) + (6 * scalar(@PLUGINS2)) + 3;
 
 my $res;
 
@@ -108,3 +111,52 @@ foreach my $plugin (@PLUGINS2) {
 		like( $res->output, $ntp_critmatch2, "$plugin: Output match CRITICAL with jitter, stratum, and truechimers" );
 	}
 }
+
+# A control responder which answers every request after $delay seconds,
+# without holding up requests from other clients meanwhile
+sub ntp_control_server {
+	my ($socket, $delay) = @_;
+	my $select = IO::Select->new($socket);
+	my @queue;
+	while (1) {
+		my $wait = @queue ? $queue[0][0] - time : undef;
+		$wait = 0 if (defined $wait && $wait < 0);
+		if ($select->can_read($wait)) {
+			my $from = $socket->recv(my $req, 1024);
+			my ($flags, $op, $seq, $status, $assoc) = unpack("C C n n n", $req);
+			my $data;
+			if (($op & 0x1f) == 1) {
+				# a sync source and a candidate
+				$data = pack("n4", 1, 0x0614, 2, 0x0414);
+			} else {
+				$data = "stratum=2, offset=1.5, jitter=0.300";
+			}
+			$data .= "\0" x ((4 - length($data) % 4) % 4);
+			push @queue, [ time + $delay, $from,
+			    pack("C C n n n n n", $flags, 0x80 | ($op & 0x1f), $seq, 0, $assoc, 0, length($data)) . $data ];
+		}
+		while (@queue && $queue[0][0] <= time) {
+			my $reply = shift @queue;
+			$socket->send($reply->[2], 0, $reply->[1]);
+		}
+	}
+}
+
+# Each server takes 0.8 seconds for its READSTAT and READVAR exchange,
+# more than a fourth of the timeout, so they must be asked at the same time
+my $socket = IO::Socket::INET->new(LocalAddr => "127.0.0.1", Proto => "udp")
+	or die "Cannot open UDP socket: $!";
+my $pid = fork();
+if ($pid == 0) {
+	ntp_control_server($socket, 0.4);
+	exit 0;
+}
+my $port = $socket->sockport;
+$res = NPTest->testCmd(
+	"./check_ntp_peer -H 127.0.0.1 -H 127.0.0.1 -H 127.0.0.1 -H 127.0.0.1 -p $port -t 2"
+	);
+cmp_ok( $res->return_code, '==', 0, "check_ntp_peer: Several slow servers within one timeout" );
+like( $res->output, '/^NTP OK: 4 of 4 servers OK; 127.0.0.1: Offset 0.0015 secs;/', "check_ntp_peer: Output for several servers" );
+like( $res->output, '/servers_ok=4;;;0;4$/', "check_ntp_peer: Servers OK in perfdata" );
+kill 'TERM', $pid;
+waitpid($pid, 0);
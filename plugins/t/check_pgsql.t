@@ -0,0 +1,56 @@
+#! /usr/bin/perl -w -I ..
+#
+# PostgreSQL Database Server Tests via check_pgsql
+#
+#
+#
+# The login needs nothing but CONNECT on the database. Check with:
+#  psql -h $host -U $user $db -c 'SELECT 1'
+
+use strict;
+use Test::More;
+use NPTest;
+
+plan skip_all => "check_pgsql not compiled" unless (-x "check_pgsql");
+
+my $pgsqlserver = getTestParameter(
+		"NP_PGSQL_SERVER",
+		"A PostgreSQL server to connect to"
+		);
+my $pgsql_login_details = getTestParameter(
+		"NP_PGSQL_LOGIN_DETAILS",
+		"Command line parameters to specify login access",
+		"-l postgres -d template1",
+		);
+my $result;
+
+if (! $pgsqlserver) {
+	plan skip_all => "No PostgreSQL server defined";
+} else {
+	plan tests => 11;
+}
+
+my $check = "./check_pgsql -H $pgsqlserver $pgsql_login_details";
+
+$result = NPTest->testCmd("$check");
+cmp_ok( $result->return_code, '==', 0, "Can connect");
+like( $result->output, "/OK - database [^ ]+ \\([0-9.]+ sec.\\)\\|time=/", "Connection output");
+
+$result = NPTest->testCmd("$check -q 'SELECT 1' -W 0:2 -C 0:3");
+cmp_ok( $result->return_code, '==', 0, "Single query");
+like( $result->output, "/^QUERY OK - 'SELECT 1' returned 1.000000\\|query=1.000000;0:2;0:3;;/m", "Single query keeps its output");
+
+$result = NPTest->testCmd("$check -q 'SELECT 1' -n one -q 'SELECT 5' -n five -W 0:2");
+cmp_ok( $result->return_code, '==', 1, "Several queries, the worst state wins");
+like( $result->output, "/^QUERY WARNING - one returned 1.000000, five returned 5.000000\\|one=1.000000;;; five=5.000000;0:2;;\$/m", "Each query with its own thresholds");
+
+$result = NPTest->testCmd("$check -W 0:0 -q 'SELECT 1' -q 'SELECT 0'");
+cmp_ok( $result->return_code, '==', 1, "Thresholds before any -q belong to the first query");
+like( $result->output, "/^QUERY WARNING - query1 returned 1.000000, query2 returned 0.000000\\|query1=1.000000;0:0;; query2=0.000000;;;\$/m", "Queries without a name are numbered");
+
+$result = NPTest->testCmd("$check -q 'SELECT 1/0' -n bad -q 'SELECT 1' -n after");
+cmp_ok( $result->return_code, '==', 2, "A failing query is critical");
+like( $result->output, "/^QUERY CRITICAL - bad: Error with query: .*, after(: Not run after an earlier error.| returned 1.000000)\\|/m", "Queries after a failure are not run in a pipeline");
+
+$result = NPTest->testCmd("$check -q 'SELECT 1' -n first -q 'SELECT 2' -n second -r");
+like( $result->output, "/\\nfirst:\\n.*\\nsecond:\\n/s", "Every result table is printed under its name");
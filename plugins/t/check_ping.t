@@ -8,7 +8,7 @@ use strict;
 use Test::More;
 use NPTest;
 
-plan tests => 20;
+plan tests => 23;
 
 my $successOutput = '/PING (ok|OK) - Packet loss = +[0-9]{1,2}\%, +RTA = [\.0-9]+ ms/';
 my $failureOutput = '/Packet loss = +[0-9]{1,2}\%, +RTA = [\.0-9]+ ms/';
@@ -107,3 +107,15 @@ $res = NPTest->testCmd(
 is( $res->return_code, 3, "No hostname" );
 like( $res->output, '/You must specify a server address or host name/', "Output with appropriate error message");
 
+
+# pinging from within the plugin needs an ICMP socket: an unprivileged
+# one (net.ipv4.ping_group_range) or a raw one
+$res = NPTest->testCmd(
+	"./check_ping -H 127.0.0.1 -w 100,20% -c 200,50% -p 3 -t 10 --icmp-socket -vv"
+	);
+SKIP: {
+	skip "No ICMP socket can be opened here", 3 if $res->output =~ /Could not open ICMP socket/;
+	is( $res->return_code, 0, "Loopback ping with an ICMP socket" );
+	like( $res->output, '/^3 packets transmitted, 3 received, 0 duplicates/m', "All replies read from the socket" );
+	like( $res->output, $successOutput, "Output OK" );
+}
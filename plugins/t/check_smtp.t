@@ -7,6 +7,7 @@
 use strict;
 use Test::More;
 use NPTest;
+use IO::Socket::INET;
 
 my $host_tcp_smtp      = getTestParameter( "NP_HOST_TCP_SMTP", 
 					   "A host providing an SMTP Service (a mail server)", "mailhost");
@@ -22,7 +23,7 @@ my $hostname_invalid   = getTestParameter( "NP_HOSTNAME_INVALID",
                                            "An invalid (not known to DNS) hostname", "nosuchhost" );
 my $res;
 
-plan tests => 10;
+plan tests => 15;
 
 SKIP: {
 	skip "No SMTP server defined", 4 unless $host_tcp_smtp;
@@ -64,3 +65,51 @@ is ($res->return_code, 2, "CRITICAL - host non responding" );
 $res = NPTest->testCmd( "./check_smtp $hostname_invalid" );
 is ($res->return_code, 3, "UNKNOWN - hostname invalid" );
 
+
+# A pipelining server on localhost that refuses anything sent after DATA
+# before its 354 reply, as RFC 2920 forbids that. It takes two connections
+my $listen = IO::Socket::INET->new( LocalAddr => "127.0.0.1", LocalPort => 0, Listen => 1, ReuseAddr => 1 )
+	or die "Cannot listen: $!";
+my $port = $listen->sockport;
+my $pid = fork();
+if ($pid == 0) {
+	CLIENT: for (1..2) {
+		my $client = $listen->accept;
+		my ($buf, $in_data) = ("", 0);
+		print $client "220 localhost ESMTP\r\n";
+		while (sysread($client, $buf, 4096, length $buf)) {
+			while ($buf =~ s/^([^\n]*)\r?\n//) {
+				my $line = $1;
+				if ($line =~ /^QUIT/i) {
+					print $client "221 Bye\r\n";
+					next CLIENT;
+				} elsif ($in_data) {
+					next;
+				} elsif ($line =~ /^EHLO/i) {
+					print $client "250-localhost\r\n250 PIPELINING\r\n";
+				} elsif ($line =~ /^DATA/i) {
+					if (length $buf) {
+						print $client "554 Command sent after DATA\r\n";
+					} else {
+						print $client "354 Go ahead\r\n";
+						$in_data = 1;
+					}
+				} else {
+					print $client "250 OK\r\n";
+				}
+			}
+		}
+	}
+	exit 0;
+}
+close($listen);
+
+$res = NPTest->testCmd( "./check_smtp -H 127.0.0.1 -p $port --pipelining -f nagios\@localhost -C 'RCPT TO:<postmaster\@localhost>' -R 250 -C DATA -R 354 -t 5" );
+is ($res->return_code, 0, "Pipelined DATA as the last command" );
+like ($res->output, "/^SMTP OK/", "Nothing sent after DATA before its reply" );
+unlike ($res->output, "/ cmd1=/", "No command times unless asked for" );
+
+$res = NPTest->testCmd( "./check_smtp -H 127.0.0.1 -p $port --pipelining --command-times -f nagios\@localhost -C 'RCPT TO:<postmaster\@localhost>' -R 250 -C DATA -R 354 -t 5" );
+is ($res->return_code, 0, "Pipelined commands with their times" );
+like ($res->output, "/\\|time=[0-9.]+s;;;0\\S* cmd1=[0-9.]+s;;;0\\S* cmd2=[0-9.]+s;;;0/", "One time per command" );
+waitpid($pid, 0);
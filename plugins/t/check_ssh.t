@@ -7,6 +7,7 @@
 use strict;
 use Test::More;
 use NPTest;
+use IO::Socket::INET;
 
 # Required parameters
 my $ssh_host           = getTestParameter("NP_SSH_HOST",
@@ -23,7 +24,7 @@ my $hostname_invalid   = getTestParameter("NP_HOSTNAME_INVALID",
 
 
 plan skip_all => "SSH_HOST must be defined" unless $ssh_host;
-plan tests    => 6;
+plan tests    => 10;
 
 
 my $result = NPTest->testCmd(
@@ -47,3 +48,34 @@ $result = NPTest->testCmd(
 cmp_ok($result->return_code, '==', 3, "Exit with return code 0 (OK)");
 like($result->output, '/^check_ssh: Invalid hostname/', "Status text if command returned none (OK)");
 
+
+# A server on localhost that sends LINES and then holds the connection
+sub fake_server {
+	my @lines = @_;
+	my $listen = IO::Socket::INET->new( LocalAddr => "127.0.0.1", LocalPort => 0, Listen => 1, ReuseAddr => 1 )
+		or die "Cannot listen: $!";
+	my $port = $listen->sockport;
+	my $pid = fork();
+	if ($pid == 0) {
+		my $client = $listen->accept;
+		print $client $_ foreach @lines;
+		sleep 10;
+		exit 0;
+	}
+	close($listen);
+	return ($port, $pid);
+}
+
+my ($port, $pid) = fake_server("Welcome\r\n", "SSH-2.0-FakeSSH\r\n");
+$result = NPTest->testCmd( "./check_ssh -H 127.0.0.1 -p $port -t 5" );
+cmp_ok($result->return_code, '==', 0, "Lines before the version string are skipped");
+like($result->output, '/^SSH OK - FakeSSH \(protocol 2.0\)/', "Version string found after them");
+kill 'TERM', $pid;
+waitpid($pid, 0);
+
+($port, $pid) = fake_server("220 localhost ESMTP\r\n");
+$result = NPTest->testCmd( "./check_ssh -H 127.0.0.1 -p $port -t 5" );
+cmp_ok($result->return_code, '==', 2, "Other services are critical");
+like($result->output, '/^Server answer: 220 localhost ESMTP/', "Without waiting for the timeout");
+kill 'TERM', $pid;
+waitpid($pid, 0);
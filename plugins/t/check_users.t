@@ -13,7 +13,7 @@ use Test;
 use NPTest;
 
 use vars qw($tests);
-BEGIN {$tests = 4; plan tests => $tests}
+BEGIN {$tests = 10; plan tests => $tests}
 
 my $successOutput = '/^USERS OK - [0-9]+ users currently logged in/';
 my $failureOutput = '/^USERS CRITICAL - [0-9]+ users currently logged in/';
@@ -23,6 +23,51 @@ my $t;
 $t += checkCmd( "./check_users 1000 1000", 0, $successOutput );
 $t += checkCmd( "./check_users    0    0", 2, $failureOutput );
 
+# struct utmpx as glibc lays it out on x86_64
+sub utmp_record {
+	my ($type, $user, $line, $host) = @_;
+	return pack("s x2 l a32 a4 a32 a256 x52", $type, 100, $line, "", $user, $host);
+}
+
+if ( $^O eq 'linux' && `uname -m` =~ /x86_64/ )
+{
+	my $utmp = "/tmp/check_users_utmp.$$";
+	my $wtmp = "/tmp/check_users_wtmp.$$";
+	open(my $fh, '>', $utmp) or die "$utmp: $!";
+	print $fh utmp_record(7, "root", "tty1", "");
+	print $fh utmp_record(7, "alice", "pts/0", "10.0.0.5");
+	print $fh utmp_record(7, "alice", "pts/1", "10.0.0.5");
+	print $fh utmp_record(8, "", "pts/2", "");
+	close($fh);
+
+	# breakdown of the sessions per type, user and host
+	$t += checkCmd( "./check_users -w 5 -c 10 --utmp-file=$utmp -b", 0,
+	                '/^USERS OK - 3 users currently logged in \|users=3;5;10;0 ssh=2;;;0 console=1;;;0 user_root=1;;;0 user_alice=2;;;0 host_10.0.0.5=2;;;0$/' );
+
+	# thresholds per group
+	$t += checkCmd( "./check_users -w 5 -c 10 --utmp-file=$utmp --user-warning=1 --ssh-critical=1", 2,
+	                '/^USERS CRITICAL - 3 users currently logged in, 2 ssh sessions, user alice has 2 sessions /' );
+
+	# the first run records the end of wtmp, the second counts what was added since
+	$ENV{NAGIOS_PLUGIN_STATE_DIRECTORY} = "/tmp/check_users_state.$$";
+	open($fh, '>', $wtmp) or die "$wtmp: $!";
+	print $fh utmp_record(7, "root", "tty1", "");
+	close($fh);
+	NPTest->testCmd( "./check_users -w 5 -c 10 --utmp-file=$utmp --wtmp-file=$wtmp --rate-warning=0" );
+	sleep 1;
+	open($fh, '>>', $wtmp) or die "$wtmp: $!";
+	print $fh utmp_record(7, "alice", "pts/0", "10.0.0.5") x 2;
+	close($fh);
+	$t += checkCmd( "./check_users -w 5 -c 10 --utmp-file=$utmp --wtmp-file=$wtmp --rate-warning=0", 1,
+	                '/, 2 logins in [0-9]+s \([0-9.]+\/min\) \|.* logins=[0-9.]+;0;;0/' );
+
+	system("rm -rf $utmp $wtmp $ENV{NAGIOS_PLUGIN_STATE_DIRECTORY}");
+}
+else
+{
+	for (1..6) { $t += skip( "utmp fixture needs the glibc x86_64 layout", 1 ); }
+}
+
 exit(0) if defined($Test::Harness::VERSION);
 exit($tests - $t);
 
@@ -46,8 +46,13 @@ if ($pid) {
 				print $client "930000000&1000000000";
 			} elsif ($arg eq "d") {
 				print $client "UNKNOWN: Drive is not a fixed drive";
+			} elsif ($arg eq "e") {
+				print $client "100000000&1000000000";
 			}
+		} elsif ($command eq "7") {
+			print $client "2000000000&1500000000";
 		}
+		close $client;
 	}
 	exit;
 }
@@ -59,7 +64,7 @@ if ($ARGV[0] && $ARGV[0] eq "-d") {
 }
 
 if (-x "./check_nt") {
-	plan tests => 5;
+	plan tests => 9;
 } else {
 	plan skip_all => "No check_nt compiled";
 }
@@ -78,3 +83,11 @@ is( $result->output, "Free disk space : Invalid drive", "Output right" );
 $result = NPTest->testCmd( "./check_nt -v USEDDISKSPACE -l d" );
 is( $result->return_code, 3, "Fail if -H missing");
 
+
+$result = NPTest->testCmd( "$command -v USEDDISKSPACE -l c -w 80 -c 90 -v USEDDISKSPACE -l e -w 80 -c 95" );
+is( $result->return_code, 1, "Two drives, one in warning");
+is( $result->output, q{c:\ - total: 0.93 Gb - used: 0.07 Gb (7%) - free 0.87 Gb (93%); e:\ - total: 0.93 Gb - used: 0.84 Gb (90%) - free 0.09 Gb (10%) | 'c:\ Used Space'=0.07Gb;0.75;0.84;0.00;0.93 'e:\ Used Space'=0.84Gb;0.75;0.88;0.00;0.93}, "Output right" );
+
+$result = NPTest->testCmd( "$command -w 50 -c 70 -v MEMUSE -v USEDDISKSPACE -l c" );
+is( $result->return_code, 2, "Thresholds before -v apply to all");
+like( $result->output, '/^Memory usage: .* \(75%\) .*; c:\\\\ - total/', "Output right" );
@@ -0,0 +1,93 @@
+#! /usr/bin/perl -w -I ..
+#
+# Test the --cert-list mode of check_tcp against a local openssl s_server
+#
+# The server presents a certificate naming 127.0.0.1 only in an IP entry
+# to clients without SNI and one for localhost to clients asking for
+# localhost, both trusted through SSL_CERT_FILE, so no network or CA is
+# needed.
+
+use strict;
+use Test::More;
+use NPTest;
+use IO::Socket::INET;
+use File::Temp qw(tempdir);
+
+my $openssl = `which openssl 2>/dev/null`;
+chomp $openssl;
+plan skip_all => "openssl is required" unless $openssl;
+plan skip_all => "check_tcp is built without SSL" unless `./check_tcp -h` =~ /--cert-list/;
+
+my $dir = tempdir( CLEANUP => 1 );
+foreach my $cert ( [ "ip", "address", "IP:127.0.0.1" ], [ "name", "localhost", "DNS:localhost" ] ) {
+	my ($file, $cn, $san) = @$cert;
+	system( "$openssl req -x509 -newkey rsa:2048 -nodes -days 30 -subj /CN=$cn -addext subjectAltName=$san "
+	      . "-keyout $dir/$file-key.pem -out $dir/$file-cert.pem >/dev/null 2>&1" ) == 0
+		or plan skip_all => "openssl cannot create test certificates";
+}
+system( "cat $dir/ip-cert.pem $dir/name-cert.pem > $dir/trusted.pem" );
+$ENV{SSL_CERT_FILE} = "$dir/trusted.pem";
+
+# a free port for the server
+my $probe = IO::Socket::INET->new( LocalAddr => "127.0.0.1", LocalPort => 0, Listen => 1, ReuseAddr => 1 )
+	or die "Cannot listen: $!";
+my $port = $probe->sockport;
+close($probe);
+
+my $pid = fork();
+if ($pid == 0) {
+	open( STDIN, "<", "/dev/null" );
+	open( STDOUT, ">", "/dev/null" );
+	open( STDERR, ">", "/dev/null" );
+	exec( $openssl, "s_server", "-quiet", "-accept", "127.0.0.1:$port",
+	      "-cert", "$dir/ip-cert.pem", "-key", "$dir/ip-key.pem",
+	      "-cert2", "$dir/name-cert.pem", "-key2", "$dir/name-key.pem", "-servername", "localhost" );
+	exit 1;
+}
+for (1..50) {
+	last if IO::Socket::INET->new( PeerAddr => "127.0.0.1", PeerPort => $port );
+	select( undef, undef, undef, 0.1 );
+}
+
+plan tests => 10;
+
+my $list = "$dir/list";
+my $res;
+
+sub write_list {
+	open( my $fh, ">", $list ) or die "Cannot write $list: $!";
+	print $fh @_;
+	close($fh);
+}
+
+# an address is verified against the IP entries and sent without SNI
+write_list( "# certificates\n", "\n", "127.0.0.1:$port\n" );
+$res = NPTest->testCmd( "./check_tcp --cert-list=$list -D 1 -t 5" );
+is( $res->return_code, 0, "Address target is OK" );
+like( $res->output, '/^SSL OK - 1 certificates, 0 warning, 0 critical, 0 errors, 0 cached/', "Comments and blank lines are left out" );
+
+# a name is sent as SNI and verified against the DNS entries
+write_list( "localhost:$port\n" );
+$res = NPTest->testCmd( "./check_tcp -4 --cert-list=$list -D 1 -t 5" );
+is( $res->return_code, 0, "Name target with -4 is OK" );
+like( $res->output, '/^SSL OK - 1 certificates/', "Name was sent as SNI" );
+
+# the third field overrides the name of an address
+write_list( "127.0.0.1:$port:localhost\n", "  127.0.0.1:$port  # again\n" );
+$res = NPTest->testCmd( "./check_tcp --cert-list=$list -D 1 -t 5 -v" );
+is( $res->return_code, 0, "SNI of an address target is OK" );
+like( $res->output, "/^127.0.0.1:$port \\(localhost\\) OK - Certificate 'localhost' expires/m", "Certificate for the SNI name" );
+like( $res->output, "/^127.0.0.1:$port OK - Certificate 'address' expires/m", "Whitespace around a target is trimmed" );
+
+# a name the certificate is not for
+write_list( "127.0.0.1:$port:example.com\n" );
+$res = NPTest->testCmd( "./check_tcp --cert-list=$list -D 1 -t 5" );
+is( $res->return_code, 2, "Wrong name is critical" );
+like( $res->output, '/Hostname mismatch for example.com/', "Mismatch reported" );
+
+write_list( "127.0.0.1:$port\n", "no-port-here\n" );
+$res = NPTest->testCmd( "./check_tcp --cert-list=$list -D 1 -t 5" );
+like( $res->output, "/^Invalid line 2 in $list/", "Line without a port is rejected" );
+
+kill 'TERM', $pid;
+waitpid( $pid, 0 );
@@ -0,0 +1,99 @@
+#! /usr/bin/perl -w -I ..
+#
+# Test check_ups by having a stub upsd
+#
+
+use strict;
+use Test::More;
+use NPTest;
+use FindBin qw($Bin);
+
+use IO::Socket;
+use POSIX;
+
+my $port = 50000 + int(rand(1000));
+
+my %vars = (
+	"ups1 ups.status" => "OL CHRG",
+	"ups1 input.voltage" => "230.0",
+	"ups1 battery.charge" => "100",
+	"ups1 ups.load" => "25",
+	"ups1 battery.runtime" => "1800",
+	"ups2 ups.status" => "OB",
+	"ups2 battery.charge" => "40",
+	"ups2 ups.load" => "60",
+);
+
+my $pid = fork();
+if ($pid) {
+	# Parent
+	# give our upsd some time to startup
+	sleep(1);
+} else {
+	# Child
+	my $server = IO::Socket::INET->new(
+		LocalPort => $port,
+		Type => SOCK_STREAM,
+		Reuse => 1,
+		Proto => "tcp",
+		Listen => 10,
+	) or die "Cannot be a tcp server on port $port: $@";
+
+	$server->autoflush(1);
+
+	while (my $client = $server->accept ) {
+		$client->autoflush(1);
+		while (my $line = <$client>) {
+			$line =~ s/\r?\n$//;
+			if ($line eq "LOGOUT") {
+				print $client "OK Goodbye\n";
+				last;
+			} elsif ($line eq "LIST UPS") {
+				print $client "BEGIN LIST UPS\nUPS ups1 \"first\"\nUPS ups2 \"second\"\nEND LIST UPS\n";
+			} elsif ($line =~ /^GET VAR (\S+) (\S+)$/) {
+				if ($1 ne "ups1" && $1 ne "ups2") {
+					print $client "ERR UNKNOWN-UPS\n";
+				} elsif (exists $vars{"$1 $2"}) {
+					print $client "VAR $1 $2 \"" . $vars{"$1 $2"} . "\"\n";
+				} else {
+					print $client "ERR VAR-NOT-SUPPORTED\n";
+				}
+			} else {
+				print $client "ERR UNKNOWN-COMMAND\n";
+			}
+		}
+		close $client;
+	}
+	exit;
+}
+
+END { if ($pid) { print "Killing $pid\n"; kill "INT", $pid } };
+
+if ($ARGV[0] && $ARGV[0] eq "-d") {
+	sleep 1000;
+}
+
+if (-x "./check_ups") {
+	plan tests => 8;
+} else {
+	plan skip_all => "No check_ups compiled";
+}
+
+my $result;
+my $command = "./check_ups -H 127.0.0.1 -p $port";
+
+$result = NPTest->testCmd( "$command -u ups1" );
+is( $result->return_code, 0, "ups1 online");
+is( $result->output, "UPS OK - Status=Online, Charging Utility=230.0V Batt=100.0% Load=25.0% Left=30.0min|voltage=230.000000;;;0.000000 battery=100.000000%;;;0.000000;100.000000 load=25.000000%;;;0.000000;100.000000 left=30.000000;;;0.000000", "Output right" );
+
+$result = NPTest->testCmd( "$command -u ups2 -v BATTPCT -w 50 -c 30" );
+is( $result->return_code, 1, "ups2 on battery");
+like( $result->output, '/^UPS WARNING - Status=On Battery Batt=40.0% Load=60.0% \| ?battery=40.000000%;50.000000;30.000000;0.000000;100.000000 /', "Output right" );
+
+$result = NPTest->testCmd( "$command -u ups3" );
+is( $result->return_code, 2, "Unknown UPS");
+is( $result->output, "CRITICAL - no such UPS 'ups3' on that host", "Output right" );
+
+$result = NPTest->testCmd( "$command -a -v LOADPCT -w 50 -c 80" );
+is( $result->return_code, 1, "All UPS");
+like( $result->output, '/^UPS WARNING - 2 UPS: ups1: Status=Online, Charging .*; ups2: Status=On Battery .*\|ups1_voltage=.* ups2_load=60.000000%;50.000000;80.000000;/', "Output right" );
@@ -649,30 +649,11 @@ char *perfdata (const char *label,
  int maxp,
  long int maxv)
 {
-	char *data = NULL;
+	np_str data = NP_STR_INIT;
 
-	if (strpbrk (label, "'= "))
-		xasprintf (&data, "'%s'=%ld%s;", label, val, uom);
-	else
-		xasprintf (&data, "%s=%ld%s;", label, val, uom);
-
-	if (warnp)
-		xasprintf (&data, "%s%ld;", data, warn);
-	else
-		xasprintf (&data, "%s;", data);
-
-	if (critp)
-		xasprintf (&data, "%s%ld;", data, crit);
-	else
-		xasprintf (&data, "%s;", data);
-
-	if (minp)
-		xasprintf (&data, "%s%ld", data, minv);
-
-	if (maxp)
-		xasprintf (&data, "%s;%ld", data, maxv);
-
-	return data;
+	np_str_perfdata (&data, label, val, uom, warnp, warn, critp, crit,
+	                 minp, minv, maxp, maxv);
+	return np_str_release (&data);
 }
 
 
@@ -688,35 +669,11 @@ char *fperfdata (const char *label,
  int maxp,
  double maxv)
 {
-	char *data = NULL;
-
-	if (strpbrk (label, "'= "))
-		xasprintf (&data, "'%s'=", label);
-	else
-		xasprintf (&data, "%s=", label);
-
-	xasprintf (&data, "%s%f", data, val);
-	xasprintf (&data, "%s%s;", data, uom);
-
-	if (warnp)
-		xasprintf (&data, "%s%f", data, warn);
-
-	xasprintf (&data, "%s;", data);
-
-	if (critp)
-		xasprintf (&data, "%s%f", data, crit);
-
-	xasprintf (&data, "%s;", data);
-
-	if (minp)
-		xasprintf (&data, "%s%f", data, minv);
-
-	if (maxp) {
-		xasprintf (&data, "%s;", data);
-		xasprintf (&data, "%s%f", data, maxv);
-	}
+	np_str data = NP_STR_INIT;
 
-	return data;
+	np_str_fperfdata (&data, label, val, uom, warnp, warn, critp, crit,
+	                  minp, minv, maxp, maxv);
+	return np_str_release (&data);
 }
 
 char *sperfdata (const char *label,
@@ -729,34 +686,10 @@ char *sperfdata (const char *label,
  int maxp,
  double maxv)
 {
-	char *data = NULL;
-	if (strpbrk (label, "'= "))
-		xasprintf (&data, "'%s'=", label);
-	else
-		xasprintf (&data, "%s=", label);
-
-	xasprintf (&data, "%s%f", data, val);
-	xasprintf (&data, "%s%s;", data, uom);
-
-	if (warn!=NULL)
-		xasprintf (&data, "%s%s", data, warn);
-
-	xasprintf (&data, "%s;", data);
-
-	if (crit!=NULL)
-		xasprintf (&data, "%s%s", data, crit);
-
-	xasprintf (&data, "%s;", data);
-
-	if (minp)
-		xasprintf (&data, "%s%f", data, minv);
-
-	if (maxp) {
-		xasprintf (&data, "%s;", data);
-		xasprintf (&data, "%s%f", data, maxv);
-	}
+	np_str data = NP_STR_INIT;
 
-	return data;
+	np_str_sperfdata (&data, label, val, uom, warn, crit, minp, minv, maxp, maxv);
+	return np_str_release (&data);
 }
 
 char *sperfdata_int (const char *label,
@@ -769,34 +702,10 @@ char *sperfdata_int (const char *label,
  int maxp,
  int maxv)
 {
-	char *data = NULL;
-	if (strpbrk (label, "'= "))
-		xasprintf (&data, "'%s'=", label);
-	else
-		xasprintf (&data, "%s=", label);
-
-	xasprintf (&data, "%s%d", data, val);
-	xasprintf (&data, "%s%s;", data, uom);
-
-	if (warn!=NULL)
-		xasprintf (&data, "%s%s", data, warn);
-
-	xasprintf (&data, "%s;", data);
-
-	if (crit!=NULL)
-		xasprintf (&data, "%s%s", data, crit);
-
-	xasprintf (&data, "%s;", data);
-
-	if (minp)
-		xasprintf (&data, "%s%d", data, minv);
-
-	if (maxp) {
-		xasprintf (&data, "%s;", data);
-		xasprintf (&data, "%s%d", data, maxv);
-	}
+	np_str data = NP_STR_INIT;
 
-	return data;
+	np_str_sperfdata_int (&data, label, val, uom, warn, crit, minp, minv, maxp, maxv);
+	return np_str_release (&data);
 }
 
 /* set entire string to lower, no need to return as it works on string in place */
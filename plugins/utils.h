@@ -15,6 +15,7 @@ suite of plugins. */
 
 /* now some functions etc are being defined in ../lib/utils_base.c */
 #include "utils_base.h"
+#include "utils_str.h"
 
 #ifdef NP_EXTRA_OPTS
 /* Include extra-opts functions if compiled in */